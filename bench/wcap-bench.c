@@ -0,0 +1,794 @@
+/*
+ ============================================================================
+ Name        : wcap-bench.c
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet concatenator
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <libgen.h>
+#include <getopt.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+
+// Injects synthetic 802.11 frames into one monitor interface and picks them
+// up again on another, after they went through a wcap client and server,
+// timing each one with the same clock on both ends.
+
+#define BENCH_MAGIC             0x5742454e
+#define BENCH_F_WARMUP          0x00000001
+
+// Radiotap header without any fields
+#define BENCH_RADIOTAP_LEN      8
+#define BENCH_DOT11_HDR_LEN     24
+#define BENCH_FRAME_MIN         (BENCH_DOT11_HDR_LEN + sizeof(struct bench_payload))
+#define BENCH_FRAME_MAX         2304
+
+#define BENCH_SIZES_DEF         "64:7,576:4,1500:1"
+#define BENCH_MIX_MAX           1024
+#define BENCH_META_MAX          16
+
+// Latency histogram: exact below 64 ns, then 32 buckets per power of two,
+// good to about 3%
+#define BENCH_HIST_SUB_BITS     5
+#define BENCH_HIST_SUB          (1 << BENCH_HIST_SUB_BITS)
+#define BENCH_HIST_BUCKETS      ((65 - BENCH_HIST_SUB_BITS) * BENCH_HIST_SUB)
+
+struct bench_payload
+{
+    uint32_t magic;
+    uint32_t flags;
+    uint64_t seq;
+    uint64_t tstamp;
+} __attribute__((packed));
+
+// Broadcast data frames, so nothing waits for an acknowledgement, from an
+// address no real station uses
+static const uint8_t gBenchHdr[BENCH_DOT11_HDR_LEN] =
+{
+    0x08, 0x00, 0x00, 0x00,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0x02, 0x77, 0x63, 0x61, 0x70, 0x62,
+    0x02, 0x77, 0x63, 0x61, 0x70, 0x62,
+    0x00, 0x00
+};
+
+static struct bench_opts
+{
+    const char* tx;
+    const char* txNetns;
+    const char* rx;
+    const char* rxNetns;
+    const char* sizes;
+    unsigned int rate;
+    unsigned int duration;
+    unsigned int warmup;
+    unsigned int drainMs;
+    const char* meta[BENCH_META_MAX];
+    unsigned int metaCount;
+} gOpts = {
+    .sizes = BENCH_SIZES_DEF,
+    .rate = 0,
+    .duration = 10,
+    .warmup = 1,
+    .drainMs = 1000
+};
+
+static struct bench_ctx
+{
+    int txSock;
+    int rxSock;
+    uint16_t mix[BENCH_MIX_MAX];
+    unsigned int mixLen;
+    volatile bool stop;
+    // Written by the sender, read by the receiver once it is done
+    uint64_t txEnd;
+    bool txDone;
+    uint64_t sent;
+    uint64_t sentBytes;
+    uint64_t warmSent;
+    uint64_t txErrs;
+    // Receiver only
+    uint8_t* seen;
+    uint64_t seenBits;
+    uint64_t received;
+    uint64_t receivedBytes;
+    uint64_t warmReceived;
+    uint64_t duplicates;
+    uint64_t foreign;
+    uint64_t hist[BENCH_HIST_BUCKETS];
+    uint64_t latMin;
+    uint64_t latMax;
+} gCtx = { 0 };
+
+enum
+{
+    OPT_TX = 256,
+    OPT_TX_NETNS,
+    OPT_RX,
+    OPT_RX_NETNS,
+    OPT_SIZES,
+    OPT_RATE,
+    OPT_DURATION,
+    OPT_WARMUP,
+    OPT_DRAIN_MS,
+    OPT_META
+};
+
+static const struct option gLongOpts[] =
+{
+    { "help", no_argument, NULL, 'h' },
+    { "tx", required_argument, NULL, OPT_TX },
+    { "tx-netns", required_argument, NULL, OPT_TX_NETNS },
+    { "rx", required_argument, NULL, OPT_RX },
+    { "rx-netns", required_argument, NULL, OPT_RX_NETNS },
+    { "sizes", required_argument, NULL, OPT_SIZES },
+    { "rate", required_argument, NULL, OPT_RATE },
+    { "duration", required_argument, NULL, OPT_DURATION },
+    { "warmup", required_argument, NULL, OPT_WARMUP },
+    { "drain-ms", required_argument, NULL, OPT_DRAIN_MS },
+    { "meta", required_argument, NULL, OPT_META },
+    { NULL, 0, NULL, 0 }
+};
+
+static void usage(const char* name)
+{
+    fprintf(stdout, "Drives 802.11 frames through a wcap client and server and measures them\n");
+    fprintf(stdout, "  Results go to stdout as a single JSON object\n\n");
+    fprintf(stdout, "Usage: %s --tx=IFACE --rx=IFACE [OPTIONS]\n", name);
+    fprintf(stdout, "\t-h                 \tDisplay usage\n");
+    fprintf(stdout, "\t--tx=IFACE         \tMonitor interface to inject into\n");
+    fprintf(stdout, "\t--tx-netns=NAME    \tNetwork namespace IFACE of --tx is in\n");
+    fprintf(stdout, "\t--rx=IFACE         \tMonitor interface the frames come out of\n");
+    fprintf(stdout, "\t--rx-netns=NAME    \tNetwork namespace IFACE of --rx is in\n");
+    fprintf(stdout, "\t--sizes=MIX        \t802.11 frame sizes and weights, SIZE:WEIGHT,...\n");
+    fprintf(stdout, "\t                   \t  (default: %s, at least %zu)\n", BENCH_SIZES_DEF,
+                    BENCH_FRAME_MIN);
+    fprintf(stdout, "\t--rate=N           \tFrames per second, 0 for as fast as possible\n");
+    fprintf(stdout, "\t                   \t  (default: 0)\n");
+    fprintf(stdout, "\t--duration=N       \tSeconds measured (default: 10)\n");
+    fprintf(stdout, "\t--warmup=N         \tSeconds sent before measuring (default: 1)\n");
+    fprintf(stdout, "\t--drain-ms=N       \tHow long to wait for stragglers (default: 1000)\n");
+    fprintf(stdout, "\t--meta=KEY=VALUE   \tCopied into the results, to tell runs apart\n");
+}
+
+static bool parse_uint(const char* str, unsigned int* val)
+{
+    char* end = NULL;
+    unsigned long v = 0;
+
+    errno = 0;
+    v = strtoul(str, &end, 0);
+    if (errno || (end == str) || *end || (v > UINT32_MAX))
+    {
+        return false;
+    }
+    *val = (unsigned int) v;
+    return true;
+}
+
+// Interleave the sizes by weight (smooth weighted round robin) so a mix like
+// 64:7,1500:1 does not go out as runs of the same size
+static bool parse_sizes(const char* str)
+{
+    unsigned int sizes[BENCH_MIX_MAX] = { 0 };
+    unsigned int weights[BENCH_MIX_MAX] = { 0 };
+    int current[BENCH_MIX_MAX] = { 0 };
+    unsigned int count = 0;
+    unsigned int total = 0;
+
+    while (*str && (count < BENCH_MIX_MAX))
+    {
+        char* end = NULL;
+        unsigned long size = strtoul(str, &end, 0);
+        unsigned long weight = 1;
+
+        if ((end == str) || (size < BENCH_FRAME_MIN) || (size > BENCH_FRAME_MAX))
+        {
+            return false;
+        }
+        if (*end == ':')
+        {
+            str = end + 1;
+            weight = strtoul(str, &end, 0);
+            if ((end == str) || !weight)
+            {
+                return false;
+            }
+        }
+        if ((total + weight) > BENCH_MIX_MAX)
+        {
+            return false;
+        }
+        sizes[count] = size;
+        weights[count++] = weight;
+        total += weight;
+
+        if (*end == ',')
+        {
+            end++;
+        }
+        else if (*end)
+        {
+            return false;
+        }
+        str = end;
+    }
+
+    if (!total)
+    {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < total; i++)
+    {
+        unsigned int best = 0;
+
+        for (unsigned int j = 0; j < count; j++)
+        {
+            current[j] += weights[j];
+            best = (current[j] > current[best]) ? j : best;
+        }
+        current[best] -= total;
+        gCtx.mix[i] = sizes[best];
+    }
+    gCtx.mixLen = total;
+
+    return true;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts = { 0 };
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static unsigned int hist_bucket(const uint64_t val)
+{
+    unsigned int msb = 0;
+
+    if (val < (2 * BENCH_HIST_SUB))
+    {
+        return val;
+    }
+    msb = 63 - __builtin_clzll(val);
+    return ((msb - BENCH_HIST_SUB_BITS) * BENCH_HIST_SUB) + (val >> (msb - BENCH_HIST_SUB_BITS));
+}
+
+// Highest value a bucket holds
+static uint64_t hist_value(const unsigned int bucket)
+{
+    unsigned int shift = 0;
+
+    if (bucket < (2 * BENCH_HIST_SUB))
+    {
+        return bucket;
+    }
+    shift = (bucket / BENCH_HIST_SUB) - 1;
+    return (((uint64_t) (bucket - (shift * BENCH_HIST_SUB)) + 1) << shift) - 1;
+}
+
+static uint64_t hist_percentile(const double pct)
+{
+    uint64_t want = 0;
+    uint64_t seen = 0;
+
+    if (!gCtx.received)
+    {
+        return 0;
+    }
+
+    want = (uint64_t) ((pct / 100.0) * gCtx.received);
+    want = (want < 1) ? 1 : want;
+    for (unsigned int i = 0; i < BENCH_HIST_BUCKETS; i++)
+    {
+        seen += gCtx.hist[i];
+        if (seen >= want)
+        {
+            uint64_t val = hist_value(i);
+            return (val > gCtx.latMax) ? gCtx.latMax : val;
+        }
+    }
+
+    return gCtx.latMax;
+}
+
+// Raw socket on an interface that may be in another network namespace; the
+// socket stays in the namespace it was made in
+static int sock_open(const char* ifname, const char* netns)
+{
+    char path[128];
+    struct sockaddr_ll addr = { 0 };
+    int self = -1;
+    int ns = -1;
+    int sock = -1;
+    int size = 64 * 1024 * 1024;
+
+    if (netns)
+    {
+        snprintf(path, sizeof(path), "/var/run/netns/%s", netns);
+        self = open("/proc/self/ns/net", (O_RDONLY | O_CLOEXEC));
+        ns = open(path, (O_RDONLY | O_CLOEXEC));
+        if ((self < 0) || (ns < 0) || (setns(ns, CLONE_NEWNET) < 0))
+        {
+            fprintf(stderr, "Failed to enter network namespace %s: [%d] %s\n", netns, errno,
+                            strerror(errno));
+            goto exit;
+        }
+    }
+
+    sock = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    if (sock < 0)
+    {
+        fprintf(stderr, "Failed to open raw socket: [%d] %s\n", errno, strerror(errno));
+        goto exit;
+    }
+
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = htons(ETH_P_ALL);
+    addr.sll_ifindex = if_nametoindex(ifname);
+    if (!addr.sll_ifindex || (bind(sock, (struct sockaddr*) &addr, sizeof(addr)) < 0))
+    {
+        fprintf(stderr, "Failed to bind to interface %s: [%d] %s\n", ifname, errno,
+                        strerror(errno));
+        close(sock);
+        sock = -1;
+        goto exit;
+    }
+
+    // Deep buffers on both ends, so it is wcap that drops rather than the bench
+    if ((setsockopt(sock, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) < 0) ||
+        (setsockopt(sock, SOL_SOCKET, SO_SNDBUFFORCE, &size, sizeof(size)) < 0))
+    {
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    }
+
+exit:
+
+    if (self >= 0)
+    {
+        if (setns(self, CLONE_NEWNET) < 0)
+        {
+            fprintf(stderr, "Failed to leave network namespace %s\n", netns);
+            if (sock >= 0)
+            {
+                close(sock);
+            }
+            sock = -1;
+        }
+        close(self);
+    }
+    if (ns >= 0)
+    {
+        close(ns);
+    }
+
+    return sock;
+}
+
+static void wait_until(const uint64_t due)
+{
+    uint64_t now = now_ns();
+
+    // Sleep through most of the gap, spin the rest of it
+    if (due > (now + 100000))
+    {
+        struct timespec ts = { 0 };
+        uint64_t wake = due - 50000;
+        ts.tv_sec = wake / 1000000000ULL;
+        ts.tv_nsec = wake % 1000000000ULL;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+    while (now_ns() < due)
+    {
+    }
+}
+
+static void* tx_main(void* arg)
+{
+    uint8_t frame[BENCH_RADIOTAP_LEN + BENCH_FRAME_MAX] = { 0 };
+    struct bench_payload* pl = (struct bench_payload*) (frame + BENCH_RADIOTAP_LEN +
+                                                        BENCH_DOT11_HDR_LEN);
+    uint64_t interval = gOpts.rate ? (1000000000ULL / gOpts.rate) : 0;
+    uint64_t start = now_ns();
+    uint64_t measure = start + (gOpts.warmup * 1000000000ULL);
+    uint64_t end = measure + (gOpts.duration * 1000000000ULL);
+    uint64_t due = start;
+    uint64_t seq = 0;
+
+    (void) arg;
+
+    frame[2] = BENCH_RADIOTAP_LEN;
+    memcpy(frame + BENCH_RADIOTAP_LEN, gBenchHdr, sizeof(gBenchHdr));
+    for (size_t i = BENCH_RADIOTAP_LEN + BENCH_FRAME_MIN; i < sizeof(frame); i++)
+    {
+        frame[i] = i;
+    }
+    pl->magic = htonl(BENCH_MAGIC);
+
+    while (!gCtx.stop)
+    {
+        uint64_t now = 0;
+        size_t len = BENCH_RADIOTAP_LEN + gCtx.mix[seq % gCtx.mixLen];
+        bool warm = false;
+
+        if (interval)
+        {
+            wait_until(due);
+            due += interval;
+        }
+
+        now = now_ns();
+        if (now >= end)
+        {
+            break;
+        }
+        warm = (now < measure);
+
+        pl->flags = warm ? BENCH_F_WARMUP : 0;
+        pl->seq = seq;
+        pl->tstamp = now;
+        if (send(gCtx.txSock, frame, len, 0) != (ssize_t) len)
+        {
+            gCtx.txErrs++;
+            continue;
+        }
+        seq++;
+
+        if (warm)
+        {
+            gCtx.warmSent++;
+        }
+        else
+        {
+            gCtx.sent++;
+            gCtx.sentBytes += len - BENCH_RADIOTAP_LEN;
+        }
+    }
+
+    __atomic_store_n(&gCtx.txEnd, now_ns(), __ATOMIC_RELAXED);
+    __atomic_store_n(&gCtx.txDone, true, __ATOMIC_RELEASE);
+
+    return NULL;
+}
+
+// Track every sequence number so a frame seen twice is not counted twice
+static bool seen_before(const uint64_t seq)
+{
+    if (seq >= gCtx.seenBits)
+    {
+        uint64_t bits = gCtx.seenBits ? gCtx.seenBits : (1ULL << 20);
+        uint8_t* seen = NULL;
+
+        while (bits <= seq)
+        {
+            bits <<= 1;
+        }
+        seen = realloc(gCtx.seen, bits / 8);
+        if (!seen)
+        {
+            return false;
+        }
+        memset(seen + (gCtx.seenBits / 8), 0, (bits - gCtx.seenBits) / 8);
+        gCtx.seen = seen;
+        gCtx.seenBits = bits;
+    }
+
+    if (gCtx.seen[seq / 8] & (1 << (seq % 8)))
+    {
+        return true;
+    }
+    gCtx.seen[seq / 8] |= (1 << (seq % 8));
+
+    return false;
+}
+
+static void rx_frame(const uint8_t* buf, const size_t len, const uint64_t now)
+{
+    const struct bench_payload* pl = NULL;
+    size_t rtlen = 0;
+    uint64_t lat = 0;
+
+    // Whatever radiotap header the receiving radio put in front
+    if (len < 4)
+    {
+        return;
+    }
+    rtlen = buf[2] | (buf[3] << 8);
+    if ((len < (rtlen + BENCH_FRAME_MIN)) ||
+        memcmp(buf + rtlen + 10, gBenchHdr + 10, 12))
+    {
+        gCtx.foreign++;
+        return;
+    }
+
+    pl = (const struct bench_payload*) (buf + rtlen + BENCH_DOT11_HDR_LEN);
+    if (ntohl(pl->magic) != BENCH_MAGIC)
+    {
+        gCtx.foreign++;
+        return;
+    }
+
+    if (seen_before(pl->seq))
+    {
+        gCtx.duplicates++;
+        return;
+    }
+
+    if (pl->flags & BENCH_F_WARMUP)
+    {
+        gCtx.warmReceived++;
+        return;
+    }
+
+    gCtx.received++;
+    gCtx.receivedBytes += len - rtlen;
+
+    lat = (now > pl->tstamp) ? (now - pl->tstamp) : 0;
+    gCtx.hist[hist_bucket(lat)]++;
+    gCtx.latMin = (!gCtx.latMin || (lat < gCtx.latMin)) ? lat : gCtx.latMin;
+    gCtx.latMax = (lat > gCtx.latMax) ? lat : gCtx.latMax;
+}
+
+static void* rx_main(void* arg)
+{
+    uint8_t buf[65536];
+    struct pollfd pfd = { .fd = gCtx.rxSock, .events = POLLIN };
+
+    (void) arg;
+
+    for (;;)
+    {
+        ssize_t cnt = 0;
+
+        // Keep going a while after the sender stopped for frames still queued
+        if (__atomic_load_n(&gCtx.txDone, __ATOMIC_ACQUIRE) &&
+            (now_ns() > (gCtx.txEnd + (gOpts.drainMs * 1000000ULL))))
+        {
+            break;
+        }
+        if (gCtx.stop)
+        {
+            break;
+        }
+
+        if (poll(&pfd, 1, 100) <= 0)
+        {
+            continue;
+        }
+        while ((cnt = recv(gCtx.rxSock, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+        {
+            rx_frame(buf, cnt, now_ns());
+        }
+    }
+
+    return NULL;
+}
+
+static void json_str(FILE* out, const char* str, const size_t len)
+{
+    fputc('"', out);
+    for (size_t i = 0; i < len; i++)
+    {
+        unsigned char c = str[i];
+        if ((c == '"') || (c == '\\'))
+        {
+            fprintf(out, "\\%c", c);
+        }
+        else if (c < 0x20)
+        {
+            fprintf(out, "\\u%04x", c);
+        }
+        else
+        {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void report(FILE* out)
+{
+    double secs = gOpts.duration;
+    uint64_t lost = (gCtx.sent > gCtx.received) ? (gCtx.sent - gCtx.received) : 0;
+
+    fprintf(out, "{\"meta\":{");
+    for (unsigned int i = 0; i < gOpts.metaCount; i++)
+    {
+        const char* eq = strchr(gOpts.meta[i], '=');
+        fprintf(out, "%s", i ? "," : "");
+        json_str(out, gOpts.meta[i], eq - gOpts.meta[i]);
+        fputc(':', out);
+        json_str(out, eq + 1, strlen(eq + 1));
+    }
+    fprintf(out, "},\"tx\":");
+    json_str(out, gOpts.tx, strlen(gOpts.tx));
+    fprintf(out, ",\"rx\":");
+    json_str(out, gOpts.rx, strlen(gOpts.rx));
+    fprintf(out, ",\"sizes\":");
+    json_str(out, gOpts.sizes, strlen(gOpts.sizes));
+    fprintf(out, ",\"rate\":%u,\"duration_s\":%u,\"warmup_s\":%u", gOpts.rate, gOpts.duration,
+                 gOpts.warmup);
+    fprintf(out, ",\"sent\":%llu,\"received\":%llu,\"lost\":%llu,\"duplicates\":%llu"
+                 ",\"tx_errors\":%llu",
+                 (unsigned long long) gCtx.sent, (unsigned long long) gCtx.received,
+                 (unsigned long long) lost, (unsigned long long) gCtx.duplicates,
+                 (unsigned long long) gCtx.txErrs);
+    fprintf(out, ",\"drop_rate\":%.6f", gCtx.sent ? ((double) lost / gCtx.sent) : 0.0);
+    fprintf(out, ",\"tx_pps\":%.1f,\"pps\":%.1f,\"mbps\":%.3f", gCtx.sent / secs,
+                 gCtx.received / secs, (gCtx.receivedBytes * 8.0) / secs / 1e6);
+    fprintf(out, ",\"latency_ns\":{\"min\":%llu,\"p50\":%llu,\"p99\":%llu,\"p999\":%llu"
+                 ",\"max\":%llu}}\n",
+                 (unsigned long long) gCtx.latMin, (unsigned long long) hist_percentile(50.0),
+                 (unsigned long long) hist_percentile(99.0),
+                 (unsigned long long) hist_percentile(99.9),
+                 (unsigned long long) gCtx.latMax);
+}
+
+static void on_signal(int signo)
+{
+    (void) signo;
+    gCtx.stop = true;
+}
+
+int main(int argc, char** argv)
+{
+
+    char* progname = basename(argv[0]);
+    pthread_t tx;
+    pthread_t rx;
+    int c;
+
+    while ((c = getopt_long(argc, argv, "h", gLongOpts, NULL)) != -1)
+    {
+        switch (c)
+        {
+            case 'h':
+            {
+                usage(progname);
+                return EXIT_SUCCESS;
+            }
+            case OPT_TX:
+            {
+                gOpts.tx = optarg;
+                break;
+            }
+            case OPT_TX_NETNS:
+            {
+                gOpts.txNetns = optarg;
+                break;
+            }
+            case OPT_RX:
+            {
+                gOpts.rx = optarg;
+                break;
+            }
+            case OPT_RX_NETNS:
+            {
+                gOpts.rxNetns = optarg;
+                break;
+            }
+            case OPT_SIZES:
+            {
+                gOpts.sizes = optarg;
+                break;
+            }
+            case OPT_RATE:
+            {
+                if (!parse_uint(optarg, &gOpts.rate))
+                {
+                    fprintf(stderr, "Invalid rate: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case OPT_DURATION:
+            {
+                if (!parse_uint(optarg, &gOpts.duration) || !gOpts.duration)
+                {
+                    fprintf(stderr, "Invalid duration: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case OPT_WARMUP:
+            {
+                if (!parse_uint(optarg, &gOpts.warmup))
+                {
+                    fprintf(stderr, "Invalid warmup: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case OPT_DRAIN_MS:
+            {
+                if (!parse_uint(optarg, &gOpts.drainMs))
+                {
+                    fprintf(stderr, "Invalid drain time: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case OPT_META:
+            {
+                if (!strchr(optarg, '=') || (gOpts.metaCount >= BENCH_META_MAX))
+                {
+                    fprintf(stderr, "Invalid meta data: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                gOpts.meta[gOpts.metaCount++] = optarg;
+                break;
+            }
+            default:
+            {
+                usage(progname);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    if (!gOpts.tx || !gOpts.rx)
+    {
+        fprintf(stderr, "Must specify --tx and --rx interfaces\n");
+        return EXIT_FAILURE;
+    }
+    if (!parse_sizes(gOpts.sizes))
+    {
+        fprintf(stderr, "Invalid size mix: %s\n", gOpts.sizes);
+        return EXIT_FAILURE;
+    }
+
+    gCtx.rxSock = sock_open(gOpts.rx, gOpts.rxNetns);
+    gCtx.txSock = sock_open(gOpts.tx, gOpts.txNetns);
+    if ((gCtx.rxSock < 0) || (gCtx.txSock < 0))
+    {
+        return EXIT_FAILURE;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    // The receiver is listening before the first frame goes out
+    if (pthread_create(&rx, NULL, rx_main, NULL) ||
+        pthread_create(&tx, NULL, tx_main, NULL))
+    {
+        fprintf(stderr, "Failed to start threads\n");
+        return EXIT_FAILURE;
+    }
+    pthread_join(tx, NULL);
+    pthread_join(rx, NULL);
+
+    fprintf(stderr, "Sent %llu (%llu warmup), received %llu (%llu warmup), %llu duplicates, "
+                    "%llu not ours\n",
+                    (unsigned long long) gCtx.sent, (unsigned long long) gCtx.warmSent,
+                    (unsigned long long) gCtx.received, (unsigned long long) gCtx.warmReceived,
+                    (unsigned long long) gCtx.duplicates, (unsigned long long) gCtx.foreign);
+    report(stdout);
+
+    close(gCtx.txSock);
+    close(gCtx.rxSock);
+    free(gCtx.seen);
+
+    return gCtx.stop ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,187 @@
+#!/bin/bash
+#
+# Benchmarks a wcap client and server back to back on one machine:
+#
+#   [gen]--air--[client]==veth==[server]--air--[sink]
+#
+# Each side lives in its own network namespace with one end of a veth pair
+# and two mac80211_hwsim radios. The radios of each side share a channel the
+# other side does not use, so the only way from the generator to the sink
+# is through the tunnel. wcap-bench injects on the generator, receives on
+# the sink and prints its results as one JSON object.
+#
+# Without mac80211_hwsim, or with -m veth, each side's air is a veth pair
+# instead: the frames are the same, only no radio driver handles them.
+#
+# Needs root and iproute2, and iw for the radios. mac80211_hwsim is loaded
+# with four radios for the run and unloaded after; one already loaded is
+# someone else's and is left alone, the radios then being veths unless -m
+# hwsim insists. Exits with 77 (skipped) when anything needed is missing.
+
+set -u
+
+WCAP=../src/wcap
+BENCH=./wcap-bench
+DURATION=10
+WARMUP=1
+RATE=0
+SIZES="64:7,576:4,1500:1"
+WCAP_OPTS=""
+LOGDIR=""
+MODE=""
+
+NS_C=wcap-bench-c
+NS_S=wcap-bench-s
+CHAN_C=2412
+CHAN_S=2462
+
+usage()
+{
+    echo "Usage: $0 [-w WCAP] [-b WCAP_BENCH] [-d SECS] [-u SECS] [-r PPS] [-s MIX]"
+    echo "          [-o WCAP_OPTIONS] [-l LOGDIR] [-m hwsim|veth]"
+}
+
+skip()
+{
+    echo "$0: skipped: $*" >&2
+    echo "{\"skipped\":\"$*\"}"
+    exit 77
+}
+
+while getopts "w:b:d:u:r:s:o:l:m:h" opt; do
+    case ${opt} in
+        w) WCAP=${OPTARG} ;;
+        b) BENCH=${OPTARG} ;;
+        d) DURATION=${OPTARG} ;;
+        u) WARMUP=${OPTARG} ;;
+        r) RATE=${OPTARG} ;;
+        s) SIZES=${OPTARG} ;;
+        o) WCAP_OPTS=${OPTARG} ;;
+        l) LOGDIR=${OPTARG} ;;
+        m) MODE=${OPTARG} ;;
+        h) usage; exit 0 ;;
+        *) usage; exit 1 ;;
+    esac
+done
+
+case ${MODE} in
+    ""|hwsim|veth) ;;
+    *) usage; exit 1 ;;
+esac
+
+[ "$(id -u)" = "0" ] || skip "must run as root"
+command -v ip > /dev/null || skip "ip not found"
+[ -x "${WCAP}" ] || skip "${WCAP} not built"
+[ -x "${BENCH}" ] || skip "${BENCH} not built"
+
+# Radios only from a mac80211_hwsim of our own
+if [ -z "${MODE}" ]; then
+    MODE=veth
+    if [ ! -d /sys/module/mac80211_hwsim ] && command -v iw > /dev/null &&
+       modprobe -n -q mac80211_hwsim 2> /dev/null; then
+        MODE=hwsim
+    fi
+fi
+if [ "${MODE}" = "hwsim" ]; then
+    for tool in iw modprobe; do
+        command -v ${tool} > /dev/null || skip "${tool} not found"
+    done
+    [ -d /sys/module/mac80211_hwsim ] && skip "mac80211_hwsim already loaded, not taking its radios"
+fi
+
+# wcap logs to its stdout and stderr, keep them out of the way unless asked for
+if [ -n "${LOGDIR}" ]; then
+    mkdir -p "${LOGDIR}"
+    LOG_C=${LOGDIR}/client.log
+    LOG_S=${LOGDIR}/server.log
+else
+    LOG_C=/dev/null
+    LOG_S=/dev/null
+fi
+
+HWSIM_OURS=0
+PID_C=""
+PID_S=""
+
+cleanup()
+{
+    [ -n "${PID_C}" ] && kill -INT ${PID_C} 2> /dev/null
+    [ -n "${PID_S}" ] && kill -INT ${PID_S} 2> /dev/null
+    wait 2> /dev/null
+    ip netns del ${NS_C} 2> /dev/null
+    ip netns del ${NS_S} 2> /dev/null
+    # Radios go back to the initial namespace with theirs, then away
+    [ ${HWSIM_OURS} = 1 ] && modprobe -r mac80211_hwsim 2> /dev/null
+}
+trap cleanup EXIT
+
+if [ "${MODE}" = "hwsim" ]; then
+    modprobe mac80211_hwsim radios=4 2> /dev/null || skip "mac80211_hwsim not available"
+    HWSIM_OURS=1
+
+    PHYS=""
+    for phy in /sys/class/ieee80211/*; do
+        if [ "$(basename "$(readlink -f ${phy}/device/driver)")" = "mac80211_hwsim" ]; then
+            PHYS="${PHYS} $(basename ${phy})"
+        fi
+    done
+    set -- ${PHYS}
+    [ $# -ge 4 ] || skip "mac80211_hwsim created fewer than 4 radios"
+fi
+
+ip netns add ${NS_C} || exit 1
+ip netns add ${NS_S} || exit 1
+
+# The server's address is made from the last two octets of its MAC
+ip link add wb-c netns ${NS_C} address 02:00:00:00:00:02 type veth \
+    peer name wb-s netns ${NS_S} address 02:00:00:00:00:01 || exit 1
+
+# radio NS CHANNEL NAME: move a radio over and give it only a monitor interface
+radio()
+{
+    for dev in $(ls /sys/class/ieee80211/$1/device/net 2> /dev/null); do
+        iw dev ${dev} del
+    done
+    iw phy $1 set netns name $2 || exit 1
+    ip netns exec $2 iw phy $1 interface add $4 type monitor || exit 1
+    ip -n $2 link set $4 up || exit 1
+    ip netns exec $2 iw dev $4 set freq $3 || exit 1
+}
+
+# air NS NAME NAME: a veth pair in place of two radios on one channel, quiet
+# but for what is sent on it and large enough for any 802.11 frame
+air()
+{
+    ip netns exec $1 sysctl -q -w net.ipv6.conf.all.disable_ipv6=1 \
+        net.ipv6.conf.default.disable_ipv6=1 > /dev/null
+    ip link add $2 netns $1 mtu 2400 type veth peer name $3 netns $1 mtu 2400 || exit 1
+    ip -n $1 link set $2 up || exit 1
+    ip -n $1 link set $3 up || exit 1
+}
+
+if [ "${MODE}" = "hwsim" ]; then
+    radio $1 ${NS_C} ${CHAN_C} wb-cap
+    radio $2 ${NS_C} ${CHAN_C} wb-gen
+    radio $3 ${NS_S} ${CHAN_S} wb-inj
+    radio $4 ${NS_S} ${CHAN_S} wb-sink
+else
+    air ${NS_C} wb-cap wb-gen
+    air ${NS_S} wb-inj wb-sink
+fi
+
+ip netns exec ${NS_S} ${WCAP} -s ${WCAP_OPTS} wb-inj wb-s > ${LOG_S} 2>&1 &
+PID_S=$!
+ip netns exec ${NS_C} ${WCAP} -c 169.254.0.1 ${WCAP_OPTS} wb-cap wb-c > ${LOG_C} 2>&1 &
+PID_C=$!
+
+# Give both ends time to open their sockets
+sleep 2
+kill -0 ${PID_S} 2> /dev/null || { echo "wcap server failed to start" >&2; exit 1; }
+kill -0 ${PID_C} 2> /dev/null || { echo "wcap client failed to start" >&2; exit 1; }
+
+VERSION=$(git -C "$(dirname "$0")" describe --always --dirty 2> /dev/null || echo unknown)
+
+${BENCH} --tx=wb-gen --tx-netns=${NS_C} --rx=wb-sink --rx-netns=${NS_S} \
+         --duration=${DURATION} --warmup=${WARMUP} --rate=${RATE} --sizes=${SIZES} \
+         --meta="version=${VERSION}" --meta="kernel=$(uname -r)" --meta="air=${MODE}" \
+         --meta="wcap_opts=${WCAP_OPTS}"
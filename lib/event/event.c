@@ -0,0 +1,525 @@
+/*
+ ============================================================================
+ Name        : event.c
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet concatenator
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <linux/types.h>
+
+#include "event.h"
+
+// Older headers lack the per epoll busy poll settings of Linux 6.9
+#ifndef EPIOCSPARAMS
+struct epoll_params
+{
+    __u32 busy_poll_usecs;
+    __u16 busy_poll_budget;
+    __u8 prefer_busy_poll;
+    __u8 __pad;
+};
+#define EPIOCSPARAMS        _IOW(0x8A, 0x01, struct epoll_params)
+#endif
+
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+#ifndef SO_BUSY_POLL_BUDGET
+#define SO_BUSY_POLL_BUDGET 70
+#endif
+
+enum
+{
+    EVENT_TYPE_IO,
+    EVENT_TYPE_TIMER,
+    EVENT_TYPE_SIGNAL,
+    EVENT_TYPE_WAKE
+};
+
+static WcapEventSource_t* _source_add(WcapEventLoop_t* loop, const int fd, const int type,
+                                      const uint32_t events, void* arg)
+{
+
+    WcapEventSource_t* src = NULL;
+    struct epoll_event ev = { 0 };
+
+    src = calloc(1, sizeof(*src));
+    if (!src)
+    {
+        fprintf(stderr, "Failed to allocate event source\n");
+        return NULL;
+    }
+
+    src->fd = fd;
+    src->type = type;
+    src->arg = arg;
+
+    ev.events = events | EPOLLET;
+    ev.data.ptr = src;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+    {
+        fprintf(stderr, "Failed to add descriptor [%d] to event loop: [%d] %s\n", fd, errno,
+                        strerror(errno));
+        free(src);
+        return NULL;
+    }
+
+    src->next = loop->sources;
+    loop->sources = src;
+
+    return src;
+}
+
+static void _source_release(WcapEventSource_t* src)
+{
+    // Timer, signal and wakeup descriptors are owned by the loop
+    if (src->type != EVENT_TYPE_IO)
+    {
+        close(src->fd);
+    }
+    free(src);
+}
+
+static void _collect_garbage(WcapEventLoop_t* loop)
+{
+    while (loop->garbage)
+    {
+        WcapEventSource_t* src = loop->garbage;
+        loop->garbage = src->next;
+        _source_release(src);
+    }
+}
+
+static void _dispatch(WcapEventLoop_t* loop, WcapEventSource_t* src, const uint32_t events)
+{
+
+    switch (src->type)
+    {
+        case EVENT_TYPE_IO:
+        {
+            src->cb.io(loop, src->fd, events, src->arg);
+            break;
+        }
+        case EVENT_TYPE_TIMER:
+        {
+            uint64_t expirations = 0;
+            if (read(src->fd, &expirations, sizeof(expirations)) == sizeof(expirations))
+            {
+                src->cb.timer(loop, expirations, src->arg);
+            }
+            break;
+        }
+        case EVENT_TYPE_SIGNAL:
+        {
+            struct signalfd_siginfo info = { 0 };
+            while (!src->removed && (read(src->fd, &info, sizeof(info)) == sizeof(info)))
+            {
+                src->cb.signal(loop, info.ssi_signo, src->arg);
+            }
+            break;
+        }
+        case EVENT_TYPE_WAKE:
+        {
+            eventfd_t val = 0;
+            eventfd_read(src->fd, &val);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+//*****************************************************************************
+
+bool WcapEventLoopCreate(WcapEventLoop_t* loop)
+{
+
+    if (!loop)
+    {
+        return false;
+    }
+
+    memset(loop, 0, sizeof(*loop));
+
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epfd < 0)
+    {
+        fprintf(stderr, "Failed to create event loop: [%d] %s\n", errno, strerror(errno));
+        return false;
+    }
+
+    // Set here rather than in WcapEventLoopRun() so a stop requested by
+    // another thread before the loop gets going is not lost
+    loop->running = true;
+
+    // Lets another thread break the loop out of epoll_wait()
+    loop->wakefd = eventfd(0, (EFD_NONBLOCK | EFD_CLOEXEC));
+    if ((loop->wakefd < 0) || !_source_add(loop, loop->wakefd, EVENT_TYPE_WAKE, EPOLLIN, NULL))
+    {
+        fprintf(stderr, "Failed to create event loop wakeup: [%d] %s\n", errno, strerror(errno));
+        if (loop->wakefd >= 0)
+        {
+            close(loop->wakefd);
+        }
+        close(loop->epfd);
+        memset(loop, 0, sizeof(*loop));
+        return false;
+    }
+
+    return true;
+}
+
+bool WcapEventLoopDestroy(WcapEventLoop_t* loop)
+{
+
+    if (!loop)
+    {
+        return false;
+    }
+
+    while (loop->sources)
+    {
+        WcapEventSource_t* src = loop->sources;
+        loop->sources = src->next;
+        _source_release(src);
+    }
+    _collect_garbage(loop);
+
+    if (loop->epfd > 0)
+    {
+        close(loop->epfd);
+    }
+
+    memset(loop, 0, sizeof(*loop));
+
+    return true;
+}
+
+bool WcapEventLoopRun(WcapEventLoop_t* loop)
+{
+
+    if (!loop || (loop->epfd <= 0))
+    {
+        return false;
+    }
+
+    struct timespec ts = { 0 };
+    uint64_t idle = 0;
+    uint64_t now = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    idle = (ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+
+    while (loop->running)
+    {
+        int timeout = -1;
+        int cnt = 0;
+
+        // Within the spin budget of the last event, poll rather than sleep
+        if (loop->spin)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            now = (ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+            timeout = ((now - idle) < loop->spin) ? 0 : -1;
+        }
+
+        cnt = WcapEventLoopPoll(loop, timeout);
+        if (cnt < 0)
+        {
+            loop->running = false;
+            return false;
+        }
+
+        if (!timeout && !cnt)
+        {
+            loop->spins++;
+        }
+        else if (loop->spin)
+        {
+            // The budget starts over after every event or sleep
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            idle = (ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+            loop->sleeps += (timeout < 0);
+        }
+    }
+
+    return true;
+}
+
+int WcapEventLoopPoll(WcapEventLoop_t* loop, const int timeout)
+{
+
+    struct epoll_event events[WCAP_EVENT_MAX];
+    int cnt = 0;
+
+    if (!loop || (loop->epfd <= 0))
+    {
+        return -1;
+    }
+
+    cnt = epoll_wait(loop->epfd, events, WCAP_EVENT_MAX, timeout);
+    if (cnt < 0)
+    {
+        if (errno == EINTR)
+        {
+            return 0;
+        }
+        fprintf(stderr, "Event loop error: [%d] %s\n", errno, strerror(errno));
+        return -1;
+    }
+
+    for (int i = 0; i < cnt; i++)
+    {
+        WcapEventSource_t* src = events[i].data.ptr;
+        // A callback earlier in this batch may have removed the source
+        if (!src->removed)
+        {
+            _dispatch(loop, src, events[i].events);
+        }
+    }
+
+    _collect_garbage(loop);
+
+    return cnt;
+}
+
+void WcapEventLoopStop(WcapEventLoop_t* loop)
+{
+    if (loop)
+    {
+        loop->running = false;
+        if (loop->wakefd > 0)
+        {
+            eventfd_write(loop->wakefd, 1);
+        }
+    }
+}
+
+void WcapEventLoopSetSpin(WcapEventLoop_t* loop, const uint64_t spin)
+{
+    if (loop)
+    {
+        loop->spin = spin;
+    }
+}
+
+bool WcapEventLoopSetBusyPoll(WcapEventLoop_t* loop, const unsigned int usecs,
+                              const unsigned int budget, const bool prefer)
+{
+
+    struct epoll_params params = { 0 };
+
+    if (!loop || (loop->epfd <= 0) || (budget > 0xffff))
+    {
+        return false;
+    }
+
+    params.busy_poll_usecs = usecs;
+    params.busy_poll_budget = budget;
+    params.prefer_busy_poll = prefer;
+    if (ioctl(loop->epfd, EPIOCSPARAMS, &params) < 0)
+    {
+        fprintf(stderr, "Failed to set event loop busy polling: [%d] %s\n", errno, strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+bool WcapEventSockBusyPoll(const int fd, const unsigned int usecs, const unsigned int budget,
+                           const bool prefer)
+{
+
+    int val = usecs;
+
+    if (fd <= 0)
+    {
+        return false;
+    }
+
+    // Raising it past net.core.busy_read takes CAP_NET_ADMIN
+    if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &val, sizeof(val)) < 0)
+    {
+        fprintf(stderr, "Failed to set busy polling on socket [%d]: [%d] %s\n", fd, errno,
+                strerror(errno));
+        return false;
+    }
+
+    val = prefer;
+    if (prefer && (setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &val, sizeof(val)) < 0))
+    {
+        fprintf(stderr, "Failed to prefer busy polling on socket [%d]: [%d] %s\n", fd, errno,
+                strerror(errno));
+        return false;
+    }
+
+    val = budget;
+    if (budget && (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL_BUDGET, &val, sizeof(val)) < 0))
+    {
+        fprintf(stderr, "Failed to set busy polling budget on socket [%d]: [%d] %s\n", fd, errno,
+                strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+bool WcapEventAdd(WcapEventLoop_t* loop, const int fd, const uint32_t events, WcapEventCb_t cb,
+                  void* arg)
+{
+
+    WcapEventSource_t* src = NULL;
+
+    if (!loop || (fd < 0) || !cb)
+    {
+        return false;
+    }
+
+    src = _source_add(loop, fd, EVENT_TYPE_IO, events, arg);
+    if (!src)
+    {
+        return false;
+    }
+    src->cb.io = cb;
+
+    return true;
+}
+
+bool WcapEventDel(WcapEventLoop_t* loop, const int fd)
+{
+
+    WcapEventSource_t** pos = NULL;
+
+    if (!loop)
+    {
+        return false;
+    }
+
+    for (pos = &loop->sources; *pos; pos = &(*pos)->next)
+    {
+        WcapEventSource_t* src = *pos;
+        if (src->fd == fd)
+        {
+            epoll_ctl(loop->epfd, EPOLL_CTL_DEL, fd, NULL);
+            *pos = src->next;
+            // Freed once the current dispatch round is over
+            src->removed = true;
+            src->next = loop->garbage;
+            loop->garbage = src;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int WcapEventTimerAdd(WcapEventLoop_t* loop, WcapEventTimerCb_t cb, void* arg)
+{
+
+    WcapEventSource_t* src = NULL;
+    int fd = -1;
+
+    if (!loop || !cb)
+    {
+        return -1;
+    }
+
+    // Timers start out disarmed, see WcapEventTimerSet()
+    fd = timerfd_create(CLOCK_MONOTONIC, (TFD_NONBLOCK | TFD_CLOEXEC));
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to create timer: [%d] %s\n", errno, strerror(errno));
+        return -1;
+    }
+
+    src = _source_add(loop, fd, EVENT_TYPE_TIMER, EPOLLIN, arg);
+    if (!src)
+    {
+        close(fd);
+        return -1;
+    }
+    src->cb.timer = cb;
+
+    return fd;
+}
+
+bool WcapEventTimerSet(const int fd, const uint64_t delay, const uint64_t interval)
+{
+
+    struct itimerspec its = { .it_value = { 0 }, .it_interval = { 0 } };
+
+    // A zero delay disarms the timer
+    its.it_value.tv_sec = delay / 1000000000ULL;
+    its.it_value.tv_nsec = delay % 1000000000ULL;
+    its.it_interval.tv_sec = interval / 1000000000ULL;
+    its.it_interval.tv_nsec = interval % 1000000000ULL;
+
+    return (timerfd_settime(fd, 0, &its, NULL) == 0);
+}
+
+bool WcapEventTimerSetAt(const int fd, const uint64_t deadline)
+{
+
+    struct itimerspec its = { .it_value = { 0 }, .it_interval = { 0 } };
+
+    // Zero would disarm rather than fire
+    its.it_value.tv_sec = deadline / 1000000000ULL;
+    its.it_value.tv_nsec = (deadline % 1000000000ULL) | !deadline;
+
+    return (timerfd_settime(fd, TFD_TIMER_ABSTIME, &its, NULL) == 0);
+}
+
+int WcapEventSignalAdd(WcapEventLoop_t* loop, const int signo, WcapEventSignalCb_t cb, void* arg)
+{
+
+    WcapEventSource_t* src = NULL;
+    sigset_t mask;
+    int fd = -1;
+
+    if (!loop || !cb)
+    {
+        return -1;
+    }
+
+    // The signal has to be blocked for it to be delivered through the descriptor
+    sigemptyset(&mask);
+    sigaddset(&mask, signo);
+    if (sigprocmask(SIG_BLOCK, &mask, NULL) < 0)
+    {
+        fprintf(stderr, "Failed to block signal %d: [%d] %s\n", signo, errno, strerror(errno));
+        return -1;
+    }
+
+    fd = signalfd(-1, &mask, (SFD_NONBLOCK | SFD_CLOEXEC));
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to create signal descriptor: [%d] %s\n", errno, strerror(errno));
+        return -1;
+    }
+
+    src = _source_add(loop, fd, EVENT_TYPE_SIGNAL, EPOLLIN, arg);
+    if (!src)
+    {
+        close(fd);
+        return -1;
+    }
+    src->cb.signal = cb;
+
+    return fd;
+}
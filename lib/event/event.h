@@ -0,0 +1,94 @@
+/*
+ ============================================================================
+ Name        : event.h
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet capture and forwarder
+ ============================================================================
+ */
+
+#ifndef _EVENT_H_
+#define _EVENT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <sys/epoll.h>
+
+#define WCAP_EVENT_MAX      64
+
+// What low latency settings start from, in usecs
+#define WCAP_EVENT_BUSY_POLL_DEF    50
+#define WCAP_EVENT_SPIN_DEF         50
+
+typedef struct WcapEventLoop WcapEventLoop_t;
+
+// Socket callbacks must drain their descriptor until EAGAIN: every source is
+// registered edge-triggered and will not be reported again until new data
+// arrives
+typedef void (*WcapEventCb_t)(WcapEventLoop_t* loop, const int fd, const uint32_t events, void* arg);
+typedef void (*WcapEventTimerCb_t)(WcapEventLoop_t* loop, const uint64_t expirations, void* arg);
+typedef void (*WcapEventSignalCb_t)(WcapEventLoop_t* loop, const int signo, void* arg);
+
+typedef struct WcapEventSource
+{
+    int fd;
+    int type;
+    bool removed;
+    union
+    {
+        WcapEventCb_t io;
+        WcapEventTimerCb_t timer;
+        WcapEventSignalCb_t signal;
+    } cb;
+    void* arg;
+    struct WcapEventSource* next;
+} WcapEventSource_t;
+
+struct WcapEventLoop
+{
+    int epfd;
+    int wakefd;
+    volatile bool running;
+    WcapEventSource_t* sources;
+    WcapEventSource_t* garbage;
+    // Spin budget in ns, and how often the loop spun or blocked
+    uint64_t spin;
+    uint64_t spins;
+    uint64_t sleeps;
+};
+
+bool WcapEventLoopCreate(WcapEventLoop_t* loop);
+bool WcapEventLoopDestroy(WcapEventLoop_t* loop);
+
+bool WcapEventLoopRun(WcapEventLoop_t* loop);
+int WcapEventLoopPoll(WcapEventLoop_t* loop, const int timeout);
+// Safe to call from any thread, the loop is woken up if it is blocked
+void WcapEventLoopStop(WcapEventLoop_t* loop);
+// Once events stop coming, keeps polling without blocking for up to 'spin'
+// ns before it sleeps again; 0, the default, always sleeps
+void WcapEventLoopSetSpin(WcapEventLoop_t* loop, const uint64_t spin);
+// Has epoll_wait() busy poll the device queues of the loop's sockets, on
+// kernels that allow it per epoll instance (6.9 and later)
+bool WcapEventLoopSetBusyPoll(WcapEventLoop_t* loop, const unsigned int usecs,
+                              const unsigned int budget, const bool prefer);
+
+// Busy polls the device queue under a socket for up to 'usecs' when it is
+// read with nothing queued; 'prefer' keeps the queue's interrupts off while
+// the application keeps polling it, 'budget' packets at a time (0: default)
+bool WcapEventSockBusyPoll(const int fd, const unsigned int usecs, const unsigned int budget,
+                           const bool prefer);
+
+bool WcapEventAdd(WcapEventLoop_t* loop, const int fd, const uint32_t events, WcapEventCb_t cb,
+                  void* arg);
+bool WcapEventDel(WcapEventLoop_t* loop, const int fd);
+
+int WcapEventTimerAdd(WcapEventLoop_t* loop, WcapEventTimerCb_t cb, void* arg);
+bool WcapEventTimerSet(const int fd, const uint64_t delay, const uint64_t interval);
+// One shot at an absolute CLOCK_MONOTONIC time, one already passed fires at once
+bool WcapEventTimerSetAt(const int fd, const uint64_t deadline);
+
+int WcapEventSignalAdd(WcapEventLoop_t* loop, const int signo, WcapEventSignalCb_t cb, void* arg);
+
+#endif /* _EVENT_H_ */
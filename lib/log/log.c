@@ -0,0 +1,310 @@
+/*
+ ============================================================================
+ Name        : log.c
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet concatenator
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+
+#include "log.h"
+
+// How long the writer sleeps once it has emptied the ring
+#define LOG_IDLE_NS     10000000
+
+typedef struct
+{
+    // Position this slot is ready for: to be written at 'pos', to be read
+    // at 'pos' + 1, as in a Vyukov bounded queue
+    uint64_t seq;
+    uint16_t level;
+    uint16_t len;
+    char text[WCAP_LOG_TEXT_LEN];
+} __attribute__((aligned(64))) LogSlot_t;
+
+static struct
+{
+    // Claimed by producers
+    uint64_t tail __attribute__((aligned(64)));
+    uint64_t drops;
+
+    // Owned by the writer thread
+    uint64_t head __attribute__((aligned(64)));
+    uint64_t dropsSeen;
+
+    bool running __attribute__((aligned(64)));
+    pthread_t tid;
+    uint64_t mask;
+    LogSlot_t* slots;
+} _log;
+
+static const char* _names[] = { "error", "warn", "info", "debug", "trace" };
+
+int gWcapLogLevel = WCAP_LOG_LEVEL_DEF;
+
+static FILE* _stream(const int level)
+{
+    return (level <= WCAP_LOG_WARN) ? stderr : stdout;
+}
+
+static void _write(const int level, const char* text, const size_t len)
+{
+    FILE* f = _stream(level);
+
+    fwrite(text, 1, len, f);
+    fputc('\n', f);
+}
+
+// Writes out whatever is ready, returns how many messages that was
+static unsigned int _drain(void)
+{
+    unsigned int cnt = 0;
+    uint64_t drops = 0;
+
+    for (;;)
+    {
+        LogSlot_t* slot = &_log.slots[_log.head & _log.mask];
+
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != (_log.head + 1))
+        {
+            break;
+        }
+        _write(slot->level, slot->text, slot->len);
+        __atomic_store_n(&slot->seq, (_log.head + _log.mask + 1), __ATOMIC_RELEASE);
+        _log.head++;
+        cnt++;
+    }
+
+    drops = __atomic_load_n(&_log.drops, __ATOMIC_RELAXED);
+    if (drops != _log.dropsSeen)
+    {
+        fprintf(stderr, "Log ring full, %llu messages dropped\n",
+                (unsigned long long) (drops - _log.dropsSeen));
+        _log.dropsSeen = drops;
+        cnt++;
+    }
+
+    if (cnt)
+    {
+        fflush(stdout);
+        fflush(stderr);
+    }
+
+    return cnt;
+}
+
+static void* _writer(void* arg)
+{
+    struct timespec idle = { .tv_sec = 0, .tv_nsec = LOG_IDLE_NS };
+
+    (void) arg;
+    while (__atomic_load_n(&_log.running, __ATOMIC_ACQUIRE))
+    {
+        if (!_drain())
+        {
+            nanosleep(&idle, NULL);
+        }
+    }
+
+    return NULL;
+}
+
+bool WcapLogStart(const unsigned int count)
+{
+
+    unsigned int size = 1;
+    sigset_t all;
+    sigset_t mask;
+    int err = 0;
+
+    if (_log.slots || !count || (count > WCAP_LOG_COUNT_MAX))
+    {
+        return false;
+    }
+
+    while (size < count)
+    {
+        size <<= 1;
+    }
+
+    if (posix_memalign((void**) &_log.slots, 64, (size_t) size * sizeof(LogSlot_t)))
+    {
+        fprintf(stderr, "Failed to allocate log ring of %u messages\n", size);
+        _log.slots = NULL;
+        return false;
+    }
+    for (unsigned int i = 0; i < size; i++)
+    {
+        _log.slots[i].seq = i;
+    }
+    _log.mask = size - 1;
+    _log.head = 0;
+    _log.tail = 0;
+    _log.drops = 0;
+    _log.dropsSeen = 0;
+
+    // What was printed so far must not come out after what is queued
+    fflush(stdout);
+    fflush(stderr);
+
+    // The writer never takes a signal, whenever the caller gets to block the
+    // ones it waits for
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &mask);
+    __atomic_store_n(&_log.running, true, __ATOMIC_RELEASE);
+    err = pthread_create(&_log.tid, NULL, _writer, NULL);
+    pthread_sigmask(SIG_SETMASK, &mask, NULL);
+    if (err)
+    {
+        fprintf(stderr, "Failed to start log thread: [%d] %s\n", err, strerror(err));
+        __atomic_store_n(&_log.running, false, __ATOMIC_RELEASE);
+        free(_log.slots);
+        _log.slots = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+// Only once nothing else logs, the ring goes away with it
+void WcapLogStop(void)
+{
+
+    if (!__atomic_load_n(&_log.running, __ATOMIC_ACQUIRE))
+    {
+        return;
+    }
+
+    __atomic_store_n(&_log.running, false, __ATOMIC_RELEASE);
+    pthread_join(_log.tid, NULL);
+    _drain();
+
+    free(_log.slots);
+    _log.slots = NULL;
+}
+
+bool WcapLogLevelParse(const char* str, int* level)
+{
+
+    if (!str || !level)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < (int) (sizeof(_names) / sizeof(_names[0])); i++)
+    {
+        if (!strcasecmp(str, _names[i]))
+        {
+            *level = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const char* WcapLogLevelName(const int level)
+{
+    if ((level < 0) || (level >= (int) (sizeof(_names) / sizeof(_names[0]))))
+    {
+        return "unknown";
+    }
+    return _names[level];
+}
+
+void WcapLogPrint(const int level, const char* fmt, ...)
+{
+
+    LogSlot_t* slot = NULL;
+    uint64_t pos = 0;
+    va_list ap;
+    int len = 0;
+
+    va_start(ap, fmt);
+
+    if (!__atomic_load_n(&_log.running, __ATOMIC_ACQUIRE))
+    {
+        FILE* f = _stream(level);
+
+        vfprintf(f, fmt, ap);
+        fputc('\n', f);
+        va_end(ap);
+        return;
+    }
+
+    // Claim the next slot, unless the writer has fallen a whole ring behind
+    pos = __atomic_load_n(&_log.tail, __ATOMIC_RELAXED);
+    for (;;)
+    {
+        int64_t diff = 0;
+
+        slot = &_log.slots[pos & _log.mask];
+        diff = (int64_t) (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+        if (!diff)
+        {
+            if (__atomic_compare_exchange_n(&_log.tail, &pos, (pos + 1), true, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            __atomic_fetch_add(&_log.drops, 1, __ATOMIC_RELAXED);
+            va_end(ap);
+            return;
+        }
+        else
+        {
+            pos = __atomic_load_n(&_log.tail, __ATOMIC_RELAXED);
+        }
+    }
+
+    len = vsnprintf(slot->text, sizeof(slot->text), fmt, ap);
+    va_end(ap);
+
+    slot->level = level;
+    slot->len = (len < 0) ? 0 : ((len < (int) sizeof(slot->text)) ? (size_t) len :
+                                                                    (sizeof(slot->text) - 1));
+    __atomic_store_n(&slot->seq, (pos + 1), __ATOMIC_RELEASE);
+}
+
+// Shared by every thread passing the call site, so counts are approximate
+bool WcapLogAllow(WcapLogLimit_t* limit, uint64_t* missed)
+{
+
+    struct timespec ts = { 0 };
+    uint64_t now = 0;
+    uint64_t window = 0;
+
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    now = ts.tv_sec / WCAP_LOG_LIMIT_SECS;
+
+    window = __atomic_load_n(&limit->window, __ATOMIC_RELAXED);
+    if ((now != window) &&
+        __atomic_compare_exchange_n(&limit->window, &window, now, false, __ATOMIC_RELAXED,
+                                    __ATOMIC_RELAXED))
+    {
+        __atomic_store_n(&limit->count, 0, __ATOMIC_RELAXED);
+        *missed = __atomic_exchange_n(&limit->missed, 0, __ATOMIC_RELAXED);
+    }
+
+    if (__atomic_fetch_add(&limit->count, 1, __ATOMIC_RELAXED) < WCAP_LOG_LIMIT_BURST)
+    {
+        return true;
+    }
+    __atomic_fetch_add(&limit->missed, 1, __ATOMIC_RELAXED);
+
+    return false;
+}
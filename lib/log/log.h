@@ -0,0 +1,106 @@
+/*
+ ============================================================================
+ Name        : log.h
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet capture and forwarder
+ ============================================================================
+ */
+
+#ifndef _LOG_H_
+#define _LOG_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Levels, most severe first; errors and warnings go to stderr, the rest to
+// stdout
+enum
+{
+    WCAP_LOG_ERR = 0,
+    WCAP_LOG_WARN,
+    WCAP_LOG_INFO,
+    WCAP_LOG_DEBUG,
+    WCAP_LOG_TRACE
+};
+
+// Messages above this level are not compiled in at all, see configure's
+// --with-log-level
+#ifndef WCAP_LOG_LEVEL_MAX
+#define WCAP_LOG_LEVEL_MAX      WCAP_LOG_DEBUG
+#endif
+
+#define WCAP_LOG_LEVEL_DEF      WCAP_LOG_INFO
+
+#define WCAP_LOG_COUNT_DEF      1024
+#define WCAP_LOG_COUNT_MAX      (1 << 16)
+
+// Longest message kept, the rest is cut off
+#define WCAP_LOG_TEXT_LEN       240
+
+// Rate limited messages: a burst per call site every interval
+#define WCAP_LOG_LIMIT_BURST    10
+#define WCAP_LOG_LIMIT_SECS     1
+
+typedef struct WcapLogLimit
+{
+    uint64_t window;
+    uint32_t count;
+    uint64_t missed;
+} WcapLogLimit_t;
+
+// Level at run time, read before anything is formatted
+extern int gWcapLogLevel;
+
+// Until started, and once stopped, messages are written as they are made;
+// in between they are formatted into a lock-free ring that a thread of its
+// own writes out, so no caller ever blocks on stdout
+bool WcapLogStart(const unsigned int count);
+void WcapLogStop(void);
+
+bool WcapLogLevelParse(const char* str, int* level);
+const char* WcapLogLevelName(const int level);
+
+void WcapLogPrint(const int level, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+bool WcapLogAllow(WcapLogLimit_t* limit, uint64_t* missed);
+
+static inline bool WcapLogEnabled(const int level)
+{
+    return (level <= WCAP_LOG_LEVEL_MAX) && (level <= __atomic_load_n(&gWcapLogLevel, __ATOMIC_RELAXED));
+}
+
+#define WCAP_LOG(level, ...) \
+    do \
+    { \
+        if (WcapLogEnabled(level)) \
+        { \
+            WcapLogPrint((level), __VA_ARGS__); \
+        } \
+    } while (0)
+
+// For messages a packet can trigger: each call site prints no more than a
+// burst a second, then says how many it held back
+#define WCAP_LOG_LIMIT(level, ...) \
+    do \
+    { \
+        static WcapLogLimit_t _limit = { 0 }; \
+        uint64_t _missed = 0; \
+        if (WcapLogEnabled(level) && WcapLogAllow(&_limit, &_missed)) \
+        { \
+            if (_missed) \
+            { \
+                WcapLogPrint((level), "%llu similar messages suppressed", \
+                             (unsigned long long) _missed); \
+            } \
+            WcapLogPrint((level), __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define WCAP_ERR(...)       WCAP_LOG(WCAP_LOG_ERR, __VA_ARGS__)
+#define WCAP_WARN(...)      WCAP_LOG(WCAP_LOG_WARN, __VA_ARGS__)
+#define WCAP_INFO(...)      WCAP_LOG(WCAP_LOG_INFO, __VA_ARGS__)
+#define WCAP_DEBUG(...)     WCAP_LOG(WCAP_LOG_DEBUG, __VA_ARGS__)
+#define WCAP_TRACE(...)     WCAP_LOG(WCAP_LOG_TRACE, __VA_ARGS__)
+
+#endif /* _LOG_H_ */
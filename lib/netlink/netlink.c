@@ -13,6 +13,7 @@
 #include <net/if.h>
 
 #include "netlink.h"
+#include "log.h"
 
 struct _nlcb
 {
@@ -83,7 +84,7 @@ static int _nlack_cb(struct nl_msg* msg, void* arg)
 static int _nlerr_cb(struct sockaddr_nl* nla, struct nlmsgerr* nlerr, void* arg)
 {
     struct nl_ctx* ctx = (struct nl_ctx*)arg;
-    fprintf(stdout, "[%d] %s(%p, %p, %p)\n", __LINE__, __FUNCTION__, nla, nlerr, arg);
+    WCAP_DEBUG("[%d] %s(%p, %p, %p)", __LINE__, __FUNCTION__, nla, nlerr, arg);
     fprintf(stderr, "Netlink error: [%d] %s\n", nlerr->error, nl_geterror(nlerr->error));
     ctx->cb.err = true;
     return NL_OK;
@@ -9,6 +9,7 @@
  */
 
 #include "nl80211.h"
+#include "log.h"
 
 struct iface_wrk
 {
@@ -24,7 +25,7 @@ static int _get_valid_cb(struct nl_msg* msg, void* arg)
     struct nlmsghdr *nlhdr = nlmsg_hdr(msg);
     struct genlmsghdr *gnlh = nlmsg_data(nlhdr);
 
-    fprintf(stdout, "[%d] %s(%p)\n", __LINE__, __FUNCTION__, info);
+    WCAP_DEBUG("[%d] %s(%p)", __LINE__, __FUNCTION__, info);
 
     // Parse all the attributes into the attribute table
     nla_parse(tb, CTRL_ATTR_MAX, genlmsg_attrdata(gnlh, 0), genlmsg_attrlen(gnlh, 0), NULL);
@@ -57,7 +58,7 @@ bool WcapNL80211WifaceCreate(WcapWifaceInfo_t* info)
 
     struct nl_msg* msg = NULL;
 
-    fprintf(stdout, "[%d] %s(%p)\n", __LINE__, __FUNCTION__, info);
+    WCAP_DEBUG("[%d] %s(%p)", __LINE__, __FUNCTION__, info);
 
     // Install callback
     if (!WcapGENLSetCallback(NL_CB_VALID, _new_valid_cb, NULL))
@@ -73,28 +74,28 @@ bool WcapNL80211WifaceCreate(WcapWifaceInfo_t* info)
         return false;
     }
 
-    fprintf(stdout, "[%d] %s(): Adding phy index: %d\n", __LINE__, __FUNCTION__, info->phy.phyindex);
+    WCAP_DEBUG("[%d] %s(): Adding phy index: %d", __LINE__, __FUNCTION__, info->phy.phyindex);
     if (nla_put_u32(msg, NL80211_ATTR_WIPHY, info->phy.phyindex) != 0)
     {
         fprintf(stderr, "Error adding PHY index\n");
         return false;
     }
 
-    fprintf(stdout, "[%d] %s(): Adding ifname: %s\n", __LINE__, __FUNCTION__, info->ifname);
+    WCAP_DEBUG("[%d] %s(): Adding ifname: %s", __LINE__, __FUNCTION__, info->ifname);
     if (nla_put_string(msg, NL80211_ATTR_IFNAME, info->ifname) != 0)
     {
         fprintf(stderr, "Error adding PHY index\n");
         return false;
     }
 
-    fprintf(stdout, "[%d] %s(): Adding iftype: %d\n", __LINE__, __FUNCTION__, info->iftype);
+    WCAP_DEBUG("[%d] %s(): Adding iftype: %d", __LINE__, __FUNCTION__, info->iftype);
     if (nla_put_u32(msg, NL80211_ATTR_IFTYPE, info->iftype) != 0)
     {
         fprintf(stderr, "Error adding interface type\n");
         return false;
     }
 
-    fprintf(stdout, "[%d] %s(): Sending:\n", __LINE__, __FUNCTION__);
+    WCAP_DEBUG("[%d] %s(): Sending:", __LINE__, __FUNCTION__);
     if (!WcapGENLSendMsg(msg))
     {
         fprintf(stderr, "Error sending netlink message\n");
@@ -122,7 +123,7 @@ bool WcapNL80211WifaceDelete(WcapWifaceInfo_t* info)
 
     struct nl_msg* msg = NULL;
 
-    fprintf(stdout, "[%d] %s(%p)\n", __LINE__, __FUNCTION__, info);
+    WCAP_DEBUG("[%d] %s(%p)", __LINE__, __FUNCTION__, info);
 
     // Install callback
     if (!WcapGENLSetCallback(NL_CB_VALID, _new_valid_cb, NULL))
@@ -144,7 +145,7 @@ bool WcapNL80211WifaceDelete(WcapWifaceInfo_t* info)
         return false;
     }
 
-    fprintf(stdout, "[%d] %s(): Sending:\n", __LINE__, __FUNCTION__);
+    WCAP_DEBUG("[%d] %s(): Sending:", __LINE__, __FUNCTION__);
     if (!WcapGENLSendMsg(msg))
     {
         fprintf(stderr, "Error sending netlink message\n");
@@ -2,6 +2,7 @@
 #include <net/if.h>
 
 #include "nl80211.h"
+#include "log.h"
 
 #define PHY_MAXNUM      8
 static WcapPhyInfo_t _phylist[PHY_MAXNUM] = { 0 }; // NOT THREAD SAFE
@@ -37,7 +38,7 @@ static int _phylist_valid_cb(struct nl_msg* msg, void* arg)
 
 static int _phylist_finish_cb(struct nl_msg* msg, void* arg)
 {
-    fprintf(stdout, "[%d] %s(%p, %p)\n", __LINE__, __FUNCTION__, msg, arg);
+    WCAP_DEBUG("[%d] %s(%p, %p)", __LINE__, __FUNCTION__, msg, arg);
     return NL_STOP;
 }
 
@@ -61,7 +62,7 @@ static int _phyinfo_valid_cb(struct nl_msg* msg, void* arg)
 
 static int _phyinfo_finish_cb(struct nl_msg* msg, void* arg)
 {
-    fprintf(stdout, "[%d] %s(%p, %p)\n", __LINE__, __FUNCTION__, msg, arg);
+    WCAP_DEBUG("[%d] %s(%p, %p)", __LINE__, __FUNCTION__, msg, arg);
     return NL_STOP;
 }
 
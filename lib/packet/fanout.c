@@ -0,0 +1,103 @@
+/*
+ ============================================================================
+ Name        : fanout.c
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet concatenator
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/socket.h>
+#include <linux/filter.h>
+#include <linux/if_packet.h>
+
+#include "fanout.h"
+
+// Offset of addr2 within the 802.11 header (frame control, duration, addr1)
+#define IEEE80211_ADDR2_OFFSET  10
+
+static bool _ta_prog_attach(const int fd, const unsigned int count)
+{
+
+    // Loads past the end of the frame end the program with 0, so runts all
+    // land on the first socket
+    struct sock_filter code[] =
+    {
+        // X = radiotap header length (little endian u16 at offset 2)
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 3),
+        BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 8),
+        BPF_STMT(BPF_MISC | BPF_TAX, 0),
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 2),
+        BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+        BPF_STMT(BPF_MISC | BPF_TAX, 0),
+        // A = addr2[0..3] ^ addr2[4..5]
+        BPF_STMT(BPF_LD | BPF_W | BPF_IND, IEEE80211_ADDR2_OFFSET),
+        BPF_STMT(BPF_ST, 0),
+        BPF_STMT(BPF_LD | BPF_H | BPF_IND, IEEE80211_ADDR2_OFFSET + 4),
+        BPF_STMT(BPF_LDX | BPF_MEM, 0),
+        BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0),
+        // Socket index
+        BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, count),
+        BPF_STMT(BPF_RET | BPF_A, 0)
+    };
+    struct sock_fprog prog = { .len = (sizeof(code) / sizeof(code[0])), .filter = code };
+
+    if (setsockopt(fd, SOL_PACKET, PACKET_FANOUT_DATA, &prog, sizeof(prog)) < 0)
+    {
+        fprintf(stderr, "Failed to attach fanout program: [%d] %s\n", errno, strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+bool WcapFanoutJoin(const int fd, const uint16_t group, const WcapFanoutMode_t mode,
+                    const unsigned int count)
+{
+
+    int type = 0;
+    int arg = 0;
+
+    if ((fd < 0) || !count || (count > WCAP_FANOUT_MAX))
+    {
+        return false;
+    }
+
+    switch (mode)
+    {
+        case WCAP_FANOUT_TA:
+            type = PACKET_FANOUT_CBPF;
+            break;
+        case WCAP_FANOUT_HASH:
+            type = PACKET_FANOUT_HASH;
+            break;
+        case WCAP_FANOUT_CPU:
+            type = PACKET_FANOUT_CPU;
+            break;
+        case WCAP_FANOUT_ROLLOVER:
+            type = PACKET_FANOUT_ROLLOVER;
+            break;
+        default:
+            return false;
+    }
+
+    arg = group | (type << 16);
+    if (setsockopt(fd, SOL_PACKET, PACKET_FANOUT, &arg, sizeof(arg)) < 0)
+    {
+        fprintf(stderr, "Failed to join fanout group %u: [%d] %s\n", group, errno, strerror(errno));
+        return false;
+    }
+
+    // The program belongs to the group, any member may (re)attach it
+    if ((mode == WCAP_FANOUT_TA) && !_ta_prog_attach(fd, count))
+    {
+        return false;
+    }
+
+    return true;
+}
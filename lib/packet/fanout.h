@@ -0,0 +1,36 @@
+/*
+ ============================================================================
+ Name        : fanout.h
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet capture and forwarder
+ ============================================================================
+ */
+
+#ifndef _FANOUT_H_
+#define _FANOUT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define WCAP_FANOUT_MAX     64
+
+typedef enum
+{
+    // Hash the transmitter address (802.11 addr2) past the radiotap header,
+    // keeping every transmitter's frames in order on one socket
+    WCAP_FANOUT_TA,
+    // Kernel flow hash; only spreads traffic the flow dissector understands
+    WCAP_FANOUT_HASH,
+    // Socket of the CPU that received the frame
+    WCAP_FANOUT_CPU,
+    // Fill one socket before spilling to the next; frames may be reordered
+    WCAP_FANOUT_ROLLOVER
+} WcapFanoutMode_t;
+
+// Join a bound AF_PACKET socket to fanout group 'group' of 'count' sockets
+bool WcapFanoutJoin(const int fd, const uint16_t group, const WcapFanoutMode_t mode,
+                    const unsigned int count);
+
+#endif /* _FANOUT_H_ */
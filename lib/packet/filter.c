@@ -0,0 +1,626 @@
+/*
+ ============================================================================
+ Name        : filter.c
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet concatenator
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+
+#include <sys/socket.h>
+
+#include "filter.h"
+
+#define FILTER_TOKENS_MAX   256
+#define FILTER_NODES_MAX    256
+#define FILTER_LABELS_MAX   (FILTER_NODES_MAX + 2)
+
+// Bytes kept of an accepted frame, anything larger than a frame will do
+#define FILTER_SNAPLEN      262144
+
+// 802.11 frame control (first byte) and address offsets
+#define IEEE80211_FC_TYPE       0x0c
+#define IEEE80211_FC_SUBTYPE    0xf0
+#define IEEE80211_ADDR1_OFFSET  4
+#define IEEE80211_ADDR2_OFFSET  10
+#define IEEE80211_ADDR3_OFFSET  16
+
+enum
+{
+    NODE_OR,
+    NODE_AND,
+    NODE_NOT,
+    NODE_TYPE,
+    NODE_SUBTYPE,
+    NODE_ADDR
+};
+
+// Jump targets that are not labels
+#define LABEL_NEXT  -1
+
+struct _node
+{
+    int op;
+    int left;
+    int right;
+    uint8_t type;
+    uint8_t subtype;
+    unsigned int offset;
+    uint8_t mac[6];
+};
+
+struct _compiler
+{
+    char* text;
+    char* tokens[FILTER_TOKENS_MAX];
+    unsigned int ntok;
+    unsigned int pos;
+    struct _node nodes[FILTER_NODES_MAX];
+    unsigned int nnode;
+    struct sock_filter code[WCAP_FILTER_INSNS_MAX];
+    int jt[WCAP_FILTER_INSNS_MAX];
+    int jf[WCAP_FILTER_INSNS_MAX];
+    unsigned int len;
+    int labels[FILTER_LABELS_MAX];
+    unsigned int nlabel;
+};
+
+static const char* _types[] = { "mgt", "ctl", "data" };
+
+static const struct
+{
+    const char* name;
+    uint8_t type;
+    uint8_t subtype;
+} _subtypes[] =
+{
+    { "assoc-req", 0, 0 }, { "assoc-resp", 0, 1 }, { "reassoc-req", 0, 2 },
+    { "reassoc-resp", 0, 3 }, { "probe-req", 0, 4 }, { "probe-resp", 0, 5 },
+    { "beacon", 0, 8 }, { "atim", 0, 9 }, { "disassoc", 0, 10 }, { "auth", 0, 11 },
+    { "deauth", 0, 12 }, { "action", 0, 13 }, { "action-no-ack", 0, 14 },
+    { "bar", 1, 8 }, { "ba", 1, 9 }, { "ps-poll", 1, 10 }, { "rts", 1, 11 }, { "cts", 1, 12 },
+    { "ack", 1, 13 }, { "cf-end", 1, 14 }, { "cf-end-ack", 1, 15 },
+    { "data", 2, 0 }, { "data-cf-ack", 2, 1 }, { "data-cf-poll", 2, 2 },
+    { "data-cf-ack-poll", 2, 3 }, { "null", 2, 4 }, { "cf-ack", 2, 5 }, { "cf-poll", 2, 6 },
+    { "cf-ack-poll", 2, 7 }, { "qos-data", 2, 8 }, { "qos-data-cf-ack", 2, 9 },
+    { "qos-data-cf-poll", 2, 10 }, { "qos-data-cf-ack-poll", 2, 11 }, { "qos", 2, 12 },
+    { "qos-cf-poll", 2, 14 }, { "qos-cf-ack-poll", 2, 15 }
+};
+
+static bool _tokenize(struct _compiler* c, const char* expr)
+{
+    char* out = NULL;
+
+    // Every token ends up NUL terminated, at worst one per input character
+    c->text = calloc(1, (strlen(expr) * 2) + 1);
+    if (!c->text)
+    {
+        return false;
+    }
+    out = c->text;
+
+    while (*expr)
+    {
+        size_t n = 0;
+
+        if (isspace((unsigned char) *expr))
+        {
+            expr++;
+            continue;
+        }
+
+        if (!strncmp(expr, "&&", 2) || !strncmp(expr, "||", 2))
+        {
+            n = 2;
+        }
+        else if ((*expr == '(') || (*expr == ')') || (*expr == '!'))
+        {
+            n = 1;
+        }
+        else
+        {
+            while (expr[n] && !isspace((unsigned char) expr[n]) && !strchr("()!", expr[n]))
+            {
+                n++;
+            }
+        }
+
+        if (c->ntok == FILTER_TOKENS_MAX)
+        {
+            fprintf(stderr, "Filter expression too long\n");
+            return false;
+        }
+        c->tokens[c->ntok++] = out;
+        memcpy(out, expr, n);
+        out += n + 1;
+        expr += n;
+    }
+
+    return true;
+}
+
+static const char* _peek(struct _compiler* c)
+{
+    return (c->pos < c->ntok) ? c->tokens[c->pos] : NULL;
+}
+
+static const char* _next(struct _compiler* c)
+{
+    return (c->pos < c->ntok) ? c->tokens[c->pos++] : NULL;
+}
+
+static bool _accept(struct _compiler* c, const char* a, const char* b)
+{
+    const char* tok = _peek(c);
+
+    if (tok && (!strcmp(tok, a) || (b && !strcmp(tok, b))))
+    {
+        c->pos++;
+        return true;
+    }
+    return false;
+}
+
+static int _node(struct _compiler* c, const int op, const int left, const int right)
+{
+    struct _node* node = NULL;
+
+    if (c->nnode == FILTER_NODES_MAX)
+    {
+        fprintf(stderr, "Filter expression too complex\n");
+        return -1;
+    }
+
+    node = &c->nodes[c->nnode];
+    memset(node, 0, sizeof(*node));
+    node->op = op;
+    node->left = left;
+    node->right = right;
+
+    return c->nnode++;
+}
+
+static int _parse_expr(struct _compiler* c);
+
+static int _parse_type(struct _compiler* c)
+{
+    const char* tok = _next(c);
+    int idx = -1;
+
+    for (unsigned int i = 0; tok && (i < (sizeof(_types) / sizeof(_types[0]))); i++)
+    {
+        if (!strcmp(tok, _types[i]))
+        {
+            idx = _node(c, NODE_TYPE, -1, -1);
+            if (idx >= 0)
+            {
+                c->nodes[idx].type = i;
+            }
+            return idx;
+        }
+    }
+
+    fprintf(stderr, "Filter: unknown frame type '%s'\n", tok ? tok : "");
+    return -1;
+}
+
+static int _parse_subtype(struct _compiler* c, const int type)
+{
+    const char* tok = _next(c);
+    int idx = -1;
+
+    // Names are unique across types, except where the type says otherwise
+    for (unsigned int i = 0; tok && (i < (sizeof(_subtypes) / sizeof(_subtypes[0]))); i++)
+    {
+        if (!strcmp(tok, _subtypes[i].name) && ((type < 0) || (type == _subtypes[i].type)))
+        {
+            idx = _node(c, NODE_SUBTYPE, -1, -1);
+            if (idx >= 0)
+            {
+                c->nodes[idx].type = _subtypes[i].type;
+                c->nodes[idx].subtype = _subtypes[i].subtype;
+            }
+            return idx;
+        }
+    }
+
+    fprintf(stderr, "Filter: unknown frame subtype '%s'\n", tok ? tok : "");
+    return -1;
+}
+
+static int _parse_addr(struct _compiler* c, const unsigned int offset, const uint8_t* mac)
+{
+    int idx = _node(c, NODE_ADDR, -1, -1);
+
+    if (idx >= 0)
+    {
+        c->nodes[idx].offset = offset;
+        memcpy(c->nodes[idx].mac, mac, 6);
+    }
+    return idx;
+}
+
+static int _parse_wlan(struct _compiler* c)
+{
+    const char* field = _next(c);
+    const char* tok = _next(c);
+    uint8_t mac[6] = { 0 };
+    char extra = 0;
+    int a1 = -1;
+    int a2 = -1;
+    int a3 = -1;
+
+    if (!field || !tok || (sscanf(tok, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx%c", &mac[0], &mac[1],
+                                  &mac[2], &mac[3], &mac[4], &mac[5], &extra) != 6))
+    {
+        fprintf(stderr, "Filter: expected 'wlan <field> <MAC address>'\n");
+        return -1;
+    }
+
+    if (!strcmp(field, "addr1") || !strcmp(field, "ra"))
+    {
+        return _parse_addr(c, IEEE80211_ADDR1_OFFSET, mac);
+    }
+    if (!strcmp(field, "addr2") || !strcmp(field, "ta"))
+    {
+        return _parse_addr(c, IEEE80211_ADDR2_OFFSET, mac);
+    }
+    if (!strcmp(field, "addr3"))
+    {
+        return _parse_addr(c, IEEE80211_ADDR3_OFFSET, mac);
+    }
+    if (!strcmp(field, "host"))
+    {
+        a1 = _parse_addr(c, IEEE80211_ADDR1_OFFSET, mac);
+        a2 = _parse_addr(c, IEEE80211_ADDR2_OFFSET, mac);
+        a3 = _parse_addr(c, IEEE80211_ADDR3_OFFSET, mac);
+        if ((a1 < 0) || (a2 < 0) || (a3 < 0))
+        {
+            return -1;
+        }
+        a2 = _node(c, NODE_OR, a2, a3);
+        return (a2 < 0) ? -1 : _node(c, NODE_OR, a1, a2);
+    }
+
+    fprintf(stderr, "Filter: unknown wlan field '%s'\n", field);
+    return -1;
+}
+
+static int _parse_factor(struct _compiler* c)
+{
+    const char* tok = _peek(c);
+    int idx = -1;
+    int sub = -1;
+
+    if (!tok)
+    {
+        fprintf(stderr, "Filter: unexpected end of expression\n");
+        return -1;
+    }
+
+    if (_accept(c, "not", "!"))
+    {
+        idx = _parse_factor(c);
+        return (idx < 0) ? -1 : _node(c, NODE_NOT, idx, -1);
+    }
+
+    if (_accept(c, "(", NULL))
+    {
+        idx = _parse_expr(c);
+        if ((idx >= 0) && !_accept(c, ")", NULL))
+        {
+            fprintf(stderr, "Filter: missing ')'\n");
+            return -1;
+        }
+        return idx;
+    }
+
+    if (_accept(c, "type", NULL))
+    {
+        idx = _parse_type(c);
+        // "type T subtype S" is a single test of both
+        if ((idx >= 0) && _accept(c, "subtype", NULL))
+        {
+            sub = _parse_subtype(c, c->nodes[idx].type);
+            return (sub < 0) ? -1 : _node(c, NODE_AND, idx, sub);
+        }
+        return idx;
+    }
+
+    if (_accept(c, "subtype", NULL))
+    {
+        return _parse_subtype(c, -1);
+    }
+
+    if (_accept(c, "wlan", NULL))
+    {
+        return _parse_wlan(c);
+    }
+
+    fprintf(stderr, "Filter: unexpected '%s'\n", tok);
+    return -1;
+}
+
+static int _parse_term(struct _compiler* c)
+{
+    int idx = _parse_factor(c);
+
+    while ((idx >= 0) && _accept(c, "and", "&&"))
+    {
+        int right = _parse_factor(c);
+        idx = (right < 0) ? -1 : _node(c, NODE_AND, idx, right);
+    }
+
+    return idx;
+}
+
+static int _parse_expr(struct _compiler* c)
+{
+    int idx = _parse_term(c);
+
+    while ((idx >= 0) && _accept(c, "or", "||"))
+    {
+        int right = _parse_term(c);
+        idx = (right < 0) ? -1 : _node(c, NODE_OR, idx, right);
+    }
+
+    return idx;
+}
+
+static int _label(struct _compiler* c)
+{
+    if (c->nlabel == FILTER_LABELS_MAX)
+    {
+        return -1;
+    }
+    c->labels[c->nlabel] = -1;
+    return c->nlabel++;
+}
+
+static void _place(struct _compiler* c, const int label)
+{
+    c->labels[label] = c->len;
+}
+
+static bool _emit(struct _compiler* c, const uint16_t code, const uint32_t k, const int jt,
+                  const int jf)
+{
+    if (c->len == WCAP_FILTER_INSNS_MAX)
+    {
+        fprintf(stderr, "Filter program too long\n");
+        return false;
+    }
+
+    c->code[c->len] = (struct sock_filter) BPF_STMT(code, k);
+    c->jt[c->len] = jt;
+    c->jf[c->len] = jf;
+    c->len++;
+
+    return true;
+}
+
+// Generate code jumping to label 't' when the node matches and 'f' otherwise
+static bool _gen(struct _compiler* c, const int idx, const int t, const int f)
+{
+    struct _node* node = &c->nodes[idx];
+    int mid = -1;
+    uint32_t hi = 0;
+
+    switch (node->op)
+    {
+        case NODE_OR:
+        case NODE_AND:
+        {
+            mid = _label(c);
+            if ((mid < 0) ||
+                !_gen(c, node->left, ((node->op == NODE_OR) ? t : mid),
+                      ((node->op == NODE_OR) ? mid : f)))
+            {
+                return false;
+            }
+            _place(c, mid);
+            return _gen(c, node->right, t, f);
+        }
+        case NODE_NOT:
+        {
+            return _gen(c, node->left, f, t);
+        }
+        case NODE_TYPE:
+        {
+            return (_emit(c, BPF_LD | BPF_B | BPF_IND, 0, LABEL_NEXT, LABEL_NEXT) &&
+                    _emit(c, BPF_ALU | BPF_AND | BPF_K, IEEE80211_FC_TYPE, LABEL_NEXT, LABEL_NEXT) &&
+                    _emit(c, BPF_JMP | BPF_JEQ | BPF_K, (node->type << 2), t, f));
+        }
+        case NODE_SUBTYPE:
+        {
+            return (_emit(c, BPF_LD | BPF_B | BPF_IND, 0, LABEL_NEXT, LABEL_NEXT) &&
+                    _emit(c, BPF_ALU | BPF_AND | BPF_K, (IEEE80211_FC_SUBTYPE | IEEE80211_FC_TYPE),
+                          LABEL_NEXT, LABEL_NEXT) &&
+                    _emit(c, BPF_JMP | BPF_JEQ | BPF_K, ((node->subtype << 4) | (node->type << 2)),
+                          t, f));
+        }
+        case NODE_ADDR:
+        {
+            // Control frames carry fewer addresses; a load past the end would
+            // abort the whole program, so check the length first
+            hi = ((uint32_t) node->mac[0] << 24) | ((uint32_t) node->mac[1] << 16) |
+                 ((uint32_t) node->mac[2] << 8) | node->mac[3];
+            return (_emit(c, BPF_LD | BPF_W | BPF_LEN, 0, LABEL_NEXT, LABEL_NEXT) &&
+                    _emit(c, BPF_ALU | BPF_SUB | BPF_X, 0, LABEL_NEXT, LABEL_NEXT) &&
+                    _emit(c, BPF_JMP | BPF_JGE | BPF_K, (node->offset + 6), LABEL_NEXT, f) &&
+                    _emit(c, BPF_LD | BPF_W | BPF_IND, node->offset, LABEL_NEXT, LABEL_NEXT) &&
+                    _emit(c, BPF_JMP | BPF_JEQ | BPF_K, hi, LABEL_NEXT, f) &&
+                    _emit(c, BPF_LD | BPF_H | BPF_IND, (node->offset + 4), LABEL_NEXT, LABEL_NEXT) &&
+                    _emit(c, BPF_JMP | BPF_JEQ | BPF_K, ((node->mac[4] << 8) | node->mac[5]), t, f));
+        }
+        default:
+        {
+            return false;
+        }
+    }
+}
+
+static bool _resolve(struct _compiler* c)
+{
+    for (unsigned int i = 0; i < c->len; i++)
+    {
+        int off = 0;
+
+        if (BPF_CLASS(c->code[i].code) != BPF_JMP)
+        {
+            continue;
+        }
+
+        // Classic BPF only jumps forward, by at most 255 instructions
+        off = (c->jt[i] == LABEL_NEXT) ? 0 : (c->labels[c->jt[i]] - (int) (i + 1));
+        if ((off < 0) || (off > 255))
+        {
+            fprintf(stderr, "Filter program too long for a branch\n");
+            return false;
+        }
+        c->code[i].jt = off;
+
+        off = (c->jf[i] == LABEL_NEXT) ? 0 : (c->labels[c->jf[i]] - (int) (i + 1));
+        if ((off < 0) || (off > 255))
+        {
+            fprintf(stderr, "Filter program too long for a branch\n");
+            return false;
+        }
+        c->code[i].jf = off;
+    }
+
+    return true;
+}
+
+bool WcapFilterCreate(WcapFilter_t* filter, const char* expr)
+{
+
+    struct _compiler* c = NULL;
+    bool status = false;
+    int root = -1;
+    int t = -1;
+    int f = -1;
+
+    if (!filter || !expr)
+    {
+        return false;
+    }
+
+    memset(filter, 0, sizeof(*filter));
+
+    c = calloc(1, sizeof(*c));
+    if (!c || !_tokenize(c, expr))
+    {
+        goto exit;
+    }
+
+    root = _parse_expr(c);
+    if (root < 0)
+    {
+        goto exit;
+    }
+    if (_peek(c))
+    {
+        fprintf(stderr, "Filter: unexpected '%s'\n", _peek(c));
+        goto exit;
+    }
+
+    t = _label(c);
+    f = _label(c);
+
+    // X = radiotap header length (little endian u16 at offset 2), everything
+    // after that indexes the 802.11 header
+    if (!_emit(c, BPF_LD | BPF_B | BPF_ABS, 3, LABEL_NEXT, LABEL_NEXT) ||
+        !_emit(c, BPF_ALU | BPF_LSH | BPF_K, 8, LABEL_NEXT, LABEL_NEXT) ||
+        !_emit(c, BPF_MISC | BPF_TAX, 0, LABEL_NEXT, LABEL_NEXT) ||
+        !_emit(c, BPF_LD | BPF_B | BPF_ABS, 2, LABEL_NEXT, LABEL_NEXT) ||
+        !_emit(c, BPF_ALU | BPF_ADD | BPF_X, 0, LABEL_NEXT, LABEL_NEXT) ||
+        !_emit(c, BPF_MISC | BPF_TAX, 0, LABEL_NEXT, LABEL_NEXT) ||
+        !_gen(c, root, t, f))
+    {
+        goto exit;
+    }
+
+    _place(c, t);
+    if (!_emit(c, BPF_RET | BPF_K, FILTER_SNAPLEN, LABEL_NEXT, LABEL_NEXT))
+    {
+        goto exit;
+    }
+    _place(c, f);
+    if (!_emit(c, BPF_RET | BPF_K, 0, LABEL_NEXT, LABEL_NEXT) || !_resolve(c))
+    {
+        goto exit;
+    }
+
+    filter->code = calloc(c->len, sizeof(*filter->code));
+    if (!filter->code)
+    {
+        goto exit;
+    }
+    memcpy(filter->code, c->code, c->len * sizeof(*filter->code));
+    filter->len = c->len;
+    status = true;
+
+exit:
+
+    if (c)
+    {
+        free(c->text);
+        free(c);
+    }
+
+    return status;
+}
+
+bool WcapFilterDestroy(WcapFilter_t* filter)
+{
+
+    if (!filter)
+    {
+        return false;
+    }
+
+    free(filter->code);
+    memset(filter, 0, sizeof(*filter));
+
+    return true;
+}
+
+bool WcapFilterAttach(const WcapFilter_t* filter, const int fd)
+{
+
+    struct sock_fprog prog = { 0 };
+
+    if (!filter || !filter->code || (fd < 0))
+    {
+        return false;
+    }
+
+    prog.len = filter->len;
+    prog.filter = filter->code;
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0)
+    {
+        fprintf(stderr, "Failed to attach capture filter: [%d] %s\n", errno, strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+void WcapFilterDump(const WcapFilter_t* filter, FILE* out)
+{
+    // Same layout as 'tcpdump -dd'
+    for (unsigned int i = 0; filter && (i < filter->len); i++)
+    {
+        fprintf(out, "{ 0x%02x, %u, %u, 0x%08x },\n", filter->code[i].code, filter->code[i].jt,
+                     filter->code[i].jf, filter->code[i].k);
+    }
+}
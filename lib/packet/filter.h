@@ -0,0 +1,46 @@
+/*
+ ============================================================================
+ Name        : filter.h
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet capture and forwarder
+ ============================================================================
+ */
+
+#ifndef _FILTER_H_
+#define _FILTER_H_
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include <linux/filter.h>
+
+#define WCAP_FILTER_INSNS_MAX   1024
+
+// Classic BPF program compiled from a capture filter expression, run by the
+// kernel on every frame of a monitor interface before it is queued:
+//
+//   expr      := term { ("or" | "||") term }
+//   term      := factor { ("and" | "&&") factor }
+//   factor    := ("not" | "!") factor | "(" expr ")" | primitive
+//   primitive := "type" TYPE [ "subtype" SUBTYPE ]
+//              | "subtype" SUBTYPE
+//              | "wlan" ("addr1" | "addr2" | "addr3" | "ra" | "ta" | "host") MAC
+//
+// TYPE is mgt, ctl or data and SUBTYPE one of tcpdump's names (beacon,
+// probe-req, ack, qos-data, ...). Offsets are relative to the end of the
+// radiotap header, whatever its length.
+typedef struct WcapFilter
+{
+    struct sock_filter* code;
+    unsigned int len;
+} WcapFilter_t;
+
+bool WcapFilterCreate(WcapFilter_t* filter, const char* expr);
+bool WcapFilterDestroy(WcapFilter_t* filter);
+
+bool WcapFilterAttach(const WcapFilter_t* filter, const int fd);
+void WcapFilterDump(const WcapFilter_t* filter, FILE* out);
+
+#endif /* _FILTER_H_ */
@@ -0,0 +1,246 @@
+/*
+ ============================================================================
+ Name        : radiotap.c
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet concatenator
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <endian.h>
+
+#include "radiotap.h"
+
+#define RADIOTAP_HDR_LEN    8
+#define RADIOTAP_EXT        31
+
+// Alignment and size of the fields up to the last one parsed; fields are
+// naturally aligned relative to the start of the header
+static const struct
+{
+    uint8_t align;
+    uint8_t size;
+} _fields[WCAP_RADIOTAP_VHT + 1] =
+{
+    { 8, 8 }, { 1, 1 }, { 1, 1 }, { 2, 4 }, { 2, 2 }, { 1, 1 }, { 1, 1 }, { 2, 2 },
+    { 2, 2 }, { 2, 2 }, { 1, 1 }, { 1, 1 }, { 1, 1 }, { 1, 1 }, { 2, 2 }, { 2, 2 },
+    { 1, 1 }, { 1, 1 }, { 4, 8 }, { 1, 3 }, { 4, 8 }, { 2, 12 }
+};
+
+static inline uint16_t _le16(const uint8_t* p)
+{
+    return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static inline uint32_t _le32(const uint8_t* p)
+{
+    return ((uint32_t) _le16(p) | ((uint32_t) _le16(p + 2) << 16));
+}
+
+static inline uint64_t _le64(const uint8_t* p)
+{
+    return ((uint64_t) _le32(p) | ((uint64_t) _le32(p + 4) << 32));
+}
+
+static inline void _put16(uint8_t* p, const uint16_t val)
+{
+    p[0] = val & 0xff;
+    p[1] = val >> 8;
+}
+
+bool WcapRadiotapParse(const uint8_t* buf, const size_t len, WcapRadiotapMeta_t* meta,
+                       size_t* hdrlen)
+{
+
+    uint32_t present = 0;
+    size_t rtlen = 0;
+    size_t off = 4;
+
+    if (!buf || !meta || (len < RADIOTAP_HDR_LEN) || (buf[0] != 0))
+    {
+        return false;
+    }
+
+    rtlen = _le16(buf + 2);
+    if ((rtlen < RADIOTAP_HDR_LEN) || (rtlen > len))
+    {
+        return false;
+    }
+
+    memset(meta, 0, sizeof(*meta));
+    present = _le32(buf + 4);
+
+    // Fields start after the last of the chained 'present' words
+    do
+    {
+        if ((off + 4) > rtlen)
+        {
+            return false;
+        }
+        off += 4;
+    } while (_le32(buf + off - 4) & (1U << RADIOTAP_EXT));
+
+    for (unsigned int bit = 0; bit <= WCAP_RADIOTAP_VHT; bit++)
+    {
+        const uint8_t* p = NULL;
+
+        if (!(present & (1U << bit)))
+        {
+            continue;
+        }
+
+        off = (off + _fields[bit].align - 1) & ~((size_t) _fields[bit].align - 1);
+        if ((off + _fields[bit].size) > rtlen)
+        {
+            break;
+        }
+        p = buf + off;
+        off += _fields[bit].size;
+
+        switch (bit)
+        {
+            case WCAP_RADIOTAP_TSFT:
+                meta->tsft = _le64(p);
+                break;
+            case WCAP_RADIOTAP_FLAGS:
+                meta->flags = p[0];
+                break;
+            case WCAP_RADIOTAP_RATE:
+                meta->rate = p[0];
+                break;
+            case WCAP_RADIOTAP_CHANNEL:
+                meta->freq = _le16(p);
+                meta->chanFlags = _le16(p + 2);
+                break;
+            case WCAP_RADIOTAP_DBM_SIGNAL:
+                meta->signal = (int8_t) p[0];
+                break;
+            case WCAP_RADIOTAP_DBM_NOISE:
+                meta->noise = (int8_t) p[0];
+                break;
+            case WCAP_RADIOTAP_ANTENNA:
+                meta->antenna = p[0];
+                break;
+            case WCAP_RADIOTAP_RX_FLAGS:
+                meta->rxFlags = _le16(p);
+                break;
+            case WCAP_RADIOTAP_MCS:
+                meta->mcsKnown = p[0];
+                meta->mcsFlags = p[1];
+                meta->mcs = p[2];
+                break;
+            case WCAP_RADIOTAP_VHT:
+                meta->vhtKnown = _le16(p);
+                meta->vhtFlags = p[2];
+                meta->vhtBandwidth = p[3];
+                meta->vhtMcsNss = p[4];
+                meta->vhtCoding = p[8];
+                break;
+            default:
+                // Walked over, nothing kept
+                continue;
+        }
+        meta->present |= (1U << bit);
+    }
+
+    if (hdrlen)
+    {
+        *hdrlen = rtlen;
+    }
+
+    return true;
+}
+
+void WcapRadiotapMetaEncode(const WcapRadiotapMeta_t* meta, uint8_t* buf)
+{
+    WcapRadiotapMeta_t wire = *meta;
+
+    wire.tsft = htobe64(meta->tsft);
+    wire.present = htobe32(meta->present);
+    wire.freq = htobe16(meta->freq);
+    wire.chanFlags = htobe16(meta->chanFlags);
+    wire.rxFlags = htobe16(meta->rxFlags);
+    wire.vhtKnown = htobe16(meta->vhtKnown);
+    memcpy(buf, &wire, sizeof(wire));
+}
+
+void WcapRadiotapMetaDecode(const uint8_t* buf, WcapRadiotapMeta_t* meta)
+{
+    memcpy(meta, buf, sizeof(*meta));
+    meta->tsft = be64toh(meta->tsft);
+    meta->present = be32toh(meta->present);
+    meta->freq = be16toh(meta->freq);
+    meta->chanFlags = be16toh(meta->chanFlags);
+    meta->rxFlags = be16toh(meta->rxFlags);
+    meta->vhtKnown = be16toh(meta->vhtKnown);
+}
+
+size_t WcapRadiotapTxLen(const WcapRadiotapMeta_t* meta)
+{
+    size_t len = RADIOTAP_HDR_LEN + 1;
+
+    if (meta && (meta->present & (1U << WCAP_RADIOTAP_RATE)))
+    {
+        len += 1;
+    }
+    if (meta && (meta->present & (1U << WCAP_RADIOTAP_MCS)))
+    {
+        len += 3;
+    }
+    if (meta && (meta->present & (1U << WCAP_RADIOTAP_VHT)))
+    {
+        len = ((len + 1) & ~1UL) + 12;
+    }
+
+    return len;
+}
+
+size_t WcapRadiotapBuild(uint8_t* buf, const WcapRadiotapMeta_t* meta)
+{
+
+    // Only what mac80211 honours on injection: flags, and the rate the frame
+    // was received at when there is one. The FCS never travels.
+    uint32_t present = (1U << WCAP_RADIOTAP_FLAGS);
+    size_t len = WcapRadiotapTxLen(meta);
+    size_t off = RADIOTAP_HDR_LEN;
+
+    memset(buf, 0, len);
+    buf[off++] = meta ? (meta->flags & (WCAP_RADIOTAP_F_SHORTPRE | WCAP_RADIOTAP_F_WEP |
+                                        WCAP_RADIOTAP_F_FRAG)) : 0;
+
+    if (meta && (meta->present & (1U << WCAP_RADIOTAP_RATE)))
+    {
+        present |= (1U << WCAP_RADIOTAP_RATE);
+        buf[off++] = meta->rate;
+    }
+    if (meta && (meta->present & (1U << WCAP_RADIOTAP_MCS)))
+    {
+        present |= (1U << WCAP_RADIOTAP_MCS);
+        buf[off++] = meta->mcsKnown;
+        buf[off++] = meta->mcsFlags;
+        buf[off++] = meta->mcs;
+    }
+    if (meta && (meta->present & (1U << WCAP_RADIOTAP_VHT)))
+    {
+        present |= (1U << WCAP_RADIOTAP_VHT);
+        off = (off + 1) & ~1UL;
+        _put16(buf + off, meta->vhtKnown);
+        buf[off + 2] = meta->vhtFlags;
+        buf[off + 3] = meta->vhtBandwidth;
+        buf[off + 4] = meta->vhtMcsNss;
+        buf[off + 8] = meta->vhtCoding;
+        off += 12;
+    }
+
+    buf[0] = 0;
+    buf[1] = 0;
+    _put16(buf + 2, len);
+    _put16(buf + 4, present & 0xffff);
+    _put16(buf + 6, present >> 16);
+
+    return len;
+}
@@ -0,0 +1,85 @@
+/*
+ ============================================================================
+ Name        : radiotap.h
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet capture and forwarder
+ ============================================================================
+ */
+
+#ifndef _RADIOTAP_H_
+#define _RADIOTAP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Radiotap fields, by their bit in the first 'present' word
+#define WCAP_RADIOTAP_TSFT          0
+#define WCAP_RADIOTAP_FLAGS         1
+#define WCAP_RADIOTAP_RATE          2
+#define WCAP_RADIOTAP_CHANNEL       3
+#define WCAP_RADIOTAP_DBM_SIGNAL    5
+#define WCAP_RADIOTAP_DBM_NOISE     6
+#define WCAP_RADIOTAP_ANTENNA       11
+#define WCAP_RADIOTAP_RX_FLAGS      14
+#define WCAP_RADIOTAP_MCS           19
+#define WCAP_RADIOTAP_VHT           21
+
+// Bits of the FLAGS field
+#define WCAP_RADIOTAP_F_SHORTPRE    0x02
+#define WCAP_RADIOTAP_F_WEP         0x04
+#define WCAP_RADIOTAP_F_FRAG        0x08
+#define WCAP_RADIOTAP_F_FCS         0x10
+#define WCAP_RADIOTAP_F_DATAPAD     0x20
+#define WCAP_RADIOTAP_F_BADFCS      0x40
+
+#define WCAP_RADIOTAP_FCS_LEN       4
+
+// Longest header WcapRadiotapBuild() writes
+#define WCAP_RADIOTAP_TX_MAX        26
+
+// What the receiver recorded about a frame, in half a cache line. Only the
+// fields whose bit is set in 'present' are meaningful.
+typedef struct WcapRadiotapMeta
+{
+    uint64_t tsft;
+    uint32_t present;
+    uint16_t freq;
+    uint16_t chanFlags;
+    uint16_t rxFlags;
+    uint16_t vhtKnown;
+    uint8_t flags;
+    uint8_t rate;
+    int8_t signal;
+    int8_t noise;
+    uint8_t antenna;
+    uint8_t mcsKnown;
+    uint8_t mcsFlags;
+    uint8_t mcs;
+    uint8_t vhtFlags;
+    uint8_t vhtBandwidth;
+    uint8_t vhtMcsNss;
+    uint8_t vhtCoding;
+} WcapRadiotapMeta_t;
+
+// Size of the metadata once encoded for the tunnel
+#define WCAP_RADIOTAP_META_LEN      sizeof(WcapRadiotapMeta_t)
+
+// Parse the radiotap header at the start of a captured frame; 'hdrlen' is
+// set to its length, the 802.11 frame starts right after it. Fields outside
+// the default namespace's first word are skipped.
+bool WcapRadiotapParse(const uint8_t* buf, const size_t len, WcapRadiotapMeta_t* meta,
+                       size_t* hdrlen);
+
+// Metadata in tunnel byte order and back
+void WcapRadiotapMetaEncode(const WcapRadiotapMeta_t* meta, uint8_t* buf);
+void WcapRadiotapMetaDecode(const uint8_t* buf, WcapRadiotapMeta_t* meta);
+
+// Length of the minimal TX header WcapRadiotapBuild() writes for 'meta', which
+// may be NULL when nothing is known about the frame
+size_t WcapRadiotapTxLen(const WcapRadiotapMeta_t* meta);
+size_t WcapRadiotapBuild(uint8_t* buf, const WcapRadiotapMeta_t* meta);
+
+#endif /* _RADIOTAP_H_ */
@@ -0,0 +1,191 @@
+/*
+ ============================================================================
+ Name        : rxring.c
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet concatenator
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+#include "rxring.h"
+
+// Only used by the kernel to validate the ring geometry, TPACKET_V3 packs
+// variable sized frames back to back within each block
+#define RXRING_FRAME_SIZE   2048
+
+static struct tpacket_block_desc* _block_desc(WcapRxRing_t* ring, const unsigned int block)
+{
+    return (struct tpacket_block_desc*) (ring->map + ((size_t) block * ring->blocksiz));
+}
+
+static void _block_release(WcapRxRing_t* ring)
+{
+    __atomic_store_n(&ring->desc->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+    ring->desc = NULL;
+    ring->frame = NULL;
+    ring->remain = 0;
+    ring->block = (ring->block + 1) % ring->blocknum;
+}
+
+bool WcapRxRingCreate(WcapRxRing_t* ring, const int fd, const unsigned int blocksiz,
+                      const unsigned int blocknum, const unsigned int timeout)
+{
+
+    int ver = TPACKET_V3;
+    struct tpacket_req3 req = { 0 };
+
+    if (!ring || (fd < 0) || !blocknum)
+    {
+        return false;
+    }
+
+    if ((blocksiz < RXRING_FRAME_SIZE) || (blocksiz % getpagesize()))
+    {
+        fprintf(stderr, "Invalid RX ring block size: %u (must be a multiple of %d)\n", blocksiz,
+                        getpagesize());
+        return false;
+    }
+
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = fd;
+    ring->blocksiz = blocksiz;
+    ring->blocknum = blocknum;
+
+    if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &ver, sizeof(ver)) < 0)
+    {
+        fprintf(stderr, "Failed to select TPACKET_V3: [%d] %s\n", errno, strerror(errno));
+        return false;
+    }
+
+    req.tp_block_size = blocksiz;
+    req.tp_block_nr = blocknum;
+    req.tp_frame_size = RXRING_FRAME_SIZE;
+    req.tp_frame_nr = (blocksiz / RXRING_FRAME_SIZE) * blocknum;
+    req.tp_retire_blk_tov = timeout;
+
+    if (setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0)
+    {
+        fprintf(stderr, "Failed to set up RX ring: [%d] %s\n", errno, strerror(errno));
+        return false;
+    }
+
+    ring->maplen = (size_t) blocksiz * blocknum;
+    ring->map = mmap(NULL, ring->maplen, (PROT_READ | PROT_WRITE), (MAP_SHARED | MAP_POPULATE), fd, 0);
+    if (ring->map == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map RX ring: [%d] %s\n", errno, strerror(errno));
+        ring->map = NULL;
+        memset(&req, 0, sizeof(req));
+        setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req));
+        return false;
+    }
+
+    return true;
+}
+
+bool WcapRxRingDestroy(WcapRxRing_t* ring)
+{
+
+    struct tpacket_req3 req = { 0 };
+
+    if (!ring)
+    {
+        return false;
+    }
+
+    if (ring->map)
+    {
+        munmap(ring->map, ring->maplen);
+        setsockopt(ring->fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req));
+    }
+
+    memset(ring, 0, sizeof(*ring));
+
+    return true;
+}
+
+bool WcapRxRingRecv(WcapRxRing_t* ring, uint8_t** data, size_t* len, uint64_t* tstamp)
+{
+
+    struct tpacket_block_desc* desc = NULL;
+    struct tpacket3_hdr* frame = NULL;
+
+    if (!ring || !ring->map || !data || !len)
+    {
+        return false;
+    }
+
+    // Hand the current block back to the kernel only once every frame in it
+    // has been consumed; the previous frame stays valid until this call
+    if (ring->desc && !ring->remain)
+    {
+        _block_release(ring);
+    }
+
+    while (!ring->desc)
+    {
+        desc = _block_desc(ring, ring->block);
+        if (!(__atomic_load_n(&desc->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+        {
+            return false;
+        }
+        ring->desc = desc;
+        ring->remain = desc->hdr.bh1.num_pkts;
+        ring->frame = (struct tpacket3_hdr*) ((uint8_t*) desc + desc->hdr.bh1.offset_to_first_pkt);
+        if (!ring->remain)
+        {
+            _block_release(ring);
+        }
+    }
+
+    frame = ring->frame;
+    *data = (uint8_t*) frame + frame->tp_mac;
+    *len = frame->tp_snaplen;
+    if (tstamp)
+    {
+        *tstamp = ((uint64_t) frame->tp_sec * 1000000000ULL) + frame->tp_nsec;
+    }
+
+    ring->frame = (struct tpacket3_hdr*) ((uint8_t*) frame + frame->tp_next_offset);
+    ring->remain--;
+
+    return true;
+}
+
+bool WcapRxRingStats(WcapRxRing_t* ring, unsigned int* packets, unsigned int* drops)
+{
+
+    struct tpacket_stats_v3 stats = { 0 };
+    socklen_t len = sizeof(stats);
+
+    if (!ring || !ring->map)
+    {
+        return false;
+    }
+
+    // Note: the kernel resets these counters on every read
+    if (getsockopt(ring->fd, SOL_PACKET, PACKET_STATISTICS, &stats, &len) < 0)
+    {
+        return false;
+    }
+
+    if (packets)
+    {
+        *packets = stats.tp_packets;
+    }
+    if (drops)
+    {
+        *drops = stats.tp_drops;
+    }
+
+    return true;
+}
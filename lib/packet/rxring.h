@@ -0,0 +1,45 @@
+/*
+ ============================================================================
+ Name        : rxring.h
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet capture and forwarder
+ ============================================================================
+ */
+
+#ifndef _RXRING_H_
+#define _RXRING_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <linux/if_packet.h>
+
+#define WCAP_RXRING_BLOCK_SIZE_DEF      (1 << 18)
+#define WCAP_RXRING_BLOCK_COUNT_DEF     16
+#define WCAP_RXRING_RETIRE_MS_DEF       8
+
+// Block based (TPACKET_V3) receive ring mapped from an AF_PACKET socket
+typedef struct WcapRxRing
+{
+    int fd;
+    uint8_t* map;
+    size_t maplen;
+    unsigned int blocksiz;
+    unsigned int blocknum;
+    unsigned int block;
+    struct tpacket_block_desc* desc;
+    struct tpacket3_hdr* frame;
+    unsigned int remain;
+} WcapRxRing_t;
+
+bool WcapRxRingCreate(WcapRxRing_t* ring, const int fd, const unsigned int blocksiz,
+                      const unsigned int blocknum, const unsigned int timeout);
+bool WcapRxRingDestroy(WcapRxRing_t* ring);
+
+bool WcapRxRingRecv(WcapRxRing_t* ring, uint8_t** data, size_t* len, uint64_t* tstamp);
+bool WcapRxRingStats(WcapRxRing_t* ring, unsigned int* packets, unsigned int* drops);
+
+#endif /* _RXRING_H_ */
@@ -0,0 +1,62 @@
+/*
+ ============================================================================
+ Name        : tstamp.c
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet concatenator
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <linux/net_tstamp.h>
+
+#include "tstamp.h"
+
+bool WcapTstampEnable(const int fd)
+{
+
+    int flags = (SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE);
+
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0)
+    {
+        fprintf(stderr, "Failed to enable timestamps on socket [%d]: [%d] %s\n", fd, errno,
+                        strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+uint64_t WcapTstampGet(const struct msghdr* hdr)
+{
+
+    struct cmsghdr* cmsg = NULL;
+    struct scm_timestamping ts = { 0 };
+
+    if (!hdr || !hdr->msg_control)
+    {
+        return 0;
+    }
+
+    // The software stamp is the first of the three, the others stay zero
+    for (cmsg = CMSG_FIRSTHDR(hdr); cmsg; cmsg = CMSG_NXTHDR((struct msghdr*) hdr, cmsg))
+    {
+        if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_TIMESTAMPING) &&
+            (cmsg->cmsg_len >= CMSG_LEN(sizeof(ts))))
+        {
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            return (ts.ts[0].tv_sec * 1000000000ULL) + ts.ts[0].tv_nsec;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,30 @@
+/*
+ ============================================================================
+ Name        : tstamp.h
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet capture and forwarder
+ ============================================================================
+ */
+
+#ifndef _TSTAMP_H_
+#define _TSTAMP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <sys/socket.h>
+#include <linux/errqueue.h>
+
+// Control message room for the timestamps of one received packet
+#define WCAP_TSTAMP_CTRL_SIZE   CMSG_SPACE(sizeof(struct scm_timestamping))
+
+// Have the kernel stamp every packet the socket receives, in software, as it
+// comes off the driver
+bool WcapTstampEnable(const int fd);
+
+// CLOCK_REALTIME nanoseconds of the SCM_TIMESTAMPING message, 0 when none
+uint64_t WcapTstampGet(const struct msghdr* hdr);
+
+#endif /* _TSTAMP_H_ */
@@ -0,0 +1,205 @@
+/*
+ ============================================================================
+ Name        : txring.c
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet concatenator
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+#include "txring.h"
+
+// Without PACKET_TX_HAS_OFF the kernel expects the frame data to start right
+// after the (aligned) frame header
+#define TXRING_DATA_OFFSET  TPACKET_ALIGN(sizeof(struct tpacket2_hdr))
+
+static struct tpacket2_hdr* _frame_hdr(WcapTxRing_t* ring, const unsigned int frame)
+{
+    unsigned int fpb = ring->blocksiz / ring->framesiz;
+    return (struct tpacket2_hdr*) (ring->map + ((size_t) (frame / fpb) * ring->blocksiz)
+                    + ((size_t) (frame % fpb) * ring->framesiz));
+}
+
+static bool _frame_available(struct tpacket2_hdr* hdr)
+{
+    uint32_t status = __atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE);
+    return ((status == TP_STATUS_AVAILABLE) || (status & TP_STATUS_WRONG_FORMAT));
+}
+
+bool WcapTxRingCreate(WcapTxRing_t* ring, const int fd, const unsigned int framesiz,
+                      const unsigned int framenum, const bool bypass)
+{
+
+    int ver = TPACKET_V2;
+    int one = 1;
+    unsigned int pagesiz = getpagesize();
+    unsigned int fpb = 0;
+    struct tpacket_req req = { 0 };
+
+    if (!ring || (fd < 0) || !framenum)
+    {
+        return false;
+    }
+
+    if ((framesiz <= TXRING_DATA_OFFSET) || (framesiz % TPACKET_ALIGNMENT))
+    {
+        fprintf(stderr, "Invalid TX ring frame size: %u (must be a multiple of %d)\n", framesiz,
+                        TPACKET_ALIGNMENT);
+        return false;
+    }
+
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = fd;
+    ring->framesiz = framesiz;
+
+    // Frames cannot straddle blocks, so size each block to hold at least one
+    // frame and round the frame count up to fill the last block
+    ring->blocksiz = ((framesiz + pagesiz - 1) / pagesiz) * pagesiz;
+    fpb = ring->blocksiz / framesiz;
+    ring->framenum = ((framenum + fpb - 1) / fpb) * fpb;
+
+    if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &ver, sizeof(ver)) < 0)
+    {
+        fprintf(stderr, "Failed to select TPACKET_V2: [%d] %s\n", errno, strerror(errno));
+        return false;
+    }
+
+    // Skip over malformed frames rather than stalling the whole ring on them
+    if (setsockopt(fd, SOL_PACKET, PACKET_LOSS, &one, sizeof(one)) < 0)
+    {
+        fprintf(stderr, "Failed to enable TX ring loss mode: [%d] %s\n", errno, strerror(errno));
+    }
+
+    if (bypass && (setsockopt(fd, SOL_PACKET, PACKET_QDISC_BYPASS, &one, sizeof(one)) < 0))
+    {
+        fprintf(stderr, "Failed to enable qdisc bypass: [%d] %s\n", errno, strerror(errno));
+        return false;
+    }
+
+    req.tp_block_size = ring->blocksiz;
+    req.tp_block_nr = ring->framenum / fpb;
+    req.tp_frame_size = framesiz;
+    req.tp_frame_nr = ring->framenum;
+
+    if (setsockopt(fd, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) < 0)
+    {
+        fprintf(stderr, "Failed to set up TX ring: [%d] %s\n", errno, strerror(errno));
+        return false;
+    }
+
+    ring->maplen = (size_t) ring->blocksiz * req.tp_block_nr;
+    ring->map = mmap(NULL, ring->maplen, (PROT_READ | PROT_WRITE), (MAP_SHARED | MAP_POPULATE), fd, 0);
+    if (ring->map == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map TX ring: [%d] %s\n", errno, strerror(errno));
+        ring->map = NULL;
+        memset(&req, 0, sizeof(req));
+        setsockopt(fd, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req));
+        return false;
+    }
+
+    return true;
+}
+
+bool WcapTxRingDestroy(WcapTxRing_t* ring)
+{
+
+    struct tpacket_req req = { 0 };
+
+    if (!ring)
+    {
+        return false;
+    }
+
+    if (ring->map)
+    {
+        WcapTxRingFlush(ring);
+        munmap(ring->map, ring->maplen);
+        setsockopt(ring->fd, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req));
+    }
+
+    memset(ring, 0, sizeof(*ring));
+
+    return true;
+}
+
+bool WcapTxRingSend(WcapTxRing_t* ring, const void* data, const size_t len)
+{
+
+    struct tpacket2_hdr* hdr = NULL;
+
+    if (!ring || !ring->map || !data)
+    {
+        return false;
+    }
+
+    if (!len || (len > (ring->framesiz - TXRING_DATA_OFFSET)))
+    {
+        ring->drops++;
+        return false;
+    }
+
+    // A slot still owned by the kernel means the ring is full; kick whatever
+    // is queued and give the driver one chance to free it up
+    hdr = _frame_hdr(ring, ring->head);
+    if (!_frame_available(hdr))
+    {
+        WcapTxRingFlush(ring);
+        if (!_frame_available(hdr))
+        {
+            ring->drops++;
+            return false;
+        }
+    }
+
+    memcpy((uint8_t*) hdr + TXRING_DATA_OFFSET, data, len);
+    hdr->tp_len = len;
+    __atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+
+    ring->head = (ring->head + 1) % ring->framenum;
+    ring->pending++;
+    ring->pendingBytes += len;
+
+    return true;
+}
+
+int WcapTxRingFlush(WcapTxRing_t* ring)
+{
+
+    int cnt = 0;
+
+    if (!ring || !ring->map)
+    {
+        return -1;
+    }
+
+    if (!ring->pending)
+    {
+        return 0;
+    }
+
+    // One syscall hands every queued frame to the driver; when it is busy the
+    // frames stay queued for the next kick, and are only counted then
+    if (send(ring->fd, NULL, 0, MSG_DONTWAIT) < 0)
+    {
+        return ((errno == EAGAIN) || (errno == ENOBUFS)) ? 0 : -1;
+    }
+
+    cnt = ring->pending;
+    ring->frames += cnt;
+    ring->bytes += ring->pendingBytes;
+    ring->kicks++;
+    ring->pending = 0;
+    ring->pendingBytes = 0;
+
+    return cnt;
+}
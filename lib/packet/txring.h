@@ -0,0 +1,50 @@
+/*
+ ============================================================================
+ Name        : txring.h
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet capture and forwarder
+ ============================================================================
+ */
+
+#ifndef _TXRING_H_
+#define _TXRING_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <linux/if_packet.h>
+
+#define WCAP_TXRING_FRAME_SIZE_DEF      8192
+#define WCAP_TXRING_FRAME_COUNT_DEF     256
+#define WCAP_TXRING_BATCH_DEF           64
+
+// Frame based (TPACKET_V2) transmit ring mapped from an AF_PACKET socket
+typedef struct WcapTxRing
+{
+    int fd;
+    uint8_t* map;
+    size_t maplen;
+    unsigned int blocksiz;
+    unsigned int framesiz;
+    unsigned int framenum;
+    unsigned int head;
+    unsigned int pending;
+    size_t pendingBytes;
+    // Handed to the kernel by a successful kick
+    uint64_t frames;
+    uint64_t bytes;
+    uint64_t kicks;
+    uint64_t drops;
+} WcapTxRing_t;
+
+bool WcapTxRingCreate(WcapTxRing_t* ring, const int fd, const unsigned int framesiz,
+                      const unsigned int framenum, const bool bypass);
+bool WcapTxRingDestroy(WcapTxRing_t* ring);
+
+bool WcapTxRingSend(WcapTxRing_t* ring, const void* data, const size_t len);
+int WcapTxRingFlush(WcapTxRing_t* ring);
+
+#endif /* _TXRING_H_ */
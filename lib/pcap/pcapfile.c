@@ -0,0 +1,390 @@
+/*
+ ============================================================================
+ Name        : pcapfile.c
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet concatenator
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "pcapfile.h"
+
+// Classic pcap: a 24 byte file header then 16 byte record headers
+#define PCAP_MAGIC_USEC         0xa1b2c3d4
+#define PCAP_MAGIC_NSEC         0xa1b23c4d
+#define PCAP_FILE_HDR_LEN       24
+#define PCAP_REC_HDR_LEN        16
+#define PCAP_LINKTYPE_OFFSET    20
+
+// pcapng blocks and the options read from them
+#define PCAPNG_SHB              0x0a0d0d0a
+#define PCAPNG_IDB              0x00000001
+#define PCAPNG_SPB              0x00000003
+#define PCAPNG_EPB              0x00000006
+#define PCAPNG_BOM              0x1a2b3c4d
+#define PCAPNG_BLOCK_MIN        12
+#define PCAPNG_IDB_HDR_LEN      16
+#define PCAPNG_SPB_HDR_LEN      12
+#define PCAPNG_EPB_HDR_LEN      28
+#define PCAPNG_OPT_END          0
+#define PCAPNG_OPT_IF_TSRESOL   9
+#define PCAPNG_OPT_IF_TSOFFSET  14
+
+#define PCAPNG_TSRESOL_DEF      6
+
+static inline uint16_t _u16(const WcapPcapFile_t* pf, const uint8_t* p)
+{
+    uint16_t val = 0;
+    memcpy(&val, p, sizeof(val));
+    return pf->swapped ? __builtin_bswap16(val) : val;
+}
+
+static inline uint32_t _u32(const WcapPcapFile_t* pf, const uint8_t* p)
+{
+    uint32_t val = 0;
+    memcpy(&val, p, sizeof(val));
+    return pf->swapped ? __builtin_bswap32(val) : val;
+}
+
+static inline uint64_t _u64(const WcapPcapFile_t* pf, const uint8_t* p)
+{
+    uint64_t val = 0;
+    memcpy(&val, p, sizeof(val));
+    return pf->swapped ? __builtin_bswap64(val) : val;
+}
+
+static uint64_t _pow10(unsigned int n)
+{
+    uint64_t val = 1;
+    while (n--)
+    {
+        val *= 10;
+    }
+    return val;
+}
+
+// Interface timestamp units to nanoseconds
+static uint64_t _to_ns(const WcapPcapIface_t* iface, uint64_t ts)
+{
+    unsigned int n = iface->tsresol & 0x7f;
+    uint64_t ns = 0;
+
+    if (iface->tsresol & 0x80)
+    {
+        // Keep the fraction within 64 bits when multiplied out
+        if (n > 32)
+        {
+            ts >>= (n - 32);
+            n = 32;
+        }
+        ns = ((ts >> n) * 1000000000ULL) + (((ts & ((1ULL << n) - 1)) * 1000000000ULL) >> n);
+    }
+    else if (n <= 9)
+    {
+        ns = ts * _pow10(9 - n);
+    }
+    else
+    {
+        ns = (n < 29) ? (ts / _pow10(n - 9)) : 0;
+    }
+
+    return ns + (iface->tsoffset * 1000000000LL);
+}
+
+static bool _classic_header(WcapPcapFile_t* pf)
+{
+    uint32_t magic = 0;
+
+    memcpy(&magic, pf->map, sizeof(magic));
+    pf->swapped = ((magic == __builtin_bswap32(PCAP_MAGIC_USEC)) ||
+                   (magic == __builtin_bswap32(PCAP_MAGIC_NSEC)));
+    magic = pf->swapped ? __builtin_bswap32(magic) : magic;
+    if ((magic != PCAP_MAGIC_USEC) && (magic != PCAP_MAGIC_NSEC))
+    {
+        return false;
+    }
+
+    pf->ng = false;
+    pf->nsec = (magic == PCAP_MAGIC_NSEC);
+    pf->ifaces[0].linktype = _u32(pf, pf->map + PCAP_LINKTYPE_OFFSET);
+    pf->ifaces[0].tsresol = pf->nsec ? 9 : 6;
+    pf->ifaces[0].tsoffset = 0;
+    pf->ifaceCount = 1;
+    pf->start = PCAP_FILE_HDR_LEN;
+
+    return true;
+}
+
+static bool _classic_next(WcapPcapFile_t* pf, WcapPcapRecord_t* rec)
+{
+    const uint8_t* hdr = pf->map + pf->off;
+    uint32_t caplen = 0;
+    uint64_t ts = 0;
+
+    if ((pf->size - pf->off) < PCAP_REC_HDR_LEN)
+    {
+        pf->truncated += (pf->size != pf->off);
+        return false;
+    }
+
+    caplen = _u32(pf, hdr + 8);
+    if ((pf->size - pf->off - PCAP_REC_HDR_LEN) < caplen)
+    {
+        pf->truncated++;
+        return false;
+    }
+
+    ts = ((uint64_t) _u32(pf, hdr) * (pf->nsec ? 1000000000ULL : 1000000ULL)) + _u32(pf, hdr + 4);
+    rec->data = hdr + PCAP_REC_HDR_LEN;
+    rec->len = caplen;
+    rec->linktype = pf->ifaces[0].linktype;
+    rec->tstamp = _to_ns(&pf->ifaces[0], ts);
+    pf->off += PCAP_REC_HDR_LEN + caplen;
+
+    return true;
+}
+
+static void _idb(WcapPcapFile_t* pf, const uint8_t* body, const size_t len)
+{
+    WcapPcapIface_t* iface = NULL;
+    size_t off = 8;
+
+    // Further interfaces are still walked past, their packets are dropped
+    if (pf->ifaceCount >= WCAP_PCAPFILE_IFACES_MAX)
+    {
+        pf->ifaceCount++;
+        return;
+    }
+
+    iface = &pf->ifaces[pf->ifaceCount++];
+    iface->linktype = _u16(pf, body);
+    iface->tsresol = PCAPNG_TSRESOL_DEF;
+    iface->tsoffset = 0;
+
+    while ((off + 4) <= len)
+    {
+        uint16_t code = _u16(pf, body + off);
+        uint16_t olen = _u16(pf, body + off + 2);
+
+        off += 4;
+        if ((code == PCAPNG_OPT_END) || ((off + olen) > len))
+        {
+            break;
+        }
+        if ((code == PCAPNG_OPT_IF_TSRESOL) && (olen >= 1))
+        {
+            iface->tsresol = body[off];
+        }
+        else if ((code == PCAPNG_OPT_IF_TSOFFSET) && (olen >= 8))
+        {
+            iface->tsoffset = (int64_t) _u64(pf, body + off);
+        }
+        off += (olen + 3) & ~3U;
+    }
+}
+
+static bool _ng_next(WcapPcapFile_t* pf, WcapPcapRecord_t* rec)
+{
+    while ((pf->size - pf->off) >= PCAPNG_BLOCK_MIN)
+    {
+        const uint8_t* block = pf->map + pf->off;
+        const uint8_t* body = block + 8;
+        uint32_t type = 0;
+        uint32_t len = 0;
+
+        memcpy(&type, block, sizeof(type));
+
+        // Every section declares its own byte order and interfaces
+        if (type == PCAPNG_SHB)
+        {
+            uint32_t bom = 0;
+
+            memcpy(&bom, block + 8, sizeof(bom));
+            if ((bom != PCAPNG_BOM) && (bom != __builtin_bswap32(PCAPNG_BOM)))
+            {
+                pf->truncated++;
+                return false;
+            }
+            pf->swapped = (bom != PCAPNG_BOM);
+            pf->ifaceCount = 0;
+        }
+        type = _u32(pf, block);
+        len = _u32(pf, block + 4);
+
+        if ((len < PCAPNG_BLOCK_MIN) || (len & 3) || (len > (pf->size - pf->off)))
+        {
+            pf->truncated++;
+            return false;
+        }
+        pf->off += len;
+
+        if ((type == PCAPNG_IDB) && (len >= PCAPNG_IDB_HDR_LEN))
+        {
+            _idb(pf, body, len - PCAPNG_BLOCK_MIN);
+        }
+        else if ((type == PCAPNG_EPB) && (len >= PCAPNG_EPB_HDR_LEN + 4))
+        {
+            uint32_t ifid = _u32(pf, body);
+            uint64_t ts = ((uint64_t) _u32(pf, body + 4) << 32) | _u32(pf, body + 8);
+            uint32_t caplen = _u32(pf, body + 12);
+
+            if ((ifid >= pf->ifaceCount) || (ifid >= WCAP_PCAPFILE_IFACES_MAX) ||
+                (caplen > (len - PCAPNG_EPB_HDR_LEN - 4)))
+            {
+                continue;
+            }
+            rec->data = body + 20;
+            rec->len = caplen;
+            rec->linktype = pf->ifaces[ifid].linktype;
+            rec->tstamp = _to_ns(&pf->ifaces[ifid], ts);
+            pf->last = rec->tstamp;
+            return true;
+        }
+        else if ((type == PCAPNG_SPB) && (len >= PCAPNG_SPB_HDR_LEN + 4) && pf->ifaceCount)
+        {
+            // Simple packets have no timestamp, they follow the one before
+            uint32_t caplen = _u32(pf, body);
+            uint32_t room = len - PCAPNG_SPB_HDR_LEN - 4;
+
+            rec->data = body + 4;
+            rec->len = (caplen < room) ? caplen : room;
+            rec->linktype = pf->ifaces[0].linktype;
+            rec->tstamp = pf->last;
+            return true;
+        }
+    }
+
+    pf->truncated += (pf->size != pf->off);
+
+    return false;
+}
+
+bool WcapPcapFileOpen(WcapPcapFile_t* pf, const char* path)
+{
+
+    struct stat st = { 0 };
+    uint32_t magic = 0;
+    int fd = 0;
+    void* map = NULL;
+
+    if (!pf || !path)
+    {
+        return false;
+    }
+
+    memset(pf, 0, sizeof(*pf));
+
+    fd = open(path, (O_RDONLY | O_CLOEXEC));
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to open %s: [%d] %s\n", path, errno, strerror(errno));
+        return false;
+    }
+    if (fstat(fd, &st) < 0)
+    {
+        fprintf(stderr, "Failed to stat %s: [%d] %s\n", path, errno, strerror(errno));
+        close(fd);
+        return false;
+    }
+    if (st.st_size < PCAP_FILE_HDR_LEN)
+    {
+        fprintf(stderr, "Not a capture file: %s\n", path);
+        close(fd);
+        return false;
+    }
+
+    // The mapping outlives the descriptor
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map %s: [%d] %s\n", path, errno, strerror(errno));
+        return false;
+    }
+    // The advice values are not flags, each needs a call of its own
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    madvise(map, st.st_size, MADV_WILLNEED);
+
+    pf->map = map;
+    pf->size = st.st_size;
+
+    memcpy(&magic, pf->map, sizeof(magic));
+    if (magic == PCAPNG_SHB)
+    {
+        pf->ng = true;
+        pf->start = 0;
+    }
+    else if (!_classic_header(pf))
+    {
+        fprintf(stderr, "Not a pcap or pcapng file: %s\n", path);
+        WcapPcapFileClose(pf);
+        return false;
+    }
+    pf->off = pf->start;
+
+    return true;
+}
+
+bool WcapPcapFileClose(WcapPcapFile_t* pf)
+{
+
+    if (!pf)
+    {
+        return false;
+    }
+
+    if (pf->map)
+    {
+        munmap((void*) pf->map, pf->size);
+    }
+    memset(pf, 0, sizeof(*pf));
+
+    return true;
+}
+
+bool WcapPcapFileNext(WcapPcapFile_t* pf, WcapPcapRecord_t* rec)
+{
+
+    if (!pf || !pf->map || !rec)
+    {
+        return false;
+    }
+
+    if (!(pf->ng ? _ng_next(pf, rec) : _classic_next(pf, rec)))
+    {
+        return false;
+    }
+    pf->records++;
+
+    return true;
+}
+
+bool WcapPcapFileRewind(WcapPcapFile_t* pf)
+{
+
+    if (!pf || !pf->map)
+    {
+        return false;
+    }
+
+    // pcapng interfaces are declared again by the first section
+    pf->off = pf->start;
+    if (pf->ng)
+    {
+        pf->ifaceCount = 0;
+    }
+    pf->last = 0;
+
+    return true;
+}
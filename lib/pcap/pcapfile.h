@@ -0,0 +1,66 @@
+/*
+ ============================================================================
+ Name        : pcapfile.h
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet capture and forwarder
+ ============================================================================
+ */
+
+#ifndef _PCAPFILE_H_
+#define _PCAPFILE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Interfaces remembered per pcapng section
+#define WCAP_PCAPFILE_IFACES_MAX    16
+
+typedef struct WcapPcapIface
+{
+    uint16_t linktype;
+    // Timestamp resolution, 10^-n or, with the top bit set, 2^-n seconds
+    uint8_t tsresol;
+    int64_t tsoffset;
+} WcapPcapIface_t;
+
+typedef struct WcapPcapRecord
+{
+    const uint8_t* data;
+    size_t len;
+    uint16_t linktype;
+    // Nanoseconds since the epoch
+    uint64_t tstamp;
+} WcapPcapRecord_t;
+
+// Reads classic pcap and pcapng files of either byte order, mapped rather
+// than read so records point straight into the file
+typedef struct WcapPcapFile
+{
+    const uint8_t* map;
+    size_t size;
+    size_t off;
+    size_t start;
+    bool ng;
+    bool swapped;
+    // Classic pcap only, nanosecond rather than microsecond timestamps
+    bool nsec;
+    WcapPcapIface_t ifaces[WCAP_PCAPFILE_IFACES_MAX];
+    unsigned int ifaceCount;
+    uint64_t last;
+    uint64_t records;
+    uint64_t truncated;
+} WcapPcapFile_t;
+
+bool WcapPcapFileOpen(WcapPcapFile_t* pf, const char* path);
+bool WcapPcapFileClose(WcapPcapFile_t* pf);
+
+// Next packet in the file, skipping blocks that carry none; false at the end
+// of the file or where it is cut short
+bool WcapPcapFileNext(WcapPcapFile_t* pf, WcapPcapRecord_t* rec);
+// Back to the first packet
+bool WcapPcapFileRewind(WcapPcapFile_t* pf);
+
+#endif /* _PCAPFILE_H_ */
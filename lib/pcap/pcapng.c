@@ -0,0 +1,418 @@
+/*
+ ============================================================================
+ Name        : pcapng.c
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet concatenator
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "pcapng.h"
+
+// Block types and options, written in host byte order as the byte order
+// magic allows
+#define PCAPNG_SHB              0x0a0d0d0a
+#define PCAPNG_IDB              0x00000001
+#define PCAPNG_EPB              0x00000006
+#define PCAPNG_BOM              0x1a2b3c4d
+#define PCAPNG_OPT_END          0
+#define PCAPNG_OPT_SHB_APPL     4
+#define PCAPNG_OPT_IF_NAME      2
+#define PCAPNG_OPT_IF_TSRESOL   9
+
+// Block header and trailing length of an enhanced packet block
+#define PCAPNG_EPB_HDR_LEN      28
+#define PCAPNG_EPB_LEN(n)       (PCAPNG_EPB_HDR_LEN + (((n) + 3) & ~3UL) + 4)
+
+#define PCAPNG_PAD(n)           ((4 - ((n) & 3)) & 3)
+
+static WcapPcapngChunk_t* _pop_free(WcapPcapng_t* pc)
+{
+    WcapPcapngChunk_t* chunk = NULL;
+
+    pthread_mutex_lock(&pc->lock);
+    if (pc->freeCount)
+    {
+        chunk = &pc->chunks[pc->freeList[pc->freeCount - 1]];
+        __atomic_store_n(&pc->freeCount, pc->freeCount - 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&pc->lock);
+
+    return chunk;
+}
+
+static void _push_full(WcapPcapng_t* pc, WcapPcapngChunk_t* chunk, const bool last)
+{
+    chunk->last = last;
+
+    pthread_mutex_lock(&pc->lock);
+    pc->fullList[(pc->fullHead + pc->fullCount) % pc->count] = chunk - pc->chunks;
+    pc->fullCount++;
+    pthread_cond_signal(&pc->cond);
+    pthread_mutex_unlock(&pc->lock);
+}
+
+// Append to the buffer, moving on to the next chunk once one is full; the
+// caller has made sure there is room
+static void _put(WcapPcapng_t* pc, const void* data, size_t len)
+{
+    const uint8_t* src = data;
+
+    while (len)
+    {
+        size_t n = 0;
+
+        if (pc->cur->len == WCAP_PCAPNG_CHUNK_SIZE)
+        {
+            _push_full(pc, pc->cur, false);
+            pc->cur = _pop_free(pc);
+        }
+
+        n = WCAP_PCAPNG_CHUNK_SIZE - pc->cur->len;
+        n = (n < len) ? n : len;
+        memcpy(pc->cur->buf + pc->cur->len, src, n);
+        pc->cur->len += n;
+        src += n;
+        len -= n;
+    }
+}
+
+static void _put32(WcapPcapng_t* pc, const uint32_t val)
+{
+    _put(pc, &val, sizeof(val));
+}
+
+static void _put_opt(WcapPcapng_t* pc, const uint16_t code, const void* val, const uint16_t len)
+{
+    static const uint8_t zero[4] = { 0 };
+
+    _put(pc, &code, sizeof(code));
+    _put(pc, &len, sizeof(len));
+    _put(pc, val, len);
+    _put(pc, zero, PCAPNG_PAD(len));
+}
+
+// Section header and the one interface every frame is captured on
+static void _headers(WcapPcapng_t* pc)
+{
+    static const char appl[] = "wcap";
+    const uint16_t nlen = strlen(pc->ifname);
+    const uint8_t tsresol = 9;
+    const uint16_t version[2] = { 1, 0 };
+    const int64_t seclen = -1;
+    const uint16_t linktype[2] = { WCAP_PCAPNG_LINKTYPE, 0 };
+    uint32_t len = 0;
+
+    len = 28 + 4 + sizeof(appl) - 1 + PCAPNG_PAD(sizeof(appl) - 1) + 4;
+    _put32(pc, PCAPNG_SHB);
+    _put32(pc, len);
+    _put32(pc, PCAPNG_BOM);
+    _put(pc, version, sizeof(version));
+    _put(pc, &seclen, sizeof(seclen));
+    _put_opt(pc, PCAPNG_OPT_SHB_APPL, appl, sizeof(appl) - 1);
+    _put_opt(pc, PCAPNG_OPT_END, NULL, 0);
+    _put32(pc, len);
+    pc->fileBytes += len;
+
+    len = 20 + 4 + nlen + PCAPNG_PAD(nlen) + 4 + 4 + 4;
+    _put32(pc, PCAPNG_IDB);
+    _put32(pc, len);
+    _put(pc, linktype, sizeof(linktype));
+    _put32(pc, 0);
+    _put_opt(pc, PCAPNG_OPT_IF_NAME, pc->ifname, nlen);
+    _put_opt(pc, PCAPNG_OPT_IF_TSRESOL, &tsresol, sizeof(tsresol));
+    _put_opt(pc, PCAPNG_OPT_END, NULL, 0);
+    _put32(pc, len);
+    pc->fileBytes += len;
+}
+
+static bool _open(WcapPcapng_t* pc)
+{
+    char name[PATH_MAX + 16];
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+
+    if (pc->files)
+    {
+        snprintf(name, sizeof(name), "%s.%u", pc->path, pc->files);
+    }
+    else
+    {
+        snprintf(name, sizeof(name), "%s", pc->path);
+    }
+
+    pc->fd = open(name, (flags | (pc->direct ? O_DIRECT : 0)), 0644);
+    if ((pc->fd < 0) && pc->direct && (errno == EINVAL))
+    {
+        fprintf(stderr, "O_DIRECT not supported for %s, using buffered writes\n", name);
+        pc->direct = false;
+        pc->fd = open(name, flags, 0644);
+    }
+    if (pc->fd < 0)
+    {
+        fprintf(stderr, "Failed to open capture file %s: [%d] %s\n", name, errno, strerror(errno));
+        pc->fd = 0;
+        return false;
+    }
+
+    pc->files++;
+
+    return true;
+}
+
+static void _write(WcapPcapng_t* pc, const WcapPcapngChunk_t* chunk)
+{
+    size_t off = 0;
+
+    // Only the tail of a file is short of the O_DIRECT alignment, and it is
+    // the last thing written to it
+    if (pc->direct && (chunk->len % WCAP_PCAPNG_ALIGN))
+    {
+        fcntl(pc->fd, F_SETFL, fcntl(pc->fd, F_GETFL) & ~O_DIRECT);
+    }
+
+    while (off < chunk->len)
+    {
+        ssize_t cnt = write(pc->fd, chunk->buf + off, chunk->len - off);
+        if (cnt < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            fprintf(stderr, "Failed to write capture file: [%d] %s\n", errno, strerror(errno));
+            pc->writeErrors++;
+            return;
+        }
+        off += cnt;
+    }
+}
+
+static void* _writer(void* arg)
+{
+    WcapPcapng_t* pc = arg;
+
+    for (;;)
+    {
+        WcapPcapngChunk_t* chunk = NULL;
+        unsigned int idx = 0;
+
+        pthread_mutex_lock(&pc->lock);
+        while (!pc->fullCount && !pc->stop)
+        {
+            pthread_cond_wait(&pc->cond, &pc->lock);
+        }
+        if (!pc->fullCount)
+        {
+            pthread_mutex_unlock(&pc->lock);
+            break;
+        }
+        idx = pc->fullList[pc->fullHead];
+        pc->fullHead = (pc->fullHead + 1) % pc->count;
+        pc->fullCount--;
+        pthread_mutex_unlock(&pc->lock);
+
+        chunk = &pc->chunks[idx];
+        if (pc->fd || _open(pc))
+        {
+            _write(pc, chunk);
+        }
+        if (chunk->last && pc->fd)
+        {
+            close(pc->fd);
+            pc->fd = 0;
+        }
+        chunk->len = 0;
+        chunk->last = false;
+
+        pthread_mutex_lock(&pc->lock);
+        pc->freeList[pc->freeCount] = idx;
+        __atomic_store_n(&pc->freeCount, pc->freeCount + 1, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&pc->lock);
+    }
+
+    if (pc->fd)
+    {
+        close(pc->fd);
+        pc->fd = 0;
+    }
+
+    return NULL;
+}
+
+bool WcapPcapngCreate(WcapPcapng_t* pc, const char* path, const char* ifname, const size_t bufsiz,
+                      const uint64_t maxBytes, const unsigned int maxSecs, const bool direct)
+{
+
+    if (!pc || !path || !ifname || (strlen(path) >= sizeof(pc->path)))
+    {
+        return false;
+    }
+
+    memset(pc, 0, sizeof(*pc));
+    snprintf(pc->path, sizeof(pc->path), "%s", path);
+    snprintf(pc->ifname, sizeof(pc->ifname), "%s", ifname);
+    pc->direct = direct;
+    pc->maxBytes = maxBytes;
+    pc->maxNs = maxSecs * 1000000000ULL;
+    pthread_mutex_init(&pc->lock, NULL);
+    pthread_cond_init(&pc->cond, NULL);
+
+    // At least one chunk being filled while another is written
+    pc->count = bufsiz / WCAP_PCAPNG_CHUNK_SIZE;
+    pc->count = (pc->count < 2) ? 2 : pc->count;
+    pc->chunks = calloc(pc->count, sizeof(*pc->chunks));
+    pc->freeList = calloc(pc->count, sizeof(*pc->freeList));
+    pc->fullList = calloc(pc->count, sizeof(*pc->fullList));
+    if (!pc->chunks || !pc->freeList || !pc->fullList)
+    {
+        goto exit_fail;
+    }
+    for (unsigned int i = 0; i < pc->count; i++)
+    {
+        if (posix_memalign((void**) &pc->chunks[i].buf, WCAP_PCAPNG_ALIGN, WCAP_PCAPNG_CHUNK_SIZE))
+        {
+            pc->chunks[i].buf = NULL;
+            goto exit_fail;
+        }
+        pc->freeList[pc->freeCount++] = i;
+    }
+
+    if (pthread_create(&pc->thread, NULL, _writer, pc))
+    {
+        goto exit_fail;
+    }
+    pthread_setname_np(pc->thread, "wcap-pcapng");
+    pc->started = true;
+
+    // The first file is there from the start, even if nothing is captured
+    pc->cur = _pop_free(pc);
+    _headers(pc);
+
+    return true;
+
+exit_fail:
+
+    fprintf(stderr, "Failed to allocate capture file buffers\n");
+    WcapPcapngDestroy(pc);
+    return false;
+}
+
+bool WcapPcapngDestroy(WcapPcapng_t* pc)
+{
+
+    if (!pc)
+    {
+        return false;
+    }
+
+    if (pc->started)
+    {
+        if (pc->cur)
+        {
+            _push_full(pc, pc->cur, true);
+            pc->cur = NULL;
+        }
+
+        pthread_mutex_lock(&pc->lock);
+        pc->stop = true;
+        pthread_cond_signal(&pc->cond);
+        pthread_mutex_unlock(&pc->lock);
+        pthread_join(pc->thread, NULL);
+    }
+
+    for (unsigned int i = 0; pc->chunks && (i < pc->count); i++)
+    {
+        free(pc->chunks[i].buf);
+    }
+    free(pc->chunks);
+    free(pc->freeList);
+    free(pc->fullList);
+    pthread_mutex_destroy(&pc->lock);
+    pthread_cond_destroy(&pc->cond);
+    pc->chunks = NULL;
+    pc->freeList = NULL;
+    pc->fullList = NULL;
+    pc->started = false;
+
+    return true;
+}
+
+bool WcapPcapngWrite(WcapPcapng_t* pc, const void* frame, const size_t len,
+                     const uint64_t tstamp)
+{
+
+    static const uint8_t zero[4] = { 0 };
+    const uint32_t blklen = PCAPNG_EPB_LEN(len);
+    uint32_t hdr[7] = { 0 };
+    size_t room = 0;
+
+    if (!pc || !pc->started || !frame || (len > UINT16_MAX))
+    {
+        return false;
+    }
+
+    // Rotate between blocks once the file is full or old enough
+    if (pc->cur && pc->fileFrames &&
+        ((pc->maxBytes && ((pc->fileBytes + blklen) > pc->maxBytes)) ||
+         (pc->maxNs && ((tstamp - pc->fileStart) >= pc->maxNs))))
+    {
+        _push_full(pc, pc->cur, true);
+        pc->cur = NULL;
+        pc->fileBytes = 0;
+        pc->fileFrames = 0;
+    }
+
+    // A new file starts in a chunk of its own
+    if (!pc->cur)
+    {
+        pc->cur = _pop_free(pc);
+        if (!pc->cur)
+        {
+            pc->drops++;
+            return false;
+        }
+    }
+    if (!pc->fileBytes)
+    {
+        _headers(pc);
+    }
+
+    room = (WCAP_PCAPNG_CHUNK_SIZE - pc->cur->len) +
+           ((size_t) __atomic_load_n(&pc->freeCount, __ATOMIC_RELAXED) * WCAP_PCAPNG_CHUNK_SIZE);
+    if (blklen > room)
+    {
+        pc->drops++;
+        return false;
+    }
+
+    hdr[0] = PCAPNG_EPB;
+    hdr[1] = blklen;
+    hdr[2] = 0;
+    hdr[3] = tstamp >> 32;
+    hdr[4] = tstamp & 0xffffffff;
+    hdr[5] = len;
+    hdr[6] = len;
+    _put(pc, hdr, sizeof(hdr));
+    _put(pc, frame, len);
+    _put(pc, zero, PCAPNG_PAD(len));
+    _put32(pc, blklen);
+
+    // A file's age counts from its first frame
+    if (!pc->fileFrames++)
+    {
+        pc->fileStart = tstamp;
+    }
+    pc->fileBytes += blklen;
+    pc->frames++;
+    pc->bytes += len;
+
+    return true;
+}
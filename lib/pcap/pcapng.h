@@ -0,0 +1,84 @@
+/*
+ ============================================================================
+ Name        : pcapng.h
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet capture and forwarder
+ ============================================================================
+ */
+
+#ifndef _PCAPNG_H_
+#define _PCAPNG_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+
+// Write-behind buffer, handed to the writer thread a chunk at a time; chunks
+// are a multiple of the O_DIRECT alignment
+#define WCAP_PCAPNG_CHUNK_SIZE      (1024 * 1024)
+#define WCAP_PCAPNG_BUF_SIZE_DEF    (32 * WCAP_PCAPNG_CHUNK_SIZE)
+#define WCAP_PCAPNG_ALIGN           4096
+
+// LINKTYPE_IEEE802_11_RADIOTAP
+#define WCAP_PCAPNG_LINKTYPE        127
+
+typedef struct WcapPcapngChunk
+{
+    uint8_t* buf;
+    size_t len;
+    // Ends its file, the next chunk starts a new one
+    bool last;
+} WcapPcapngChunk_t;
+
+// Records captured frames to pcapng files, one interface per file, rotating
+// by size and age. The capture thread only copies into the write-behind
+// buffer, a frame that does not fit is dropped rather than waited for;
+// a writer thread does the I/O.
+typedef struct WcapPcapng
+{
+    char path[PATH_MAX];
+    char ifname[16];
+    bool direct;
+    uint64_t maxBytes;
+    uint64_t maxNs;
+    WcapPcapngChunk_t* chunks;
+    unsigned int count;
+    WcapPcapngChunk_t* cur;
+    uint64_t fileBytes;
+    uint64_t fileFrames;
+    uint64_t fileStart;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    unsigned int* freeList;
+    unsigned int freeCount;
+    unsigned int* fullList;
+    unsigned int fullHead;
+    unsigned int fullCount;
+    pthread_t thread;
+    bool started;
+    bool stop;
+    int fd;
+    unsigned int files;
+    uint64_t frames;
+    uint64_t bytes;
+    uint64_t drops;
+    uint64_t writeErrors;
+} WcapPcapng_t;
+
+// Record to 'path', then 'path'.1, 'path'.2, ... after each rotation; zero
+// limits never rotate
+bool WcapPcapngCreate(WcapPcapng_t* pc, const char* path, const char* ifname, const size_t bufsiz,
+                      const uint64_t maxBytes, const unsigned int maxSecs, const bool direct);
+// Write out whatever is buffered and stop the writer
+bool WcapPcapngDestroy(WcapPcapng_t* pc);
+
+// Queue a frame, radiotap header included, captured at 'tstamp' (ns since the
+// epoch); false when it was dropped
+bool WcapPcapngWrite(WcapPcapng_t* pc, const void* frame, const size_t len,
+                     const uint64_t tstamp);
+
+#endif /* _PCAPNG_H_ */
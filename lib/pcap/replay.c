@@ -0,0 +1,233 @@
+/*
+ ============================================================================
+ Name        : replay.c
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet concatenator
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "replay.h"
+
+// Radiotap header without any fields, enough for the driver to inject with
+#define RADIOTAP_HDR_LEN    8
+
+// Frame ready to inject, or false when the record has to be skipped
+static bool _frame(WcapReplay_t* rp, WcapPcapRecord_t* rec)
+{
+    if (!rec->len)
+    {
+        return false;
+    }
+
+    if (rec->linktype == WCAP_REPLAY_LINKTYPE_RADIOTAP)
+    {
+        return true;
+    }
+
+    if ((rec->linktype == WCAP_REPLAY_LINKTYPE_80211) &&
+        ((rec->len + RADIOTAP_HDR_LEN) <= WCAP_REPLAY_FRAME_MAX))
+    {
+        memset(rp->frame, 0, RADIOTAP_HDR_LEN);
+        rp->frame[2] = RADIOTAP_HDR_LEN;
+        memcpy(rp->frame + RADIOTAP_HDR_LEN, rec->data, rec->len);
+        rec->data = rp->frame;
+        rec->len += RADIOTAP_HDR_LEN;
+        return true;
+    }
+
+    return false;
+}
+
+bool WcapReplayCreate(WcapReplay_t* rp, const char* path, const bool timed,
+                      const unsigned int loops)
+{
+
+    if (!rp || !path)
+    {
+        return false;
+    }
+
+    memset(rp, 0, sizeof(*rp));
+    rp->timed = timed;
+    rp->loops = loops;
+    rp->rebase = true;
+
+    rp->frame = malloc(WCAP_REPLAY_FRAME_MAX);
+    if (!rp->frame)
+    {
+        fprintf(stderr, "Failed to allocate replay buffer\n");
+        return false;
+    }
+
+    if (!WcapPcapFileOpen(&rp->file, path))
+    {
+        WcapReplayDestroy(rp);
+        return false;
+    }
+
+    return true;
+}
+
+bool WcapReplayDestroy(WcapReplay_t* rp)
+{
+
+    if (!rp)
+    {
+        return false;
+    }
+
+    WcapPcapFileClose(&rp->file);
+    free(rp->frame);
+    rp->frame = NULL;
+
+    return true;
+}
+
+bool WcapReplayPeek(WcapReplay_t* rp, const uint64_t now, const uint8_t** frame, size_t* len,
+                    uint64_t* due)
+{
+
+    if (!rp || !rp->frame || !frame || !len || !due)
+    {
+        return false;
+    }
+
+    while (!rp->pending && !rp->done)
+    {
+        if (!WcapPcapFileNext(&rp->file, &rp->rec))
+        {
+            // Nothing at all to send would loop forever
+            rp->pass++;
+            if (!rp->frames || (rp->loops && (rp->pass >= rp->loops)))
+            {
+                rp->done = true;
+                break;
+            }
+            WcapPcapFileRewind(&rp->file);
+            rp->rebase = true;
+            continue;
+        }
+
+        if (!_frame(rp, &rp->rec))
+        {
+            rp->skipped++;
+            continue;
+        }
+
+        if (!rp->timed)
+        {
+            rp->due = now;
+        }
+        else
+        {
+            // Each pass follows straight on from the one before, at the gaps
+            // the frames were captured with
+            if (rp->rebase)
+            {
+                rp->rebase = false;
+                rp->first = rp->rec.tstamp;
+                rp->base = rp->frames ? rp->due : now;
+            }
+            if (rp->rec.tstamp >= rp->first)
+            {
+                uint64_t at = rp->base + (rp->rec.tstamp - rp->first);
+                rp->due = (at > rp->due) ? at : rp->due;
+            }
+        }
+        rp->pending = true;
+    }
+
+    if (!rp->pending)
+    {
+        return false;
+    }
+
+    *frame = rp->rec.data;
+    *len = rp->rec.len;
+    *due = rp->due;
+
+    return true;
+}
+
+void WcapReplaySent(WcapReplay_t* rp, const uint64_t now)
+{
+    uint64_t err = 0;
+    uint64_t usec = 0;
+    unsigned int bucket = 0;
+
+    if (!rp || !rp->pending)
+    {
+        return;
+    }
+
+    rp->pending = false;
+    rp->frames++;
+    rp->bytes += rp->rec.len;
+
+    if (!rp->timed)
+    {
+        return;
+    }
+
+    // Frames are never sent early, only late
+    err = (now > rp->due) ? (now - rp->due) : 0;
+    rp->errSum += err;
+    rp->errMax = (err > rp->errMax) ? err : rp->errMax;
+
+    usec = err / 1000;
+    bucket = usec ? (64 - __builtin_clzll(usec)) : 0;
+    bucket = (bucket < WCAP_REPLAY_HIST_BUCKETS) ? bucket : (WCAP_REPLAY_HIST_BUCKETS - 1);
+    rp->hist[bucket]++;
+}
+
+void WcapReplayPrint(const WcapReplay_t* rp, FILE* out)
+{
+    if (!rp || !out)
+    {
+        return;
+    }
+
+    fprintf(out, "Replayed %llu frames (%llu bytes) in %u passes, %llu skipped\n",
+                 (unsigned long long) rp->frames, (unsigned long long) rp->bytes, rp->pass,
+                 (unsigned long long) rp->skipped);
+    if (rp->file.truncated)
+    {
+        fprintf(out, "Capture file is cut short or damaged\n");
+    }
+
+    if (!rp->timed || !rp->frames)
+    {
+        return;
+    }
+
+    fprintf(out, "Timing error: mean %llu ns, max %llu ns\n",
+                 (unsigned long long) (rp->errSum / rp->frames),
+                 (unsigned long long) rp->errMax);
+    for (unsigned int i = 0; i < WCAP_REPLAY_HIST_BUCKETS; i++)
+    {
+        if (!rp->hist[i])
+        {
+            continue;
+        }
+        if (!i)
+        {
+            fprintf(out, "  %10s us: %llu\n", "< 1", (unsigned long long) rp->hist[i]);
+        }
+        else if (i == (WCAP_REPLAY_HIST_BUCKETS - 1))
+        {
+            fprintf(out, "  >= %7llu us: %llu\n", (1ULL << (i - 1)),
+                         (unsigned long long) rp->hist[i]);
+        }
+        else
+        {
+            fprintf(out, "  %4llu-%5llu us: %llu\n", (1ULL << (i - 1)), (1ULL << i),
+                         (unsigned long long) rp->hist[i]);
+        }
+    }
+}
@@ -0,0 +1,74 @@
+/*
+ ============================================================================
+ Name        : replay.h
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet capture and forwarder
+ ============================================================================
+ */
+
+#ifndef _REPLAY_H_
+#define _REPLAY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "pcapfile.h"
+
+// LINKTYPE_IEEE802_11 and LINKTYPE_IEEE802_11_RADIOTAP, the only frames
+// that can be injected
+#define WCAP_REPLAY_LINKTYPE_80211      105
+#define WCAP_REPLAY_LINKTYPE_RADIOTAP   127
+
+#define WCAP_REPLAY_FRAME_MAX           65536
+
+// Frames injected per wakeup at most
+#define WCAP_REPLAY_BURST               64
+
+// Timing error histogram, power of two buckets from under a microsecond up
+#define WCAP_REPLAY_HIST_BUCKETS        24
+
+// Paces the frames of a capture file, at the gaps they were captured with or
+// back to back, any number of times over; owned by a single thread
+typedef struct WcapReplay
+{
+    WcapPcapFile_t file;
+    bool timed;
+    // Passes over the file, 0 for no end
+    unsigned int loops;
+    unsigned int pass;
+    // When the current pass started and the capture time it started at
+    uint64_t base;
+    uint64_t first;
+    uint64_t due;
+    bool rebase;
+    WcapPcapRecord_t rec;
+    bool pending;
+    bool done;
+    // Bare 802.11 frames get a radiotap header put in front of them here
+    uint8_t* frame;
+    uint64_t frames;
+    uint64_t bytes;
+    uint64_t skipped;
+    uint64_t errSum;
+    uint64_t errMax;
+    uint64_t hist[WCAP_REPLAY_HIST_BUCKETS];
+} WcapReplay_t;
+
+bool WcapReplayCreate(WcapReplay_t* rp, const char* path, const bool timed,
+                      const unsigned int loops);
+bool WcapReplayDestroy(WcapReplay_t* rp);
+
+// Next frame to inject and the CLOCK_MONOTONIC time it is due at, which is
+// always now when not timed; false once every pass is over
+bool WcapReplayPeek(WcapReplay_t* rp, const uint64_t now, const uint8_t** frame, size_t* len,
+                    uint64_t* due);
+// The frame from WcapReplayPeek() went out at 'now'
+void WcapReplaySent(WcapReplay_t* rp, const uint64_t now);
+
+void WcapReplayPrint(const WcapReplay_t* rp, FILE* out);
+
+#endif /* _REPLAY_H_ */
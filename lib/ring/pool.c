@@ -0,0 +1,259 @@
+/*
+ ============================================================================
+ Name        : pool.c
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet concatenator
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/mman.h>
+
+#include "pool.h"
+
+#define POOL_HUGE_PAGE      (2 * 1024 * 1024)
+
+static void* _map(WcapPool_t* pool, const size_t len, const bool huge)
+{
+    void* mem = MAP_FAILED;
+
+    if (huge)
+    {
+        pool->memsiz = (len + POOL_HUGE_PAGE - 1) & ~((size_t) POOL_HUGE_PAGE - 1);
+        mem = mmap(NULL, pool->memsiz, (PROT_READ | PROT_WRITE),
+                   (MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE), -1, 0);
+        if (mem != MAP_FAILED)
+        {
+            pool->huge = true;
+            return mem;
+        }
+        // Nothing reserved in /proc/sys/vm/nr_hugepages, settle for whatever
+        // transparent huge pages give
+        fprintf(stderr, "No huge pages for frame pool, using normal pages: [%d] %s\n", errno,
+                strerror(errno));
+    }
+
+    pool->memsiz = len;
+    mem = mmap(NULL, pool->memsiz, (PROT_READ | PROT_WRITE), (MAP_PRIVATE | MAP_ANONYMOUS), -1, 0);
+    if (mem == MAP_FAILED)
+    {
+        return mem;
+    }
+    if (huge)
+    {
+        madvise(mem, pool->memsiz, MADV_HUGEPAGE);
+    }
+
+    // Fault every page in now rather than on the datapath
+    memset(mem, 0, pool->memsiz);
+
+    return mem;
+}
+
+bool WcapPoolCreate(WcapPool_t* pool, const unsigned int count, const size_t bufsiz,
+                    const bool huge)
+{
+
+    if (!pool || !count || (count > WCAP_POOL_COUNT_MAX) || !bufsiz)
+    {
+        return false;
+    }
+
+    memset(pool, 0, sizeof(*pool));
+
+    pool->count = count;
+    pool->bufsiz = (bufsiz + WCAP_CACHE_LINE - 1) & ~(WCAP_CACHE_LINE - 1);
+
+    // Descriptors live apart from the data so the data is all frames
+    pool->bufs = calloc(count, sizeof(*pool->bufs));
+    if (!pool->bufs)
+    {
+        fprintf(stderr, "Failed to allocate frame pool of %u buffers\n", count);
+        return false;
+    }
+
+    pool->mem = _map(pool, ((size_t) count * pool->bufsiz), huge);
+    if (pool->mem == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map frame pool of %u buffers: [%d] %s\n", count, errno,
+                strerror(errno));
+        free(pool->bufs);
+        memset(pool, 0, sizeof(*pool));
+        return false;
+    }
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        pool->bufs[i].data = pool->mem + ((size_t) i * pool->bufsiz);
+        pool->bufs[i].next = (i + 1 < count) ? &pool->bufs[i + 1] : NULL;
+    }
+    pool->free = pool->bufs;
+    pool->freeCount = count;
+
+    pthread_mutex_init(&pool->lock, NULL);
+
+    return true;
+}
+
+bool WcapPoolDestroy(WcapPool_t* pool)
+{
+
+    if (!pool)
+    {
+        return false;
+    }
+
+    if (pool->mem)
+    {
+        munmap(pool->mem, pool->memsiz);
+        pthread_mutex_destroy(&pool->lock);
+    }
+    free(pool->bufs);
+    memset(pool, 0, sizeof(*pool));
+
+    return true;
+}
+
+unsigned int WcapPoolAvailable(WcapPool_t* pool)
+{
+
+    unsigned int cnt = 0;
+
+    if (!pool || !pool->mem)
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    cnt = pool->freeCount;
+    pthread_mutex_unlock(&pool->lock);
+
+    return cnt;
+}
+
+void WcapPoolCacheInit(WcapPoolCache_t* cache, WcapPool_t* pool)
+{
+    if (cache)
+    {
+        memset(cache, 0, sizeof(*cache));
+        cache->pool = pool;
+    }
+}
+
+// Hands 'n' buffers from the head of the cache back to the shared list
+static void _give(WcapPoolCache_t* cache, unsigned int n)
+{
+
+    WcapPool_t* pool = cache->pool;
+    WcapPoolBuf_t* head = cache->free;
+    WcapPoolBuf_t* tail = head;
+
+    if (!n || !head)
+    {
+        return;
+    }
+
+    for (unsigned int i = 1; (i < n) && tail->next; i++)
+    {
+        tail = tail->next;
+    }
+    cache->free = tail->next;
+
+    pthread_mutex_lock(&pool->lock);
+    tail->next = pool->free;
+    pool->free = head;
+    pool->freeCount += n;
+    pthread_mutex_unlock(&pool->lock);
+
+    cache->count -= n;
+}
+
+void WcapPoolCacheFlush(WcapPoolCache_t* cache)
+{
+    if (cache && cache->pool && cache->pool->mem)
+    {
+        _give(cache, cache->count);
+    }
+}
+
+WcapPoolBuf_t* WcapPoolGet(WcapPoolCache_t* cache)
+{
+
+    WcapPool_t* pool = NULL;
+    WcapPoolBuf_t* buf = NULL;
+
+    if (!cache || !cache->pool || !cache->pool->mem)
+    {
+        return NULL;
+    }
+    pool = cache->pool;
+
+    // Refill a batch at a time so the lock is taken once per batch
+    if (!cache->free)
+    {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->free && (cache->count < WCAP_POOL_CACHE_BATCH))
+        {
+            buf = pool->free;
+            pool->free = buf->next;
+            pool->freeCount--;
+            buf->next = cache->free;
+            cache->free = buf;
+            cache->count++;
+        }
+        if (!cache->free)
+        {
+            pool->exhausted++;
+        }
+        pthread_mutex_unlock(&pool->lock);
+
+        if (!cache->free)
+        {
+            cache->exhausted++;
+            return NULL;
+        }
+    }
+
+    buf = cache->free;
+    cache->free = buf->next;
+    cache->count--;
+    cache->gets++;
+
+    buf->next = NULL;
+    buf->len = 0;
+    buf->tstamp = 0;
+    __atomic_store_n(&buf->refs, 1, __ATOMIC_RELAXED);
+
+    return buf;
+}
+
+void WcapPoolPut(WcapPoolCache_t* cache, WcapPoolBuf_t* buf)
+{
+
+    if (!cache || !cache->pool || !buf)
+    {
+        return;
+    }
+
+    // Whoever drops the last reference sees every write the others made
+    if (__atomic_sub_fetch(&buf->refs, 1, __ATOMIC_ACQ_REL))
+    {
+        return;
+    }
+
+    buf->next = cache->free;
+    cache->free = buf;
+    cache->count++;
+
+    // A thread that only ever frees passes buffers back to those that allocate
+    if (cache->count > WCAP_POOL_CACHE_MAX)
+    {
+        _give(cache, (cache->count - WCAP_POOL_CACHE_BATCH));
+    }
+}
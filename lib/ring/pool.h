@@ -0,0 +1,87 @@
+/*
+ ============================================================================
+ Name        : pool.h
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet capture and forwarder
+ ============================================================================
+ */
+
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "spsc.h"
+
+#define WCAP_POOL_COUNT_MAX     (1 << 20)
+
+// Buffers a thread keeps for itself, and moves to or from the shared list
+// at once when it runs out or has too many
+#define WCAP_POOL_CACHE_BATCH   32
+#define WCAP_POOL_CACHE_MAX     (4 * WCAP_POOL_CACHE_BATCH)
+
+// One frame buffer; whoever holds a reference may read it, the last one to
+// let go gives it back
+typedef struct WcapPoolBuf
+{
+    uint32_t refs;
+    uint32_t len;
+    uint64_t tstamp;
+    uint8_t* data;
+    struct WcapPoolBuf* next;
+} WcapPoolBuf_t;
+
+// Fixed size buffers allocated once, in huge pages when asked for and
+// available. Buffers move between threads in batches through a shared list,
+// each thread otherwise allocating from and freeing to a cache of its own.
+typedef struct WcapPool
+{
+    // Shared between every cache
+    pthread_mutex_t lock WCAP_CACHE_ALIGNED;
+    WcapPoolBuf_t* free;
+    unsigned int freeCount;
+    uint64_t exhausted;
+
+    // Constant once created
+    unsigned int count WCAP_CACHE_ALIGNED;
+    size_t bufsiz;
+    size_t memsiz;
+    bool huge;
+    uint8_t* mem;
+    WcapPoolBuf_t* bufs;
+} WcapPool_t;
+
+// Owned by a single thread
+typedef struct WcapPoolCache
+{
+    WcapPool_t* pool;
+    WcapPoolBuf_t* free;
+    unsigned int count;
+    uint64_t gets;
+    uint64_t exhausted;
+} WcapPoolCache_t;
+
+bool WcapPoolCreate(WcapPool_t* pool, const unsigned int count, const size_t bufsiz,
+                    const bool huge);
+bool WcapPoolDestroy(WcapPool_t* pool);
+unsigned int WcapPoolAvailable(WcapPool_t* pool);
+
+void WcapPoolCacheInit(WcapPoolCache_t* cache, WcapPool_t* pool);
+void WcapPoolCacheFlush(WcapPoolCache_t* cache);
+
+// A buffer with one reference, or NULL and counted when there are none left
+WcapPoolBuf_t* WcapPoolGet(WcapPoolCache_t* cache);
+// Gives up one reference, into the cache of the caller's thread
+void WcapPoolPut(WcapPoolCache_t* cache, WcapPoolBuf_t* buf);
+
+static inline void WcapPoolRef(WcapPoolBuf_t* buf)
+{
+    __atomic_fetch_add(&buf->refs, 1, __ATOMIC_RELAXED);
+}
+
+#endif /* _POOL_H_ */
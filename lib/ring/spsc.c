@@ -0,0 +1,212 @@
+/*
+ ============================================================================
+ Name        : spsc.c
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet concatenator
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <sys/eventfd.h>
+
+#include "spsc.h"
+
+typedef struct
+{
+    uint32_t len;
+    uint32_t pad;
+    uint64_t tstamp;
+} SpscSlot_t;
+
+static SpscSlot_t* _slot(WcapSpsc_t* ring, const uint32_t idx)
+{
+    return (SpscSlot_t*) (ring->slots + ((size_t) (idx & ring->mask) * ring->slotsiz));
+}
+
+bool WcapSpscCreate(WcapSpsc_t* ring, const unsigned int count, const size_t maxlen)
+{
+
+    unsigned int size = 1;
+
+    if (!ring || !count || (count > WCAP_SPSC_COUNT_MAX) || !maxlen)
+    {
+        return false;
+    }
+
+    memset(ring, 0, sizeof(*ring));
+
+    // Free running indices are masked, so round up to a power of two
+    while (size < count)
+    {
+        size <<= 1;
+    }
+
+    ring->mask = size - 1;
+    ring->maxlen = maxlen;
+    ring->slotsiz = (sizeof(SpscSlot_t) + maxlen + WCAP_CACHE_LINE - 1) & ~(WCAP_CACHE_LINE - 1);
+
+    if (posix_memalign((void**) &ring->slots, WCAP_CACHE_LINE, (size_t) size * ring->slotsiz))
+    {
+        fprintf(stderr, "Failed to allocate ring of %u slots\n", size);
+        ring->slots = NULL;
+        return false;
+    }
+
+    // Wakes the consumer when it is blocked in its event loop
+    ring->efd = eventfd(0, (EFD_NONBLOCK | EFD_CLOEXEC));
+    if (ring->efd < 0)
+    {
+        fprintf(stderr, "Failed to create ring notifier: [%d] %s\n", errno, strerror(errno));
+        free(ring->slots);
+        memset(ring, 0, sizeof(*ring));
+        return false;
+    }
+
+    return true;
+}
+
+bool WcapSpscDestroy(WcapSpsc_t* ring)
+{
+
+    if (!ring)
+    {
+        return false;
+    }
+
+    if (ring->efd > 0)
+    {
+        close(ring->efd);
+    }
+    free(ring->slots);
+    memset(ring, 0, sizeof(*ring));
+
+    return true;
+}
+
+bool WcapSpscPush(WcapSpsc_t* ring, const void* data, const size_t len, const uint64_t tstamp)
+{
+
+    SpscSlot_t* slot = NULL;
+    uint32_t head = 0;
+
+    if (!ring || !ring->slots || (len > ring->maxlen))
+    {
+        if (ring)
+        {
+            ring->drops++;
+        }
+        return false;
+    }
+
+    // Only reload the consumer's index when the cached one says we are full
+    head = ring->head;
+    if ((head - ring->tailCache) > ring->mask)
+    {
+        ring->tailCache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if ((head - ring->tailCache) > ring->mask)
+        {
+            ring->drops++;
+            return false;
+        }
+    }
+
+    slot = _slot(ring, head);
+    slot->len = len;
+    slot->tstamp = tstamp;
+    memcpy(slot + 1, data, len);
+
+    __atomic_store_n(&ring->head, (head + 1), __ATOMIC_RELEASE);
+    ring->pushed++;
+
+    return true;
+}
+
+void WcapSpscNotify(WcapSpsc_t* ring)
+{
+    // Called once per burst rather than once per push
+    if (ring && (ring->efd > 0))
+    {
+        eventfd_write(ring->efd, 1);
+    }
+}
+
+bool WcapSpscPeek(WcapSpsc_t* ring, uint8_t** data, size_t* len, uint64_t* tstamp)
+{
+
+    SpscSlot_t* slot = NULL;
+    uint32_t tail = 0;
+
+    if (!ring || !ring->slots || !data || !len)
+    {
+        return false;
+    }
+
+    tail = ring->tail;
+    if (tail == ring->headCache)
+    {
+        ring->headCache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (tail == ring->headCache)
+        {
+            return false;
+        }
+        // Track the deepest backlog the consumer has found waiting
+        if ((ring->headCache - tail) > ring->peak)
+        {
+            ring->peak = ring->headCache - tail;
+        }
+    }
+
+    slot = _slot(ring, tail);
+    *data = (uint8_t*) (slot + 1);
+    *len = slot->len;
+    if (tstamp)
+    {
+        *tstamp = slot->tstamp;
+    }
+
+    return true;
+}
+
+void WcapSpscPop(WcapSpsc_t* ring)
+{
+    if (ring && ring->slots)
+    {
+        __atomic_store_n(&ring->tail, (ring->tail + 1), __ATOMIC_RELEASE);
+    }
+}
+
+void WcapSpscClear(WcapSpsc_t* ring)
+{
+    eventfd_t val = 0;
+
+    // Consume the pending notification before draining, so a push that races
+    // with the drain leaves a fresh one behind
+    if (ring && (ring->efd > 0))
+    {
+        eventfd_read(ring->efd, &val);
+    }
+}
+
+unsigned int WcapSpscCount(WcapSpsc_t* ring)
+{
+
+    uint32_t head = 0;
+    uint32_t tail = 0;
+
+    if (!ring || !ring->slots)
+    {
+        return 0;
+    }
+
+    head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    return (head - tail);
+}
@@ -0,0 +1,64 @@
+/*
+ ============================================================================
+ Name        : spsc.h
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet capture and forwarder
+ ============================================================================
+ */
+
+#ifndef _SPSC_H_
+#define _SPSC_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define WCAP_CACHE_LINE         64
+
+#define WCAP_SPSC_COUNT_DEF     1024
+#define WCAP_SPSC_COUNT_MAX     (1 << 20)
+
+#define WCAP_CACHE_ALIGNED      __attribute__((aligned(WCAP_CACHE_LINE)))
+
+// Lock-free single producer / single consumer ring of fixed size slots. Each
+// side's index lives on its own cache line next to a private copy of the
+// other side's index, so the line only bounces when the cached copy runs out.
+typedef struct WcapSpsc
+{
+    // Owned by the producer
+    uint32_t head WCAP_CACHE_ALIGNED;
+    uint32_t tailCache;
+    uint64_t pushed;
+    uint64_t drops;
+
+    // Owned by the consumer
+    uint32_t tail WCAP_CACHE_ALIGNED;
+    uint32_t headCache;
+    uint32_t peak;
+
+    // Constant once created
+    int efd WCAP_CACHE_ALIGNED;
+    uint32_t mask;
+    size_t slotsiz;
+    size_t maxlen;
+    uint8_t* slots;
+} WcapSpsc_t;
+
+bool WcapSpscCreate(WcapSpsc_t* ring, const unsigned int count, const size_t maxlen);
+bool WcapSpscDestroy(WcapSpsc_t* ring);
+
+// Producer side
+bool WcapSpscPush(WcapSpsc_t* ring, const void* data, const size_t len, const uint64_t tstamp);
+void WcapSpscNotify(WcapSpsc_t* ring);
+
+// Consumer side; the slot returned by Peek stays valid until Pop
+bool WcapSpscPeek(WcapSpsc_t* ring, uint8_t** data, size_t* len, uint64_t* tstamp);
+void WcapSpscPop(WcapSpsc_t* ring);
+void WcapSpscClear(WcapSpsc_t* ring);
+
+// Either side
+unsigned int WcapSpscCount(WcapSpsc_t* ring);
+
+#endif /* _SPSC_H_ */
@@ -0,0 +1,406 @@
+/*
+ ============================================================================
+ Name        : stats.c
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet concatenator
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "stats.h"
+
+static const char* _names[WCAP_STATS_MAX] =
+{
+    [WCAP_STATS_RAW_RX_FRAMES] = "raw_rx_frames",
+    [WCAP_STATS_RAW_RX_BYTES] = "raw_rx_bytes",
+    [WCAP_STATS_RAW_RX_BURSTS] = "raw_rx_bursts",
+    [WCAP_STATS_RAW_RX_TRUNC] = "raw_rx_truncated",
+    [WCAP_STATS_RAW_RX_DROP_RING] = "raw_rx_drop_ring_full",
+    [WCAP_STATS_RAW_RX_DROP_RECORD] = "raw_rx_drop_record",
+    [WCAP_STATS_RAW_RX_DROP_POOL] = "raw_rx_drop_pool_empty",
+    [WCAP_STATS_UDP_TX_DATAGRAMS] = "udp_tx_datagrams",
+    [WCAP_STATS_UDP_TX_BYTES] = "udp_tx_bytes",
+    [WCAP_STATS_UDP_TX_BATCHES] = "udp_tx_batches",
+    [WCAP_STATS_UDP_TX_EAGAIN] = "udp_tx_eagain",
+    [WCAP_STATS_UDP_TX_DROP_SOCKET] = "udp_tx_drop_socket",
+    [WCAP_STATS_UDP_TX_DROP_SUPPRESS] = "udp_tx_drop_suppressed",
+    [WCAP_STATS_UDP_TX_DROP_OVERSIZE] = "udp_tx_drop_oversize",
+    [WCAP_STATS_UDP_TX_BATCH + 0] = "udp_tx_batch_1",
+    [WCAP_STATS_UDP_TX_BATCH + 1] = "udp_tx_batch_2_3",
+    [WCAP_STATS_UDP_TX_BATCH + 2] = "udp_tx_batch_4_7",
+    [WCAP_STATS_UDP_TX_BATCH + 3] = "udp_tx_batch_8_15",
+    [WCAP_STATS_UDP_TX_BATCH + 4] = "udp_tx_batch_16_31",
+    [WCAP_STATS_UDP_TX_BATCH + 5] = "udp_tx_batch_32_63",
+    [WCAP_STATS_UDP_TX_BATCH + 6] = "udp_tx_batch_64_up",
+    [WCAP_STATS_UDP_TX_LZ4 + WCAP_STATS_LZ4_PACKED] = "udp_tx_lz4_packed",
+    [WCAP_STATS_UDP_TX_LZ4 + WCAP_STATS_LZ4_SMALL] = "udp_tx_lz4_small",
+    [WCAP_STATS_UDP_TX_LZ4 + WCAP_STATS_LZ4_INCOMPRESSIBLE] = "udp_tx_lz4_incompressible",
+    [WCAP_STATS_UDP_TX_LZ4 + WCAP_STATS_LZ4_BYTES_IN] = "udp_tx_lz4_bytes_in",
+    [WCAP_STATS_UDP_TX_LZ4 + WCAP_STATS_LZ4_BYTES_OUT] = "udp_tx_lz4_bytes_out",
+    [WCAP_STATS_UDP_TX_LZ4 + WCAP_STATS_LZ4_NS] = "udp_tx_lz4_ns",
+    [WCAP_STATS_UDP_RX_DATAGRAMS] = "udp_rx_datagrams",
+    [WCAP_STATS_UDP_RX_BYTES] = "udp_rx_bytes",
+    [WCAP_STATS_UDP_RX_BATCHES] = "udp_rx_batches",
+    [WCAP_STATS_UDP_RX_TRUNC] = "udp_rx_truncated",
+    [WCAP_STATS_UDP_RX_DROP_MALFORMED] = "udp_rx_drop_malformed",
+    [WCAP_STATS_UDP_RX_DROP_TUNNEL] = "udp_rx_drop_unknown_tunnel",
+    [WCAP_STATS_UDP_RX_DROP_SESSION] = "udp_rx_drop_session_full",
+    [WCAP_STATS_UDP_RX_DROP_REBUILD] = "udp_rx_drop_not_rebuilt",
+    [WCAP_STATS_UDP_RX_DROP_RING] = "udp_rx_drop_ring_full",
+    [WCAP_STATS_UDP_RX_MISROUTED] = "udp_rx_misrouted",
+    [WCAP_STATS_UDP_RX_SEQ_LOST] = "udp_rx_seq_lost",
+    [WCAP_STATS_UDP_RX_SEQ_REORDERED] = "udp_rx_seq_reordered",
+    [WCAP_STATS_UDP_RX_SEQ_DUPLICATE] = "udp_rx_seq_duplicate",
+    [WCAP_STATS_UDP_RX_SEQ_LATE] = "udp_rx_seq_late",
+    [WCAP_STATS_UDP_RX_SEQ_RESYNC] = "udp_rx_seq_resync",
+    [WCAP_STATS_UDP_RX_REORDER_HELD] = "udp_rx_reorder_held",
+    [WCAP_STATS_UDP_RX_BATCH + 0] = "udp_rx_batch_1",
+    [WCAP_STATS_UDP_RX_BATCH + 1] = "udp_rx_batch_2_3",
+    [WCAP_STATS_UDP_RX_BATCH + 2] = "udp_rx_batch_4_7",
+    [WCAP_STATS_UDP_RX_BATCH + 3] = "udp_rx_batch_8_15",
+    [WCAP_STATS_UDP_RX_BATCH + 4] = "udp_rx_batch_16_31",
+    [WCAP_STATS_UDP_RX_BATCH + 5] = "udp_rx_batch_32_63",
+    [WCAP_STATS_UDP_RX_BATCH + 6] = "udp_rx_batch_64_up",
+    [WCAP_STATS_UDP_RX_LZ4 + WCAP_STATS_LZ4_PACKED] = "udp_rx_lz4_expanded",
+    [WCAP_STATS_UDP_RX_LZ4 + WCAP_STATS_LZ4_MALFORMED] = "udp_rx_lz4_malformed",
+    [WCAP_STATS_UDP_RX_LZ4 + WCAP_STATS_LZ4_BYTES_IN] = "udp_rx_lz4_bytes_in",
+    [WCAP_STATS_UDP_RX_LZ4 + WCAP_STATS_LZ4_BYTES_OUT] = "udp_rx_lz4_bytes_out",
+    [WCAP_STATS_UDP_RX_LZ4 + WCAP_STATS_LZ4_NS] = "udp_rx_lz4_ns",
+    [WCAP_STATS_RAW_TX_FRAMES] = "raw_tx_frames",
+    [WCAP_STATS_RAW_TX_BYTES] = "raw_tx_bytes",
+    [WCAP_STATS_RAW_TX_EAGAIN] = "raw_tx_eagain",
+    [WCAP_STATS_RAW_TX_ERRORS] = "raw_tx_errors",
+    [WCAP_STATS_RAW_RX_DROP_KERNEL] = "raw_rx_drop_kernel",
+    [WCAP_STATS_UDP_RX_DROP_KERNEL] = "udp_rx_drop_kernel"
+};
+
+static const char* _histNames[WCAP_STATS_HIST_MAX] =
+{
+    [WCAP_STATS_LAT_CAPTURE_SEND] = "capture_to_send",
+    [WCAP_STATS_LAT_TRANSIT] = "network_transit",
+    [WCAP_STATS_LAT_RECV_INJECT] = "receive_to_inject"
+};
+
+static size_t _size(const unsigned int slots)
+{
+    return sizeof(WcapStatsHdr_t) + ((size_t) slots * sizeof(WcapStatsSlot_t));
+}
+
+static bool _name(WcapStats_t* st, const char* name)
+{
+    if (!name || !*name || strchr(name, '/') || (strlen(name) >= WCAP_STATS_NAME_LEN))
+    {
+        fprintf(stderr, "Invalid statistics region name: %s\n", name ? name : "");
+        return false;
+    }
+    snprintf(st->name, sizeof(st->name), "/%s", name);
+    return true;
+}
+
+// Shared memory object for the region, taking over one left behind by a
+// process that is no longer running
+static int _shm_create(WcapStats_t* st)
+{
+    int fd = shm_open(st->name, (O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC), 0644);
+
+    if ((fd < 0) && (errno == EEXIST))
+    {
+        WcapStats_t old = { 0 };
+        bool alive = true;
+
+        if (WcapStatsOpen(&old, (st->name + 1)))
+        {
+            alive = WcapStatsAlive(&old);
+            WcapStatsDestroy(&old);
+        }
+        if (alive)
+        {
+            fprintf(stderr, "Statistics region %s is in use\n", st->name);
+            errno = EEXIST;
+            return -1;
+        }
+        shm_unlink(st->name);
+        fd = shm_open(st->name, (O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC), 0644);
+    }
+
+    return fd;
+}
+
+bool WcapStatsCreate(WcapStats_t* st, const char* name, const unsigned int slots)
+{
+
+    struct timespec ts = { 0 };
+    void* map = MAP_FAILED;
+    int fd = -1;
+
+    if (!st || !slots || (slots > WCAP_STATS_SLOTS_MAX))
+    {
+        return false;
+    }
+
+    memset(st, 0, sizeof(*st));
+    st->size = _size(slots);
+
+    if (name && _name(st, name))
+    {
+        fd = _shm_create(st);
+        if (fd < 0)
+        {
+            fprintf(stderr, "Failed to create statistics region %s: [%d] %s\n", st->name, errno,
+                            strerror(errno));
+        }
+        else if (ftruncate(fd, st->size) < 0)
+        {
+            fprintf(stderr, "Failed to size statistics region %s: [%d] %s\n", st->name, errno,
+                            strerror(errno));
+            shm_unlink(st->name);
+        }
+        else
+        {
+            map = mmap(NULL, st->size, (PROT_READ | PROT_WRITE), MAP_SHARED, fd, 0);
+            if (map == MAP_FAILED)
+            {
+                shm_unlink(st->name);
+            }
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+
+    if (map != MAP_FAILED)
+    {
+        st->owner = true;
+    }
+    else
+    {
+        // Only wcap itself gets to see them then
+        fprintf(stderr, "Statistics are not published\n");
+        map = mmap(NULL, st->size, (PROT_READ | PROT_WRITE), (MAP_PRIVATE | MAP_ANONYMOUS), -1, 0);
+        if (map == MAP_FAILED)
+        {
+            fprintf(stderr, "Failed to map statistics: [%d] %s\n", errno, strerror(errno));
+            return false;
+        }
+    }
+    st->hdr = map;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    st->hdr->version = WCAP_STATS_VERSION;
+    st->hdr->hdrSize = sizeof(WcapStatsHdr_t);
+    st->hdr->slotSize = sizeof(WcapStatsSlot_t);
+    st->hdr->slotCount = slots;
+    st->hdr->counterCount = WCAP_STATS_MAX;
+    st->hdr->counterOffset = offsetof(WcapStatsSlot_t, counters);
+    st->hdr->histCount = WCAP_STATS_HIST_MAX;
+    st->hdr->histOffset = offsetof(WcapStatsSlot_t, hists);
+    st->hdr->histSize = sizeof(WcapStatsHist_t);
+    st->hdr->histSubBits = WCAP_STATS_HIST_SUB_BITS;
+    st->hdr->histBuckets = WCAP_STATS_HIST_BUCKETS;
+    st->hdr->pid = getpid();
+    st->hdr->start = (ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+    for (unsigned int i = 0; i < WCAP_STATS_MAX; i++)
+    {
+        if (_names[i])
+        {
+            snprintf(st->hdr->names[i], WCAP_STATS_NAME_LEN, "%s", _names[i]);
+        }
+    }
+    for (unsigned int i = 0; i < WCAP_STATS_HIST_MAX; i++)
+    {
+        snprintf(st->hdr->histNames[i], WCAP_STATS_NAME_LEN, "%s", _histNames[i]);
+    }
+    // A datapath per slot until the writer says otherwise
+    for (unsigned int i = 0; i < slots; i++)
+    {
+        WcapStatsSlot(st, i)->datapath = i;
+    }
+
+    // Readers ignore the region until the magic shows it is filled in
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(st->hdr->magic, WCAP_STATS_MAGIC, sizeof(st->hdr->magic));
+
+    return true;
+}
+
+bool WcapStatsDestroy(WcapStats_t* st)
+{
+
+    if (!st)
+    {
+        return false;
+    }
+
+    if (st->hdr)
+    {
+        munmap(st->hdr, st->size);
+    }
+    if (st->owner)
+    {
+        shm_unlink(st->name);
+    }
+    memset(st, 0, sizeof(*st));
+
+    return true;
+}
+
+WcapStatsSlot_t* WcapStatsSlot(const WcapStats_t* st, const unsigned int idx)
+{
+    if (!st || !st->hdr || (idx >= st->hdr->slotCount))
+    {
+        return NULL;
+    }
+
+    return (WcapStatsSlot_t*) ((uint8_t*) st->hdr + st->hdr->hdrSize +
+                               ((size_t) idx * st->hdr->slotSize));
+}
+
+bool WcapStatsOpen(WcapStats_t* st, const char* name)
+{
+
+    struct stat sb = { 0 };
+    WcapStatsHdr_t* hdr = NULL;
+    void* map = NULL;
+    int fd = 0;
+
+    if (!st)
+    {
+        return false;
+    }
+
+    memset(st, 0, sizeof(*st));
+    if (!_name(st, name))
+    {
+        return false;
+    }
+
+    fd = shm_open(st->name, (O_RDONLY | O_CLOEXEC), 0);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to open statistics region %s: [%d] %s\n", st->name, errno,
+                        strerror(errno));
+        return false;
+    }
+    if ((fstat(fd, &sb) < 0) || (sb.st_size < (off_t) sizeof(WcapStatsHdr_t)))
+    {
+        fprintf(stderr, "Statistics region %s is not ready\n", st->name);
+        close(fd);
+        return false;
+    }
+
+    map = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map statistics region %s: [%d] %s\n", st->name, errno,
+                        strerror(errno));
+        return false;
+    }
+    hdr = map;
+    st->hdr = hdr;
+    st->size = sb.st_size;
+
+    // The layout is only trusted as far as it fits the object
+    if (memcmp(hdr->magic, WCAP_STATS_MAGIC, sizeof(hdr->magic)) ||
+        (hdr->version != WCAP_STATS_VERSION) || (hdr->hdrSize < sizeof(WcapStatsHdr_t)) ||
+        (hdr->counterCount > WCAP_STATS_MAX) ||
+        (hdr->counterOffset != offsetof(WcapStatsSlot_t, counters)) ||
+        ((hdr->counterOffset + (hdr->counterCount * sizeof(uint64_t))) > hdr->slotSize) ||
+        (hdr->histCount > WCAP_STATS_HIST_MAX) ||
+        (hdr->histOffset != offsetof(WcapStatsSlot_t, hists)) ||
+        (hdr->histSize != sizeof(WcapStatsHist_t)) ||
+        (hdr->histSubBits != WCAP_STATS_HIST_SUB_BITS) ||
+        (hdr->histBuckets != WCAP_STATS_HIST_BUCKETS) ||
+        ((hdr->histOffset + (hdr->histCount * hdr->histSize)) > hdr->slotSize) ||
+        ((hdr->hdrSize + ((size_t) hdr->slotCount * hdr->slotSize)) > st->size))
+    {
+        fprintf(stderr, "Statistics region %s is not readable by this version\n", st->name);
+        WcapStatsDestroy(st);
+        return false;
+    }
+
+    return true;
+}
+
+bool WcapStatsAlive(const WcapStats_t* st)
+{
+    if (!st || !st->hdr)
+    {
+        return false;
+    }
+
+    return ((kill(st->hdr->pid, 0) == 0) || (errno == EPERM));
+}
+
+void WcapStatsHistMerge(WcapStatsHist_t* to, const WcapStatsHist_t* from)
+{
+    uint64_t max = 0;
+
+    if (!to || !from)
+    {
+        return;
+    }
+
+    to->count += __atomic_load_n(&from->count, __ATOMIC_RELAXED);
+    to->sum += __atomic_load_n(&from->sum, __ATOMIC_RELAXED);
+    to->skewed += __atomic_load_n(&from->skewed, __ATOMIC_RELAXED);
+    max = __atomic_load_n(&from->max, __ATOMIC_RELAXED);
+    to->max = (max > to->max) ? max : to->max;
+    for (unsigned int i = 0; i < WCAP_STATS_HIST_BUCKETS; i++)
+    {
+        to->buckets[i] += __atomic_load_n(&from->buckets[i], __ATOMIC_RELAXED);
+    }
+}
+
+uint64_t WcapStatsHistPercentile(const WcapStatsHist_t* hist, const double pct)
+{
+    uint64_t total = 0;
+    uint64_t want = 0;
+    uint64_t seen = 0;
+
+    if (!hist)
+    {
+        return 0;
+    }
+
+    // The buckets are summed rather than trusting 'count', which a live
+    // writer may have moved on since
+    for (unsigned int i = 0; i < WCAP_STATS_HIST_BUCKETS; i++)
+    {
+        total += hist->buckets[i];
+    }
+    if (!total)
+    {
+        return 0;
+    }
+
+    want = (uint64_t) ((pct / 100.0) * total);
+    want = want ? want : 1;
+    for (unsigned int i = 0; i < WCAP_STATS_HIST_BUCKETS; i++)
+    {
+        seen += hist->buckets[i];
+        if (seen >= want)
+        {
+            // Top of the bucket, never past the largest value seen
+            uint64_t top = (i < (WCAP_STATS_HIST_BUCKETS - 1)) ? (WcapStatsHistValue(i + 1) - 1) :
+                                                                 hist->max;
+            return (hist->max && (top > hist->max)) ? hist->max : top;
+        }
+    }
+
+    return hist->max;
+}
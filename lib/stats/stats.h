@@ -0,0 +1,279 @@
+/*
+ ============================================================================
+ Name        : stats.h
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet capture and forwarder
+ ============================================================================
+ */
+
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define WCAP_STATS_MAGIC        "WCAPSTAT"
+#define WCAP_STATS_VERSION      4
+
+#define WCAP_STATS_LINE         64
+#define WCAP_STATS_NAME_LEN     32
+#define WCAP_STATS_SLOTS_MAX    1024
+
+// Prefix of the default region name, followed by the pid
+#define WCAP_STATS_PREFIX       "wcap."
+
+// Batch size histograms, power of two buckets: 1, 2-3, 4-7, ... 64 and up
+#define WCAP_STATS_BATCH_BUCKETS    7
+
+// LZ4 counters, from the first of a group, the same whether compressing or
+// expanding; the ratio is bytes in over bytes out
+enum
+{
+    WCAP_STATS_LZ4_PACKED = 0,
+    WCAP_STATS_LZ4_SMALL,
+    WCAP_STATS_LZ4_INCOMPRESSIBLE,
+    WCAP_STATS_LZ4_MALFORMED,
+    WCAP_STATS_LZ4_BYTES_IN,
+    WCAP_STATS_LZ4_BYTES_OUT,
+    // CPU time spent in the codec
+    WCAP_STATS_LZ4_NS
+};
+
+// Counters of a datapath, grouped by the pipeline stage that updates them.
+// Every group starts on its own cache line; a datapath split across several
+// threads has a slot for each, so that every slot has a single writer.
+enum
+{
+    // Capture from the wireless interface
+    WCAP_STATS_RAW_RX_FRAMES = 0,
+    WCAP_STATS_RAW_RX_BYTES,
+    WCAP_STATS_RAW_RX_BURSTS,
+    WCAP_STATS_RAW_RX_TRUNC,
+    WCAP_STATS_RAW_RX_DROP_RING,
+    WCAP_STATS_RAW_RX_DROP_RECORD,
+    WCAP_STATS_RAW_RX_DROP_POOL,
+
+    // Encapsulation and UDP out
+    WCAP_STATS_UDP_TX_DATAGRAMS = 8,
+    WCAP_STATS_UDP_TX_BYTES,
+    WCAP_STATS_UDP_TX_BATCHES,
+    WCAP_STATS_UDP_TX_EAGAIN,
+    WCAP_STATS_UDP_TX_DROP_SOCKET,
+    WCAP_STATS_UDP_TX_DROP_SUPPRESS,
+    WCAP_STATS_UDP_TX_DROP_OVERSIZE,
+    WCAP_STATS_UDP_TX_BATCH = 16,
+    WCAP_STATS_UDP_TX_LZ4 = 24,
+
+    // UDP in and decapsulation
+    WCAP_STATS_UDP_RX_DATAGRAMS = 32,
+    WCAP_STATS_UDP_RX_BYTES,
+    WCAP_STATS_UDP_RX_BATCHES,
+    WCAP_STATS_UDP_RX_TRUNC,
+    WCAP_STATS_UDP_RX_DROP_MALFORMED,
+    WCAP_STATS_UDP_RX_DROP_TUNNEL,
+    WCAP_STATS_UDP_RX_DROP_SESSION,
+    WCAP_STATS_UDP_RX_DROP_REBUILD,
+    WCAP_STATS_UDP_RX_DROP_RING,
+    WCAP_STATS_UDP_RX_MISROUTED,
+    WCAP_STATS_UDP_RX_SEQ_LOST,
+    WCAP_STATS_UDP_RX_SEQ_REORDERED,
+    WCAP_STATS_UDP_RX_SEQ_DUPLICATE,
+    WCAP_STATS_UDP_RX_SEQ_LATE,
+    WCAP_STATS_UDP_RX_SEQ_RESYNC,
+    WCAP_STATS_UDP_RX_REORDER_HELD,
+    WCAP_STATS_UDP_RX_BATCH = 48,
+    WCAP_STATS_UDP_RX_LZ4 = 56,
+
+    // Injection into the wireless interface
+    WCAP_STATS_RAW_TX_FRAMES = 64,
+    WCAP_STATS_RAW_TX_BYTES,
+    WCAP_STATS_RAW_TX_EAGAIN,
+    WCAP_STATS_RAW_TX_ERRORS,
+
+    // Drops only the kernel knows of, polled by the main thread
+    WCAP_STATS_RAW_RX_DROP_KERNEL = 72,
+    WCAP_STATS_UDP_RX_DROP_KERNEL,
+
+    WCAP_STATS_MAX = 80
+};
+
+// Latency histograms, log-linear like HdrHistogram: values under 2^SUB_BITS
+// ns get a bucket each, every power of two above is split in 2^SUB_BITS
+// buckets, so a value is known to within 1/2^SUB_BITS of itself
+#define WCAP_STATS_HIST_SUB_BITS    4
+#define WCAP_STATS_HIST_MAX_BITS    40
+#define WCAP_STATS_HIST_BUCKETS     \
+    ((WCAP_STATS_HIST_MAX_BITS - WCAP_STATS_HIST_SUB_BITS + 1) << WCAP_STATS_HIST_SUB_BITS)
+
+// Stages a frame goes through between the air on one end and the other; as
+// with the counters each has a single writer
+enum
+{
+    // Capture to the datagram carrying it being sent, per frame
+    WCAP_STATS_LAT_CAPTURE_SEND,
+    // Sent by the peer to received here, per datagram; needs synced clocks
+    WCAP_STATS_LAT_TRANSIT,
+    // Received here to injected, per frame
+    WCAP_STATS_LAT_RECV_INJECT,
+    WCAP_STATS_HIST_MAX
+};
+
+typedef struct WcapStatsHist
+{
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    // Samples that came out negative, clocks being out of step, counted as 0
+    uint64_t skewed;
+    uint64_t buckets[WCAP_STATS_HIST_BUCKETS] __attribute__((aligned(WCAP_STATS_LINE)));
+} __attribute__((aligned(WCAP_STATS_LINE))) WcapStatsHist_t;
+
+// Fixed header at the start of the region; readers check the magic and the
+// version, then find everything else from the sizes and the name table
+typedef struct WcapStatsHdr
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t hdrSize;
+    uint32_t slotSize;
+    uint32_t slotCount;
+    uint32_t counterCount;
+    uint32_t counterOffset;
+    uint32_t histCount;
+    uint32_t histOffset;
+    uint32_t histSize;
+    uint32_t histSubBits;
+    uint32_t histBuckets;
+    int32_t pid;
+    uint64_t start;
+    // Empty for counters that are not in use
+    char names[WCAP_STATS_MAX][WCAP_STATS_NAME_LEN];
+    char histNames[WCAP_STATS_HIST_MAX][WCAP_STATS_NAME_LEN];
+} __attribute__((aligned(WCAP_STATS_LINE))) WcapStatsHdr_t;
+
+// Counters of one writer to a datapath; readers add up the slots of a
+// datapath and show them under the name of its first
+typedef struct WcapStatsSlot
+{
+    char name[WCAP_STATS_NAME_LEN];
+    uint32_t datapath;
+    uint64_t counters[WCAP_STATS_MAX] __attribute__((aligned(WCAP_STATS_LINE)));
+    WcapStatsHist_t hists[WCAP_STATS_HIST_MAX];
+} WcapStatsSlot_t;
+
+// A region of per datapath counters, published as a POSIX shared memory
+// object other processes can map and read while wcap runs
+typedef struct WcapStats
+{
+    char name[WCAP_STATS_NAME_LEN + 2];
+    WcapStatsHdr_t* hdr;
+    size_t size;
+    bool owner;
+} WcapStats_t;
+
+// Writer side; without a shared memory object the counters still work, from
+// a private mapping
+bool WcapStatsCreate(WcapStats_t* st, const char* name, const unsigned int slots);
+bool WcapStatsDestroy(WcapStats_t* st);
+WcapStatsSlot_t* WcapStatsSlot(const WcapStats_t* st, const unsigned int idx);
+
+// Reader side, mapped read only
+bool WcapStatsOpen(WcapStats_t* st, const char* name);
+bool WcapStatsAlive(const WcapStats_t* st);
+// Adds a snapshot of 'from' to 'to', which belongs to the caller
+void WcapStatsHistMerge(WcapStatsHist_t* to, const WcapStatsHist_t* from);
+// Least value 'pct' percent of the samples are at or below, to bucket precision
+uint64_t WcapStatsHistPercentile(const WcapStatsHist_t* hist, const double pct);
+
+// Each counter has exactly one writer, so a plain load and a relaxed store
+// are enough for readers never to see a torn value
+static inline void WcapStatsAdd(WcapStatsSlot_t* slot, const unsigned int ctr, const uint64_t n)
+{
+    __atomic_store_n(&slot->counters[ctr], (slot->counters[ctr] + n), __ATOMIC_RELAXED);
+}
+
+// Mirrors a counter kept elsewhere by the same writer
+static inline void WcapStatsSet(WcapStatsSlot_t* slot, const unsigned int ctr, const uint64_t val)
+{
+    __atomic_store_n(&slot->counters[ctr], val, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t WcapStatsGet(const WcapStatsSlot_t* slot, const unsigned int ctr)
+{
+    return __atomic_load_n(&slot->counters[ctr], __ATOMIC_RELAXED);
+}
+
+// Counts one batch of 'n' in the histogram starting at counter 'base'
+static inline void WcapStatsBatch(WcapStatsSlot_t* slot, const unsigned int base,
+                                  const unsigned int n)
+{
+    unsigned int bucket = 0;
+
+    if (!n)
+    {
+        return;
+    }
+    bucket = 31 - __builtin_clz(n);
+    bucket = (bucket < WCAP_STATS_BATCH_BUCKETS) ? bucket : (WCAP_STATS_BATCH_BUCKETS - 1);
+    WcapStatsAdd(slot, (base + bucket), 1);
+}
+
+static inline unsigned int WcapStatsHistBucket(const uint64_t ns)
+{
+    unsigned int exp = 0;
+
+    if (ns < (1ULL << WCAP_STATS_HIST_SUB_BITS))
+    {
+        return ns;
+    }
+    exp = 63 - __builtin_clzll(ns);
+    if (exp >= WCAP_STATS_HIST_MAX_BITS)
+    {
+        return WCAP_STATS_HIST_BUCKETS - 1;
+    }
+
+    return ((exp - WCAP_STATS_HIST_SUB_BITS + 1) << WCAP_STATS_HIST_SUB_BITS) +
+           ((ns >> (exp - WCAP_STATS_HIST_SUB_BITS)) & ((1U << WCAP_STATS_HIST_SUB_BITS) - 1));
+}
+
+// Least value that falls in 'bucket'
+static inline uint64_t WcapStatsHistValue(const unsigned int bucket)
+{
+    unsigned int sub = bucket & ((1U << WCAP_STATS_HIST_SUB_BITS) - 1);
+    unsigned int exp = (bucket >> WCAP_STATS_HIST_SUB_BITS) + WCAP_STATS_HIST_SUB_BITS - 1;
+
+    if (bucket < (1U << WCAP_STATS_HIST_SUB_BITS))
+    {
+        return bucket;
+    }
+
+    return (uint64_t) ((1U << WCAP_STATS_HIST_SUB_BITS) | sub) << (exp - WCAP_STATS_HIST_SUB_BITS);
+}
+
+// Records one latency of 'ns', which the clocks may have made negative
+static inline void WcapStatsRecord(WcapStatsSlot_t* slot, const unsigned int hist, int64_t ns)
+{
+    WcapStatsHist_t* h = &slot->hists[hist];
+    unsigned int bucket = 0;
+
+    if (ns < 0)
+    {
+        __atomic_store_n(&h->skewed, (h->skewed + 1), __ATOMIC_RELAXED);
+        ns = 0;
+    }
+    bucket = WcapStatsHistBucket(ns);
+
+    __atomic_store_n(&h->buckets[bucket], (h->buckets[bucket] + 1), __ATOMIC_RELAXED);
+    __atomic_store_n(&h->sum, (h->sum + ns), __ATOMIC_RELAXED);
+    if ((uint64_t) ns > h->max)
+    {
+        __atomic_store_n(&h->max, ns, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&h->count, (h->count + 1), __ATOMIC_RELAXED);
+}
+
+#endif /* _STATS_H_ */
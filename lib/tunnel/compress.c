@@ -0,0 +1,382 @@
+/*
+ ============================================================================
+ Name        : compress.c
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet concatenator
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <arpa/inet.h>
+
+#include "encap.h"
+#include "compress.h"
+
+// Limits of the LZ4 block format: matches are at least 4 bytes long, none
+// starts in the last 12 bytes and the last 5 are always literals
+#define LZ4_MINMATCH        4
+#define LZ4_MFLIMIT         12
+#define LZ4_LAST_LITERALS   5
+#define LZ4_DISTANCE_MAX    65535
+#define LZ4_RUN_MASK        15
+
+static uint64_t _now(void)
+{
+    struct timespec ts = { 0 };
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static inline uint32_t _read32(const uint8_t* p)
+{
+    uint32_t val = 0;
+    memcpy(&val, p, sizeof(val));
+    return val;
+}
+
+static inline uint32_t _hash(const uint32_t seq)
+{
+    return (seq * 2654435761U) >> (32 - WCAP_LZ4_HASH_LOG);
+}
+
+// Token nibble plus as many 255 bytes as the length needs
+static inline size_t _len_bytes(const size_t len)
+{
+    return (len >= LZ4_RUN_MASK) ? (((len - LZ4_RUN_MASK) / 255) + 1) : 0;
+}
+
+static inline size_t _put_len(uint8_t* dst, size_t len)
+{
+    size_t op = 0;
+
+    for (len -= LZ4_RUN_MASK; len >= 255; len -= 255)
+    {
+        dst[op++] = 255;
+    }
+    dst[op++] = len;
+
+    return op;
+}
+
+size_t WcapLz4Compress(uint16_t* table, const uint8_t* src, const size_t len, uint8_t* dst,
+                       const size_t cap)
+{
+
+    size_t ip = 0;
+    size_t anchor = 0;
+    size_t op = 0;
+    size_t lit = 0;
+
+    // Positions are kept in 16 bits, the format's window anyway
+    if (!table || !src || !dst || (len > UINT16_MAX))
+    {
+        return 0;
+    }
+
+    memset(table, 0, sizeof(*table) << WCAP_LZ4_HASH_LOG);
+
+    // Greedy parse: take the first match the hash table turns up
+    while ((len > LZ4_MFLIMIT) && (ip < (len - LZ4_MFLIMIT)))
+    {
+        uint32_t seq = _read32(src + ip);
+        uint32_t h = _hash(seq);
+        size_t ref = table[h];
+        size_t mlen = LZ4_MINMATCH;
+
+        table[h] = ip;
+        if ((ref >= ip) || ((ip - ref) > LZ4_DISTANCE_MAX) || (_read32(src + ref) != seq))
+        {
+            ip++;
+            continue;
+        }
+
+        while ((ip > anchor) && (ref > 0) && (src[ip - 1] == src[ref - 1]))
+        {
+            ip--;
+            ref--;
+            mlen++;
+        }
+        while (((ip + mlen) < (len - LZ4_LAST_LITERALS)) && (src[ip + mlen] == src[ref + mlen]))
+        {
+            mlen++;
+        }
+
+        lit = ip - anchor;
+        if ((op + 1 + _len_bytes(lit) + lit + 2 + _len_bytes(mlen - LZ4_MINMATCH)) > cap)
+        {
+            return 0;
+        }
+
+        {
+            uint8_t* token = &dst[op++];
+            *token = ((lit >= LZ4_RUN_MASK) ? LZ4_RUN_MASK : lit) << 4;
+            if (lit >= LZ4_RUN_MASK)
+            {
+                op += _put_len(dst + op, lit);
+            }
+            memcpy(dst + op, src + anchor, lit);
+            op += lit;
+
+            dst[op++] = (ip - ref) & 0xff;
+            dst[op++] = (ip - ref) >> 8;
+
+            *token |= ((mlen - LZ4_MINMATCH) >= LZ4_RUN_MASK) ? LZ4_RUN_MASK :
+                                                                (mlen - LZ4_MINMATCH);
+            if ((mlen - LZ4_MINMATCH) >= LZ4_RUN_MASK)
+            {
+                op += _put_len(dst + op, mlen - LZ4_MINMATCH);
+            }
+        }
+
+        ip += mlen;
+        anchor = ip;
+    }
+
+    // Whatever is left goes as a literal run without a match
+    lit = len - anchor;
+    if ((op + 1 + _len_bytes(lit) + lit) > cap)
+    {
+        return 0;
+    }
+    dst[op++] = ((lit >= LZ4_RUN_MASK) ? LZ4_RUN_MASK : lit) << 4;
+    if (lit >= LZ4_RUN_MASK)
+    {
+        op += _put_len(dst + op, lit);
+    }
+    memcpy(dst + op, src + anchor, lit);
+    op += lit;
+
+    return op;
+}
+
+static inline bool _get_len(const uint8_t* src, const size_t len, size_t* ip, size_t* val)
+{
+    uint8_t b = 0;
+
+    do
+    {
+        if (*ip >= len)
+        {
+            return false;
+        }
+        b = src[(*ip)++];
+        *val += b;
+    } while (b == 255);
+
+    return true;
+}
+
+size_t WcapLz4Decompress(const uint8_t* src, const size_t len, uint8_t* dst, const size_t cap)
+{
+
+    size_t ip = 0;
+    size_t op = 0;
+
+    if (!src || !dst || !len)
+    {
+        return 0;
+    }
+
+    while (ip < len)
+    {
+        uint8_t token = src[ip++];
+        size_t lit = token >> 4;
+        size_t mlen = token & LZ4_RUN_MASK;
+        size_t off = 0;
+
+        if ((lit == LZ4_RUN_MASK) && !_get_len(src, len, &ip, &lit))
+        {
+            return 0;
+        }
+        if (((ip + lit) > len) || ((op + lit) > cap))
+        {
+            return 0;
+        }
+        memcpy(dst + op, src + ip, lit);
+        ip += lit;
+        op += lit;
+
+        // The last sequence has no match
+        if (ip == len)
+        {
+            break;
+        }
+
+        if ((ip + 2) > len)
+        {
+            return 0;
+        }
+        off = src[ip] | (src[ip + 1] << 8);
+        ip += 2;
+        if ((mlen == LZ4_RUN_MASK) && !_get_len(src, len, &ip, &mlen))
+        {
+            return 0;
+        }
+        mlen += LZ4_MINMATCH;
+        if (!off || (off > op) || ((op + mlen) > cap))
+        {
+            return 0;
+        }
+
+        // Matches may overlap what they produce, a byte at a time then
+        if (off >= mlen)
+        {
+            memcpy(dst + op, dst + op - off, mlen);
+        }
+        else
+        {
+            for (size_t i = 0; i < mlen; i++)
+            {
+                dst[op + i] = dst[op - off + i];
+            }
+        }
+        op += mlen;
+    }
+
+    return op;
+}
+
+bool WcapCompressCreate(WcapCompress_t* comp, const size_t bufsiz, const size_t minlen)
+{
+
+    if (!comp || (bufsiz <= sizeof(WcapEncapHdr_t)))
+    {
+        return false;
+    }
+
+    memset(comp, 0, sizeof(*comp));
+    comp->bufsiz = bufsiz;
+    comp->minlen = minlen;
+
+    comp->table = calloc((1U << WCAP_LZ4_HASH_LOG), sizeof(*comp->table));
+    comp->buf = malloc(bufsiz);
+    if (!comp->table || !comp->buf)
+    {
+        fprintf(stderr, "Failed to allocate compression buffers\n");
+        WcapCompressDestroy(comp);
+        return false;
+    }
+
+    return true;
+}
+
+bool WcapCompressDestroy(WcapCompress_t* comp)
+{
+
+    if (!comp)
+    {
+        return false;
+    }
+
+    free(comp->table);
+    free(comp->buf);
+    memset(comp, 0, sizeof(*comp));
+
+    return true;
+}
+
+size_t WcapCompressDatagram(WcapCompress_t* comp, const uint8_t* buf, const size_t len)
+{
+
+    WcapEncapHdr_t* hdr = NULL;
+    size_t zlen = 0;
+    size_t cap = 0;
+    uint64_t start = 0;
+
+    if (!comp || !comp->buf || !buf || (len <= sizeof(*hdr)))
+    {
+        return 0;
+    }
+
+    comp->datagrams++;
+    if ((len < comp->minlen) || (len > comp->bufsiz))
+    {
+        comp->small++;
+        return 0;
+    }
+
+    // Only worth sending if it comes out shorter, so give up as soon as not
+    start = _now();
+    cap = len - sizeof(*hdr) - 1;
+    zlen = WcapLz4Compress(comp->table, buf + sizeof(*hdr), len - sizeof(*hdr),
+                           comp->buf + sizeof(*hdr), cap);
+    comp->ns += _now() - start;
+    if (!zlen)
+    {
+        comp->incompressible++;
+        return 0;
+    }
+
+    // The header stays readable for steering, and says how long the block is
+    // since GSO may pad the datagram
+    memcpy(comp->buf, buf, sizeof(*hdr));
+    hdr = (WcapEncapHdr_t*) comp->buf;
+    hdr->flags |= WCAP_ENCAP_HDR_F_LZ4;
+    hdr->reserved = htons(zlen);
+
+    comp->packed++;
+    comp->bytesIn += len;
+    comp->bytesOut += sizeof(*hdr) + zlen;
+
+    return sizeof(*hdr) + zlen;
+}
+
+bool WcapDecompressDatagram(WcapCompress_t* comp, const uint8_t* buf, const size_t len,
+                            const uint8_t** out, size_t* outlen)
+{
+
+    WcapEncapHdr_t hdr = { 0 };
+    size_t zlen = 0;
+    size_t raw = 0;
+    uint64_t start = 0;
+
+    if (!comp || !comp->buf || !buf || !out || !outlen || (len < sizeof(hdr)))
+    {
+        return false;
+    }
+
+    memcpy(&hdr, buf, sizeof(hdr));
+    if (!(hdr.flags & WCAP_ENCAP_HDR_F_LZ4))
+    {
+        *out = buf;
+        *outlen = len;
+        return true;
+    }
+
+    comp->datagrams++;
+    zlen = ntohs(hdr.reserved);
+    if ((sizeof(hdr) + zlen) > len)
+    {
+        comp->errors++;
+        return false;
+    }
+
+    start = _now();
+    raw = WcapLz4Decompress(buf + sizeof(hdr), zlen, comp->buf + sizeof(hdr),
+                            comp->bufsiz - sizeof(hdr));
+    comp->ns += _now() - start;
+    if (!raw)
+    {
+        comp->errors++;
+        return false;
+    }
+
+    hdr.flags &= ~WCAP_ENCAP_HDR_F_LZ4;
+    hdr.reserved = 0;
+    memcpy(comp->buf, &hdr, sizeof(hdr));
+
+    comp->packed++;
+    comp->bytesIn += sizeof(hdr) + zlen;
+    comp->bytesOut += sizeof(hdr) + raw;
+
+    *out = comp->buf;
+    *outlen = sizeof(hdr) + raw;
+
+    return true;
+}
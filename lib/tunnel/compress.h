@@ -0,0 +1,61 @@
+/*
+ ============================================================================
+ Name        : compress.h
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet capture and forwarder
+ ============================================================================
+ */
+
+#ifndef _COMPRESS_H_
+#define _COMPRESS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Datagrams shorter than this are not worth the cycles
+#define WCAP_COMPRESS_MIN_DEF       256
+
+#define WCAP_LZ4_HASH_LOG           12
+
+// Compresses datagrams on the sending side, or expands them on the receiving
+// side, into its own buffer; owned by a single thread. Times are spent on
+// the CPU, nothing in here blocks.
+typedef struct WcapCompress
+{
+    uint16_t* table;
+    uint8_t* buf;
+    size_t bufsiz;
+    size_t minlen;
+    uint64_t datagrams;
+    uint64_t packed;
+    uint64_t small;
+    uint64_t incompressible;
+    uint64_t errors;
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+    uint64_t ns;
+} WcapCompress_t;
+
+bool WcapCompressCreate(WcapCompress_t* comp, const size_t bufsiz, const size_t minlen);
+bool WcapCompressDestroy(WcapCompress_t* comp);
+
+// LZ4 compressed copy of an encapsulated datagram in comp->buf, its length,
+// or 0 when it is below the threshold or does not shrink
+size_t WcapCompressDatagram(WcapCompress_t* comp, const uint8_t* buf, const size_t len);
+
+// Expanded copy of a compressed datagram in comp->buf; any other datagram is
+// passed through as it is
+bool WcapDecompressDatagram(WcapCompress_t* comp, const uint8_t* buf, const size_t len,
+                            const uint8_t** out, size_t* outlen);
+
+// LZ4 block format, as LZ4_compress_default() and LZ4_decompress_safe()
+// would produce and accept; both return 0 when 'dst' is too small, and the
+// compressor needs a table of (1 << WCAP_LZ4_HASH_LOG) entries
+size_t WcapLz4Compress(uint16_t* table, const uint8_t* src, const size_t len, uint8_t* dst,
+                       const size_t cap);
+size_t WcapLz4Decompress(const uint8_t* src, const size_t len, uint8_t* dst, const size_t cap);
+
+#endif /* _COMPRESS_H_ */
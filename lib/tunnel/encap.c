@@ -0,0 +1,231 @@
+/*
+ ============================================================================
+ Name        : encap.c
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet concatenator
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <endian.h>
+#include <time.h>
+
+#include <arpa/inet.h>
+
+#include "encap.h"
+
+bool WcapEncapCreate(WcapEncap_t* enc, const size_t bufsiz, const size_t maxlen)
+{
+
+    if (!enc || (bufsiz <= WCAP_ENCAP_OVERHEAD(1)) || (maxlen > bufsiz))
+    {
+        return false;
+    }
+
+    memset(enc, 0, sizeof(*enc));
+    enc->bufsiz = bufsiz;
+    enc->maxlen = maxlen ? maxlen : bufsiz;
+
+    enc->buf = calloc(1, bufsiz);
+    if (!enc->buf)
+    {
+        fprintf(stderr, "Failed to allocate encapsulation buffer\n");
+        return false;
+    }
+
+    WcapEncapReset(enc);
+
+    return true;
+}
+
+bool WcapEncapDestroy(WcapEncap_t* enc)
+{
+
+    if (!enc)
+    {
+        return false;
+    }
+
+    free(enc->buf);
+    memset(enc, 0, sizeof(*enc));
+
+    return true;
+}
+
+bool WcapEncapAdd(WcapEncap_t* enc, const void* data, const size_t len, const uint64_t tstamp)
+{
+    return WcapEncapAddFrame(enc, NULL, 0, data, len, 0, tstamp);
+}
+
+bool WcapEncapAddFrame(WcapEncap_t* enc, const void* hdr, const size_t hdrlen, const void* data,
+                       const size_t len, const uint16_t flags, const uint64_t tstamp)
+{
+
+    WcapEncapRec_t rec = { 0 };
+    size_t need = sizeof(rec) + hdrlen + len + ((enc && enc->stamp) ? WCAP_ENCAP_SENT_LEN : 0);
+
+    if (!enc || !enc->buf || !data || !len || ((hdrlen + len) > UINT16_MAX) || (hdrlen && !hdr))
+    {
+        return false;
+    }
+
+    // Pack up to the aggregation target, but never refuse a frame that would
+    // travel on its own as long as it fits the buffer at all
+    if (enc->count && ((enc->len + need) > enc->maxlen))
+    {
+        return false;
+    }
+    if ((enc->len + need) > enc->bufsiz)
+    {
+        return false;
+    }
+
+    rec.len = htons(hdrlen + len);
+    rec.flags = htons(flags);
+    rec.seq = htonl(enc->seq++);
+    rec.tstamp = htobe64(tstamp);
+
+    memcpy(enc->buf + enc->len, &rec, sizeof(rec));
+    if (hdrlen)
+    {
+        memcpy(enc->buf + enc->len + sizeof(rec), hdr, hdrlen);
+    }
+    memcpy(enc->buf + enc->len + sizeof(rec) + hdrlen, data, len);
+    enc->len += sizeof(rec) + hdrlen + len;
+    enc->count++;
+
+    return true;
+}
+
+size_t WcapEncapClose(WcapEncap_t* enc)
+{
+
+    WcapEncapHdr_t* hdr = NULL;
+
+    if (!enc || !enc->buf || !enc->count)
+    {
+        return 0;
+    }
+
+    hdr = (WcapEncapHdr_t*) enc->buf;
+    hdr->version = WCAP_ENCAP_VERSION;
+    hdr->flags = WCAP_ENCAP_HDR_F_ACCEPT_LZ4 | enc->flags;
+    enc->flags = 0;
+    hdr->count = htons(enc->count);
+    hdr->stream = enc->stream;
+    hdr->tunnel = enc->tunnel;
+    hdr->reserved = 0;
+    hdr->seq = htonl(enc->dgramSeq++);
+
+    // Room for the stamp was kept by every frame added
+    if (enc->stamp)
+    {
+        struct timespec ts = { 0 };
+        uint64_t sent = 0;
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        enc->sent = (ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+        sent = htobe64(enc->sent);
+        memcpy(enc->buf + enc->len, &sent, sizeof(sent));
+        hdr->flags |= WCAP_ENCAP_HDR_F_SENT;
+        return enc->len + WCAP_ENCAP_SENT_LEN;
+    }
+
+    return enc->len;
+}
+
+void WcapEncapReset(WcapEncap_t* enc)
+{
+    if (enc)
+    {
+        enc->len = sizeof(WcapEncapHdr_t);
+        enc->count = 0;
+    }
+}
+
+bool WcapDecapInit(WcapDecap_t* dec, const void* buf, const size_t len)
+{
+
+    WcapEncapHdr_t hdr = { 0 };
+
+    if (!dec || !buf || (len < sizeof(hdr)))
+    {
+        return false;
+    }
+
+    // Compressed datagrams have to be expanded first
+    memcpy(&hdr, buf, sizeof(hdr));
+    if ((hdr.version != WCAP_ENCAP_VERSION) || (hdr.flags & WCAP_ENCAP_HDR_F_LZ4) ||
+        (hdr.stream >= WCAP_ENCAP_STREAM_MAX))
+    {
+        return false;
+    }
+
+    dec->buf = buf;
+    dec->len = len;
+    dec->off = sizeof(hdr);
+    dec->remain = ntohs(hdr.count);
+    dec->flags = hdr.flags;
+    dec->stream = hdr.stream;
+    dec->tunnel = hdr.tunnel;
+    dec->seq = ntohl(hdr.seq);
+
+    return true;
+}
+
+bool WcapDecapNext(WcapDecap_t* dec, WcapEncapFrame_t* frame)
+{
+
+    WcapEncapRec_t rec = { 0 };
+
+    if (!dec || !dec->buf || !frame || !dec->remain)
+    {
+        return false;
+    }
+
+    // Stop at the first record that runs past the end of the datagram
+    if ((dec->off + sizeof(rec)) > dec->len)
+    {
+        dec->remain = 0;
+        return false;
+    }
+
+    memcpy(&rec, dec->buf + dec->off, sizeof(rec));
+    frame->len = ntohs(rec.len);
+    if ((dec->off + sizeof(rec) + frame->len) > dec->len)
+    {
+        dec->remain = 0;
+        return false;
+    }
+
+    frame->data = dec->buf + dec->off + sizeof(rec);
+    frame->flags = ntohs(rec.flags);
+    frame->seq = ntohl(rec.seq);
+    frame->tstamp = be64toh(rec.tstamp);
+
+    dec->off += sizeof(rec) + frame->len;
+    dec->remain--;
+
+    return true;
+}
+
+bool WcapDecapSent(const WcapDecap_t* dec, uint64_t* sent)
+{
+
+    uint64_t val = 0;
+
+    if (!dec || !dec->buf || !sent || !(dec->flags & WCAP_ENCAP_HDR_F_SENT) || dec->remain ||
+        ((dec->off + WCAP_ENCAP_SENT_LEN) > dec->len))
+    {
+        return false;
+    }
+
+    memcpy(&val, dec->buf + dec->off, sizeof(val));
+    *sent = be64toh(val);
+
+    return true;
+}
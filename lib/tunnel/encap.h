@@ -0,0 +1,158 @@
+/*
+ ============================================================================
+ Name        : encap.h
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet capture and forwarder
+ ============================================================================
+ */
+
+#ifndef _ENCAP_H_
+#define _ENCAP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//*****************************************************************************
+// Tunnel wire format (all fields in network byte order):
+//
+//   +---------+-------+-------+--------+--------+----------+-----+
+//   | version | flags | count | stream | tunnel | reserved | seq |   header
+//   +---------+-------+-------+--------+--------+----------+-----+
+//   |   len   | flags |  seq  |   tstamp     |   frame record (x count)
+//   +---------+-------+-------+--------------+
+//   |   802.11 frame (len bytes)             |
+//   +----------------------------------------+
+//
+// The header's seq numbers the datagrams of a stream, the datapath of the
+// sender that packed them, for the receiver to tell loss, reordering and
+// duplication on the way (see seq.h); a record's numbers the frames of the
+// encapsulator that packed it. The workers of a tunnel send in parallel, so
+// only the datagrams of one of them keep an order to restore.
+//
+// Header flags: every sender sets ACCEPT_LZ4, the receiver may then send it
+// LZ4 datagrams whose frame records are one LZ4 block (see compress.h) of
+// 'reserved' bytes.
+//
+// SENT says the last frame record is followed by the u64 CLOCK_REALTIME
+// nanoseconds the datagram was sent at, for the receiver to time the network
+// with; receivers that do not know it ignore it like any trailing bytes.
+//
+// RESEND asks the receiver to send its suppressed frames whole again, as the
+// sender could not rebuild one it repeated.
+//
+// A frame normally starts with the radiotap header it was captured with.
+// Record flags say when the sender replaced it, len then covering both:
+//
+//   NO_RADIOTAP   the frame is bare 802.11, without FCS
+//   META          as NO_RADIOTAP, preceded by WcapRadiotapMeta_t in network
+//                 byte order
+//
+// Beacons and probes unchanged since the last one from their transmitter
+// may be suppressed (see suppress.h):
+//
+//   CACHE         the receiver keeps the frame to rebuild later copies from
+//   REPEAT        a WcapSuppressRepeat_t stands in for the frame
+//*****************************************************************************
+
+#define WCAP_ENCAP_VERSION      4
+
+// A tunnel carries the frames of one radio
+#define WCAP_ENCAP_TUNNEL_MAX   16
+// Datapaths of a sender, whatever tunnels they serve
+#define WCAP_ENCAP_STREAM_MAX   64
+
+#define WCAP_ENCAP_HDR_F_LZ4        0x01
+#define WCAP_ENCAP_HDR_F_ACCEPT_LZ4 0x02
+#define WCAP_ENCAP_HDR_F_SENT       0x04
+#define WCAP_ENCAP_HDR_F_RESEND     0x08
+
+#define WCAP_ENCAP_SENT_LEN         sizeof(uint64_t)
+
+#define WCAP_ENCAP_F_NO_RADIOTAP    0x0001
+#define WCAP_ENCAP_F_META           0x0002
+#define WCAP_ENCAP_F_CACHE          0x0004
+#define WCAP_ENCAP_F_REPEAT         0x0008
+
+typedef struct __attribute__((packed)) WcapEncapHdr
+{
+    uint8_t version;
+    uint8_t flags;
+    uint16_t count;
+    uint8_t stream;
+    uint8_t tunnel;
+    uint16_t reserved;
+    uint32_t seq;
+} WcapEncapHdr_t;
+
+typedef struct __attribute__((packed)) WcapEncapRec
+{
+    uint16_t len;
+    uint16_t flags;
+    uint32_t seq;
+    uint64_t tstamp;
+} WcapEncapRec_t;
+
+#define WCAP_ENCAP_OVERHEAD(n)  (sizeof(WcapEncapHdr_t) + ((n) * sizeof(WcapEncapRec_t)))
+
+// Decoded view of one frame record, data points into the datagram
+typedef struct WcapEncapFrame
+{
+    const uint8_t* data;
+    size_t len;
+    uint16_t flags;
+    uint32_t seq;
+    uint64_t tstamp;
+} WcapEncapFrame_t;
+
+// Aggregates frames into a single datagram
+typedef struct WcapEncap
+{
+    uint8_t* buf;
+    size_t bufsiz;
+    size_t maxlen;
+    size_t len;
+    unsigned int count;
+    uint32_t seq;
+    uint16_t tunnel;
+    // Datagrams are numbered in the stream of the encapsulator
+    uint8_t stream;
+    uint32_t dgramSeq;
+    // Stamp datagrams with the time they are closed, which is kept in 'sent'
+    bool stamp;
+    uint64_t sent;
+    // Header flags added to the next datagram closed only
+    uint8_t flags;
+} WcapEncap_t;
+
+// Walks the frames packed into a received datagram
+typedef struct WcapDecap
+{
+    const uint8_t* buf;
+    size_t len;
+    size_t off;
+    unsigned int remain;
+    uint8_t flags;
+    uint8_t stream;
+    uint16_t tunnel;
+    uint32_t seq;
+} WcapDecap_t;
+
+bool WcapEncapCreate(WcapEncap_t* enc, const size_t bufsiz, const size_t maxlen);
+bool WcapEncapDestroy(WcapEncap_t* enc);
+
+bool WcapEncapAdd(WcapEncap_t* enc, const void* data, const size_t len, const uint64_t tstamp);
+// Add a frame record of 'hdr' followed by 'data'
+bool WcapEncapAddFrame(WcapEncap_t* enc, const void* hdr, const size_t hdrlen, const void* data,
+                       const size_t len, const uint16_t flags, const uint64_t tstamp);
+size_t WcapEncapClose(WcapEncap_t* enc);
+void WcapEncapReset(WcapEncap_t* enc);
+
+bool WcapDecapInit(WcapDecap_t* dec, const void* buf, const size_t len);
+bool WcapDecapNext(WcapDecap_t* dec, WcapEncapFrame_t* frame);
+// Time a datagram was sent at, once all its frames have been walked
+bool WcapDecapSent(const WcapDecap_t* dec, uint64_t* sent);
+
+#endif /* _ENCAP_H_ */
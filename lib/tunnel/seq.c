@@ -0,0 +1,411 @@
+/*
+ ============================================================================
+ Name        : seq.c
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet concatenator
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "seq.h"
+
+#define SEQ_WORDS   (WCAP_SEQ_WINDOW / 64)
+
+static inline void _lock(WcapSeqTrack_t* trk)
+{
+    while (__atomic_test_and_set(&trk->lock, __ATOMIC_ACQUIRE))
+    {
+        while (__atomic_load_n(&trk->lock, __ATOMIC_RELAXED))
+        {
+        }
+    }
+}
+
+static inline void _unlock(WcapSeqTrack_t* trk)
+{
+    __atomic_clear(&trk->lock, __ATOMIC_RELEASE);
+}
+
+// Datagrams received from window position 'from' up to 'to'
+static unsigned int _ones(const uint64_t* win, const unsigned int from, const unsigned int to)
+{
+    unsigned int ones = 0;
+
+    for (unsigned int w = (from / 64); (w * 64) < to; w++)
+    {
+        uint64_t word = win[w];
+        if (w == (from / 64))
+        {
+            word &= ~0ULL << (from % 64);
+        }
+        if (((w + 1) * 64) > to)
+        {
+            word &= ~(~0ULL << (to % 64));
+        }
+        ones += __builtin_popcountll(word);
+    }
+
+    return ones;
+}
+
+// Window positions since the stream started, the ones before tell nothing
+static unsigned int _span(const WcapSeqTrack_t* trk)
+{
+    uint32_t span = (trk->head - trk->base) + 1;
+    return (span < WCAP_SEQ_WINDOW) ? span : WCAP_SEQ_WINDOW;
+}
+
+// Moves every position 'n' further from the head
+static void _shift(uint64_t* win, const unsigned int n)
+{
+    unsigned int words = n / 64;
+    unsigned int bits = n % 64;
+
+    for (int w = (SEQ_WORDS - 1); w >= 0; w--)
+    {
+        uint64_t word = 0;
+        if (w >= (int) words)
+        {
+            word = win[w - words] << bits;
+            if (bits && (w > (int) words))
+            {
+                word |= win[w - words - 1] >> (64 - bits);
+            }
+        }
+        win[w] = word;
+    }
+}
+
+// Whatever came before the first datagram is neither lost nor received yet,
+// it may still be on its way
+static void _restart(WcapSeqTrack_t* trk, const uint32_t seq)
+{
+    memset(trk->window, 0, sizeof(trk->window));
+    trk->window[0] = 1;
+    trk->head = seq;
+    trk->base = seq;
+    // Out of reach, it is in the window
+    trk->resync = seq;
+    trk->started = true;
+    trk->ordered = false;
+}
+
+WcapSeqVerdict_t WcapSeqTrackCheck(WcapSeqTrack_t* trk, const uint32_t seq, uint64_t* lost)
+{
+
+    WcapSeqVerdict_t verdict = WCAP_SEQ_NEW;
+    int32_t diff = 0;
+    uint64_t gone = 0;
+
+    _lock(trk);
+
+    trk->received++;
+    diff = (int32_t) (seq - trk->head);
+
+    if (!trk->started)
+    {
+        _restart(trk, seq);
+    }
+    else if ((diff > 0) && (diff <= WCAP_SEQ_JUMP_MAX))
+    {
+        // The gaps since the start pushed out of the window are now lost,
+        // along with any in the jump that never made it in
+        unsigned int from = (diff < WCAP_SEQ_WINDOW) ? (WCAP_SEQ_WINDOW - diff) : 0;
+        unsigned int span = _span(trk);
+
+        if (from < span)
+        {
+            gone = (span - from) - _ones(trk->window, from, span);
+        }
+        if (diff > WCAP_SEQ_WINDOW)
+        {
+            gone += diff - WCAP_SEQ_WINDOW;
+        }
+        _shift(trk->window, ((diff < WCAP_SEQ_WINDOW) ? diff : WCAP_SEQ_WINDOW));
+        trk->window[0] |= 1;
+        trk->head = seq;
+        // Keeps the start within reach of the window
+        if ((uint32_t) (trk->head - trk->base) >= WCAP_SEQ_WINDOW)
+        {
+            trk->base = trk->head - (WCAP_SEQ_WINDOW - 1);
+        }
+    }
+    else if ((diff <= 0) && (-diff < WCAP_SEQ_WINDOW))
+    {
+        unsigned int pos = -diff;
+        uint64_t bit = 1ULL << (pos % 64);
+
+        if (trk->window[pos / 64] & bit)
+        {
+            verdict = WCAP_SEQ_DUPLICATE;
+            trk->duplicates++;
+        }
+        else
+        {
+            trk->window[pos / 64] |= bit;
+            verdict = WCAP_SEQ_REORDERED;
+            trk->reordered++;
+            // Overtaken by the first one, the stream started earlier
+            if ((int32_t) (seq - trk->base) < 0)
+            {
+                trk->base = seq;
+            }
+        }
+    }
+    else if (seq == trk->resync)
+    {
+        // Two in a row out there, the sender started over
+        _restart(trk, seq);
+        verdict = WCAP_SEQ_RESYNC;
+        trk->resyncs++;
+    }
+    else
+    {
+        trk->resync = seq + 1;
+        verdict = (diff < 0) ? WCAP_SEQ_LATE : WCAP_SEQ_STRAY;
+        trk->late++;
+    }
+
+    trk->lost += gone;
+
+    _unlock(trk);
+
+    if (lost)
+    {
+        *lost = gone;
+    }
+
+    return verdict;
+}
+
+unsigned int WcapSeqTrackMissing(const WcapSeqTrack_t* trk)
+{
+    unsigned int span = 0;
+
+    if (!trk->started)
+    {
+        return 0;
+    }
+
+    span = _span(trk);
+    return (span - _ones(trk->window, 0, span));
+}
+
+bool WcapSeqReorderCreate(WcapSeqReorder_t* ro, const unsigned int size, const size_t bufsiz,
+                          const uint64_t delay)
+{
+
+    if (!ro || !size || (size > WCAP_SEQ_REORDER_MAX) || !bufsiz)
+    {
+        return false;
+    }
+
+    memset(ro, 0, sizeof(*ro));
+    ro->size = size;
+    ro->bufsiz = bufsiz;
+    ro->delay = delay;
+
+    ro->held = calloc(size, sizeof(*ro->held));
+    ro->mem = calloc(size, bufsiz);
+    if (!ro->held || !ro->mem)
+    {
+        fprintf(stderr, "Failed to allocate reorder buffer of %u datagrams\n", size);
+        WcapSeqReorderDestroy(ro);
+        return false;
+    }
+
+    for (unsigned int i = 0; i < size; i++)
+    {
+        ro->held[i].buf = ro->mem + (i * bufsiz);
+    }
+
+    return true;
+}
+
+bool WcapSeqReorderDestroy(WcapSeqReorder_t* ro)
+{
+
+    if (!ro)
+    {
+        return false;
+    }
+
+    free(ro->held);
+    free(ro->mem);
+    memset(ro, 0, sizeof(*ro));
+
+    return true;
+}
+
+bool WcapSeqReorderAccept(WcapSeqReorder_t* ro, WcapSeqTrack_t* trk, const uint32_t seq)
+{
+
+    int32_t diff = 0;
+
+    if (!ro || !trk)
+    {
+        return true;
+    }
+
+    // The first datagram of a stream, or of a restarted one, sets the order
+    if (!trk->ordered)
+    {
+        trk->ordered = true;
+        trk->next = seq + 1;
+        return true;
+    }
+
+    diff = (int32_t) (seq - trk->next);
+    if (diff == 0)
+    {
+        trk->next = seq + 1;
+        return true;
+    }
+
+    // Behind, its gap was already given up on
+    if (diff < 0)
+    {
+        return true;
+    }
+
+    // A gap wider than the tracker's window is lost whatever happens
+    if (diff >= WCAP_SEQ_WINDOW)
+    {
+        trk->next = seq + 1;
+        ro->skips++;
+        return true;
+    }
+
+    return false;
+}
+
+bool WcapSeqReorderHold(WcapSeqReorder_t* ro, WcapSeqTrack_t* trk, const uint32_t seq,
+                        const void* buf, const size_t len, const uint64_t tstamp,
+                        const uint64_t now)
+{
+
+    if (!ro || !ro->held || !trk || !buf || (len > ro->bufsiz) || WcapSeqReorderFull(ro))
+    {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < ro->size; i++)
+    {
+        WcapSeqHeld_t* held = &ro->held[i];
+
+        if (held->used)
+        {
+            continue;
+        }
+        memcpy(held->buf, buf, len);
+        held->len = len;
+        held->track = trk;
+        held->seq = seq;
+        held->tstamp = tstamp;
+        held->deadline = now + ro->delay;
+        held->used = true;
+        ro->count++;
+        ro->holds++;
+        return true;
+    }
+
+    return false;
+}
+
+WcapSeqHeld_t* WcapSeqReorderNext(WcapSeqReorder_t* ro, const uint64_t now, const bool force)
+{
+
+    WcapSeqHeld_t* oldest = NULL;
+    WcapSeqHeld_t* first = NULL;
+
+    if (!ro || !ro->count)
+    {
+        return NULL;
+    }
+
+    // In order now, or behind a gap given up on since it was held
+    for (unsigned int i = 0; i < ro->size; i++)
+    {
+        WcapSeqHeld_t* held = &ro->held[i];
+        int32_t diff = 0;
+
+        if (!held->used)
+        {
+            continue;
+        }
+        diff = (int32_t) (held->seq - held->track->next);
+        if (diff <= 0)
+        {
+            if (diff == 0)
+            {
+                held->track->next = held->seq + 1;
+            }
+            return held;
+        }
+        if (!oldest || (held->deadline < oldest->deadline))
+        {
+            oldest = held;
+        }
+    }
+
+    if (!force && (oldest->deadline > now))
+    {
+        return NULL;
+    }
+
+    // Give up on the gap before the earliest datagram of the stream that has
+    // waited longest; the rest of the stream may then follow in order
+    for (unsigned int i = 0; i < ro->size; i++)
+    {
+        WcapSeqHeld_t* held = &ro->held[i];
+
+        if (held->used && (held->track == oldest->track) &&
+            (!first || ((int32_t) (held->seq - first->seq) < 0)))
+        {
+            first = held;
+        }
+    }
+    first->track->next = first->seq + 1;
+    ro->skips++;
+    if (force)
+    {
+        ro->forced++;
+    }
+
+    return first;
+}
+
+void WcapSeqReorderRelease(WcapSeqReorder_t* ro, WcapSeqHeld_t* held)
+{
+    if (ro && held && held->used)
+    {
+        held->used = false;
+        ro->count--;
+    }
+}
+
+uint64_t WcapSeqReorderDeadline(const WcapSeqReorder_t* ro)
+{
+
+    uint64_t deadline = 0;
+
+    if (!ro || !ro->count)
+    {
+        return 0;
+    }
+
+    for (unsigned int i = 0; i < ro->size; i++)
+    {
+        if (ro->held[i].used && (!deadline || (ro->held[i].deadline < deadline)))
+        {
+            deadline = ro->held[i].deadline;
+        }
+    }
+
+    return deadline;
+}
@@ -0,0 +1,132 @@
+/*
+ ============================================================================
+ Name        : seq.h
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet capture and forwarder
+ ============================================================================
+ */
+
+#ifndef _SEQ_H_
+#define _SEQ_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Datagrams remembered behind the newest one; a gap that slides out of the
+// window unfilled is counted lost
+#define WCAP_SEQ_WINDOW             256
+
+// Ahead of the newest datagram by more than this, or behind the window, a
+// sequence number is taken for the sender having restarted once the next one
+// follows it (as RTP's MAX_DROPOUT)
+#define WCAP_SEQ_JUMP_MAX           3000
+
+#define WCAP_SEQ_REORDER_MAX        64
+#define WCAP_SEQ_REORDER_DELAY_DEF  1000
+
+typedef enum
+{
+    // Newest so far, possibly after a gap
+    WCAP_SEQ_NEW,
+    // Fills a gap in the window
+    WCAP_SEQ_REORDERED,
+    // Already received
+    WCAP_SEQ_DUPLICATE,
+    // Older than the window, its gap was already counted lost
+    WCAP_SEQ_LATE,
+    // Too far ahead to place, until the sender proves it restarted
+    WCAP_SEQ_STRAY,
+    // Follows a stray or late one, the sender started over from it
+    WCAP_SEQ_RESYNC
+} WcapSeqVerdict_t;
+
+// Receive side view of one sequence space. Bit i of the window stands for
+// the datagram 'head - i'; only those from 'base', the earliest datagram seen
+// since the stream started, count towards losses. A byte lock serializes
+// updates, since a datagram may be handled by another datapath than its
+// tunnel's.
+typedef struct WcapSeqTrack
+{
+    uint8_t lock;
+    bool started;
+    // Next sequence number to deliver while restoring order, owned by the
+    // reordering datapath
+    bool ordered;
+    uint32_t next;
+    uint32_t head;
+    uint32_t base;
+    uint32_t resync;
+    uint64_t window[WCAP_SEQ_WINDOW / 64];
+    uint64_t received;
+    uint64_t lost;
+    uint64_t reordered;
+    uint64_t duplicates;
+    // Late or stray
+    uint64_t late;
+    uint64_t resyncs;
+} WcapSeqTrack_t;
+
+// Verdict on datagram 'seq', 'lost' is set to the number of gaps that just
+// slid out of the window
+WcapSeqVerdict_t WcapSeqTrackCheck(WcapSeqTrack_t* trk, const uint32_t seq, uint64_t* lost);
+// Gaps still in the window, which may yet be filled; a snapshot, exact once
+// the datagrams stopped
+unsigned int WcapSeqTrackMissing(const WcapSeqTrack_t* trk);
+
+// A datagram held back until the ones before it arrive
+typedef struct WcapSeqHeld
+{
+    bool used;
+    WcapSeqTrack_t* track;
+    uint32_t seq;
+    uint64_t deadline;
+    uint64_t tstamp;
+    size_t len;
+    uint8_t* buf;
+} WcapSeqHeld_t;
+
+// Restores the order of datagrams within a bounded number held and a bounded
+// delay, after which the gap is given up on. Owned by a single thread.
+typedef struct WcapSeqReorder
+{
+    WcapSeqHeld_t* held;
+    uint8_t* mem;
+    unsigned int size;
+    unsigned int count;
+    size_t bufsiz;
+    uint64_t delay;
+    uint64_t holds;
+    // Gaps given up on, and how many of those to make room
+    uint64_t skips;
+    uint64_t forced;
+} WcapSeqReorder_t;
+
+bool WcapSeqReorderCreate(WcapSeqReorder_t* ro, const unsigned int size, const size_t bufsiz,
+                          const uint64_t delay);
+bool WcapSeqReorderDestroy(WcapSeqReorder_t* ro);
+
+// Whether datagram 'seq', already checked by its tracker, can be delivered
+// now rather than held
+bool WcapSeqReorderAccept(WcapSeqReorder_t* ro, WcapSeqTrack_t* trk, const uint32_t seq);
+// Keeps a copy of a datagram that could not be delivered yet; fails when it
+// is too large or nothing is free, see WcapSeqReorderFull()
+bool WcapSeqReorderHold(WcapSeqReorder_t* ro, WcapSeqTrack_t* trk, const uint32_t seq,
+                        const void* buf, const size_t len, const uint64_t tstamp,
+                        const uint64_t now);
+// Next held datagram to deliver: one that is now in order, or when its delay
+// ran out or 'force' is set, the first of the stream that waited longest.
+// It stays valid until released.
+WcapSeqHeld_t* WcapSeqReorderNext(WcapSeqReorder_t* ro, const uint64_t now, const bool force);
+void WcapSeqReorderRelease(WcapSeqReorder_t* ro, WcapSeqHeld_t* held);
+// Earliest delay to run out, 0 when nothing is held
+uint64_t WcapSeqReorderDeadline(const WcapSeqReorder_t* ro);
+
+static inline bool WcapSeqReorderFull(const WcapSeqReorder_t* ro)
+{
+    return (ro->count == ro->size);
+}
+
+#endif /* _SEQ_H_ */
@@ -0,0 +1,293 @@
+/*
+ ============================================================================
+ Name        : session.c
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet concatenator
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "session.h"
+
+static uint64_t _key(const struct sockaddr_in* addr)
+{
+    return ((uint64_t) addr->sin_addr.s_addr << 16) | addr->sin_port;
+}
+
+static unsigned int _hash(WcapSessionTable_t* tbl, const uint64_t key)
+{
+    // Fibonacci hashing spreads the sequential addresses of a subnet
+    return (unsigned int) ((key * 0x9E3779B97F4A7C15ULL) >> (64 - tbl->bits));
+}
+
+// Whether no reader may still hold a session expired in epoch 'retired'
+static bool _reclaimable(WcapSessionTable_t* tbl, const uint64_t retired)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    for (unsigned int i = 0; i < tbl->readerCount; i++)
+    {
+        uint64_t epoch = __atomic_load_n(&tbl->readers[i].epoch, __ATOMIC_ACQUIRE);
+        if (epoch && (epoch <= retired))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static WcapSession_t* _find(WcapSessionTable_t* tbl, const uint64_t key)
+{
+    unsigned int idx = _hash(tbl, key);
+
+    // Tombstones keep the probe going, only an empty slot ends it
+    for (unsigned int i = 0; i <= tbl->mask; i++, idx = (idx + 1) & tbl->mask)
+    {
+        WcapSession_t* slot = &tbl->slots[idx];
+        uint64_t cur = __atomic_load_n(&slot->key, __ATOMIC_ACQUIRE);
+        if (cur == key)
+        {
+            return slot;
+        }
+        if (cur == WCAP_SESSION_EMPTY)
+        {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+bool WcapSessionTableCreate(WcapSessionTable_t* tbl, const unsigned int max, const uint64_t idle,
+                            const unsigned int readers)
+{
+
+    unsigned int size = 1;
+    unsigned int bits = 0;
+
+    if (!tbl || !max || (max > WCAP_SESSION_MAX) || !readers ||
+        (readers > WCAP_SESSION_READERS_MAX))
+    {
+        return false;
+    }
+
+    memset(tbl, 0, sizeof(*tbl));
+
+    // Keep the load factor at or below one half so probes stay short
+    while (size < (max * 2))
+    {
+        size <<= 1;
+        bits++;
+    }
+
+    tbl->slots = calloc(size, sizeof(*tbl->slots));
+    tbl->readers = calloc(readers, sizeof(*tbl->readers));
+    if (!tbl->slots || !tbl->readers)
+    {
+        fprintf(stderr, "Failed to allocate session table of %u slots\n", size);
+        free(tbl->slots);
+        free(tbl->readers);
+        tbl->slots = NULL;
+        tbl->readers = NULL;
+        return false;
+    }
+
+    pthread_mutex_init(&tbl->lock, NULL);
+    tbl->mask = size - 1;
+    tbl->bits = bits;
+    tbl->max = max;
+    tbl->idle = idle;
+    tbl->epoch = 1;
+    tbl->readerCount = readers;
+
+    return true;
+}
+
+bool WcapSessionTableDestroy(WcapSessionTable_t* tbl)
+{
+
+    if (!tbl)
+    {
+        return false;
+    }
+
+    if (tbl->slots)
+    {
+        pthread_mutex_destroy(&tbl->lock);
+        free(tbl->slots);
+        free(tbl->readers);
+    }
+    memset(tbl, 0, sizeof(*tbl));
+
+    return true;
+}
+
+WcapSession_t* WcapSessionFind(WcapSessionTable_t* tbl, const struct sockaddr_in* addr)
+{
+
+    if (!tbl || !tbl->slots || !addr)
+    {
+        return NULL;
+    }
+
+    return _find(tbl, _key(addr));
+}
+
+WcapSession_t* WcapSessionTouch(WcapSessionTable_t* tbl, const struct sockaddr_in* addr,
+                                const uint64_t now)
+{
+
+    WcapSession_t* session = NULL;
+    WcapSession_t* slot = NULL;
+    uint64_t key = 0;
+    unsigned int idx = 0;
+
+    if (!tbl || !tbl->slots || !addr || !addr->sin_addr.s_addr)
+    {
+        return NULL;
+    }
+
+    // Known peers take the lock-free path
+    key = _key(addr);
+    session = _find(tbl, key);
+    if (session)
+    {
+        __atomic_store_n(&session->lastSeen, now, __ATOMIC_RELAXED);
+        return session;
+    }
+
+    pthread_mutex_lock(&tbl->lock);
+
+    // Another thread may have inserted it while we waited for the lock
+    session = _find(tbl, key);
+    if (session || (tbl->count >= tbl->max))
+    {
+        if (!session)
+        {
+            tbl->refused++;
+        }
+        pthread_mutex_unlock(&tbl->lock);
+        return session;
+    }
+
+    // Reuse the first tombstone on the probe path no reader can still be
+    // using, else the empty slot
+    idx = _hash(tbl, key);
+    for (unsigned int i = 0; i <= tbl->mask; i++, idx = (idx + 1) & tbl->mask)
+    {
+        uint64_t cur = tbl->slots[idx].key;
+        if ((cur == WCAP_SESSION_EMPTY) ||
+            ((cur == WCAP_SESSION_TOMBSTONE) && _reclaimable(tbl, tbl->slots[idx].retired)))
+        {
+            slot = &tbl->slots[idx];
+            break;
+        }
+    }
+    if (!slot)
+    {
+        tbl->refused++;
+    }
+
+    if (slot)
+    {
+        uint64_t cur = slot->key;
+        memset(slot, 0, sizeof(*slot));
+        slot->key = cur;
+        slot->addr = *addr;
+        slot->created = now;
+        slot->lastSeen = now;
+        // Publish the key last so lock-free readers never see a half made entry
+        __atomic_store_n(&slot->key, key, __ATOMIC_RELEASE);
+        __atomic_store_n(&tbl->count, (tbl->count + 1), __ATOMIC_RELAXED);
+    }
+
+    pthread_mutex_unlock(&tbl->lock);
+
+    return slot;
+}
+
+unsigned int WcapSessionExpire(WcapSessionTable_t* tbl, const uint64_t now, WcapSessionCb_t cb,
+                               void* arg)
+{
+
+    unsigned int cnt = 0;
+
+    if (!tbl || !tbl->slots || !tbl->idle)
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&tbl->lock);
+
+    for (unsigned int i = 0; i <= tbl->mask; i++)
+    {
+        WcapSession_t* slot = &tbl->slots[i];
+        uint64_t last = __atomic_load_n(&slot->lastSeen, __ATOMIC_RELAXED);
+        if ((slot->key == WCAP_SESSION_EMPTY) || (slot->key == WCAP_SESSION_TOMBSTONE) ||
+            slot->fixed || ((now - last) < tbl->idle))
+        {
+            continue;
+        }
+        if (cb)
+        {
+            cb(slot, arg);
+        }
+        slot->retired = tbl->epoch;
+        __atomic_store_n(&slot->key, WCAP_SESSION_TOMBSTONE, __ATOMIC_RELEASE);
+        __atomic_store_n(&tbl->count, (tbl->count - 1), __ATOMIC_RELAXED);
+        cnt++;
+    }
+
+    // Readers entering from now on can no longer find what just expired
+    if (cnt)
+    {
+        tbl->retired = tbl->epoch;
+        __atomic_store_n(&tbl->epoch, (tbl->epoch + 1), __ATOMIC_RELEASE);
+    }
+
+    // With nothing live, and no reader left that could hold an expired slot,
+    // the probe chains can be wiped clean
+    if (!tbl->count && _reclaimable(tbl, tbl->retired))
+    {
+        for (unsigned int i = 0; i <= tbl->mask; i++)
+        {
+            __atomic_store_n(&tbl->slots[i].key, WCAP_SESSION_EMPTY, __ATOMIC_RELEASE);
+        }
+    }
+
+    pthread_mutex_unlock(&tbl->lock);
+
+    return cnt;
+}
+
+WcapSession_t* WcapSessionNext(WcapSessionTable_t* tbl, unsigned int* iter)
+{
+
+    if (!tbl || !tbl->slots || !iter)
+    {
+        return NULL;
+    }
+
+    while (*iter <= tbl->mask)
+    {
+        WcapSession_t* slot = &tbl->slots[(*iter)++];
+        uint64_t key = __atomic_load_n(&slot->key, __ATOMIC_ACQUIRE);
+        if ((key != WCAP_SESSION_EMPTY) && (key != WCAP_SESSION_TOMBSTONE))
+        {
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+unsigned int WcapSessionCount(WcapSessionTable_t* tbl)
+{
+    return tbl ? __atomic_load_n(&tbl->count, __ATOMIC_RELAXED) : 0;
+}
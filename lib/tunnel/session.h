@@ -0,0 +1,120 @@
+/*
+ ============================================================================
+ Name        : session.h
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet capture and forwarder
+ ============================================================================
+ */
+
+#ifndef _SESSION_H_
+#define _SESSION_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include <netinet/in.h>
+
+#include "encap.h"
+#include "seq.h"
+
+#define WCAP_SESSION_MAX_DEF        64
+#define WCAP_SESSION_MAX            4096
+// Peers are never forgotten unless asked: a client whose radio hears nothing
+// to send back would otherwise stop receiving once it went idle
+#define WCAP_SESSION_IDLE_DEF       0
+
+// Slot keys; live keys pack the address and port into the low 48 bits
+#define WCAP_SESSION_EMPTY          0ULL
+#define WCAP_SESSION_TOMBSTONE      UINT64_MAX
+
+// Threads that may hold session pointers, one reader slot each
+#define WCAP_SESSION_READERS_MAX    128
+
+// One peer of the tunnel. Counters are updated with relaxed atomics from
+// whichever datapath thread touches the session.
+typedef struct WcapSession
+{
+    uint64_t key;
+    // Epoch the slot was expired in, it is not reused before readers pass it
+    uint64_t retired;
+    struct sockaddr_in addr;
+    bool fixed;
+    uint64_t created;
+    uint64_t lastSeen;
+    uint32_t tunnels;
+    uint8_t peerFlags;
+    uint64_t rxDatagrams;
+    uint64_t rxFrames;
+    uint64_t rxBytes;
+    uint64_t txDatagrams;
+    uint64_t txBytes;
+    // Datagrams received in each stream, one per datapath of the peer
+    WcapSeqTrack_t seq[WCAP_ENCAP_STREAM_MAX];
+} __attribute__((aligned(64))) WcapSession_t;
+
+typedef void (*WcapSessionCb_t)(const WcapSession_t* session, void* arg);
+
+// Epoch a reader entered in, 0 while it holds no session
+typedef struct WcapSessionReader
+{
+    uint64_t epoch;
+} __attribute__((aligned(64))) WcapSessionReader_t;
+
+// Open addressing (linear probing) table of sessions keyed by address and
+// port. Lookups and walks are lock-free; inserts and expiry are serialized by
+// the lock and never move a live entry, removed slots become tombstones.
+// Readers keep the sessions they find only between entering and leaving, and
+// a tombstone is reused once every reader inside when it expired has left.
+typedef struct WcapSessionTable
+{
+    pthread_mutex_t lock;
+    WcapSession_t* slots;
+    unsigned int mask;
+    unsigned int bits;
+    unsigned int max;
+    unsigned int count;
+    uint64_t idle;
+    uint64_t refused;
+    uint64_t epoch;
+    uint64_t retired;
+    WcapSessionReader_t* readers;
+    unsigned int readerCount;
+} WcapSessionTable_t;
+
+bool WcapSessionTableCreate(WcapSessionTable_t* tbl, const unsigned int max, const uint64_t idle,
+                            const unsigned int readers);
+bool WcapSessionTableDestroy(WcapSessionTable_t* tbl);
+
+WcapSession_t* WcapSessionFind(WcapSessionTable_t* tbl, const struct sockaddr_in* addr);
+WcapSession_t* WcapSessionTouch(WcapSessionTable_t* tbl, const struct sockaddr_in* addr,
+                                const uint64_t now);
+unsigned int WcapSessionExpire(WcapSessionTable_t* tbl, const uint64_t now, WcapSessionCb_t cb,
+                               void* arg);
+
+// Walk the live sessions, start with *iter set to 0
+WcapSession_t* WcapSessionNext(WcapSessionTable_t* tbl, unsigned int* iter);
+unsigned int WcapSessionCount(WcapSessionTable_t* tbl);
+
+// Entering again while inside keeps the epoch first entered in, so a reader
+// may stay inside across calls for what it still holds
+static inline void WcapSessionEnter(WcapSessionTable_t* tbl, const unsigned int reader)
+{
+    if (__atomic_load_n(&tbl->readers[reader].epoch, __ATOMIC_RELAXED))
+    {
+        return;
+    }
+    __atomic_store_n(&tbl->readers[reader].epoch, __atomic_load_n(&tbl->epoch, __ATOMIC_ACQUIRE),
+                     __ATOMIC_RELAXED);
+    // Seen by the lock holder before any slot is looked at
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline void WcapSessionLeave(WcapSessionTable_t* tbl, const unsigned int reader)
+{
+    __atomic_store_n(&tbl->readers[reader].epoch, 0, __ATOMIC_RELEASE);
+}
+
+#endif /* _SESSION_H_ */
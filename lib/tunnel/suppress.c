@@ -0,0 +1,298 @@
+/*
+ ============================================================================
+ Name        : suppress.c
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet concatenator
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "suppress.h"
+
+// 802.11 management header and the fields that change from one copy of a
+// frame to the next
+#define IEEE80211_FC_BEACON         0x80
+#define IEEE80211_FC_PROBE_REQ      0x40
+#define IEEE80211_FC_PROBE_RESP     0x50
+#define IEEE80211_TA_OFFSET         10
+#define IEEE80211_SEQ_OFFSET        22
+#define IEEE80211_HDR_LEN           24
+#define IEEE80211_TSF_LEN           8
+
+#define FNV_OFFSET                  0xcbf29ce484222325ULL
+#define FNV_PRIME                   0x100000001b3ULL
+
+static inline bool _suppressed(const uint8_t fc)
+{
+    return ((fc == IEEE80211_FC_BEACON) || (fc == IEEE80211_FC_PROBE_REQ) ||
+            (fc == IEEE80211_FC_PROBE_RESP));
+}
+
+static inline bool _has_tsf(const uint8_t fc)
+{
+    return ((fc == IEEE80211_FC_BEACON) || (fc == IEEE80211_FC_PROBE_RESP));
+}
+
+static uint64_t _fnv(uint64_t hash, const uint8_t* buf, const size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        hash = (hash ^ buf[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+// Everything but the sequence control field and, where there is one, the TSF
+static uint64_t _hash(const uint8_t* frame, const size_t len)
+{
+    size_t body = IEEE80211_HDR_LEN + (_has_tsf(frame[0]) ? IEEE80211_TSF_LEN : 0);
+    uint64_t hash = _fnv(FNV_OFFSET, frame, IEEE80211_SEQ_OFFSET);
+
+    return _fnv(hash, frame + body, len - body);
+}
+
+static WcapSuppressEntry_t* _lookup(WcapSuppress_t* sup, const uint16_t tunnel, const uint8_t* ta,
+                                    const uint8_t fc, const bool insert)
+{
+    WcapSuppressEntry_t* victim = NULL;
+    unsigned int idx = (unsigned int) (_fnv(_fnv(FNV_OFFSET, ta, 6), &fc, 1) ^ tunnel);
+
+    for (unsigned int i = 0; i < WCAP_SUPPRESS_WAYS; i++)
+    {
+        WcapSuppressEntry_t* entry = &sup->entries[(idx + i) & sup->mask];
+
+        if (entry->valid && (entry->tunnel == tunnel) && (entry->fc == fc) &&
+            !memcmp(entry->ta, ta, 6))
+        {
+            entry->used = ++sup->clock;
+            return entry;
+        }
+        // Prefer a free slot, otherwise the least recently used
+        if (!entry->valid)
+        {
+            victim = (victim && !victim->valid) ? victim : entry;
+        }
+        else if (!victim || (victim->valid && (entry->used < victim->used)))
+        {
+            victim = entry;
+        }
+    }
+
+    if (!insert)
+    {
+        return NULL;
+    }
+
+    if (victim->valid)
+    {
+        sup->evictions++;
+    }
+    victim->valid = true;
+    victim->tunnel = tunnel;
+    memcpy(victim->ta, ta, 6);
+    victim->fc = fc;
+    victim->hash = 0;
+    victim->repeats = 0;
+    victim->len = 0;
+    victim->used = ++sup->clock;
+
+    return victim;
+}
+
+bool WcapSuppressCreate(WcapSuppress_t* sup, const unsigned int entries,
+                        const unsigned int refresh)
+{
+
+    unsigned int size = WCAP_SUPPRESS_WAYS;
+
+    if (!sup || !entries || (entries > WCAP_SUPPRESS_ENTRIES_MAX))
+    {
+        return false;
+    }
+
+    memset(sup, 0, sizeof(*sup));
+
+    while (size < entries)
+    {
+        size <<= 1;
+    }
+
+    sup->entries = calloc(size, sizeof(*sup->entries));
+    if (!sup->entries)
+    {
+        fprintf(stderr, "Failed to allocate suppression table\n");
+        return false;
+    }
+    sup->mask = size - 1;
+    sup->refresh = refresh;
+
+    return true;
+}
+
+bool WcapSuppressDestroy(WcapSuppress_t* sup)
+{
+
+    if (!sup)
+    {
+        return false;
+    }
+
+    for (unsigned int i = 0; sup->entries && (i <= sup->mask); i++)
+    {
+        free(sup->entries[i].frame);
+    }
+    free(sup->entries);
+    memset(sup, 0, sizeof(*sup));
+
+    return true;
+}
+
+WcapSuppressVerdict_t WcapSuppressCheck(WcapSuppress_t* sup, const uint16_t tunnel,
+                                        const uint8_t* frame, const size_t len,
+                                        WcapSuppressRepeat_t* rep)
+{
+
+    WcapSuppressEntry_t* entry = NULL;
+    uint64_t hash = 0;
+
+    if (!sup || !sup->entries || !frame || (len < (IEEE80211_HDR_LEN + IEEE80211_TSF_LEN)) ||
+        !_suppressed(frame[0]))
+    {
+        return WCAP_SUPPRESS_PASS;
+    }
+
+    sup->frames++;
+    hash = _hash(frame, len);
+    entry = _lookup(sup, tunnel, frame + IEEE80211_TA_OFFSET, frame[0], true);
+
+    if ((entry->hash != hash) || (entry->len != len) ||
+        (sup->refresh && (++entry->repeats >= sup->refresh)))
+    {
+        entry->hash = hash;
+        entry->len = len;
+        entry->repeats = 0;
+        return WCAP_SUPPRESS_CACHE;
+    }
+
+    sup->repeats++;
+    if (rep)
+    {
+        uint32_t tag = (uint32_t) hash;
+
+        memset(rep, 0, sizeof(*rep));
+        memcpy(rep->ta, frame + IEEE80211_TA_OFFSET, sizeof(rep->ta));
+        rep->fc = frame[0];
+        memcpy(rep->seqCtrl, frame + IEEE80211_SEQ_OFFSET, sizeof(rep->seqCtrl));
+        if (_has_tsf(frame[0]))
+        {
+            memcpy(rep->tsf, frame + IEEE80211_HDR_LEN, sizeof(rep->tsf));
+        }
+        for (int i = (sizeof(rep->hash) - 1); i >= 0; i--, tag >>= 8)
+        {
+            rep->hash[i] = (uint8_t) tag;
+        }
+    }
+
+    return WCAP_SUPPRESS_REPEAT;
+}
+
+void WcapSuppressReset(WcapSuppress_t* sup)
+{
+    for (unsigned int i = 0; sup && sup->entries && (i <= sup->mask); i++)
+    {
+        sup->entries[i].len = 0;
+    }
+}
+
+bool WcapSuppressStore(WcapSuppress_t* sup, const uint16_t tunnel, const uint8_t* frame,
+                       const size_t len, const size_t fcs)
+{
+
+    WcapSuppressEntry_t* entry = NULL;
+    size_t dot11 = 0;
+
+    if (!sup || !sup->entries || !frame || (len < 4))
+    {
+        return false;
+    }
+
+    // The 802.11 header follows the radiotap header
+    dot11 = frame[2] | (frame[3] << 8);
+    if ((len < (dot11 + IEEE80211_HDR_LEN + IEEE80211_TSF_LEN + fcs)) ||
+        !_suppressed(frame[dot11]))
+    {
+        return false;
+    }
+
+    entry = _lookup(sup, tunnel, frame + dot11 + IEEE80211_TA_OFFSET, frame[dot11], true);
+    if (entry->size < len)
+    {
+        uint8_t* buf = realloc(entry->frame, len);
+        if (!buf)
+        {
+            entry->valid = false;
+            return false;
+        }
+        entry->frame = buf;
+        entry->size = len;
+    }
+
+    memcpy(entry->frame, frame, len);
+    entry->len = len;
+    entry->dot11 = dot11;
+    // Hashed as the sender did, to match its repeats against
+    entry->hash = _hash(frame + dot11, len - dot11 - fcs);
+    sup->frames++;
+
+    return true;
+}
+
+bool WcapSuppressRegenerate(WcapSuppress_t* sup, const uint16_t tunnel,
+                            const WcapSuppressRepeat_t* rep, const uint8_t** frame, size_t* len)
+{
+
+    WcapSuppressEntry_t* entry = NULL;
+    uint32_t tag = 0;
+
+    if (!sup || !sup->entries || !rep || !frame || !len)
+    {
+        return false;
+    }
+
+    // Nothing to rebuild from when the cached copy was lost or evicted
+    entry = _lookup(sup, tunnel, rep->ta, rep->fc, false);
+    if (!entry || !entry->len)
+    {
+        sup->misses++;
+        return false;
+    }
+
+    // The sender has moved on from the copy kept here
+    for (unsigned int i = 0; i < sizeof(rep->hash); i++)
+    {
+        tag = (tag << 8) | rep->hash[i];
+    }
+    if (tag != (uint32_t) entry->hash)
+    {
+        sup->misses++;
+        sup->stale++;
+        return false;
+    }
+
+    memcpy(entry->frame + entry->dot11 + IEEE80211_SEQ_OFFSET, rep->seqCtrl, sizeof(rep->seqCtrl));
+    if (_has_tsf(rep->fc))
+    {
+        memcpy(entry->frame + entry->dot11 + IEEE80211_HDR_LEN, rep->tsf, sizeof(rep->tsf));
+    }
+    sup->repeats++;
+
+    *frame = entry->frame;
+    *len = entry->len;
+
+    return true;
+}
@@ -0,0 +1,104 @@
+/*
+ ============================================================================
+ Name        : suppress.h
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet capture and forwarder
+ ============================================================================
+ */
+
+#ifndef _SUPPRESS_H_
+#define _SUPPRESS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define WCAP_SUPPRESS_ENTRIES_DEF   256
+#define WCAP_SUPPRESS_ENTRIES_MAX   65536
+#define WCAP_SUPPRESS_REFRESH_DEF   10
+
+// Slots probed for a key before the least recently used one is evicted
+#define WCAP_SUPPRESS_WAYS          4
+
+// Sent in place of a frame identical to the last one cached by the receiver
+// for the same transmitter and subtype, apart from the fields carried here
+// verbatim. The hash, of the frame as sent whole and big endian, tells a
+// receiver that missed the latest copy not to rebuild from an older one.
+typedef struct __attribute__((packed)) WcapSuppressRepeat
+{
+    uint8_t ta[6];
+    uint8_t fc;
+    uint8_t reserved;
+    uint8_t seqCtrl[2];
+    uint8_t tsf[8];
+    uint8_t hash[4];
+} WcapSuppressRepeat_t;
+
+typedef enum
+{
+    // Not a frame that is suppressed, send it as usual
+    WCAP_SUPPRESS_PASS,
+    // New or changed, send it whole for the receiver to cache
+    WCAP_SUPPRESS_CACHE,
+    // Unchanged, a repeat record stands in for it
+    WCAP_SUPPRESS_REPEAT
+} WcapSuppressVerdict_t;
+
+typedef struct WcapSuppressEntry
+{
+    bool valid;
+    uint16_t tunnel;
+    uint8_t ta[6];
+    uint8_t fc;
+    uint64_t hash;
+    uint64_t used;
+    unsigned int repeats;
+    uint8_t* frame;
+    size_t len;
+    size_t size;
+    size_t dot11;
+} WcapSuppressEntry_t;
+
+// Last beacon, probe request and probe response of each transmitter, set
+// associative on its address. A sender keeps the hash of what it sent, a
+// receiver the frame itself. Owned by a single thread.
+typedef struct WcapSuppress
+{
+    WcapSuppressEntry_t* entries;
+    unsigned int mask;
+    unsigned int refresh;
+    uint64_t clock;
+    uint64_t frames;
+    uint64_t repeats;
+    uint64_t evictions;
+    // Repeats with no cached copy, or only one that is out of date
+    uint64_t misses;
+    uint64_t stale;
+} WcapSuppress_t;
+
+bool WcapSuppressCreate(WcapSuppress_t* sup, const unsigned int entries,
+                        const unsigned int refresh);
+bool WcapSuppressDestroy(WcapSuppress_t* sup);
+
+// Sender: verdict on a bare 802.11 frame without FCS, 'rep' is filled in for
+// a repeat. Every 'refresh'th repeat is sent whole in case the receiver lost
+// the cached copy.
+WcapSuppressVerdict_t WcapSuppressCheck(WcapSuppress_t* sup, const uint16_t tunnel,
+                                        const uint8_t* frame, const size_t len,
+                                        WcapSuppressRepeat_t* rep);
+// Sender: forget what was sent, so the next frame of each transmitter and
+// subtype goes whole; for a receiver that joined late or lost its copies
+void WcapSuppressReset(WcapSuppress_t* sup);
+
+// Receiver: cache a frame, radiotap header included and followed by 'fcs'
+// bytes of FCS, and rebuild it from a repeat record. The rebuilt frame lives
+// in the cache until the next frame from the same transmitter and subtype is
+// stored.
+bool WcapSuppressStore(WcapSuppress_t* sup, const uint16_t tunnel, const uint8_t* frame,
+                       const size_t len, const size_t fcs);
+bool WcapSuppressRegenerate(WcapSuppress_t* sup, const uint16_t tunnel,
+                            const WcapSuppressRepeat_t* rep, const uint8_t** frame, size_t* len);
+
+#endif /* _SUPPRESS_H_ */
@@ -0,0 +1,417 @@
+/*
+ ============================================================================
+ Name        : udp.c
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet concatenator
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <netinet/udp.h>
+#include <linux/filter.h>
+
+#include "tstamp.h"
+#include "udp.h"
+
+// Room for either a UDP_SEGMENT (u16) or a UDP_GRO (int) control message,
+// and the receive timestamp
+#define UDP_CTRL_SIZE   (CMSG_SPACE(sizeof(int)) + WCAP_TSTAMP_CTRL_SIZE)
+
+static bool _same_addr(const struct sockaddr_in* a, const struct sockaddr_in* b)
+{
+    return ((a->sin_addr.s_addr == b->sin_addr.s_addr) && (a->sin_port == b->sin_port));
+}
+
+bool WcapUdpSteer(const int fd, const unsigned int offset, const unsigned int stride)
+{
+
+    // The program sees the UDP payload; an index past the end of the group
+    // (including a failed load) leaves the choice to the kernel's hash
+    struct sock_filter code[] =
+    {
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, offset),
+        BPF_STMT(BPF_ALU | BPF_MUL | BPF_K, stride),
+        BPF_STMT(BPF_RET | BPF_A, 0)
+    };
+    struct sock_fprog prog = { .len = (sizeof(code) / sizeof(code[0])), .filter = code };
+
+    if ((fd < 0) || !stride)
+    {
+        return false;
+    }
+
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0)
+    {
+        fprintf(stderr, "Failed to attach UDP steering program: [%d] %s\n", errno, strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+bool WcapUdpBatchCreate(WcapUdpBatch_t* batch, const int fd, const unsigned int size,
+                        const size_t bufsiz)
+{
+
+    if (!batch || (fd < 0) || !size || (size > WCAP_UDP_BATCH_MAX) || !bufsiz)
+    {
+        return false;
+    }
+
+    memset(batch, 0, sizeof(*batch));
+    batch->fd = fd;
+    batch->size = size;
+    batch->bufsiz = bufsiz;
+
+    batch->bufs = calloc(size, bufsiz);
+    batch->msgs = calloc(size, sizeof(*batch->msgs));
+    batch->iovs = calloc(size, sizeof(*batch->iovs));
+    batch->addrs = calloc(size, sizeof(*batch->addrs));
+    batch->ctrls = calloc(size, UDP_CTRL_SIZE);
+    batch->segs = calloc(size, sizeof(*batch->segs));
+    if (!batch->bufs || !batch->msgs || !batch->iovs || !batch->addrs || !batch->ctrls ||
+        !batch->segs)
+    {
+        fprintf(stderr, "Failed to allocate UDP batch of %u datagrams\n", size);
+        WcapUdpBatchDestroy(batch);
+        return false;
+    }
+
+    // Each message permanently owns one buffer, one iovec and one address
+    for (unsigned int i = 0; i < size; i++)
+    {
+        batch->iovs[i].iov_base = batch->bufs + (i * bufsiz);
+        batch->iovs[i].iov_len = bufsiz;
+        batch->msgs[i].msg_hdr.msg_iov = &batch->iovs[i];
+        batch->msgs[i].msg_hdr.msg_iovlen = 1;
+        batch->msgs[i].msg_hdr.msg_name = &batch->addrs[i];
+        batch->msgs[i].msg_hdr.msg_namelen = sizeof(batch->addrs[i]);
+    }
+
+    return true;
+}
+
+bool WcapUdpBatchDestroy(WcapUdpBatch_t* batch)
+{
+
+    if (!batch)
+    {
+        return false;
+    }
+
+    free(batch->bufs);
+    free(batch->msgs);
+    free(batch->iovs);
+    free(batch->addrs);
+    free(batch->ctrls);
+    free(batch->segs);
+    memset(batch, 0, sizeof(*batch));
+
+    return true;
+}
+
+bool WcapUdpBatchSetGso(WcapUdpBatch_t* batch, const size_t segsiz)
+{
+
+    if (!batch || !batch->msgs || !segsiz || (segsiz > UINT16_MAX) || (segsiz > batch->bufsiz))
+    {
+        return false;
+    }
+
+    // Segments are requested per message with a UDP_SEGMENT control message,
+    // so there is nothing to set on the socket itself
+    batch->segsiz = segsiz;
+
+    return true;
+}
+
+bool WcapUdpBatchSetGro(WcapUdpBatch_t* batch)
+{
+
+    int one = 1;
+
+    if (!batch || !batch->msgs)
+    {
+        return false;
+    }
+
+    if (setsockopt(batch->fd, SOL_UDP, UDP_GRO, &one, sizeof(one)) < 0)
+    {
+        fprintf(stderr, "Failed to enable UDP GRO: [%d] %s\n", errno, strerror(errno));
+        return false;
+    }
+
+    batch->gro = true;
+
+    return true;
+}
+
+bool WcapUdpBatchSetTstamp(WcapUdpBatch_t* batch)
+{
+
+    if (!batch || !batch->msgs || !WcapTstampEnable(batch->fd))
+    {
+        return false;
+    }
+
+    batch->tstamp = true;
+
+    return true;
+}
+
+int WcapUdpBatchRecv(WcapUdpBatch_t* batch)
+{
+
+    int cnt = 0;
+
+    if (!batch || !batch->msgs)
+    {
+        return -1;
+    }
+
+    for (unsigned int i = 0; i < batch->size; i++)
+    {
+        batch->iovs[i].iov_len = batch->bufsiz;
+        batch->msgs[i].msg_hdr.msg_namelen = sizeof(batch->addrs[i]);
+        batch->msgs[i].msg_hdr.msg_flags = 0;
+        batch->msgs[i].msg_len = 0;
+        if (batch->gro || batch->tstamp)
+        {
+            batch->msgs[i].msg_hdr.msg_control = batch->ctrls + (i * UDP_CTRL_SIZE);
+            batch->msgs[i].msg_hdr.msg_controllen = UDP_CTRL_SIZE;
+        }
+    }
+
+    batch->count = 0;
+
+    cnt = recvmmsg(batch->fd, batch->msgs, batch->size, MSG_DONTWAIT, NULL);
+    if (cnt < 0)
+    {
+        return ((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? 0 : -1;
+    }
+
+    for (int i = 0; i < cnt; i++)
+    {
+        if (batch->msgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+        {
+            batch->truncs++;
+        }
+    }
+
+    batch->count = cnt;
+
+    return cnt;
+}
+
+bool WcapUdpBatchGet(WcapUdpBatch_t* batch, const unsigned int idx, uint8_t** data, size_t* len,
+                     struct sockaddr_in** addr)
+{
+
+    if (!batch || (idx >= batch->count))
+    {
+        return false;
+    }
+
+    // Truncated datagrams cannot be forwarded intact
+    if (batch->msgs[idx].msg_hdr.msg_flags & MSG_TRUNC)
+    {
+        return false;
+    }
+
+    if (data)
+    {
+        *data = batch->iovs[idx].iov_base;
+    }
+    if (len)
+    {
+        *len = batch->msgs[idx].msg_len;
+    }
+    if (addr)
+    {
+        *addr = &batch->addrs[idx];
+    }
+
+    return true;
+}
+
+size_t WcapUdpBatchSegSize(WcapUdpBatch_t* batch, const unsigned int idx)
+{
+
+    struct msghdr* hdr = NULL;
+    struct cmsghdr* cmsg = NULL;
+    int segsiz = 0;
+
+    if (!batch || (idx >= batch->count))
+    {
+        return 0;
+    }
+
+    // A coalesced GRO buffer holds equally sized segments (the last one may be
+    // shorter); anything else is a single datagram
+    hdr = &batch->msgs[idx].msg_hdr;
+    if (batch->gro)
+    {
+        for (cmsg = CMSG_FIRSTHDR(hdr); cmsg; cmsg = CMSG_NXTHDR(hdr, cmsg))
+        {
+            if ((cmsg->cmsg_level == SOL_UDP) && (cmsg->cmsg_type == UDP_GRO))
+            {
+                memcpy(&segsiz, CMSG_DATA(cmsg), sizeof(segsiz));
+                if (segsiz > 0)
+                {
+                    return segsiz;
+                }
+            }
+        }
+    }
+
+    return batch->msgs[idx].msg_len;
+}
+
+uint64_t WcapUdpBatchTstamp(WcapUdpBatch_t* batch, const unsigned int idx)
+{
+
+    if (!batch || !batch->tstamp || (idx >= batch->count))
+    {
+        return 0;
+    }
+
+    return WcapTstampGet(&batch->msgs[idx].msg_hdr);
+}
+
+bool WcapUdpBatchAdd(WcapUdpBatch_t* batch, const void* data, const size_t len,
+                     const struct sockaddr_in* addr)
+{
+
+    unsigned int idx = 0;
+
+    if (!batch || !batch->msgs || !data || !addr)
+    {
+        return false;
+    }
+
+    if (len > batch->bufsiz)
+    {
+        batch->drops++;
+        return false;
+    }
+
+    // With GSO, append the datagram as another segment of the previous message
+    // when it is headed to the same peer, padding the previous segment out to
+    // the segment size; receivers ignore bytes past the last frame record
+    if (batch->segsiz && batch->count && (len <= batch->segsiz))
+    {
+        size_t off = 0;
+        idx = batch->count - 1;
+        off = batch->segs[idx] * batch->segsiz;
+        if (batch->segs[idx] && (batch->segs[idx] < WCAP_UDP_GSO_SEGS_MAX) &&
+            ((off + len) <= batch->bufsiz) && _same_addr(&batch->addrs[idx], addr))
+        {
+            uint8_t* base = batch->iovs[idx].iov_base;
+            memset(base + batch->iovs[idx].iov_len, 0, off - batch->iovs[idx].iov_len);
+            memcpy(base + off, data, len);
+            batch->iovs[idx].iov_len = off + len;
+            batch->segs[idx]++;
+            return true;
+        }
+    }
+
+    if (batch->count == batch->size)
+    {
+        WcapUdpBatchFlush(batch);
+    }
+
+    idx = batch->count++;
+    memcpy(batch->iovs[idx].iov_base, data, len);
+    batch->iovs[idx].iov_len = len;
+    batch->addrs[idx] = *addr;
+    batch->msgs[idx].msg_hdr.msg_namelen = sizeof(batch->addrs[idx]);
+
+    // Oversized datagrams travel on their own without segmentation
+    batch->segs[idx] = (batch->segsiz && (len <= batch->segsiz)) ? 1 : 0;
+
+    return true;
+}
+
+unsigned int WcapUdpBatchPrepare(WcapUdpBatch_t* batch)
+{
+
+    if (!batch || !batch->msgs)
+    {
+        return 0;
+    }
+
+    // Let the kernel split multi-segment messages back into datagrams
+    for (unsigned int i = 0; i < batch->count; i++)
+    {
+        struct msghdr* hdr = &batch->msgs[i].msg_hdr;
+        if (batch->segs[i] > 1)
+        {
+            struct cmsghdr* cmsg = NULL;
+            uint16_t segsiz = batch->segsiz;
+            hdr->msg_control = batch->ctrls + (i * UDP_CTRL_SIZE);
+            hdr->msg_controllen = CMSG_SPACE(sizeof(segsiz));
+            cmsg = CMSG_FIRSTHDR(hdr);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(segsiz));
+            memcpy(CMSG_DATA(cmsg), &segsiz, sizeof(segsiz));
+        }
+        else
+        {
+            hdr->msg_control = NULL;
+            hdr->msg_controllen = 0;
+        }
+    }
+
+    return batch->count;
+}
+
+int WcapUdpBatchFlush(WcapUdpBatch_t* batch)
+{
+
+    unsigned int idx = 0;
+    int sent = 0;
+    int cnt = 0;
+
+    if (!batch || !batch->msgs)
+    {
+        return -1;
+    }
+
+    WcapUdpBatchPrepare(batch);
+
+    while (idx < batch->count)
+    {
+        cnt = sendmmsg(batch->fd, &batch->msgs[idx], (batch->count - idx), MSG_DONTWAIT);
+        if (cnt < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == ENOBUFS))
+            {
+                batch->blocked++;
+                break;
+            }
+            // Skip the datagram the kernel refused and carry on with the rest
+            batch->drops++;
+            idx++;
+            continue;
+        }
+        idx += cnt;
+        sent += cnt;
+    }
+
+    // Anything left over could not be queued on the socket
+    batch->drops += (batch->count - idx);
+    batch->count = 0;
+
+    return sent;
+}
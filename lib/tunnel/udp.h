@@ -0,0 +1,78 @@
+/*
+ ============================================================================
+ Name        : udp.h
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet capture and forwarder
+ ============================================================================
+ */
+
+#ifndef _UDP_H_
+#define _UDP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#define WCAP_UDP_BATCH_DEF      32
+#define WCAP_UDP_BATCH_MAX      1024
+#define WCAP_UDP_BUF_SIZE       9216
+
+// Largest IPv4 UDP payload, the limit for a GSO super-buffer or GRO buffer
+#define WCAP_UDP_GSO_BUF_SIZE   65507
+#define WCAP_UDP_GSO_SEGS_MAX   64
+
+// Batch of datagrams received with one recvmmsg() or sent with one sendmmsg()
+typedef struct WcapUdpBatch
+{
+    int fd;
+    unsigned int size;
+    unsigned int count;
+    size_t bufsiz;
+    uint8_t* bufs;
+    struct mmsghdr* msgs;
+    struct iovec* iovs;
+    struct sockaddr_in* addrs;
+    uint8_t* ctrls;
+    unsigned int* segs;
+    size_t segsiz;
+    bool gro;
+    bool tstamp;
+    uint64_t drops;
+    uint64_t truncs;
+    // Flushes cut short by a full socket buffer
+    uint64_t blocked;
+} WcapUdpBatch_t;
+
+// Pick the SO_REUSEPORT group member for each datagram from the u8 found
+// 'offset' bytes into its payload, multiplied by 'stride'
+bool WcapUdpSteer(const int fd, const unsigned int offset, const unsigned int stride);
+
+bool WcapUdpBatchCreate(WcapUdpBatch_t* batch, const int fd, const unsigned int size,
+                        const size_t bufsiz);
+bool WcapUdpBatchDestroy(WcapUdpBatch_t* batch);
+
+bool WcapUdpBatchSetGso(WcapUdpBatch_t* batch, const size_t segsiz);
+bool WcapUdpBatchSetGro(WcapUdpBatch_t* batch);
+// Receive with kernel software timestamps, see WcapUdpBatchTstamp()
+bool WcapUdpBatchSetTstamp(WcapUdpBatch_t* batch);
+
+int WcapUdpBatchRecv(WcapUdpBatch_t* batch);
+bool WcapUdpBatchGet(WcapUdpBatch_t* batch, const unsigned int idx, uint8_t** data, size_t* len,
+                     struct sockaddr_in** addr);
+size_t WcapUdpBatchSegSize(WcapUdpBatch_t* batch, const unsigned int idx);
+// CLOCK_REALTIME nanoseconds the kernel received the message at, 0 if unknown
+uint64_t WcapUdpBatchTstamp(WcapUdpBatch_t* batch, const unsigned int idx);
+
+bool WcapUdpBatchAdd(WcapUdpBatch_t* batch, const void* data, const size_t len,
+                     const struct sockaddr_in* addr);
+int WcapUdpBatchFlush(WcapUdpBatch_t* batch);
+// Fill in the control messages of the queued messages so they can be sent by
+// other means than WcapUdpBatchFlush(); returns the number queued
+unsigned int WcapUdpBatchPrepare(WcapUdpBatch_t* batch);
+
+#endif /* _UDP_H_ */
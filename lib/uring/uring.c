@@ -0,0 +1,521 @@
+/*
+ ============================================================================
+ Name        : uring.c
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet concatenator
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "uring.h"
+
+static int _setup(const unsigned int entries, struct io_uring_params* params)
+{
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int _enter(const int fd, const unsigned int submit, const unsigned int wait,
+                  const unsigned int flags)
+{
+    return (int) syscall(__NR_io_uring_enter, fd, submit, wait, flags, NULL, 0);
+}
+
+static int _register(const int fd, const unsigned int opcode, void* arg, const unsigned int nargs)
+{
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nargs);
+}
+
+static void _skip_success(WcapUring_t* ring, struct io_uring_sqe* sqe)
+{
+    // Only failed sends are worth a completion
+    if (ring->features & IORING_FEAT_CQE_SKIP)
+    {
+        sqe->flags |= IOSQE_CQE_SKIP_SUCCESS;
+    }
+}
+
+bool WcapUringCreate(WcapUring_t* ring, const unsigned int entries)
+{
+
+    struct io_uring_params params = { 0 };
+    uint8_t* sq = NULL;
+    uint8_t* cq = NULL;
+
+    if (!ring || !entries)
+    {
+        return false;
+    }
+
+    memset(ring, 0, sizeof(*ring));
+
+    // Receives complete in bursts so the completion queue is made roomier.
+    // Cooperative task running is left off: it holds completions back until
+    // the ring is entered, and an event loop only enters once it is woken.
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 4;
+    ring->fd = _setup(entries, &params);
+    if (ring->fd < 0)
+    {
+        ring->fd = 0;
+        fprintf(stderr, "Failed to set up io_uring: [%d] %s\n", errno, strerror(errno));
+        return false;
+    }
+    ring->features = params.features;
+
+    ring->sqMapLen = params.sq_off.array + (params.sq_entries * sizeof(unsigned int));
+    ring->cqMapLen = params.cq_off.cqes + (params.cq_entries * sizeof(struct io_uring_cqe));
+    if (ring->features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (ring->cqMapLen > ring->sqMapLen)
+        {
+            ring->sqMapLen = ring->cqMapLen;
+        }
+        ring->cqMapLen = 0;
+    }
+
+    ring->sqMap = mmap(NULL, ring->sqMapLen, (PROT_READ | PROT_WRITE), (MAP_SHARED | MAP_POPULATE),
+                       ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sqMap == MAP_FAILED)
+    {
+        ring->sqMap = NULL;
+        goto exit_fail;
+    }
+
+    if (ring->cqMapLen)
+    {
+        ring->cqMap = mmap(NULL, ring->cqMapLen, (PROT_READ | PROT_WRITE),
+                           (MAP_SHARED | MAP_POPULATE), ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cqMap == MAP_FAILED)
+        {
+            ring->cqMap = NULL;
+            goto exit_fail;
+        }
+    }
+
+    ring->sqesLen = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqesLen, (PROT_READ | PROT_WRITE), (MAP_SHARED | MAP_POPULATE),
+                      ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+    {
+        ring->sqes = NULL;
+        goto exit_fail;
+    }
+
+    sq = ring->sqMap;
+    cq = ring->cqMap ? ring->cqMap : ring->sqMap;
+    ring->sqHead = (unsigned int*) (sq + params.sq_off.head);
+    ring->sqTail = (unsigned int*) (sq + params.sq_off.tail);
+    ring->sqArray = (unsigned int*) (sq + params.sq_off.array);
+    ring->sqMask = *(unsigned int*) (sq + params.sq_off.ring_mask);
+    ring->sqEntries = params.sq_entries;
+    ring->sqLocal = *ring->sqTail;
+    ring->cqHead = (unsigned int*) (cq + params.cq_off.head);
+    ring->cqTail = (unsigned int*) (cq + params.cq_off.tail);
+    ring->cqMask = *(unsigned int*) (cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*) (cq + params.cq_off.cqes);
+
+    // Entries are always submitted in order, so the indirection array is fixed
+    for (unsigned int i = 0; i < ring->sqEntries; i++)
+    {
+        ring->sqArray[i] = i;
+    }
+
+    return true;
+
+exit_fail:
+
+    fprintf(stderr, "Failed to map io_uring: [%d] %s\n", errno, strerror(errno));
+    WcapUringDestroy(ring);
+    return false;
+}
+
+bool WcapUringDestroy(WcapUring_t* ring)
+{
+
+    if (!ring)
+    {
+        return false;
+    }
+
+    if (ring->sqes)
+    {
+        munmap(ring->sqes, ring->sqesLen);
+    }
+    if (ring->cqMap)
+    {
+        munmap(ring->cqMap, ring->cqMapLen);
+    }
+    if (ring->sqMap)
+    {
+        munmap(ring->sqMap, ring->sqMapLen);
+    }
+    if (ring->fd > 0)
+    {
+        close(ring->fd);
+    }
+    memset(ring, 0, sizeof(*ring));
+
+    return true;
+}
+
+struct io_uring_sqe* WcapUringSqe(WcapUring_t* ring)
+{
+
+    struct io_uring_sqe* sqe = NULL;
+
+    if (!ring || !ring->sqes)
+    {
+        return NULL;
+    }
+
+    // Make room by handing what is queued to the kernel
+    if ((ring->sqLocal - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE)) >= ring->sqEntries)
+    {
+        WcapUringSubmit(ring, 0);
+        if ((ring->sqLocal - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE)) >= ring->sqEntries)
+        {
+            return NULL;
+        }
+    }
+
+    sqe = &ring->sqes[ring->sqLocal & ring->sqMask];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sqLocal++;
+
+    return sqe;
+}
+
+unsigned int WcapUringPending(WcapUring_t* ring)
+{
+    return (ring && ring->sqTail) ? (ring->sqLocal - *ring->sqTail) : 0;
+}
+
+int WcapUringSubmit(WcapUring_t* ring, const unsigned int wait)
+{
+
+    unsigned int submit = 0;
+    unsigned int flags = 0;
+    int ret = 0;
+
+    if (!ring || !ring->sqes)
+    {
+        return -1;
+    }
+
+    // Publish the new entries before the kernel is told about them
+    submit = WcapUringPending(ring);
+    __atomic_store_n(ring->sqTail, ring->sqLocal, __ATOMIC_RELEASE);
+
+    if (wait)
+    {
+        flags |= IORING_ENTER_GETEVENTS;
+    }
+
+    if (!submit && !flags)
+    {
+        return 0;
+    }
+
+    do
+    {
+        ret = _enter(ring->fd, submit, wait, flags);
+    } while ((ret < 0) && (errno == EINTR));
+
+    ring->enters++;
+    if (ret < 0)
+    {
+        fprintf(stderr, "Failed to enter io_uring: [%d] %s\n", errno, strerror(errno));
+        return -1;
+    }
+    ring->submitted += ret;
+
+    return ret;
+}
+
+struct io_uring_cqe* WcapUringPeek(WcapUring_t* ring)
+{
+
+    unsigned int head = 0;
+
+    if (!ring || !ring->cqes)
+    {
+        return NULL;
+    }
+
+    head = *ring->cqHead;
+    if (head == __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE))
+    {
+        return NULL;
+    }
+
+    return &ring->cqes[head & ring->cqMask];
+}
+
+void WcapUringSeen(WcapUring_t* ring)
+{
+    __atomic_store_n(ring->cqHead, (*ring->cqHead + 1), __ATOMIC_RELEASE);
+    ring->completed++;
+}
+
+bool WcapUringRecvMultishot(WcapUring_t* ring, const int fd, const uint16_t bgid,
+                            const uint64_t data)
+{
+
+    struct io_uring_sqe* sqe = WcapUringSqe(ring);
+
+    if (!sqe)
+    {
+        return false;
+    }
+
+    // Stays armed, posting a completion per packet until it runs out of buffers
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = bgid;
+    sqe->user_data = data;
+
+    return true;
+}
+
+bool WcapUringRecvmsgMultishot(WcapUring_t* ring, const int fd, struct msghdr* msg,
+                               const uint16_t bgid, const uint64_t data)
+{
+
+    struct io_uring_sqe* sqe = WcapUringSqe(ring);
+
+    if (!sqe)
+    {
+        return false;
+    }
+
+    // Only the name and control lengths of 'msg' are used, each buffer gets
+    // a struct io_uring_recvmsg_out followed by the name, control and payload
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t) (uintptr_t) msg;
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = bgid;
+    sqe->user_data = data;
+
+    return true;
+}
+
+bool WcapUringSend(WcapUring_t* ring, const int fd, const void* buf, const size_t len,
+                   const uint64_t data)
+{
+
+    struct io_uring_sqe* sqe = WcapUringSqe(ring);
+
+    if (!sqe)
+    {
+        return false;
+    }
+
+    // MSG_DONTWAIT fails a full socket instead of parking the request, so the
+    // send has either happened or failed by the time the ring is left and the
+    // buffer can be reused
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t) (uintptr_t) buf;
+    sqe->len = len;
+    sqe->msg_flags = MSG_DONTWAIT;
+    sqe->user_data = data;
+    _skip_success(ring, sqe);
+
+    return true;
+}
+
+bool WcapUringSendmsg(WcapUring_t* ring, const int fd, const struct msghdr* msg,
+                      const uint64_t data)
+{
+
+    struct io_uring_sqe* sqe = WcapUringSqe(ring);
+
+    if (!sqe)
+    {
+        return false;
+    }
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t) (uintptr_t) msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_DONTWAIT;
+    sqe->user_data = data;
+    _skip_success(ring, sqe);
+
+    return true;
+}
+
+bool WcapUringBufCreate(WcapUring_t* ring, WcapUringBufRing_t* bufs, const uint16_t bgid,
+                        const unsigned int count, const size_t bufsiz)
+{
+
+    struct io_uring_buf_reg reg = { 0 };
+    long page = sysconf(_SC_PAGESIZE);
+
+    if (!ring || !bufs || !count || (count > WCAP_URING_BUFS_MAX) || (count & (count - 1)) ||
+        !bufsiz)
+    {
+        return false;
+    }
+
+    memset(bufs, 0, sizeof(*bufs));
+    bufs->bufsiz = bufsiz;
+    bufs->count = count;
+    bufs->mask = count - 1;
+    bufs->bgid = bgid;
+
+    // The ring shared with the kernel has to be page aligned
+    bufs->brLen = ((count * sizeof(struct io_uring_buf)) + page - 1) & ~(page - 1);
+    bufs->br = mmap(NULL, bufs->brLen, (PROT_READ | PROT_WRITE), (MAP_PRIVATE | MAP_ANONYMOUS),
+                    -1, 0);
+    if (bufs->br == MAP_FAILED)
+    {
+        bufs->br = NULL;
+        fprintf(stderr, "Failed to allocate io_uring buffer ring: [%d] %s\n", errno, strerror(errno));
+        return false;
+    }
+
+    bufs->bufs = calloc(count, bufsiz);
+    if (!bufs->bufs)
+    {
+        fprintf(stderr, "Failed to allocate %u io_uring buffers of %zu bytes\n", count, bufsiz);
+        WcapUringBufDestroy(ring, bufs);
+        return false;
+    }
+
+    reg.ring_addr = (uint64_t) (uintptr_t) bufs->br;
+    reg.ring_entries = count;
+    reg.bgid = bgid;
+    if (_register(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        fprintf(stderr, "Failed to register io_uring buffer ring: [%d] %s\n", errno, strerror(errno));
+        free(bufs->bufs);
+        munmap(bufs->br, bufs->brLen);
+        memset(bufs, 0, sizeof(*bufs));
+        return false;
+    }
+
+    // Every buffer starts out available to the kernel
+    for (unsigned int i = 0; i < count; i++)
+    {
+        struct io_uring_buf* buf = &bufs->br->bufs[i];
+        buf->addr = (uint64_t) (uintptr_t) (bufs->bufs + (i * bufsiz));
+        buf->len = bufsiz;
+        buf->bid = i;
+    }
+    bufs->tail = count;
+    WcapUringBufCommit(bufs);
+
+    return true;
+}
+
+bool WcapUringBufDestroy(WcapUring_t* ring, WcapUringBufRing_t* bufs)
+{
+
+    struct io_uring_buf_reg reg = { 0 };
+
+    if (!bufs)
+    {
+        return false;
+    }
+
+    if (bufs->br)
+    {
+        if (ring && (ring->fd > 0) && bufs->bufs)
+        {
+            reg.bgid = bufs->bgid;
+            _register(ring->fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+        }
+        munmap(bufs->br, bufs->brLen);
+    }
+    free(bufs->bufs);
+    memset(bufs, 0, sizeof(*bufs));
+
+    return true;
+}
+
+uint8_t* WcapUringBufGet(WcapUringBufRing_t* bufs, const struct io_uring_cqe* cqe)
+{
+
+    unsigned int bid = 0;
+
+    if (!bufs || !bufs->bufs || !cqe || !(cqe->flags & IORING_CQE_F_BUFFER))
+    {
+        return NULL;
+    }
+
+    bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+    return (bid < bufs->count) ? (bufs->bufs + (bid * bufs->bufsiz)) : NULL;
+}
+
+void WcapUringBufRecycle(WcapUringBufRing_t* bufs, const struct io_uring_cqe* cqe)
+{
+
+    struct io_uring_buf* buf = NULL;
+    unsigned int bid = 0;
+
+    if (!bufs || !bufs->br || !cqe || !(cqe->flags & IORING_CQE_F_BUFFER))
+    {
+        return;
+    }
+
+    bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+    buf = &bufs->br->bufs[bufs->tail & bufs->mask];
+    buf->addr = (uint64_t) (uintptr_t) (bufs->bufs + (bid * bufs->bufsiz));
+    buf->len = bufs->bufsiz;
+    buf->bid = bid;
+    bufs->tail++;
+}
+
+void WcapUringBufCommit(WcapUringBufRing_t* bufs)
+{
+    if (bufs && bufs->br)
+    {
+        __atomic_store_n(&bufs->br->tail, bufs->tail, __ATOMIC_RELEASE);
+    }
+}
+
+bool WcapUringMsgParse(const struct msghdr* msg, uint8_t* buf, const int res, WcapUringMsg_t* out)
+{
+
+    struct io_uring_recvmsg_out* hdr = (struct io_uring_recvmsg_out*) buf;
+    size_t off = sizeof(*hdr) + msg->msg_namelen + msg->msg_controllen;
+
+    if (!buf || (res < 0) || ((size_t) res < off) || !out)
+    {
+        return false;
+    }
+
+    memset(out, 0, sizeof(*out));
+    out->name = (struct sockaddr*) (buf + sizeof(*hdr));
+    out->namelen = (hdr->namelen < msg->msg_namelen) ? hdr->namelen : msg->msg_namelen;
+    out->ctrl = hdr->controllen ? (struct cmsghdr*) (buf + sizeof(*hdr) + msg->msg_namelen) : NULL;
+    out->ctrllen = (hdr->controllen < msg->msg_controllen) ? hdr->controllen : msg->msg_controllen;
+    out->data = buf + off;
+    out->len = res - off;
+    out->flags = hdr->flags;
+
+    // A payload longer than the buffer was cut short
+    if (hdr->payloadlen > out->len)
+    {
+        out->flags |= MSG_TRUNC;
+    }
+
+    return true;
+}
@@ -0,0 +1,112 @@
+/*
+ ============================================================================
+ Name        : uring.h
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet capture and forwarder
+ ============================================================================
+ */
+
+#ifndef _URING_H_
+#define _URING_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sys/socket.h>
+#include <linux/io_uring.h>
+
+#define WCAP_URING_ENTRIES_DEF  256
+#define WCAP_URING_BUFS_DEF     256
+#define WCAP_URING_BUFS_MAX     32768
+
+// Minimal io_uring instance driven with raw syscalls. The ring file
+// descriptor becomes readable while completions are waiting, so it can sit
+// in an event loop next to timers and signals.
+typedef struct WcapUring
+{
+    int fd;
+    unsigned int features;
+    void* sqMap;
+    size_t sqMapLen;
+    void* cqMap;
+    size_t cqMapLen;
+    struct io_uring_sqe* sqes;
+    size_t sqesLen;
+    unsigned int* sqHead;
+    unsigned int* sqTail;
+    unsigned int* sqArray;
+    unsigned int sqMask;
+    unsigned int sqEntries;
+    unsigned int sqLocal;
+    unsigned int* cqHead;
+    unsigned int* cqTail;
+    unsigned int cqMask;
+    struct io_uring_cqe* cqes;
+    uint64_t enters;
+    uint64_t submitted;
+    uint64_t completed;
+} WcapUring_t;
+
+// Ring of equally sized buffers the kernel picks from for multishot receives;
+// buffers handed back are only republished by WcapUringBufCommit()
+typedef struct WcapUringBufRing
+{
+    struct io_uring_buf_ring* br;
+    size_t brLen;
+    uint8_t* bufs;
+    size_t bufsiz;
+    unsigned int count;
+    unsigned int mask;
+    uint16_t bgid;
+    uint16_t tail;
+    uint64_t exhausted;
+} WcapUringBufRing_t;
+
+// Layout of a multishot recvmsg() completion within its buffer
+typedef struct WcapUringMsg
+{
+    struct sockaddr* name;
+    unsigned int namelen;
+    struct cmsghdr* ctrl;
+    unsigned int ctrllen;
+    uint8_t* data;
+    size_t len;
+    unsigned int flags;
+} WcapUringMsg_t;
+
+bool WcapUringCreate(WcapUring_t* ring, const unsigned int entries);
+bool WcapUringDestroy(WcapUring_t* ring);
+
+// Next free submission entry, pending entries are submitted if the queue is full
+struct io_uring_sqe* WcapUringSqe(WcapUring_t* ring);
+// Hand every pending entry to the kernel in one io_uring_enter(), optionally
+// waiting for 'wait' completions
+int WcapUringSubmit(WcapUring_t* ring, const unsigned int wait);
+unsigned int WcapUringPending(WcapUring_t* ring);
+
+struct io_uring_cqe* WcapUringPeek(WcapUring_t* ring);
+void WcapUringSeen(WcapUring_t* ring);
+
+bool WcapUringRecvMultishot(WcapUring_t* ring, const int fd, const uint16_t bgid,
+                            const uint64_t data);
+bool WcapUringRecvmsgMultishot(WcapUring_t* ring, const int fd, struct msghdr* msg,
+                               const uint16_t bgid, const uint64_t data);
+bool WcapUringSend(WcapUring_t* ring, const int fd, const void* buf, const size_t len,
+                   const uint64_t data);
+bool WcapUringSendmsg(WcapUring_t* ring, const int fd, const struct msghdr* msg,
+                      const uint64_t data);
+
+bool WcapUringBufCreate(WcapUring_t* ring, WcapUringBufRing_t* bufs, const uint16_t bgid,
+                        const unsigned int count, const size_t bufsiz);
+bool WcapUringBufDestroy(WcapUring_t* ring, WcapUringBufRing_t* bufs);
+uint8_t* WcapUringBufGet(WcapUringBufRing_t* bufs, const struct io_uring_cqe* cqe);
+void WcapUringBufRecycle(WcapUringBufRing_t* bufs, const struct io_uring_cqe* cqe);
+void WcapUringBufCommit(WcapUringBufRing_t* bufs);
+
+// Split a recvmsg() completion laid out against 'msg' into its parts
+bool WcapUringMsgParse(const struct msghdr* msg, uint8_t* buf, const int res, WcapUringMsg_t* out);
+
+#endif /* _URING_H_ */
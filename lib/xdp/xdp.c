@@ -0,0 +1,218 @@
+/*
+ ============================================================================
+ Name        : xdp.c
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet concatenator
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <sys/syscall.h>
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/if_link.h>
+
+#include "xdp.h"
+
+// Raw eBPF instruction encodings, there being no libbpf to lean on
+#define INSN(c, d, s, o, i)     ((struct bpf_insn) { .code = (c), .dst_reg = (d), \
+                                                     .src_reg = (s), .off = (o), .imm = (i) })
+#define MOV64_REG(d, s)         INSN(BPF_ALU64 | BPF_MOV | BPF_X, d, s, 0, 0)
+#define MOV64_IMM(d, i)         INSN(BPF_ALU64 | BPF_MOV | BPF_K, d, 0, 0, i)
+#define ADD64_IMM(d, i)         INSN(BPF_ALU64 | BPF_ADD | BPF_K, d, 0, 0, i)
+#define AND64_IMM(d, i)         INSN(BPF_ALU64 | BPF_AND | BPF_K, d, 0, 0, i)
+#define LDX_MEM(sz, d, s, o)    INSN(BPF_LDX | BPF_MEM | (sz), d, s, o, 0)
+#define JGT_REG(d, s, o)        INSN(BPF_JMP | BPF_JGT | BPF_X, d, s, o, 0)
+#define JNE_IMM(d, i, o)        INSN(BPF_JMP | BPF_JNE | BPF_K, d, 0, o, i)
+#define LD_MAP_FD(d, fd)        INSN(BPF_LD | BPF_DW | BPF_IMM, d, BPF_PSEUDO_MAP_FD, 0, fd), \
+                                INSN(0, 0, 0, 0, 0)
+#define CALL(f)                 INSN(BPF_JMP | BPF_CALL, 0, 0, 0, f)
+#define EXIT()                  INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0)
+
+// Ethernet, IPv4 without options and UDP headers
+#define XDP_HDR_LEN             42
+
+static int _bpf(const int cmd, union bpf_attr* attr)
+{
+    return (int) syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+static int _load(const int mapfd, const uint16_t port)
+{
+
+    // Matches IPv4 (no options, not fragmented) UDP to 'port'; the fallback
+    // action of bpf_redirect_map() passes the frame when the queue it came
+    // in on has no socket
+    struct bpf_insn code[] =
+    {
+        /*  0 */ MOV64_REG(BPF_REG_6, BPF_REG_1),
+        /*  1 */ LDX_MEM(BPF_W, BPF_REG_2, BPF_REG_6, offsetof(struct xdp_md, data_end)),
+        /*  2 */ LDX_MEM(BPF_W, BPF_REG_3, BPF_REG_6, offsetof(struct xdp_md, data)),
+        /*  3 */ MOV64_REG(BPF_REG_4, BPF_REG_3),
+        /*  4 */ ADD64_IMM(BPF_REG_4, XDP_HDR_LEN),
+        /*  5 */ JGT_REG(BPF_REG_4, BPF_REG_2, 17),
+        /*  6 */ LDX_MEM(BPF_H, BPF_REG_5, BPF_REG_3, 12),
+        /*  7 */ JNE_IMM(BPF_REG_5, htons(ETH_P_IP), 15),
+        /*  8 */ LDX_MEM(BPF_B, BPF_REG_5, BPF_REG_3, 14),
+        /*  9 */ JNE_IMM(BPF_REG_5, 0x45, 13),
+        /* 10 */ LDX_MEM(BPF_B, BPF_REG_5, BPF_REG_3, 23),
+        /* 11 */ JNE_IMM(BPF_REG_5, IPPROTO_UDP, 11),
+        /* 12 */ LDX_MEM(BPF_H, BPF_REG_5, BPF_REG_3, 20),
+        /* 13 */ AND64_IMM(BPF_REG_5, htons(0x3fff)),
+        /* 14 */ JNE_IMM(BPF_REG_5, 0, 8),
+        /* 15 */ LDX_MEM(BPF_H, BPF_REG_5, BPF_REG_3, 36),
+        /* 16 */ JNE_IMM(BPF_REG_5, htons(port), 6),
+        /* 17 */ LD_MAP_FD(BPF_REG_1, mapfd),
+        /* 19 */ LDX_MEM(BPF_W, BPF_REG_2, BPF_REG_6, offsetof(struct xdp_md, rx_queue_index)),
+        /* 20 */ MOV64_IMM(BPF_REG_3, XDP_PASS),
+        /* 21 */ CALL(BPF_FUNC_redirect_map),
+        /* 22 */ EXIT(),
+        /* 23 */ MOV64_IMM(BPF_REG_0, XDP_PASS),
+        /* 24 */ EXIT()
+    };
+    static char log[4096];
+    union bpf_attr attr = { 0 };
+    int fd = -1;
+
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insns = (uint64_t) (uintptr_t) code;
+    attr.insn_cnt = sizeof(code) / sizeof(code[0]);
+    attr.license = (uint64_t) (uintptr_t) "GPL";
+    attr.log_buf = (uint64_t) (uintptr_t) log;
+    attr.log_size = sizeof(log);
+    attr.log_level = 1;
+    snprintf(attr.prog_name, sizeof(attr.prog_name), "wcap_xdp");
+
+    fd = _bpf(BPF_PROG_LOAD, &attr);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to load XDP program: [%d] %s\n%s", errno, strerror(errno), log);
+    }
+
+    return fd;
+}
+
+static int _link(const int progfd, const unsigned int ifindex, const unsigned int flags)
+{
+
+    union bpf_attr attr = { 0 };
+
+    attr.link_create.prog_fd = progfd;
+    attr.link_create.target_ifindex = ifindex;
+    attr.link_create.attach_type = BPF_XDP;
+    attr.link_create.flags = flags;
+
+    return _bpf(BPF_LINK_CREATE, &attr);
+}
+
+bool WcapXdpProgAttach(WcapXdpProg_t* prog, const unsigned int ifindex, const uint16_t port)
+{
+
+    union bpf_attr attr = { 0 };
+
+    if (!prog || !ifindex)
+    {
+        return false;
+    }
+
+    memset(prog, 0, sizeof(*prog));
+    prog->progFd = prog->mapFd = prog->linkFd = -1;
+    prog->ifindex = ifindex;
+
+    attr.map_type = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size = sizeof(uint32_t);
+    attr.value_size = sizeof(uint32_t);
+    attr.max_entries = WCAP_XDP_QUEUE_MAX;
+    prog->mapFd = _bpf(BPF_MAP_CREATE, &attr);
+    if (prog->mapFd < 0)
+    {
+        fprintf(stderr, "Failed to create XSK map: [%d] %s\n", errno, strerror(errno));
+        goto exit_fail;
+    }
+
+    prog->progFd = _load(prog->mapFd, port);
+    if (prog->progFd < 0)
+    {
+        goto exit_fail;
+    }
+
+    // Prefer the driver hook and settle for the generic one; the link is
+    // released, and the program detached, when the descriptor is closed
+    prog->linkFd = _link(prog->progFd, ifindex, XDP_FLAGS_DRV_MODE);
+    if (prog->linkFd < 0)
+    {
+        prog->linkFd = _link(prog->progFd, ifindex, XDP_FLAGS_SKB_MODE);
+        prog->generic = true;
+    }
+    if (prog->linkFd < 0)
+    {
+        fprintf(stderr, "Failed to attach XDP program: [%d] %s\n", errno, strerror(errno));
+        goto exit_fail;
+    }
+
+    return true;
+
+exit_fail:
+
+    WcapXdpProgDetach(prog);
+    return false;
+}
+
+bool WcapXdpProgDetach(WcapXdpProg_t* prog)
+{
+
+    if (!prog)
+    {
+        return false;
+    }
+
+    if (prog->linkFd > 0)
+    {
+        close(prog->linkFd);
+    }
+    if (prog->progFd > 0)
+    {
+        close(prog->progFd);
+    }
+    if (prog->mapFd > 0)
+    {
+        close(prog->mapFd);
+    }
+    memset(prog, 0, sizeof(*prog));
+
+    return true;
+}
+
+bool WcapXdpProgSetSocket(WcapXdpProg_t* prog, const unsigned int queue, const int fd)
+{
+
+    union bpf_attr attr = { 0 };
+    uint32_t key = queue;
+    uint32_t val = fd;
+
+    if (!prog || (prog->mapFd <= 0) || (queue >= WCAP_XDP_QUEUE_MAX) || (fd < 0))
+    {
+        return false;
+    }
+
+    attr.map_fd = prog->mapFd;
+    attr.key = (uint64_t) (uintptr_t) &key;
+    attr.value = (uint64_t) (uintptr_t) &val;
+    attr.flags = BPF_ANY;
+    if (_bpf(BPF_MAP_UPDATE_ELEM, &attr) < 0)
+    {
+        fprintf(stderr, "Failed to add socket to XSK map: [%d] %s\n", errno, strerror(errno));
+        return false;
+    }
+
+    return true;
+}
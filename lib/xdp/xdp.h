@@ -0,0 +1,37 @@
+/*
+ ============================================================================
+ Name        : xdp.h
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet capture and forwarder
+ ============================================================================
+ */
+
+#ifndef _XDP_H_
+#define _XDP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Receive queues an XSKMAP can hold sockets for
+#define WCAP_XDP_QUEUE_MAX      64
+
+// XDP program handing the UDP datagrams for one port to AF_XDP sockets, by
+// receive queue; everything else, and traffic arriving on a queue without a
+// socket, goes on to the kernel stack as usual
+typedef struct WcapXdpProg
+{
+    int progFd;
+    int mapFd;
+    int linkFd;
+    unsigned int ifindex;
+    bool generic;
+} WcapXdpProg_t;
+
+bool WcapXdpProgAttach(WcapXdpProg_t* prog, const unsigned int ifindex, const uint16_t port);
+bool WcapXdpProgDetach(WcapXdpProg_t* prog);
+
+bool WcapXdpProgSetSocket(WcapXdpProg_t* prog, const unsigned int queue, const int fd);
+
+#endif /* _XDP_H_ */
@@ -0,0 +1,506 @@
+/*
+ ============================================================================
+ Name        : xsk.c
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet concatenator
+ ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <linux/if_xdp.h>
+
+#include "xsk.h"
+
+#ifndef AF_XDP
+#define AF_XDP      44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP     283
+#endif
+
+// How often the kernel is prodded into resolving an unknown peer
+#define XSK_ARP_INTERVAL_NS     1000000000ULL
+
+static uint64_t _now(void)
+{
+    struct timespec ts = { 0 };
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static bool _ring_map(const int fd, WcapXskRing_t* ring, const struct xdp_ring_offset* off,
+                      const uint32_t size, const size_t descsiz, const uint64_t pgoff)
+{
+    uint8_t* base = NULL;
+
+    ring->mapLen = off->desc + (size * descsiz);
+    ring->map = mmap(NULL, ring->mapLen, (PROT_READ | PROT_WRITE), (MAP_SHARED | MAP_POPULATE),
+                     fd, pgoff);
+    if (ring->map == MAP_FAILED)
+    {
+        ring->map = NULL;
+        fprintf(stderr, "Failed to map AF_XDP ring: [%d] %s\n", errno, strerror(errno));
+        return false;
+    }
+
+    base = ring->map;
+    ring->producer = (uint32_t*) (base + off->producer);
+    ring->consumer = (uint32_t*) (base + off->consumer);
+    ring->flags = (uint32_t*) (base + off->flags);
+    ring->descs = base + off->desc;
+    ring->size = size;
+    ring->mask = size - 1;
+
+    return true;
+}
+
+static void _ring_unmap(WcapXskRing_t* ring)
+{
+    if (ring->map)
+    {
+        munmap(ring->map, ring->mapLen);
+    }
+    memset(ring, 0, sizeof(*ring));
+}
+
+static uint16_t _csum(const void* data, size_t len)
+{
+    const uint16_t* p = data;
+    uint32_t sum = 0;
+
+    for (; len > 1; len -= 2)
+    {
+        sum += *p++;
+    }
+    if (len)
+    {
+        sum += *(const uint8_t*) p;
+    }
+    while (sum >> 16)
+    {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+
+    return (uint16_t) ~sum;
+}
+
+static WcapXskNeigh_t* _neigh(WcapXsk_t* xsk, const uint32_t ip)
+{
+    for (unsigned int i = 0; i < WCAP_XSK_NEIGH_MAX; i++)
+    {
+        if (xsk->neigh[i].ip == ip)
+        {
+            return &xsk->neigh[i];
+        }
+    }
+    return NULL;
+}
+
+static WcapXskNeigh_t* _learn(WcapXsk_t* xsk, const uint32_t ip, const uint8_t* hwaddr)
+{
+    WcapXskNeigh_t* neigh = _neigh(xsk, ip);
+
+    // Oldest entry goes first when the table is full
+    if (!neigh)
+    {
+        neigh = &xsk->neigh[xsk->neighNext++ % WCAP_XSK_NEIGH_MAX];
+        memset(neigh, 0, sizeof(*neigh));
+        neigh->ip = ip;
+    }
+    if (hwaddr)
+    {
+        memcpy(neigh->hwaddr, hwaddr, ETH_ALEN);
+        neigh->valid = true;
+    }
+
+    return neigh;
+}
+
+static const uint8_t* _resolve(WcapXsk_t* xsk, const struct sockaddr_in* dst)
+{
+    WcapXskNeigh_t* neigh = _neigh(xsk, dst->sin_addr.s_addr);
+    struct arpreq req = { 0 };
+    struct sockaddr_in* pa = (struct sockaddr_in*) &req.arp_pa;
+    struct sockaddr_in prod = *dst;
+    uint64_t now = 0;
+
+    if (neigh && neigh->valid)
+    {
+        return neigh->hwaddr;
+    }
+
+    // Peers that have not spoken yet may already be in the kernel's cache
+    pa->sin_family = AF_INET;
+    pa->sin_addr = dst->sin_addr;
+    snprintf(req.arp_dev, sizeof(req.arp_dev), "%s", xsk->ifname);
+    if ((ioctl(xsk->arpSock, SIOCGARP, &req) == 0) && (req.arp_flags & ATF_COM))
+    {
+        return _learn(xsk, dst->sin_addr.s_addr, (uint8_t*) req.arp_ha.sa_data)->hwaddr;
+    }
+
+    // Otherwise have the kernel ask, by sending it something for the peer's
+    // discard port, and try again later
+    neigh = _learn(xsk, dst->sin_addr.s_addr, NULL);
+    now = _now();
+    if ((now - neigh->asked) >= XSK_ARP_INTERVAL_NS)
+    {
+        prod.sin_port = htons(9);
+        sendto(xsk->arpSock, "", 0, MSG_DONTWAIT, (struct sockaddr*) &prod, sizeof(prod));
+        neigh->asked = now;
+    }
+
+    return NULL;
+}
+
+static void _complete(WcapXsk_t* xsk)
+{
+    WcapXskRing_t* comp = &xsk->comp;
+    uint32_t prod = __atomic_load_n(comp->producer, __ATOMIC_ACQUIRE);
+
+    // Transmitted frames are free to be filled again
+    while (comp->local != prod)
+    {
+        xsk->txFree[xsk->txFreeCount++] = ((uint64_t*) comp->descs)[comp->local & comp->mask];
+        comp->local++;
+    }
+    __atomic_store_n(comp->consumer, comp->local, __ATOMIC_RELEASE);
+}
+
+bool WcapXskCreate(WcapXsk_t* xsk, const char* ifname, const unsigned int queue,
+                   const unsigned int frames, const bool copy)
+{
+
+    struct xdp_umem_reg reg = { 0 };
+    struct xdp_mmap_offsets off = { 0 };
+    struct xdp_options opts = { 0 };
+    struct sockaddr_xdp addr = { 0 };
+    socklen_t len = sizeof(off);
+    uint32_t half = frames / 2;
+
+    if (!xsk || !ifname || (frames < 2) || (frames > WCAP_XSK_FRAME_COUNT_MAX) ||
+        (frames & (frames - 1)))
+    {
+        return false;
+    }
+
+    memset(xsk, 0, sizeof(*xsk));
+    snprintf(xsk->ifname, sizeof(xsk->ifname), "%s", ifname);
+    xsk->queue = queue;
+    xsk->frames = frames;
+
+    addr.sxdp_family = AF_XDP;
+    addr.sxdp_ifindex = if_nametoindex(ifname);
+    addr.sxdp_queue_id = queue;
+    if (!addr.sxdp_ifindex)
+    {
+        fprintf(stderr, "Failed to find interface: %s\n", ifname);
+        return false;
+    }
+
+    // The lower half of the UMEM receives, the upper half transmits
+    xsk->umemLen = (size_t) frames * WCAP_XSK_FRAME_SIZE;
+    xsk->umem = mmap(NULL, xsk->umemLen, (PROT_READ | PROT_WRITE), (MAP_PRIVATE | MAP_ANONYMOUS),
+                     -1, 0);
+    xsk->txFree = calloc(half, sizeof(*xsk->txFree));
+    if (xsk->umem == MAP_FAILED)
+    {
+        xsk->umem = NULL;
+    }
+    if (!xsk->umem || !xsk->txFree)
+    {
+        fprintf(stderr, "Failed to allocate UMEM of %u frames\n", frames);
+        goto exit_fail;
+    }
+
+    xsk->fd = socket(AF_XDP, SOCK_RAW, 0);
+    if (xsk->fd < 0)
+    {
+        xsk->fd = 0;
+        fprintf(stderr, "Failed to open AF_XDP socket: [%d] %s\n", errno, strerror(errno));
+        goto exit_fail;
+    }
+
+    reg.addr = (uint64_t) (uintptr_t) xsk->umem;
+    reg.len = xsk->umemLen;
+    reg.chunk_size = WCAP_XSK_FRAME_SIZE;
+    if ((setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) < 0) ||
+        (setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_FILL_RING, &half, sizeof(half)) < 0) ||
+        (setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &half, sizeof(half)) < 0) ||
+        (setsockopt(xsk->fd, SOL_XDP, XDP_RX_RING, &half, sizeof(half)) < 0) ||
+        (setsockopt(xsk->fd, SOL_XDP, XDP_TX_RING, &half, sizeof(half)) < 0) ||
+        (getsockopt(xsk->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &len) < 0))
+    {
+        fprintf(stderr, "Failed to set up AF_XDP rings: [%d] %s\n", errno, strerror(errno));
+        goto exit_fail;
+    }
+
+    if (!_ring_map(xsk->fd, &xsk->rx, &off.rx, half, sizeof(struct xdp_desc), XDP_PGOFF_RX_RING) ||
+        !_ring_map(xsk->fd, &xsk->tx, &off.tx, half, sizeof(struct xdp_desc), XDP_PGOFF_TX_RING) ||
+        !_ring_map(xsk->fd, &xsk->fill, &off.fr, half, sizeof(uint64_t),
+                   XDP_UMEM_PGOFF_FILL_RING) ||
+        !_ring_map(xsk->fd, &xsk->comp, &off.cr, half, sizeof(uint64_t),
+                   XDP_UMEM_PGOFF_COMPLETION_RING))
+    {
+        goto exit_fail;
+    }
+
+    // Every receive frame starts out with the kernel
+    for (uint32_t i = 0; i < half; i++)
+    {
+        ((uint64_t*) xsk->fill.descs)[i] = (uint64_t) i * WCAP_XSK_FRAME_SIZE;
+        xsk->txFree[i] = (uint64_t) (half + i) * WCAP_XSK_FRAME_SIZE;
+    }
+    xsk->fill.local = half;
+    xsk->txFreeCount = half;
+    __atomic_store_n(xsk->fill.producer, xsk->fill.local, __ATOMIC_RELEASE);
+
+    // Zero-copy needs driver support, copy mode works anywhere (veth included)
+    addr.sxdp_flags = XDP_USE_NEED_WAKEUP | (copy ? XDP_COPY : XDP_ZEROCOPY);
+    if (bind(xsk->fd, (struct sockaddr*) &addr, sizeof(addr)) < 0)
+    {
+        addr.sxdp_flags = XDP_USE_NEED_WAKEUP | XDP_COPY;
+        if (copy || (bind(xsk->fd, (struct sockaddr*) &addr, sizeof(addr)) < 0))
+        {
+            fprintf(stderr, "Failed to bind AF_XDP socket to %s queue %u: [%d] %s\n", ifname,
+                            queue, errno, strerror(errno));
+            goto exit_fail;
+        }
+    }
+
+    len = sizeof(opts);
+    if (getsockopt(xsk->fd, SOL_XDP, XDP_OPTIONS, &opts, &len) == 0)
+    {
+        xsk->zerocopy = (opts.flags & XDP_OPTIONS_ZEROCOPY);
+    }
+
+    // Used to look up and prod the kernel's ARP cache
+    xsk->arpSock = socket(AF_INET, (SOCK_DGRAM | SOCK_NONBLOCK), 0);
+    if (xsk->arpSock < 0)
+    {
+        xsk->arpSock = 0;
+        fprintf(stderr, "Failed to open ARP socket: [%d] %s\n", errno, strerror(errno));
+        goto exit_fail;
+    }
+    setsockopt(xsk->arpSock, SOL_SOCKET, SO_BINDTODEVICE, ifname, strlen(ifname));
+
+    return true;
+
+exit_fail:
+
+    WcapXskDestroy(xsk);
+    return false;
+}
+
+bool WcapXskDestroy(WcapXsk_t* xsk)
+{
+
+    if (!xsk)
+    {
+        return false;
+    }
+
+    _ring_unmap(&xsk->rx);
+    _ring_unmap(&xsk->tx);
+    _ring_unmap(&xsk->fill);
+    _ring_unmap(&xsk->comp);
+    if (xsk->fd > 0)
+    {
+        close(xsk->fd);
+    }
+    if (xsk->arpSock > 0)
+    {
+        close(xsk->arpSock);
+    }
+    if (xsk->umem)
+    {
+        munmap(xsk->umem, xsk->umemLen);
+    }
+    free(xsk->txFree);
+    memset(xsk, 0, sizeof(*xsk));
+
+    return true;
+}
+
+void WcapXskSetSource(WcapXsk_t* xsk, const uint8_t* hwaddr, const struct sockaddr_in* src)
+{
+    memcpy(xsk->hwaddr, hwaddr, ETH_ALEN);
+    xsk->src = *src;
+}
+
+bool WcapXskRecv(WcapXsk_t* xsk, const uint8_t** data, size_t* len, struct sockaddr_in* src)
+{
+
+    WcapXskRing_t* rx = &xsk->rx;
+    uint32_t prod = __atomic_load_n(rx->producer, __ATOMIC_ACQUIRE);
+
+    while (rx->local != prod)
+    {
+        struct xdp_desc* desc = &((struct xdp_desc*) rx->descs)[rx->local & rx->mask];
+        uint8_t* frame = xsk->umem + desc->addr;
+        struct ethhdr* eth = (struct ethhdr*) frame;
+        struct iphdr* ip = (struct iphdr*) (frame + sizeof(*eth));
+        struct udphdr* udp = NULL;
+        size_t hlen = 0;
+        size_t ulen = 0;
+
+        rx->local++;
+
+        // The frame goes back on the fill ring, though the kernel only sees
+        // it once released
+        ((uint64_t*) xsk->fill.descs)[xsk->fill.local++ & xsk->fill.mask] =
+            desc->addr & ~((uint64_t) WCAP_XSK_FRAME_SIZE - 1);
+
+        if ((desc->len < WCAP_XSK_HDR_SIZE) || (eth->h_proto != htons(ETH_P_IP)) ||
+            (ip->version != 4) || (ip->ihl < 5) || (ip->protocol != IPPROTO_UDP))
+        {
+            xsk->rxInvalid++;
+            continue;
+        }
+
+        hlen = sizeof(*eth) + (ip->ihl * 4) + sizeof(*udp);
+        udp = (struct udphdr*) (frame + sizeof(*eth) + (ip->ihl * 4));
+        ulen = ntohs(udp->len);
+        if ((hlen > desc->len) || (udp->dest != xsk->src.sin_port) || (ulen < sizeof(*udp)) ||
+            ((hlen - sizeof(*udp) + ulen) > desc->len))
+        {
+            xsk->rxInvalid++;
+            continue;
+        }
+
+        // Remember where the peer is so replies need no ARP
+        _learn(xsk, ip->saddr, eth->h_source);
+
+        src->sin_family = AF_INET;
+        src->sin_addr.s_addr = ip->saddr;
+        src->sin_port = udp->source;
+        *data = frame + hlen;
+        *len = ulen - sizeof(*udp);
+        xsk->rxPackets++;
+
+        return true;
+    }
+
+    return false;
+}
+
+void WcapXskRelease(WcapXsk_t* xsk)
+{
+    __atomic_store_n(xsk->rx.consumer, xsk->rx.local, __ATOMIC_RELEASE);
+    __atomic_store_n(xsk->fill.producer, xsk->fill.local, __ATOMIC_RELEASE);
+
+    // Without a busy driver, the kernel has to be told there is room again
+    if (__atomic_load_n(xsk->fill.flags, __ATOMIC_RELAXED) & XDP_RING_NEED_WAKEUP)
+    {
+        recvfrom(xsk->fd, NULL, 0, MSG_DONTWAIT, NULL, NULL);
+    }
+}
+
+bool WcapXskSend(WcapXsk_t* xsk, const void* data, const size_t len,
+                 const struct sockaddr_in* dst)
+{
+
+    const uint8_t* hwaddr = NULL;
+    struct xdp_desc* desc = NULL;
+    uint8_t* frame = NULL;
+    struct ethhdr* eth = NULL;
+    struct iphdr* ip = NULL;
+    struct udphdr* udp = NULL;
+    uint64_t addr = 0;
+
+    if (!xsk || !xsk->fd || !data || !dst || (len > WCAP_XSK_PAYLOAD_MAX))
+    {
+        return false;
+    }
+
+    hwaddr = _resolve(xsk, dst);
+    if (!hwaddr)
+    {
+        xsk->unresolved++;
+        return false;
+    }
+
+    if (!xsk->txFreeCount)
+    {
+        _complete(xsk);
+    }
+    if (!xsk->txFreeCount ||
+        ((xsk->tx.local - __atomic_load_n(xsk->tx.consumer, __ATOMIC_ACQUIRE)) >= xsk->tx.size))
+    {
+        xsk->txDrops++;
+        return false;
+    }
+
+    addr = xsk->txFree[--xsk->txFreeCount];
+    frame = xsk->umem + addr;
+    eth = (struct ethhdr*) frame;
+    ip = (struct iphdr*) (frame + sizeof(*eth));
+    udp = (struct udphdr*) (frame + sizeof(*eth) + sizeof(*ip));
+
+    memcpy(eth->h_dest, hwaddr, ETH_ALEN);
+    memcpy(eth->h_source, xsk->hwaddr, ETH_ALEN);
+    eth->h_proto = htons(ETH_P_IP);
+
+    memset(ip, 0, sizeof(*ip));
+    ip->version = 4;
+    ip->ihl = 5;
+    ip->tot_len = htons(sizeof(*ip) + sizeof(*udp) + len);
+    ip->id = htons(xsk->ipId++);
+    ip->frag_off = htons(IP_DF);
+    ip->ttl = 64;
+    ip->protocol = IPPROTO_UDP;
+    ip->saddr = xsk->src.sin_addr.s_addr;
+    ip->daddr = dst->sin_addr.s_addr;
+    ip->check = _csum(ip, sizeof(*ip));
+
+    // A zero UDP checksum means none over IPv4
+    udp->source = xsk->src.sin_port;
+    udp->dest = dst->sin_port;
+    udp->len = htons(sizeof(*udp) + len);
+    udp->check = 0;
+
+    memcpy(frame + WCAP_XSK_HDR_SIZE, data, len);
+
+    desc = &((struct xdp_desc*) xsk->tx.descs)[xsk->tx.local++ & xsk->tx.mask];
+    desc->addr = addr;
+    desc->len = WCAP_XSK_HDR_SIZE + len;
+    desc->options = 0;
+    xsk->txPending++;
+
+    return true;
+}
+
+void WcapXskFlush(WcapXsk_t* xsk)
+{
+    if (!xsk || !xsk->txPending)
+    {
+        return;
+    }
+
+    __atomic_store_n(xsk->tx.producer, xsk->tx.local, __ATOMIC_RELEASE);
+    xsk->txPackets += xsk->txPending;
+    xsk->txPending = 0;
+
+    // Copy mode always transmits from sendto(), zero-copy only when asked to
+    if (__atomic_load_n(xsk->tx.flags, __ATOMIC_RELAXED) & XDP_RING_NEED_WAKEUP)
+    {
+        sendto(xsk->fd, NULL, 0, MSG_DONTWAIT, NULL, 0);
+    }
+
+    _complete(xsk);
+}
@@ -0,0 +1,104 @@
+/*
+ ============================================================================
+ Name        : xsk.h
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet capture and forwarder
+ ============================================================================
+ */
+
+#ifndef _XSK_H_
+#define _XSK_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <netinet/in.h>
+#include <linux/if_ether.h>
+
+// Frames of the UMEM shared with the kernel, half of them receive and half
+// transmit; each holds a whole Ethernet frame
+#define WCAP_XSK_FRAME_SIZE         4096
+#define WCAP_XSK_FRAME_COUNT_DEF    4096
+#define WCAP_XSK_FRAME_COUNT_MAX    65536
+
+// Ethernet, IPv4 (no options) and UDP headers built and parsed in user space
+#define WCAP_XSK_HDR_SIZE           42
+#define WCAP_XSK_PAYLOAD_MAX        (WCAP_XSK_FRAME_SIZE - WCAP_XSK_HDR_SIZE)
+
+#define WCAP_XSK_NEIGH_MAX          64
+
+// One of the four single producer, single consumer rings shared with the kernel
+typedef struct WcapXskRing
+{
+    void* map;
+    size_t mapLen;
+    uint32_t* producer;
+    uint32_t* consumer;
+    uint32_t* flags;
+    void* descs;
+    uint32_t mask;
+    uint32_t size;
+    uint32_t local;
+} WcapXskRing_t;
+
+// Peer hardware address, learned from received frames or the ARP cache
+typedef struct WcapXskNeigh
+{
+    uint32_t ip;
+    uint8_t hwaddr[ETH_ALEN];
+    bool valid;
+    uint64_t asked;
+} WcapXskNeigh_t;
+
+// AF_XDP socket on one receive queue, carrying UDP datagrams to and from
+// 'src' without the kernel's IP stack. Only the thread owning the datapath
+// may use it.
+typedef struct WcapXsk
+{
+    int fd;
+    int arpSock;
+    char ifname[16];
+    unsigned int queue;
+    bool zerocopy;
+    uint8_t* umem;
+    size_t umemLen;
+    unsigned int frames;
+    WcapXskRing_t rx;
+    WcapXskRing_t tx;
+    WcapXskRing_t fill;
+    WcapXskRing_t comp;
+    uint64_t* txFree;
+    unsigned int txFreeCount;
+    unsigned int txPending;
+    uint8_t hwaddr[ETH_ALEN];
+    struct sockaddr_in src;
+    uint16_t ipId;
+    WcapXskNeigh_t neigh[WCAP_XSK_NEIGH_MAX];
+    unsigned int neighNext;
+    uint64_t rxPackets;
+    uint64_t rxInvalid;
+    uint64_t txPackets;
+    uint64_t txDrops;
+    uint64_t unresolved;
+} WcapXsk_t;
+
+bool WcapXskCreate(WcapXsk_t* xsk, const char* ifname, const unsigned int queue,
+                   const unsigned int frames, const bool copy);
+bool WcapXskDestroy(WcapXsk_t* xsk);
+
+// Address and port datagrams are sent from and received on
+void WcapXskSetSource(WcapXsk_t* xsk, const uint8_t* hwaddr, const struct sockaddr_in* src);
+
+// Next datagram received; its payload stays valid until WcapXskRelease()
+bool WcapXskRecv(WcapXsk_t* xsk, const uint8_t** data, size_t* len, struct sockaddr_in* src);
+void WcapXskRelease(WcapXsk_t* xsk);
+
+// Queue a datagram; fails while the peer's hardware address is unresolved
+bool WcapXskSend(WcapXsk_t* xsk, const void* data, const size_t len,
+                 const struct sockaddr_in* dst);
+void WcapXskFlush(WcapXsk_t* xsk);
+
+#endif /* _XSK_H_ */
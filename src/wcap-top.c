@@ -0,0 +1,403 @@
+/*
+ ============================================================================
+ Name        : wcap-top.c
+ Author      : Kevin Mahoney <kevin.mahoney@zenotec.net>
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Wireless packet concatenator
+ ============================================================================
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <libgen.h>
+#include <getopt.h>
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stats.h"
+
+#define SHM_DIR     "/dev/shm"
+
+static struct wcaptop_opts
+{
+    unsigned int interval;
+    unsigned int count;
+    bool all;
+} gOpts = {
+    .interval = 1,
+    .count = 0,
+    .all = false
+};
+
+static void usage(const char* name)
+{
+    fprintf(stdout, "Shows the datapath counters a running wcap publishes in shared memory\n\n");
+    fprintf(stdout, "Usage: %s [-h] [-i SECS] [-n COUNT] [-a] [NAME | PID]\n", name);
+    fprintf(stdout, "\t-h        \tDisplay usage\n");
+    fprintf(stdout, "\t-i SECS   \tRefresh every SECS seconds (default: 1)\n");
+    fprintf(stdout, "\t-n COUNT  \tStop after COUNT refreshes (default: 0, never)\n");
+    fprintf(stdout, "\t-a        \tShow counters that are still zero\n");
+    fprintf(stdout, "\tNAME | PID\tRegion given to wcap --stats-shm, or the pid of a wcap\n");
+    fprintf(stdout, "\t          \t  using the default; needed only when several are running\n");
+}
+
+static bool parse_uint(const char* str, unsigned int* val)
+{
+    char* end = NULL;
+    unsigned long v = 0;
+
+    errno = 0;
+    v = strtoul(str, &end, 0);
+    if (errno || (end == str) || *end || (v > 0xffffffffUL))
+    {
+        return false;
+    }
+    *val = v;
+
+    return true;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts = { 0 };
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+// The only region of a wcap in /dev/shm, when there is exactly one
+static bool find_region(char* name, const size_t len)
+{
+    DIR* dir = opendir(SHM_DIR);
+    struct dirent* ent = NULL;
+    unsigned int found = 0;
+
+    if (!dir)
+    {
+        fprintf(stderr, "Failed to open %s: [%d] %s\n", SHM_DIR, errno, strerror(errno));
+        return false;
+    }
+
+    while ((ent = readdir(dir)))
+    {
+        if (strncmp(ent->d_name, WCAP_STATS_PREFIX, strlen(WCAP_STATS_PREFIX)))
+        {
+            continue;
+        }
+        if (!found++)
+        {
+            snprintf(name, len, "%s", ent->d_name);
+            continue;
+        }
+        if (found == 2)
+        {
+            fprintf(stderr, "Several wcap are running, pick one of: %s", name);
+        }
+        fprintf(stderr, " %s", ent->d_name);
+    }
+    closedir(dir);
+
+    if (found > 1)
+    {
+        fprintf(stderr, "\n");
+        return false;
+    }
+    if (!found)
+    {
+        fprintf(stderr, "No wcap statistics found in %s\n", SHM_DIR);
+        return false;
+    }
+
+    return true;
+}
+
+static void print_counter(const WcapStats_t* st, const unsigned int ctr, const uint64_t val,
+                          const uint64_t prev, const double secs)
+{
+    if (!val && !gOpts.all)
+    {
+        return;
+    }
+
+    if (secs > 0)
+    {
+        fprintf(stdout, "  %-28s %20llu %14.1f/s\n", st->hdr->names[ctr], (unsigned long long) val,
+                        (double) (val - prev) / secs);
+    }
+    else
+    {
+        fprintf(stdout, "  %-28s %20llu\n", st->hdr->names[ctr], (unsigned long long) val);
+    }
+}
+
+// Latency percentiles in microseconds, of histograms that have samples
+static void print_hists(const WcapStats_t* st, const WcapStatsHist_t* hists)
+{
+    static const double pcts[] = { 50.0, 90.0, 99.0, 99.9 };
+
+    for (unsigned int h = 0; h < st->hdr->histCount; h++)
+    {
+        const WcapStatsHist_t* hist = &hists[h];
+
+        if (!hist->count)
+        {
+            continue;
+        }
+
+        fprintf(stdout, "  %-28s %20llu  mean %.1f", st->hdr->histNames[h],
+                        (unsigned long long) hist->count,
+                        ((double) hist->sum / hist->count) / 1000.0);
+        for (unsigned int p = 0; p < (sizeof(pcts) / sizeof(pcts[0])); p++)
+        {
+            fprintf(stdout, "  p%g %.1f", pcts[p],
+                            (double) WcapStatsHistPercentile(hist, pcts[p]) / 1000.0);
+        }
+        fprintf(stdout, "  max %.1f us", (double) hist->max / 1000.0);
+        if (hist->skewed)
+        {
+            fprintf(stdout, "  (%llu skewed)", (unsigned long long) hist->skewed);
+        }
+        fprintf(stdout, "\n");
+    }
+}
+
+static void print_region(const WcapStats_t* st, uint64_t* prev, WcapStatsHist_t* hists,
+                         const double secs)
+{
+    const WcapStatsHdr_t* hdr = st->hdr;
+    uint64_t* total = prev + ((size_t) hdr->slotCount * hdr->counterCount);
+    uint64_t* totalPrev = total + hdr->counterCount;
+    uint64_t* sum = totalPrev + hdr->counterCount;
+    struct timespec ts = { 0 };
+    unsigned int datapaths = 0;
+    uint64_t up = 0;
+
+    // Slots of a datapath may be written by several threads, each its own
+    for (unsigned int i = 0; i < hdr->slotCount; i++)
+    {
+        const WcapStatsSlot_t* slot = WcapStatsSlot(st, i);
+        if ((slot->datapath < hdr->slotCount) && (slot->datapath >= datapaths))
+        {
+            datapaths = slot->datapath + 1;
+        }
+    }
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    up = (((ts.tv_sec * 1000000000ULL) + ts.tv_nsec) - hdr->start) / 1000000000ULL;
+    fprintf(stdout, "%s: pid %d, up %llu:%02llu:%02llu, %u datapaths\n", (st->name + 1), hdr->pid,
+                    (unsigned long long) (up / 3600), (unsigned long long) ((up / 60) % 60),
+                    (unsigned long long) (up % 60), datapaths);
+
+    WcapStatsHist_t* totalHists = hists + hdr->histCount;
+
+    memcpy(totalPrev, total, (hdr->counterCount * sizeof(*total)));
+    memset(total, 0, (hdr->counterCount * sizeof(*total)));
+    memset(totalHists, 0, (hdr->histCount * sizeof(*totalHists)));
+
+    for (unsigned int d = 0; d < datapaths; d++)
+    {
+        uint64_t* last = prev + ((size_t) d * hdr->counterCount);
+        bool named = false;
+
+        memset(sum, 0, (hdr->counterCount * sizeof(*sum)));
+        // Snapshot first, the writers keep going while this one prints
+        memset(hists, 0, (hdr->histCount * sizeof(*hists)));
+
+        for (unsigned int i = 0; i < hdr->slotCount; i++)
+        {
+            const WcapStatsSlot_t* slot = WcapStatsSlot(st, i);
+
+            if (slot->datapath != d)
+            {
+                continue;
+            }
+            if (!named)
+            {
+                char name[WCAP_STATS_NAME_LEN];
+
+                memcpy(name, slot->name, sizeof(name));
+                name[sizeof(name) - 1] = 0;
+                fprintf(stdout, "\n%s\n", name);
+                named = true;
+            }
+            for (unsigned int c = 0; c < hdr->counterCount; c++)
+            {
+                sum[c] += WcapStatsGet(slot, c);
+            }
+            for (unsigned int h = 0; h < hdr->histCount; h++)
+            {
+                WcapStatsHistMerge(&hists[h], &slot->hists[h]);
+            }
+        }
+        if (!named)
+        {
+            continue;
+        }
+
+        for (unsigned int c = 0; c < hdr->counterCount; c++)
+        {
+            if (hdr->names[c][0])
+            {
+                print_counter(st, c, sum[c], last[c], secs);
+            }
+            last[c] = sum[c];
+            total[c] += sum[c];
+        }
+        for (unsigned int h = 0; h < hdr->histCount; h++)
+        {
+            WcapStatsHistMerge(&totalHists[h], &hists[h]);
+        }
+        print_hists(st, hists);
+    }
+
+    if (datapaths > 1)
+    {
+        fprintf(stdout, "\ntotal\n");
+        for (unsigned int c = 0; c < hdr->counterCount; c++)
+        {
+            if (hdr->names[c][0])
+            {
+                print_counter(st, c, total[c], totalPrev[c], secs);
+            }
+        }
+        print_hists(st, totalHists);
+    }
+}
+
+int main(int argc, char** argv)
+{
+
+    WcapStats_t st = { 0 };
+    char name[NAME_MAX + 1] = { 0 };
+    uint64_t* prev = NULL;
+    WcapStatsHist_t* hists = NULL;
+    uint64_t last = 0;
+    bool tty = isatty(STDOUT_FILENO);
+    int opt = 0;
+
+    while ((opt = getopt(argc, argv, "hi:n:a")) != -1)
+    {
+        switch (opt)
+        {
+            case 'h':
+            {
+                usage(basename(argv[0]));
+                return 0;
+            }
+            case 'i':
+            {
+                if (!parse_uint(optarg, &gOpts.interval) || !gOpts.interval)
+                {
+                    fprintf(stderr, "Invalid interval: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            case 'n':
+            {
+                if (!parse_uint(optarg, &gOpts.count))
+                {
+                    fprintf(stderr, "Invalid count: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            case 'a':
+            {
+                gOpts.all = true;
+                break;
+            }
+            default:
+            {
+                usage(basename(argv[0]));
+                return 1;
+            }
+        }
+    }
+
+    if ((argc - optind) > 1)
+    {
+        usage(basename(argv[0]));
+        return 1;
+    }
+
+    // A bare number is the pid of a wcap using the default name
+    if (optind < argc)
+    {
+        const char* arg = argv[optind];
+        bool pid = *arg;
+
+        for (const char* p = arg; *p; p++)
+        {
+            pid &= (isdigit((unsigned char) *p) != 0);
+        }
+        snprintf(name, sizeof(name), "%s%s", (pid ? WCAP_STATS_PREFIX : ""), arg);
+    }
+    else if (!find_region(name, sizeof(name)))
+    {
+        return 1;
+    }
+
+    if (!WcapStatsOpen(&st, name))
+    {
+        return 1;
+    }
+
+    // Last values of every datapath, then the totals and their last values,
+    // then the sum of the datapath being printed
+    prev = calloc(((size_t) st.hdr->slotCount + 3) * st.hdr->counterCount, sizeof(*prev));
+    // Latency snapshots of one datapath, then the totals
+    hists = aligned_alloc(WCAP_STATS_LINE, (2 * WCAP_STATS_HIST_MAX * sizeof(*hists)));
+    if (!prev || !hists)
+    {
+        fprintf(stderr, "Failed to allocate counters\n");
+        free(prev);
+        free(hists);
+        WcapStatsDestroy(&st);
+        return 1;
+    }
+
+    for (unsigned int n = 0; !gOpts.count || (n < gOpts.count); n++)
+    {
+        uint64_t now = 0;
+        bool alive = false;
+
+        if (n)
+        {
+            sleep(gOpts.interval);
+        }
+        now = now_ns();
+        alive = WcapStatsAlive(&st);
+
+        if (tty)
+        {
+            fprintf(stdout, "\033[H\033[2J");
+        }
+        print_region(&st, prev, hists, n ? ((double) (now - last) / 1000000000.0) : 0.0);
+        last = now;
+
+        // What is left behind is the final word
+        if (!alive)
+        {
+            fprintf(stdout, "\nwcap (pid %d) is no longer running\n", st.hdr->pid);
+            break;
+        }
+        if (!tty)
+        {
+            fprintf(stdout, "\n");
+        }
+        fflush(stdout);
+    }
+
+    free(hists);
+    free(prev);
+    WcapStatsDestroy(&st);
+
+    return 0;
+}
@@ -12,596 +12,4198 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <unistd.h>
 #include <string.h>
 #include <libgen.h>
-#include <poll.h>
+#include <getopt.h>
 #include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
 
+#include <sys/prctl.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
 #include <linux/if_packet.h>
 #include <linux/if_ether.h>
+#include <linux/filter.h>
+#include <linux/sock_diag.h>
 
 #include "iface.h"
 #include "nl80211.h"
+#include "rxring.h"
+#include "txring.h"
+#include "fanout.h"
+#include "filter.h"
+#include "radiotap.h"
+#include "tstamp.h"
+#include "udp.h"
+#include "encap.h"
+#include "session.h"
+#include "suppress.h"
+#include "compress.h"
+#include "seq.h"
+#include "event.h"
+#include "spsc.h"
+#include "pool.h"
+#include "uring.h"
+#include "xdp.h"
+#include "xsk.h"
+#include "pcapng.h"
+#include "replay.h"
+#include "stats.h"
+#include "log.h"
 
-static struct wcap_ctx
+// Which sessions receive captured frames
+enum
+{
+    SESSION_SEND_ALL,
+    SESSION_SEND_TUNNEL
+};
+
+// How the datapath waits for and moves packets
+enum
+{
+    IO_EPOLL,
+    IO_URING
+};
+
+// What becomes of the radiotap header of captured frames on the tunnel
+enum
+{
+    RADIOTAP_KEEP,
+    RADIOTAP_STRIP,
+    RADIOTAP_COMPACT
+};
+
+// What becomes of unchanged beacons and probes
+enum
+{
+    SUPPRESS_OFF,
+    SUPPRESS_REPEAT,
+    SUPPRESS_DROP
+};
+
+static struct wcap_opts
+{
+    bool rxRing;
+    unsigned int rxBlockSize;
+    unsigned int rxBlockCount;
+    unsigned int rxRetireMs;
+    bool txRing;
+    unsigned int txFrameSize;
+    unsigned int txFrameCount;
+    unsigned int txBatch;
+    bool txBypass;
+    unsigned int batch;
+    unsigned int aggSize;
+    unsigned int aggDelay;
+    bool udpGso;
+    bool udpGro;
+    bool threads;
+    int cpus[WCAP_FANOUT_MAX];
+    unsigned int cpuCount;
+    unsigned int ringSize;
+    unsigned int statsInterval;
+    const char* statsShm;
+    bool latency;
+    unsigned int logRing;
+    unsigned int poolFrames;
+    bool poolHuge;
+    bool lowLatency;
+    unsigned int busyPoll;
+    unsigned int busyPollBudget;
+    bool preferBusyPoll;
+    unsigned int spinUs;
+    unsigned int schedFifo;
+    unsigned int fanout;
+    WcapFanoutMode_t fanoutMode;
+    unsigned int maxSessions;
+    unsigned int sessionIdle;
+    int sessionSend;
+    int io;
+    unsigned int uringBufs;
+    bool xdp;
+    unsigned int xdpQueue;
+    unsigned int xdpFrames;
+    bool xdpCopy;
+    int radiotap;
+    int suppress;
+    unsigned int suppressEntries;
+    unsigned int suppressRefresh;
+    bool compress;
+    unsigned int compressMin;
+    unsigned int reorder;
+    unsigned int reorderDelay;
+    const char* record;
+    unsigned int recordSize;
+    unsigned int recordTime;
+    unsigned int recordBuffer;
+    bool recordDirect;
+    bool replayTimed;
+    unsigned int replayLoops;
+} gOpts = {
+    .rxRing = false,
+    .rxBlockSize = WCAP_RXRING_BLOCK_SIZE_DEF,
+    .rxBlockCount = WCAP_RXRING_BLOCK_COUNT_DEF,
+    .rxRetireMs = WCAP_RXRING_RETIRE_MS_DEF,
+    .txRing = false,
+    .txFrameSize = WCAP_TXRING_FRAME_SIZE_DEF,
+    .txFrameCount = WCAP_TXRING_FRAME_COUNT_DEF,
+    .txBatch = WCAP_TXRING_BATCH_DEF,
+    .txBypass = false,
+    .batch = WCAP_UDP_BATCH_DEF,
+    .aggSize = 0,
+    .aggDelay = 0,
+    .udpGso = false,
+    .udpGro = false,
+    .threads = false,
+    .cpuCount = 0,
+    .ringSize = WCAP_SPSC_COUNT_DEF,
+    .statsInterval = 0,
+    .statsShm = NULL,
+    .latency = false,
+    .logRing = WCAP_LOG_COUNT_DEF,
+    .poolFrames = 0,
+    .poolHuge = false,
+    .lowLatency = false,
+    .busyPoll = 0,
+    .busyPollBudget = 0,
+    .preferBusyPoll = false,
+    .spinUs = 0,
+    .schedFifo = 0,
+    .fanout = 1,
+    .fanoutMode = WCAP_FANOUT_TA,
+    .maxSessions = WCAP_SESSION_MAX_DEF,
+    .sessionIdle = WCAP_SESSION_IDLE_DEF,
+    .sessionSend = SESSION_SEND_ALL,
+    .io = IO_EPOLL,
+    .uringBufs = WCAP_URING_BUFS_DEF,
+    .xdp = false,
+    .xdpQueue = 0,
+    .xdpFrames = WCAP_XSK_FRAME_COUNT_DEF,
+    .xdpCopy = false,
+    .radiotap = RADIOTAP_KEEP,
+    .suppress = SUPPRESS_OFF,
+    .suppressEntries = WCAP_SUPPRESS_ENTRIES_DEF,
+    .suppressRefresh = WCAP_SUPPRESS_REFRESH_DEF,
+    .compress = false,
+    .compressMin = WCAP_COMPRESS_MIN_DEF,
+    .reorder = 0,
+    .reorderDelay = WCAP_SEQ_REORDER_DELAY_DEF,
+    .record = NULL,
+    .recordSize = 0,
+    .recordTime = 0,
+    .recordBuffer = (WCAP_PCAPNG_BUF_SIZE_DEF >> 20),
+    .recordDirect = false,
+    .replayTimed = true,
+    .replayLoops = 1
+};
+
+// Threads of the pipeline mode, in the order --cpu-list assigns them
+enum
+{
+    THREAD_RAW_RX,
+    THREAD_UDP_TX,
+    THREAD_UDP_RX,
+    THREAD_RAW_TX,
+    THREAD_MAX
+};
+
+// Tags of io_uring requests, receives double as their buffer group IDs
+enum
+{
+    URING_RAW_RECV = 1,
+    URING_UDP_RECV,
+    URING_RAW_SEND,
+    URING_UDP_SEND
+};
+
+// Sockets and state moving frames in both directions for one radio; each
+// radio has one per fanout worker, so radios never share a datapath
+struct wcap_path
 {
+    unsigned int id;
+    uint16_t tunnel;
     int udpSock;
-    int udpSockIdx;
-    struct sockaddr_in udpAddr;
+    WcapUdpBatch_t udpRx;
+    WcapUdpBatch_t udpTx;
+    WcapEncap_t encap;
+    int aggTimer;
+    bool aggArmed;
     int rawSock;
-    int rawSockIdx;
     struct sockaddr_ll rawAddr;
-    struct sockaddr_in dstAddr;
+    WcapRxRing_t rxRing;
+    // Capture allocates from one cache, the pipeline's encapsulation thread
+    // frees to the other
+    WcapPoolCache_t rxCache;
+    WcapPoolCache_t txCache;
+    WcapPoolBuf_t* rxBuf;
+    int txSock;
+    WcapTxRing_t txRing;
+    WcapStatsSlot_t* stats;
+    // Drops only the kernel knows of, polled by the main thread
+    WcapStatsSlot_t* kstats;
+    int64_t radiotapSaved;
+    WcapSuppress_t suppressTx;
+    WcapSuppress_t suppressRx;
+    // Last gCtx.suppressEpoch the sent frames were forgotten at
+    unsigned int suppressEpoch;
+    WcapCompress_t compress;
+    WcapCompress_t decompress;
+    WcapSeqReorder_t reorder;
+    int reorderTimer;
+    uint64_t reorderDeadline;
+    WcapPcapng_t record;
+    WcapUring_t uring;
+    WcapUringBufRing_t rawBufs;
+    WcapUringBufRing_t udpBufs;
+    struct msghdr udpMsg;
+    uint64_t uringSendErrs;
+    WcapXsk_t xsk;
+};
+
+struct wcap_thread
+{
+    char name[24];
+    pthread_t tid;
+    bool started;
+    bool status;
+    WcapEventLoop_t loop;
+    struct wcap_path* path;
+    WcapStatsSlot_t* stats;
+    bool flush;
+};
+
+static struct wcap_ctx
+{
+    WcapEventLoop_t loop;
+    struct sockaddr_in udpAddr;
+    WcapXdpProg_t xdp;
+    WcapFilter_t filter;
+    WcapSessionTable_t sessions;
+    // Bumped when a peer may lack the frames suppressed so far, a new one or
+    // one that asked for them again; and set to ask the peers in turn
+    unsigned int suppressEpoch;
+    bool suppressResend;
+    unsigned int radioCount;
+    struct wcap_path* paths;
+    unsigned int pathCount;
+    WcapSpsc_t rawRing;
+    WcapSpsc_t udpRing;
+    WcapPool_t pool;
+    struct wcap_thread* threads;
+    unsigned int threadCount;
+    WcapReplay_t replay;
+    int replayTimer;
+    WcapStats_t stats;
 } gCtx = { 0 };
 
+// Session table reader of the running thread, 0 being the main thread
+static __thread unsigned int tReader = 0;
+
+// Counter slot of a pipeline thread, which shares its datapath with the
+// others; datapaths run by a single thread count in their own
+static __thread WcapStatsSlot_t* tStats = NULL;
+
+static inline WcapStatsSlot_t* path_stats(const struct wcap_path* path)
+{
+    return tStats ? tStats : path->stats;
+}
+
+enum
+{
+    OPT_RX_RING = 256,
+    OPT_RX_BLOCK_SIZE,
+    OPT_RX_BLOCK_COUNT,
+    OPT_RX_RETIRE_MS,
+    OPT_TX_RING,
+    OPT_TX_FRAME_SIZE,
+    OPT_TX_FRAME_COUNT,
+    OPT_TX_BATCH,
+    OPT_TX_QDISC_BYPASS,
+    OPT_BATCH,
+    OPT_AGG_SIZE,
+    OPT_AGG_DELAY,
+    OPT_UDP_GSO,
+    OPT_UDP_GRO,
+    OPT_THREADS,
+    OPT_CPU_LIST,
+    OPT_RING_SIZE,
+    OPT_STATS_INTERVAL,
+    OPT_STATS_SHM,
+    OPT_LATENCY,
+    OPT_LOG_LEVEL,
+    OPT_LOG_RING,
+    OPT_POOL_FRAMES,
+    OPT_POOL_HUGE,
+    OPT_LOW_LATENCY,
+    OPT_BUSY_POLL,
+    OPT_BUSY_POLL_BUDGET,
+    OPT_PREFER_BUSY_POLL,
+    OPT_SPIN_US,
+    OPT_SCHED_FIFO,
+    OPT_FANOUT,
+    OPT_FANOUT_MODE,
+    OPT_MAX_SESSIONS,
+    OPT_SESSION_IDLE,
+    OPT_SESSION_SEND,
+    OPT_IO,
+    OPT_URING_BUFS,
+    OPT_XDP,
+    OPT_XDP_QUEUE,
+    OPT_XDP_FRAMES,
+    OPT_XDP_COPY,
+    OPT_FILTER_DUMP,
+    OPT_RADIOTAP,
+    OPT_SUPPRESS,
+    OPT_SUPPRESS_ENTRIES,
+    OPT_SUPPRESS_REFRESH,
+    OPT_COMPRESS,
+    OPT_COMPRESS_MIN,
+    OPT_REORDER,
+    OPT_REORDER_DELAY,
+    OPT_RECORD,
+    OPT_RECORD_SIZE,
+    OPT_RECORD_TIME,
+    OPT_RECORD_BUFFER,
+    OPT_RECORD_DIRECT,
+    OPT_REPLAY_SPEED,
+    OPT_REPLAY_LOOP
+};
+
+static const struct option gLongOpts[] =
+{
+    { "help", no_argument, NULL, 'h' },
+    { "server", no_argument, NULL, 's' },
+    { "client", required_argument, NULL, 'c' },
+    { "filter", required_argument, NULL, 'f' },
+    { "filter-dump", no_argument, NULL, OPT_FILTER_DUMP },
+    { "rx-ring", no_argument, NULL, OPT_RX_RING },
+    { "rx-block-size", required_argument, NULL, OPT_RX_BLOCK_SIZE },
+    { "rx-block-count", required_argument, NULL, OPT_RX_BLOCK_COUNT },
+    { "rx-retire-ms", required_argument, NULL, OPT_RX_RETIRE_MS },
+    { "tx-ring", no_argument, NULL, OPT_TX_RING },
+    { "tx-frame-size", required_argument, NULL, OPT_TX_FRAME_SIZE },
+    { "tx-frame-count", required_argument, NULL, OPT_TX_FRAME_COUNT },
+    { "tx-batch", required_argument, NULL, OPT_TX_BATCH },
+    { "tx-qdisc-bypass", no_argument, NULL, OPT_TX_QDISC_BYPASS },
+    { "batch", required_argument, NULL, OPT_BATCH },
+    { "agg-size", required_argument, NULL, OPT_AGG_SIZE },
+    { "agg-delay-us", required_argument, NULL, OPT_AGG_DELAY },
+    { "udp-gso", no_argument, NULL, OPT_UDP_GSO },
+    { "udp-gro", no_argument, NULL, OPT_UDP_GRO },
+    { "threads", no_argument, NULL, OPT_THREADS },
+    { "cpu-list", required_argument, NULL, OPT_CPU_LIST },
+    { "ring-size", required_argument, NULL, OPT_RING_SIZE },
+    { "stats-interval", required_argument, NULL, OPT_STATS_INTERVAL },
+    { "stats-shm", required_argument, NULL, OPT_STATS_SHM },
+    { "latency", no_argument, NULL, OPT_LATENCY },
+    { "log-level", required_argument, NULL, OPT_LOG_LEVEL },
+    { "log-ring", required_argument, NULL, OPT_LOG_RING },
+    { "pool-frames", required_argument, NULL, OPT_POOL_FRAMES },
+    { "pool-hugepages", no_argument, NULL, OPT_POOL_HUGE },
+    { "low-latency", no_argument, NULL, OPT_LOW_LATENCY },
+    { "busy-poll", required_argument, NULL, OPT_BUSY_POLL },
+    { "busy-poll-budget", required_argument, NULL, OPT_BUSY_POLL_BUDGET },
+    { "prefer-busy-poll", no_argument, NULL, OPT_PREFER_BUSY_POLL },
+    { "spin-us", required_argument, NULL, OPT_SPIN_US },
+    { "sched-fifo", required_argument, NULL, OPT_SCHED_FIFO },
+    { "fanout", required_argument, NULL, OPT_FANOUT },
+    { "fanout-mode", required_argument, NULL, OPT_FANOUT_MODE },
+    { "max-sessions", required_argument, NULL, OPT_MAX_SESSIONS },
+    { "session-idle", required_argument, NULL, OPT_SESSION_IDLE },
+    { "session-send", required_argument, NULL, OPT_SESSION_SEND },
+    { "io", required_argument, NULL, OPT_IO },
+    { "uring-bufs", required_argument, NULL, OPT_URING_BUFS },
+    { "xdp", no_argument, NULL, OPT_XDP },
+    { "xdp-queue", required_argument, NULL, OPT_XDP_QUEUE },
+    { "xdp-frames", required_argument, NULL, OPT_XDP_FRAMES },
+    { "xdp-copy", no_argument, NULL, OPT_XDP_COPY },
+    { "radiotap", required_argument, NULL, OPT_RADIOTAP },
+    { "suppress", required_argument, NULL, OPT_SUPPRESS },
+    { "suppress-entries", required_argument, NULL, OPT_SUPPRESS_ENTRIES },
+    { "suppress-refresh", required_argument, NULL, OPT_SUPPRESS_REFRESH },
+    { "compress", required_argument, NULL, OPT_COMPRESS },
+    { "compress-min", required_argument, NULL, OPT_COMPRESS_MIN },
+    { "reorder", required_argument, NULL, OPT_REORDER },
+    { "reorder-delay", required_argument, NULL, OPT_REORDER_DELAY },
+    { "record", required_argument, NULL, OPT_RECORD },
+    { "record-size", required_argument, NULL, OPT_RECORD_SIZE },
+    { "record-time", required_argument, NULL, OPT_RECORD_TIME },
+    { "record-buffer", required_argument, NULL, OPT_RECORD_BUFFER },
+    { "record-direct", no_argument, NULL, OPT_RECORD_DIRECT },
+    { "replay-speed", required_argument, NULL, OPT_REPLAY_SPEED },
+    { "replay-loop", required_argument, NULL, OPT_REPLAY_LOOP },
+    { NULL, 0, NULL, 0 }
+};
+
 void usage(const char* name)
 {
     fprintf(stdout, "Utility to capture wireless packets from a local wireless\n");
     fprintf(stdout, "  interface and forward over a LAN to another instance\n");
-    fprintf(stdout, "  which injects them into local wireless interface\n\n");
-    fprintf(stdout, "Usage: %s { [-h] -s | -c <address> } WIFACE IFACE \n", name);
+    fprintf(stdout, "  which injects them into local wireless interface\n");
+    fprintf(stdout, "  Each WIFACE is carried in its own tunnel, numbered in order\n\n");
+    fprintf(stdout, "Usage: %s { [-h] -s | -c <address> } [OPTIONS] WIFACE [WIFACE...] IFACE \n",
+                    name);
+    fprintf(stdout, "       %s -r <file> [OPTIONS] WIFACE\n", name);
     fprintf(stdout, "\t-h                 \tDisplay usage\n");
     fprintf(stdout, "\t-s                 \tOperate in server mode\n");
     fprintf(stdout, "\t-c <address>       \tOperate in client mode\n");
+    fprintf(stdout, "\t-r <file>          \tInject the frames of a pcap or pcapng file into WIFACE\n");
+    fprintf(stdout, "\t-f, --filter=EXPR  \tOnly capture frames matching EXPR, checked in the kernel:\n");
+    fprintf(stdout, "\t                   \t  type TYPE [subtype SUBTYPE], subtype SUBTYPE,\n");
+    fprintf(stdout, "\t                   \t  wlan addr1|addr2|addr3|ra|ta|host MAC,\n");
+    fprintf(stdout, "\t                   \t  combined with and, or, not and parentheses\n");
+    fprintf(stdout, "\t--filter-dump      \tPrint the compiled filter program and exit\n");
+    fprintf(stdout, "\t--rx-ring          \tCapture through a mmap'd TPACKET_V3 RX ring\n");
+    fprintf(stdout, "\t--rx-block-size=N  \tRX ring block size in bytes (default: %d)\n",
+                    WCAP_RXRING_BLOCK_SIZE_DEF);
+    fprintf(stdout, "\t--rx-block-count=N \tNumber of RX ring blocks (default: %d)\n",
+                    WCAP_RXRING_BLOCK_COUNT_DEF);
+    fprintf(stdout, "\t--rx-retire-ms=N   \tRX ring block retire timeout (default: %d)\n",
+                    WCAP_RXRING_RETIRE_MS_DEF);
+    fprintf(stdout, "\t--tx-ring          \tInject through a mmap'd PACKET_TX_RING\n");
+    fprintf(stdout, "\t--tx-frame-size=N  \tTX ring frame size in bytes (default: %d)\n",
+                    WCAP_TXRING_FRAME_SIZE_DEF);
+    fprintf(stdout, "\t--tx-frame-count=N \tNumber of TX ring frames (default: %d)\n",
+                    WCAP_TXRING_FRAME_COUNT_DEF);
+    fprintf(stdout, "\t--tx-batch=N       \tKick the TX ring after N queued frames (default: %d)\n",
+                    WCAP_TXRING_BATCH_DEF);
+    fprintf(stdout, "\t--tx-qdisc-bypass  \tSend TX ring frames straight to the driver\n");
+    fprintf(stdout, "\t--batch=N          \tUDP datagrams per recvmmsg()/sendmmsg() (default: %d)\n",
+                    WCAP_UDP_BATCH_DEF);
+    fprintf(stdout, "\t--agg-size=N       \tAggregate frames into datagrams of up to N bytes\n");
+    fprintf(stdout, "\t                   \t  (default: Ethernet MTU less IP/UDP headers)\n");
+    fprintf(stdout, "\t--agg-delay-us=N   \tHold a partial datagram for at most N usecs\n");
+    fprintf(stdout, "\t                   \t  (default: 0, send at the end of every wakeup)\n");
+    fprintf(stdout, "\t--udp-gso          \tSend datagrams as UDP_SEGMENT super-buffers\n");
+    fprintf(stdout, "\t--udp-gro          \tReceive coalesced UDP_GRO buffers\n");
+    fprintf(stdout, "\t--threads          \tRun each direction on its own capture and forwarding\n");
+    fprintf(stdout, "\t                   \t  threads connected by lock-free rings\n");
+    fprintf(stdout, "\t--cpu-list=LIST    \tPin the threads to CPUs, in order: wireless capture,\n");
+    fprintf(stdout, "\t                   \t  UDP send, UDP receive, wireless inject (-1: unpinned)\n");
+    fprintf(stdout, "\t                   \t  or, with --fanout, one CPU per worker\n");
+    fprintf(stdout, "\t--pool-frames=N    \tCaptured frame buffers, allocated once (default: enough\n");
+    fprintf(stdout, "\t                   \t  for --ring-size, or a few per worker)\n");
+    fprintf(stdout, "\t--pool-hugepages   \tBack the frame buffers with huge pages\n");
+    fprintf(stdout, "\t--low-latency      \tTrade CPU for latency: --busy-poll=%d --spin-us=%d\n",
+                    WCAP_EVENT_BUSY_POLL_DEF, WCAP_EVENT_SPIN_DEF);
+    fprintf(stdout, "\t                   \t  unless given otherwise; pair with --cpu-list\n");
+    fprintf(stdout, "\t--busy-poll=USECS  \tBusy poll device queues under the sockets (SO_BUSY_POLL)\n");
+    fprintf(stdout, "\t                   \t  and, from Linux 6.9, in epoll_wait()\n");
+    fprintf(stdout, "\t--busy-poll-budget=N\tPackets per busy poll (default: kernel's)\n");
+    fprintf(stdout, "\t--prefer-busy-poll \tKeep device interrupts off while busy polling keeps up\n");
+    fprintf(stdout, "\t                   \t  (SO_PREFER_BUSY_POLL, needs napi_defer_hard_irqs)\n");
+    fprintf(stdout, "\t--spin-us=N        \tKeep polling for N usecs after the last event before\n");
+    fprintf(stdout, "\t                   \t  blocking (default: 0, always block)\n");
+    fprintf(stdout, "\t--sched-fifo=PRIO  \tRun the datapath threads SCHED_FIFO at PRIO (1-99)\n");
+    fprintf(stdout, "\t--ring-size=N      \tFrames queued between threads (default: %d)\n",
+                    WCAP_SPSC_COUNT_DEF);
+    fprintf(stdout, "\t--stats-interval=N \tReport thread statistics every N seconds\n");
+    fprintf(stdout, "\t--stats-shm=NAME   \tPublish datapath counters in shared memory NAME for\n");
+    fprintf(stdout, "\t                   \t  wcap-top (default: %s<pid>)\n", WCAP_STATS_PREFIX);
+    fprintf(stdout, "\t--latency          \tTimestamp packets in the kernel and keep histograms of\n");
+    fprintf(stdout, "\t                   \t  capture to send, network transit and receive to inject\n");
+    fprintf(stdout, "\t                   \t  latency; transit needs the peers' clocks in sync\n");
+    fprintf(stdout, "\t--log-level=LEVEL  \terror, warn, info (default), debug or trace; debug has a\n");
+    fprintf(stdout, "\t                   \t  line per batch, trace per frame (built in: %s)\n",
+                    WcapLogLevelName(WCAP_LOG_LEVEL_MAX));
+    fprintf(stdout, "\t--log-ring=N       \tMessages queued for the log thread (default: %d)\n",
+                    WCAP_LOG_COUNT_DEF);
+    fprintf(stdout, "\t--fanout=N         \tCapture with N workers in a PACKET_FANOUT group, each\n");
+    fprintf(stdout, "\t                   \t  with its own raw and UDP sockets (max: %d)\n",
+                    WCAP_FANOUT_MAX);
+    fprintf(stdout, "\t--fanout-mode=MODE \tta (per transmitter, default), hash, cpu or rollover\n");
+    fprintf(stdout, "\t--max-sessions=N   \tPeers tracked at once (default: %d)\n",
+                    WCAP_SESSION_MAX_DEF);
+    fprintf(stdout, "\t--session-idle=N   \tForget peers silent for N seconds (default: 0, never);\n");
+    fprintf(stdout, "\t                   \t  a peer that only listens is forgotten too\n");
+    fprintf(stdout, "\t--session-send=SET \tSend captured frames to 'all' peers (default) or only\n");
+    fprintf(stdout, "\t                   \t  to those heard on the radio's 'tunnel'\n");
+    fprintf(stdout, "\t--io=MODE          \tepoll (default) or uring: multishot receives into\n");
+    fprintf(stdout, "\t                   \t  provided buffers, sends batched per io_uring_enter()\n");
+    fprintf(stdout, "\t--uring-bufs=N     \tio_uring receive buffers per socket, a power of two\n");
+    fprintf(stdout, "\t                   \t  (default: %d)\n", WCAP_URING_BUFS_DEF);
+    fprintf(stdout, "\t--xdp              \tCarry the tunnel over an AF_XDP socket on IFACE, an XDP\n");
+    fprintf(stdout, "\t                   \t  program redirects the tunnel's port only\n");
+    fprintf(stdout, "\t--xdp-queue=N      \tReceive queue of IFACE to bind to (default: 0)\n");
+    fprintf(stdout, "\t--xdp-frames=N     \tUMEM frames, a power of two (default: %d)\n",
+                    WCAP_XSK_FRAME_COUNT_DEF);
+    fprintf(stdout, "\t--xdp-copy         \tDo not try zero-copy mode\n");
+    fprintf(stdout, "\t--radiotap=MODE    \tSend the radiotap header of captured frames as is\n");
+    fprintf(stdout, "\t                   \t  ('keep', default), drop it ('strip') or replace it\n");
+    fprintf(stdout, "\t                   \t  with %zu bytes of metadata ('compact'); the peer\n",
+                    WCAP_RADIOTAP_META_LEN);
+    fprintf(stdout, "\t                   \t  injects with a minimal header either way\n");
+    fprintf(stdout, "\t--suppress=POLICY  \tBeacons and probes unchanged since the last one from\n");
+    fprintf(stdout, "\t                   \t  their transmitter are sent whole ('off', default),\n");
+    fprintf(stdout, "\t                   \t  as a short record the peer rebuilds them from\n");
+    fprintf(stdout, "\t                   \t  ('repeat') or not at all ('drop')\n");
+    fprintf(stdout, "\t--suppress-entries=N\tTransmitters and subtypes remembered (default: %d)\n",
+                    WCAP_SUPPRESS_ENTRIES_DEF);
+    fprintf(stdout, "\t--suppress-refresh=N\tSend every Nth unchanged frame whole (default: %d,\n",
+                    WCAP_SUPPRESS_REFRESH_DEF);
+    fprintf(stdout, "\t                   \t  0: never)\n");
+    fprintf(stdout, "\t--compress=CODEC   \tnone (default) or lz4: compress datagrams to peers\n");
+    fprintf(stdout, "\t                   \t  that accept it, when they come out shorter\n");
+    fprintf(stdout, "\t--compress-min=N   \tLeave datagrams under N bytes alone (default: %d)\n",
+                    WCAP_COMPRESS_MIN_DEF);
+    fprintf(stdout, "\t--reorder=N        \tHold up to N datagrams (max: %d) that arrive ahead of\n",
+                    WCAP_SEQ_REORDER_MAX);
+    fprintf(stdout, "\t                   \t  a gap in what the peer's worker sent, to inject\n");
+    fprintf(stdout, "\t                   \t  them in order (default: 0, inject as they arrive)\n");
+    fprintf(stdout, "\t--reorder-delay=USECS\tGive up on a gap after USECS (default: %d)\n",
+                    WCAP_SEQ_REORDER_DELAY_DEF);
+    fprintf(stdout, "\t--record=FILE      \tAlso write captured frames to pcapng FILE, FILE-N for\n");
+    fprintf(stdout, "\t                   \t  worker N when there are several\n");
+    fprintf(stdout, "\t--record-size=N    \tStart a new file (FILE.1, FILE.2, ...) every N MB\n");
+    fprintf(stdout, "\t--record-time=N    \tStart a new file every N seconds\n");
+    fprintf(stdout, "\t--record-buffer=N  \tWrite-behind buffer per file in MB (default: %d),\n",
+                    (WCAP_PCAPNG_BUF_SIZE_DEF >> 20));
+    fprintf(stdout, "\t                   \t  frames are dropped from the file when it is full\n");
+    fprintf(stdout, "\t--record-direct    \tWrite with O_DIRECT, bypassing the page cache\n");
+    fprintf(stdout, "\t--replay-speed=SPEED\tReplay at the captured gaps (orig) or as fast as\n");
+    fprintf(stdout, "\t                   \t  frames can be injected (max) (default: orig)\n");
+    fprintf(stdout, "\t--replay-loop=N    \tReplay the file N times, 0 for no end (default: 1)\n");
 }
 
-static bool do_server(const char* wiface, const char* iface)
+static bool parse_uint(const char* str, unsigned int* val)
 {
-
-    bool status = true;
-    bool hwsim = true;
-    WcapIfaceInfo_t iface_info = { 0 };
-    char addr[16] = { 0 };
-    WcapWifaceInfo_t wiface_info = { 0 };
-    struct pollfd fds[2] = { 0 };
-    int nfds = 0;
+    char* end = NULL;
+    unsigned long v = 0;
 
     errno = 0;
-
-    // Validity check arguments
-    if ((iface == NULL) || !strlen(iface))
+    v = strtoul(str, &end, 0);
+    if (errno || (end == str) || *end || (v > UINT32_MAX))
     {
-        fprintf(stderr, "Invalid ethernet interface name");
         return false;
     }
-    if ((wiface == NULL) || !strlen(wiface))
+    *val = (unsigned int) v;
+    return true;
+}
+
+static bool parse_cpu_list(const char* str, int* cpus, unsigned int* count,
+                           const unsigned int max)
+{
+    char* end = NULL;
+    long v = 0;
+
+    for (unsigned int i = 0; i < max; i++)
     {
-        fprintf(stderr, "Invalid wireless interface name");
-        return false;
+        errno = 0;
+        v = strtol(str, &end, 0);
+        if (errno || (end == str) || (v < -1) || (v >= CPU_SETSIZE))
+        {
+            return false;
+        }
+        cpus[i] = (int) v;
+        if (*end == 0)
+        {
+            *count = i + 1;
+            return true;
+        }
+        if (*end != ',')
+        {
+            return false;
+        }
+        str = end + 1;
     }
 
-    // Connect NL80211 netlink socket for managing wireless interfaces
-    if (!WcapGENLConnect())
+    return false;
+}
+
+
+static bool parse_fanout_mode(const char* str, WcapFanoutMode_t* mode)
+{
+    if (!strcmp(str, "ta"))
     {
-        fprintf(stderr, "Failed to connect General netlink socket\n");
-        return false;
+        *mode = WCAP_FANOUT_TA;
     }
-
-    // Connect Route netlink socket for managing ethernet interfaces
-    if (!WcapRTNLConnect())
+    else if (!strcmp(str, "hash"))
+    {
+        *mode = WCAP_FANOUT_HASH;
+    }
+    else if (!strcmp(str, "cpu"))
+    {
+        *mode = WCAP_FANOUT_CPU;
+    }
+    else if (!strcmp(str, "rollover"))
+    {
+        *mode = WCAP_FANOUT_ROLLOVER;
+    }
+    else
     {
-        fprintf(stderr, "Failed to connect Route netlink socket\n");
         return false;
     }
+    return true;
+}
 
-    //-------------------------------------------------------------------------
-    // Retrieve information about Ethernet interface
-    //-------------------------------------------------------------------------
+static uint64_t now_ns(const clockid_t clk)
+{
+    struct timespec ts = { 0 };
+    clock_gettime(clk, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
 
-    if (!WcapIfaceInfoGet(iface, &iface_info))
+static size_t agg_size(const WcapIfaceInfo_t* info)
+{
+    size_t size = gOpts.aggSize;
+
+    // Leave room for the IPv4 and UDP headers within the link MTU
+    if (!size && (info->mtu > 28))
     {
-        fprintf(stderr, "Failed to find interface: %s\n", iface);
-        status = false;
-        goto exit_fail;
+        size = info->mtu - 28;
     }
 
-    fprintf(stdout, "Found ethernet interface: [%d] %s (%02x:%02x:%02x:%02x:%02x:%02x)\n",
-                    iface_info.ifindex, iface_info.ifname,
-                    iface_info.hwaddr[0], iface_info.hwaddr[1], iface_info.hwaddr[2],
-                    iface_info.hwaddr[3], iface_info.hwaddr[4], iface_info.hwaddr[5]);
+    return (size && (size < WCAP_UDP_BUF_SIZE)) ? size : WCAP_UDP_BUF_SIZE;
+}
 
-    // Construct link local address using the last two octets of the interface's MAC
-    snprintf(addr, 16, "169.254.%d.%d", iface_info.hwaddr[4], iface_info.hwaddr[5]);
+// Handlers keep the sessions they find, and the sequence trackers held
+// datagrams point into, only while inside the session table
+static void session_enter(void)
+{
+    WcapSessionEnter(&gCtx.sessions, tReader);
+}
 
-    // Add address to interface
-    if (!WcapIfaceInetAddrAdd(iface, addr, 16))
+static void session_leave(const bool holding)
+{
+    if (!holding)
     {
-        fprintf(stdout, "Failed to add link local address to interface: %s\n", iface);
+        WcapSessionLeave(&gCtx.sessions, tReader);
     }
+}
 
-    // Set the interface's state to administratively up
-    iface_info.flags |= (IFF_UP | IFF_RUNNING);
-    if (!WcapIfaceInfoSet(iface, &iface_info))
+static bool session_wanted(const WcapSession_t* session, const struct wcap_path* path)
+{
+    // Only send a radio's frames to peers that have spoken on its tunnel
+    if (gOpts.sessionSend == SESSION_SEND_TUNNEL)
     {
-        fprintf(stderr, "Failed to bring interface '%s' up\n", iface);
-        status = false;
-        goto exit_del_addr;
+        return (__atomic_load_n(&session->tunnels, __ATOMIC_RELAXED) & (1U << path->tunnel));
     }
+    return true;
+}
 
-    // Open UDP socket for sending / receiving encapsulated 80211 frames
-    gCtx.udpSock = socket(AF_INET, (SOCK_DGRAM | SOCK_NONBLOCK), 0);
-    if (gCtx.udpSock < 0)
+static void session_print(const WcapSession_t* session, void* arg)
+{
+    WCAP_INFO("Session %s:%d%s: %llu datagrams (%llu frames, %llu bytes) in, "
+              "%llu datagrams (%llu bytes) out, idle %llu ms",
+              inet_ntoa(session->addr.sin_addr), ntohs(session->addr.sin_port),
+              (const char*) arg,
+              (unsigned long long) session->rxDatagrams,
+              (unsigned long long) session->rxFrames,
+              (unsigned long long) session->rxBytes,
+              (unsigned long long) session->txDatagrams,
+              (unsigned long long) session->txBytes,
+              (unsigned long long) ((now_ns(CLOCK_MONOTONIC) - session->lastSeen) / 1000000ULL));
+
+    // Gaps still in the window may only be late, they are not counted lost yet
+    for (unsigned int s = 0; s < WCAP_ENCAP_STREAM_MAX; s++)
     {
-        fprintf(stderr, "Failed to open UDP socket on Ethernet interface: %s\n", iface_info.ifname);
-        status = false;
-        goto exit_del_addr;
+        const WcapSeqTrack_t* trk = &session->seq[s];
+
+        if (!trk->received)
+        {
+            continue;
+        }
+        WCAP_INFO("Session %s:%d stream %u: %llu datagrams, %llu lost, %u missing, "
+                  "%llu reordered, %llu duplicated, %llu late, %llu restarts",
+                  inet_ntoa(session->addr.sin_addr), ntohs(session->addr.sin_port), s,
+                  (unsigned long long) trk->received, (unsigned long long) trk->lost,
+                  WcapSeqTrackMissing(trk), (unsigned long long) trk->reordered,
+                  (unsigned long long) trk->duplicates, (unsigned long long) trk->late,
+                  (unsigned long long) trk->resyncs);
     }
+}
 
-    // Set up IP address for UDP socket
-    gCtx.udpAddr.sin_family = AF_INET;
-    gCtx.udpAddr.sin_addr.s_addr = inet_addr(addr);
-    gCtx.udpAddr.sin_port = htons(8888);
+static void udp_flush(struct wcap_path* path);
 
-    // Bind UDP socket to link local address
-    if (bind(gCtx.udpSock, (struct sockaddr*) &gCtx.udpAddr, sizeof(gCtx.udpAddr)) < 0)
-    {
-        fprintf(stderr, "Failed to bind socket to monitor interface: %s\n", iface_info.ifname);
-        status = false;
-        goto exit_del_addr;
-    }
+// Counts what the codec did with one datagram, from its counters before
+static void compress_stats(struct wcap_path* path, const unsigned int base,
+                           const WcapCompress_t* was, const WcapCompress_t* comp)
+{
+    WcapStatsSlot_t* stats = path_stats(path);
 
-    fprintf(stdout, "Listening on Ethernet interface: %s (%s)\n", iface, addr);
+    WcapStatsAdd(stats, (base + WCAP_STATS_LZ4_PACKED), (comp->packed - was->packed));
+    WcapStatsAdd(stats, (base + WCAP_STATS_LZ4_SMALL), (comp->small - was->small));
+    WcapStatsAdd(stats, (base + WCAP_STATS_LZ4_INCOMPRESSIBLE),
+                 (comp->incompressible - was->incompressible));
+    WcapStatsAdd(stats, (base + WCAP_STATS_LZ4_MALFORMED), (comp->errors - was->errors));
+    WcapStatsAdd(stats, (base + WCAP_STATS_LZ4_BYTES_IN), (comp->bytesIn - was->bytesIn));
+    WcapStatsAdd(stats, (base + WCAP_STATS_LZ4_BYTES_OUT), (comp->bytesOut - was->bytesOut));
+    WcapStatsAdd(stats, (base + WCAP_STATS_LZ4_NS), (comp->ns - was->ns));
+}
 
-    //-------------------------------------------------------------------------
-    // Retrieve information about wireless interface
-    //-------------------------------------------------------------------------
+static void encap_close(struct wcap_path* path)
+{
+    size_t len = 0;
+    size_t zlen = 0;
+    bool zdone = false;
 
-    if (!WcapNL80211WifaceGet(wiface, &wiface_info))
+    // A repeat could not be rebuilt, have the peers send theirs whole again
+    if (__atomic_load_n(&gCtx.suppressResend, __ATOMIC_RELAXED) &&
+        __atomic_exchange_n(&gCtx.suppressResend, false, __ATOMIC_RELAXED))
     {
-        fprintf(stderr, "Failed to find interface: %s\n", wiface);
-        status = false;
-        goto exit_del_addr;
+        path->encap.flags |= WCAP_ENCAP_HDR_F_RESEND;
     }
+    len = WcapEncapClose(&path->encap);
 
-    fprintf(stdout, "Found wireless interface: [%d] %s (%02x:%02x:%02x:%02x:%02x:%02x)\n",
-                    wiface_info.ifindex, wiface_info.ifname,
-                    wiface_info.iface.hwaddr[0], wiface_info.iface.hwaddr[1],
-                    wiface_info.iface.hwaddr[2],
-                    wiface_info.iface.hwaddr[3], wiface_info.iface.hwaddr[4],
-                    wiface_info.iface.hwaddr[5]);
-
-    // Set the monitor interface's state to administratively up
-    wiface_info.iface.flags |= (IFF_UP | IFF_RUNNING);
-    if (!WcapIfaceInfoSet(wiface, &wiface_info.iface))
+    // Every frame waited from its capture until the datagram was stamped
+    if (len && path->encap.stamp)
     {
-        fprintf(stderr, "Failed to bring interface '%s' up\n", iface);
-        status = false;
-        goto exit_del_addr;
+        WcapDecap_t dec = { 0 };
+        WcapEncapFrame_t frame = { 0 };
+
+        WcapDecapInit(&dec, path->encap.buf, len);
+        while (WcapDecapNext(&dec, &frame))
+        {
+            WcapStatsRecord(path_stats(path), WCAP_STATS_LAT_CAPTURE_SEND,
+                            (int64_t) (path->encap.sent - frame.tstamp));
+        }
     }
 
-    // Open raw socket for sending / receiving on monitor interface
-    gCtx.rawSock = socket(AF_PACKET, (SOCK_RAW | SOCK_NONBLOCK), htons(ETH_P_ALL));
-    if (gCtx.rawSock < 0)
+    // Every interested session gets a copy, all queued in the same batch
+    if (len)
     {
-        fprintf(stderr, "Failed to open raw socket on monitor interface: %s\n",
-                        wiface_info.ifname);
-        status = false;
-        goto exit_del_addr;
-    }
+        WcapSession_t* session = NULL;
+        unsigned int iter = 0;
+        while ((session = WcapSessionNext(&gCtx.sessions, &iter)))
+        {
+            const uint8_t* data = path->encap.buf;
+            size_t dlen = len;
 
-    // Construct raw socket address of monitor interface
-    gCtx.rawAddr.sll_ifindex = wiface_info.ifindex;
-    gCtx.rawAddr.sll_family = AF_PACKET;
-    gCtx.rawAddr.sll_protocol = htons(ETH_P_ALL);
-    gCtx.rawAddr.sll_pkttype = PACKET_HOST;
+            if (!session_wanted(session, path))
+            {
+                continue;
+            }
 
-    // Bind raw socket to monitor interface
-    if (bind(gCtx.rawSock, (struct sockaddr*) &gCtx.rawAddr, sizeof(gCtx.rawAddr)) < 0)
-    {
-        fprintf(stderr, "Failed to bind socket to monitor interface: %s\n", wiface_info.ifname);
-        status = false;
-        goto exit_del_addr;
-    }
+            // Compressed once, for the first peer known to accept it
+            if (gOpts.compress &&
+                (__atomic_load_n(&session->peerFlags, __ATOMIC_RELAXED) &
+                 WCAP_ENCAP_HDR_F_ACCEPT_LZ4))
+            {
+                if (!zdone)
+                {
+                    WcapCompress_t was = path->compress;
+                    zlen = WcapCompressDatagram(&path->compress, path->encap.buf, len);
+                    zdone = true;
+                    compress_stats(path, WCAP_STATS_UDP_TX_LZ4, &was, &path->compress);
+                }
+                if (zlen)
+                {
+                    data = path->compress.buf;
+                    dlen = zlen;
+                }
+            }
 
-    fprintf(stdout, "Listening on Wireless interface: [%d] %s\n", wiface_info.ifindex, wiface_info.ifname);
+            // A full batch would otherwise be sent by sendmmsg() behind
+            // the back of io_uring or AF_XDP
+            if ((path->uring.fd || path->xsk.fd) && (path->udpTx.count == path->udpTx.size))
+            {
+                udp_flush(path);
+            }
+            if (WcapUdpBatchAdd(&path->udpTx, data, dlen, &session->addr))
+            {
+                __atomic_fetch_add(&session->txDatagrams, 1, __ATOMIC_RELAXED);
+                __atomic_fetch_add(&session->txBytes, dlen, __ATOMIC_RELAXED);
+                WcapStatsAdd(path_stats(path), WCAP_STATS_UDP_TX_DATAGRAMS, 1);
+                WcapStatsAdd(path_stats(path), WCAP_STATS_UDP_TX_BYTES, dlen);
+            }
+        }
+    }
 
-    //-------------------------------------------------------------------------
-    // Set up to listen on both sockets
-    //-------------------------------------------------------------------------
+    WcapEncapReset(&path->encap);
 
-    nfds = 0;
+    // Nothing is pending any more, so the flush deadline no longer applies
+    if (path->aggArmed)
+    {
+        WcapEventTimerSet(path->aggTimer, 0, 0);
+        path->aggArmed = false;
+    }
+}
 
-    gCtx.udpSockIdx = nfds++;
-    fds[gCtx.udpSockIdx].fd = gCtx.udpSock;
-    fds[gCtx.udpSockIdx].events = (POLLIN | POLLERR);
+static void raw_to_udp(struct wcap_path* path, const void* buf, const int len,
+                       const uint64_t tstamp)
+{
+    WcapRadiotapMeta_t meta = { 0 };
+    WcapSuppressRepeat_t repeat = { 0 };
+    uint8_t hdr[WCAP_RADIOTAP_META_LEN];
+    const uint8_t* data = buf;
+    const uint8_t* dot11 = NULL;
+    size_t dot11len = 0;
+    size_t hdrlen = 0;
+    size_t rtlen = 0;
+    size_t flen = len;
+    uint16_t flags = 0;
 
-    gCtx.rawSockIdx = nfds++;
-    fds[gCtx.rawSockIdx].fd = gCtx.rawSock;
-    fds[gCtx.rawSockIdx].events = (POLLIN | POLLERR);
+    // Server mode only learns where to send once a client has spoken
+    if ((len <= 0) || !WcapSessionCount(&gCtx.sessions))
+    {
+        return;
+    }
 
-    while (true)
+    // Find the bare 802.11 frame; padded frames and unreadable headers go as
+    // they are
+    if (((gOpts.radiotap != RADIOTAP_KEEP) || (gOpts.suppress != SUPPRESS_OFF)) &&
+        WcapRadiotapParse(buf, len, &meta, &rtlen) && (rtlen < (size_t) len) &&
+        !(meta.flags & WCAP_RADIOTAP_F_DATAPAD))
     {
-        if (poll(fds, nfds, 10000) < 0)
+        dot11 = data + rtlen;
+        dot11len = len - rtlen;
+        if ((meta.flags & WCAP_RADIOTAP_F_FCS) && (dot11len > WCAP_RADIOTAP_FCS_LEN))
         {
-            fprintf(stderr, "Polling error occurred\n");
-            status = false;
-            goto exit_del_addr;
+            dot11len -= WCAP_RADIOTAP_FCS_LEN;
         }
-        for (int i = 0; i < nfds; i++)
+    }
+
+    // Send it without its radiotap header, perhaps with the gist of it
+    if (dot11 && (gOpts.radiotap != RADIOTAP_KEEP))
+    {
+        data = dot11;
+        flen = dot11len;
+        flags = WCAP_ENCAP_F_NO_RADIOTAP;
+        if (gOpts.radiotap == RADIOTAP_COMPACT)
         {
-            if (fds[i].revents & POLLERR)
-            {
-                fprintf(stderr, "Socket [%d] encountered an error: [%d] %s\n", fds[i].fd, errno,
-                                strerror(errno));
-                status = false;
-                goto exit_del_addr;
-            }
+            WcapRadiotapMetaEncode(&meta, hdr);
+            hdrlen = sizeof(hdr);
+            flags = WCAP_ENCAP_F_META;
         }
-        if (fds[gCtx.udpSockIdx].revents & POLLIN)
+    }
+
+    // An unchanged beacon or probe is replaced by a repeat record, or dropped
+    if (dot11 && (gOpts.suppress != SUPPRESS_OFF))
+    {
+        unsigned int epoch = __atomic_load_n(&gCtx.suppressEpoch, __ATOMIC_RELAXED);
+        if (path->suppressEpoch != epoch)
         {
-            char buf[8192] = { 0 };
-            int addrlen = sizeof(gCtx.dstAddr);
-            int cnt = recvfrom(fds[gCtx.udpSockIdx].fd, &buf, sizeof(buf), 0, (struct sockaddr*) &gCtx.dstAddr, &addrlen);
-            fprintf(stdout, "Received %d bytes on UDP socket: %d\n", cnt, fds[gCtx.udpSockIdx].fd);
-            cnt = sendto(gCtx.rawSock, buf, cnt, 0, NULL, 0);
-            fprintf(stdout, "Sent %d bytes on Raw socket: %d\n", cnt, fds[gCtx.rawSockIdx].fd);
+            WcapSuppressReset(&path->suppressTx);
+            path->suppressEpoch = epoch;
         }
-        if (fds[gCtx.rawSockIdx].revents & POLLIN)
+        switch (WcapSuppressCheck(&path->suppressTx, path->tunnel, dot11, dot11len, &repeat))
         {
-            char buf[8192] = { 0 };
-            int cnt = recvfrom(fds[gCtx.rawSockIdx].fd, &buf, sizeof(buf), 0, NULL, NULL);
-            fprintf(stdout, "Received %d bytes on Raw socket: %d\n", cnt, fds[gCtx.rawSockIdx].fd);
-            if (gCtx.dstAddr.sin_addr.s_addr)
+            case WCAP_SUPPRESS_CACHE:
+            {
+                flags |= WCAP_ENCAP_F_CACHE;
+                break;
+            }
+            case WCAP_SUPPRESS_REPEAT:
             {
-                cnt = sendto(gCtx.udpSock, buf, cnt, 0, (struct sockaddr*) &gCtx.dstAddr, sizeof(gCtx.dstAddr));
-                fprintf(stdout, "Sent %d bytes on UDP socket: %d\n", cnt, fds[gCtx.udpSockIdx].fd);
+                if (gOpts.suppress == SUPPRESS_DROP)
+                {
+                    WcapStatsAdd(path_stats(path), WCAP_STATS_UDP_TX_DROP_SUPPRESS, 1);
+                    return;
+                }
+                data = (const uint8_t*) &repeat;
+                flen = sizeof(repeat);
+                hdrlen = 0;
+                flags = WCAP_ENCAP_F_REPEAT;
+                break;
+            }
+            default:
+            {
+                break;
             }
         }
     }
 
-exit_del_addr:
-
-    if (!WcapIfaceInetAddrRemove(iface, addr, 16))
+    if (flags & (WCAP_ENCAP_F_NO_RADIOTAP | WCAP_ENCAP_F_META))
     {
-        fprintf(stdout, "Failed to remove link local address from interface: %s\n", iface);
+        path->radiotapSaved += (int64_t) len - (int64_t) (hdrlen + flen);
     }
 
-exit_fail:
-
-    if (gCtx.udpSock != 0)
+    // Start a new datagram when the frame does not fit the current one
+    if (!WcapEncapAddFrame(&path->encap, hdr, hdrlen, data, flen, flags, tstamp))
     {
-        close(gCtx.udpSock);
-        gCtx.udpSock = 0;
+        encap_close(path);
+        if (!WcapEncapAddFrame(&path->encap, hdr, hdrlen, data, flen, flags, tstamp))
+        {
+            WCAP_LOG_LIMIT(WCAP_LOG_WARN, "Dropped %d byte frame too large to encapsulate", len);
+            WcapStatsAdd(path_stats(path), WCAP_STATS_UDP_TX_DROP_OVERSIZE, 1);
+            return;
+        }
     }
 
-    if (gCtx.rawSock != 0)
+    // The first frame of a datagram starts the clock on its flush deadline
+    if ((path->encap.count == 1) && gOpts.aggDelay)
     {
-        close(gCtx.rawSock);
-        gCtx.rawSock = 0;
+        path->aggArmed = WcapEventTimerSet(path->aggTimer, (gOpts.aggDelay * 1000ULL), 0);
     }
-
-    WcapNL80211Disconnect();
-
-    return status;
-
 }
 
-bool do_client(const char* wiface, const char* iface, const char* dst)
+static void udp_flush(struct wcap_path* path)
 {
+    unsigned int queued = path->udpTx.count;
+    int cnt = 0;
 
-    bool status = true;
-    WcapIfaceInfo_t iface_info = { 0 };
-    char addr[16] = { 0 };
-    WcapWifaceInfo_t wiface_info = { 0 };
-    WcapWifaceInfo_t monitor_info = { 0 };
-    struct pollfd fds[2] = { 0 };
-    int nfds = 0;
-
-    errno = 0;
-
-    // Validity check arguments
-    if ((iface == NULL) || !strlen(iface))
+    if (path->udpTx.count && path->uring.fd)
     {
-        fprintf(stderr, "Invalid ethernet interface name");
-        return false;
+        // Queue the whole batch, together with any injected frames, and hand
+        // it to the kernel in one io_uring_enter(); sends are issued before
+        // the call returns so the batch can be refilled straight away
+        cnt = WcapUdpBatchPrepare(&path->udpTx);
+        for (int i = 0; i < cnt; i++)
+        {
+            if (!WcapUringSendmsg(&path->uring, path->udpSock, &path->udpTx.msgs[i].msg_hdr,
+                                  URING_UDP_SEND))
+            {
+                path->udpTx.drops++;
+            }
+        }
+        WcapUringSubmit(&path->uring, 0);
+        path->udpTx.count = 0;
+        WCAP_DEBUG("Queued %d datagrams on io_uring [%d] to %u sessions", cnt,
+                   path->uring.fd, WcapSessionCount(&gCtx.sessions));
     }
-    if ((wiface == NULL) || !strlen(wiface))
+    else if (path->udpTx.count && path->xsk.fd)
     {
-        fprintf(stderr, "Invalid wireless interface name");
-        return false;
+        // Frames are built straight into the UMEM and sent with one kick
+        for (unsigned int i = 0; i < path->udpTx.count; i++)
+        {
+            if (WcapXskSend(&path->xsk, path->udpTx.iovs[i].iov_base, path->udpTx.iovs[i].iov_len,
+                            &path->udpTx.addrs[i]))
+            {
+                cnt++;
+            }
+        }
+        WcapXskFlush(&path->xsk);
+        path->udpTx.drops += path->udpTx.count - cnt;
+        path->udpTx.count = 0;
+        WCAP_DEBUG("Sent %d datagrams on AF_XDP socket [%d] to %u sessions", cnt,
+                   path->xsk.fd, WcapSessionCount(&gCtx.sessions));
+    }
+    else if (path->udpTx.count)
+    {
+        cnt = WcapUdpBatchFlush(&path->udpTx);
+        WCAP_DEBUG("Sent %d datagrams on UDP socket [%d] to %u sessions", cnt, path->udpSock,
+                   WcapSessionCount(&gCtx.sessions));
     }
 
-    // Connect NL80211 netlink socket for managing wireless interfaces
-    if (!WcapGENLConnect())
+    if (queued)
     {
-        fprintf(stderr, "Failed to connect General netlink socket\n");
-        return false;
+        WcapStatsAdd(path_stats(path), WCAP_STATS_UDP_TX_BATCHES, 1);
+        WcapStatsBatch(path_stats(path), WCAP_STATS_UDP_TX_BATCH, queued);
+        WcapStatsSet(path_stats(path), WCAP_STATS_UDP_TX_EAGAIN, path->udpTx.blocked);
+        WcapStatsSet(path_stats(path), WCAP_STATS_UDP_TX_DROP_SOCKET, path->udpTx.drops);
     }
+}
 
-    // Connect Route netlink socket for managing ethernet interfaces
-    if (!WcapRTNLConnect())
+static void udp_burst_end(struct wcap_path* path)
+{
+    // Without a flush deadline a partial datagram never outlives the wakeup
+    if (!gOpts.aggDelay)
     {
-        fprintf(stderr, "Failed to connect Route netlink socket\n");
-        return false;
+        encap_close(path);
     }
 
-    //-------------------------------------------------------------------------
-    // Retrieve information about Ethernet interface
-    //-------------------------------------------------------------------------
+    // Everything captured in this wakeup leaves in one sendmmsg()
+    udp_flush(path);
+}
 
-    if (!WcapIfaceInfoGet(iface, &iface_info))
+static void inject_latency(struct wcap_path* path, const uint64_t rxTstamp)
+{
+    if (rxTstamp)
     {
-        fprintf(stderr, "Failed to find interface: %s\n", iface);
-        status = false;
-        goto exit_fail;
+        WcapStatsRecord(path_stats(path), WCAP_STATS_LAT_RECV_INJECT,
+                        (int64_t) (now_ns(CLOCK_REALTIME) - rxTstamp));
     }
+}
 
-    fprintf(stdout, "Found ethernet interface: [%d] %s (%02x:%02x:%02x:%02x:%02x:%02x)\n",
-                    iface_info.ifindex, iface_info.ifname,
-                    iface_info.hwaddr[0], iface_info.hwaddr[1], iface_info.hwaddr[2],
-                    iface_info.hwaddr[3], iface_info.hwaddr[4], iface_info.hwaddr[5]);
-    fprintf(stdout, "Flags: 0x%08x\n", iface_info.flags);
+// Frames on the TX ring only count as injected once a kick handed them over
+static void tx_ring_count(struct wcap_path* path)
+{
+    WcapStatsSet(path_stats(path), WCAP_STATS_RAW_TX_FRAMES, path->txRing.frames);
+    WcapStatsSet(path_stats(path), WCAP_STATS_RAW_TX_BYTES, path->txRing.bytes);
+}
 
-    // Construct link local address using the last two octets of the interface's MAC
-    snprintf(addr, 16, "169.254.%d.%d", iface_info.hwaddr[4], iface_info.hwaddr[5]);
+static void udp_to_raw(struct wcap_path* path, const void* buf, const int len,
+                       const uint64_t rxTstamp)
+{
+    int cnt = 0;
+    int err = 0;
 
-    // Add address to interface
-    if (!WcapIfaceInetAddrAdd(iface, addr, 16))
+    if (len <= 0)
     {
-        fprintf(stdout, "Failed to add link local address to interface: %s\n", iface);
+        return;
     }
 
-    // Set the interface's state to administratively up
-    iface_info.flags |= (IFF_UP | IFF_RUNNING);
-    if (!WcapIfaceInfoSet(iface, &iface_info))
+    if (path->txRing.map)
     {
-        fprintf(stderr, "Failed to bring interface '%s' up\n", iface);
-        status = false;
-        goto exit_del_addr;
+        // The only reason to fail is a ring with no free frame
+        if (WcapTxRingSend(&path->txRing, buf, len))
+        {
+            WCAP_TRACE("Queued %d bytes on Raw ring: %d", len, path->txSock);
+            inject_latency(path, rxTstamp);
+        }
+        else
+        {
+            WcapStatsAdd(path_stats(path), WCAP_STATS_RAW_TX_EAGAIN, 1);
+        }
+        if (path->txRing.pending >= gOpts.txBatch)
+        {
+            WcapTxRingFlush(&path->txRing);
+        }
+        tx_ring_count(path);
     }
-
-    // Open UDP socket for sending / receiving encapsulated 80211 frames
-    gCtx.udpSock = socket(AF_INET, (SOCK_DGRAM | SOCK_NONBLOCK), 0);
-    if (gCtx.udpSock < 0)
+    else if (path->uring.fd)
     {
-        fprintf(stderr, "Failed to open UDP socket on Ethernet interface: %s\n", iface_info.ifname);
-        status = false;
-        goto exit_del_addr;
+        // The frame stays in its receive buffer until the burst is submitted
+        if (WcapUringSend(&path->uring, path->rawSock, buf, len, URING_RAW_SEND))
+        {
+            WcapStatsAdd(path_stats(path), WCAP_STATS_RAW_TX_FRAMES, 1);
+            WcapStatsAdd(path_stats(path), WCAP_STATS_RAW_TX_BYTES, len);
+            inject_latency(path, rxTstamp);
+        }
+        else
+        {
+            path->uringSendErrs++;
+            WcapStatsAdd(path_stats(path), WCAP_STATS_RAW_TX_ERRORS, 1);
+        }
     }
-
-    // Set up IP address for UDP socket
-    gCtx.udpAddr.sin_family = AF_INET;
-    gCtx.udpAddr.sin_addr.s_addr = inet_addr(addr);
-    gCtx.udpAddr.sin_port = htons(8888);
-
-    // Set up IP address of server
-    gCtx.dstAddr.sin_family = AF_INET;
-    gCtx.dstAddr.sin_addr.s_addr = inet_addr(dst);
-    gCtx.dstAddr.sin_port = htons(8888);
-
-    // Bind UDP socket to link local address
-    if (bind(gCtx.udpSock, (struct sockaddr*) &gCtx.udpAddr, sizeof(gCtx.udpAddr)) < 0)
+    else
     {
-        fprintf(stderr, "Failed to bind socket to monitor interface: %s\n", monitor_info.ifname);
-        status = false;
-        goto exit_del_addr;
+        cnt = sendto(path->rawSock, buf, len, 0, NULL, 0);
+        err = errno;
+        WCAP_TRACE("Sent %d bytes on Raw socket: %d", cnt, path->rawSock);
+        if (cnt == len)
+        {
+            WcapStatsAdd(path_stats(path), WCAP_STATS_RAW_TX_FRAMES, 1);
+            WcapStatsAdd(path_stats(path), WCAP_STATS_RAW_TX_BYTES, len);
+            inject_latency(path, rxTstamp);
+        }
+        else if ((cnt < 0) && ((err == EAGAIN) || (err == EWOULDBLOCK) || (err == ENOBUFS)))
+        {
+            WcapStatsAdd(path_stats(path), WCAP_STATS_RAW_TX_EAGAIN, 1);
+        }
+        else
+        {
+            WcapStatsAdd(path_stats(path), WCAP_STATS_RAW_TX_ERRORS, 1);
+        }
     }
+}
 
-    fprintf(stdout, "Listening on Ethernet interface: %s (%s)\n", iface, addr);
-
-    //-------------------------------------------------------------------------
-    // Retrieve information about wireless interface
-    //-------------------------------------------------------------------------
-
-    if (!WcapNL80211WifaceGet(wiface, &wiface_info))
+static void raw_flush(struct wcap_path* path)
+{
+    // Whatever is left of the burst goes to the driver in a single kick
+    if (path->txRing.map)
     {
-        fprintf(stderr, "Failed to find interface: %s\n", wiface);
-        status = false;
-        goto exit_del_addr;
+        WcapTxRingFlush(&path->txRing);
+        tx_ring_count(path);
     }
-
-    fprintf(stdout, "Found wireless interface: [%d] %s (%02x:%02x:%02x:%02x:%02x:%02x)\n",
-                    wiface_info.ifindex, wiface_info.ifname,
-                    wiface_info.iface.hwaddr[0], wiface_info.iface.hwaddr[1],
-                    wiface_info.iface.hwaddr[2],
-                    wiface_info.iface.hwaddr[3], wiface_info.iface.hwaddr[4],
-                    wiface_info.iface.hwaddr[5]);
-
-    // Set the monitor interface's state to administratively up
-    wiface_info.iface.flags |= (IFF_UP | IFF_RUNNING);
-    if (!WcapIfaceInfoSet(wiface, &wiface_info.iface))
+    else if (path->uring.fd)
     {
-        fprintf(stderr, "Failed to bring interface '%s' up\n", iface);
-        status = false;
-        goto exit_del_addr;
+        WcapUringSubmit(&path->uring, 0);
     }
+}
 
-    // Open raw socket for sending / receiving on monitor interface
-    gCtx.rawSock = socket(AF_PACKET, (SOCK_RAW | SOCK_NONBLOCK), htons(ETH_P_ALL));
-    if (gCtx.rawSock < 0)
+static bool radiotap_restore(WcapEncapFrame_t* frame)
+{
+    WcapRadiotapMeta_t meta = { 0 };
+    uint8_t* hdr = NULL;
+    size_t hdrlen = 0;
+
+    if (frame->flags & WCAP_ENCAP_F_META)
     {
-        fprintf(stderr, "Failed to open raw socket on monitor interface: %s\n",
-                        wiface_info.ifname);
-        status = false;
-        goto exit_del_addr;
+        if (frame->len <= WCAP_RADIOTAP_META_LEN)
+        {
+            return false;
+        }
+        WcapRadiotapMetaDecode(frame->data, &meta);
+        frame->data += WCAP_RADIOTAP_META_LEN;
+        frame->len -= WCAP_RADIOTAP_META_LEN;
     }
 
-    // Construct raw socket address of monitor interface
-    gCtx.rawAddr.sll_ifindex = wiface_info.ifindex;
-    gCtx.rawAddr.sll_family = AF_PACKET;
-    gCtx.rawAddr.sll_protocol = htons(ETH_P_ALL);
-    gCtx.rawAddr.sll_pkttype = PACKET_HOST;
+    // The header is built in place over the frame record, and metadata, that
+    // precede the frame; the receive buffer stays ours until the burst ends
+    hdrlen = WcapRadiotapTxLen(&meta);
+    hdr = (uint8_t*) frame->data - hdrlen;
+    WcapRadiotapBuild(hdr, &meta);
+    frame->data = hdr;
+    frame->len += hdrlen;
 
-    // Bind raw socket to monitor interface
-    if (bind(gCtx.rawSock, (struct sockaddr*) &gCtx.rawAddr, sizeof(gCtx.rawAddr)) < 0)
+    return true;
+}
+
+static bool suppress_regenerate(struct wcap_path* path, const WcapDecap_t* dec,
+                                WcapEncapFrame_t* frame)
+{
+    WcapSuppressRepeat_t repeat = { 0 };
+    const uint8_t* data = NULL;
+    size_t len = 0;
+
+    if (frame->len < sizeof(repeat))
     {
-        fprintf(stderr, "Failed to bind socket to monitor interface: %s\n", wiface_info.ifname);
-        status = false;
-        goto exit_del_addr;
+        return false;
     }
+    memcpy(&repeat, frame->data, sizeof(repeat));
 
-    fprintf(stdout, "Listening on Wireless interface: [%d] %s\n", wiface_info.ifindex, wiface_info.ifname);
-
-    //-------------------------------------------------------------------------
-    // Set up to listen on both sockets
-    //-------------------------------------------------------------------------
+    if (!WcapSuppressRegenerate(&path->suppressRx, dec->tunnel, &repeat, &data, &len))
+    {
+        return false;
+    }
+    frame->data = data;
+    frame->len = len;
 
-    nfds = 0;
+    return true;
+}
 
-    gCtx.udpSockIdx = nfds++;
-    fds[gCtx.udpSockIdx].fd = gCtx.udpSock;
-    fds[gCtx.udpSockIdx].events = (POLLIN | POLLERR);
+// Injects the frames of a datagram, or hands them to the injection thread
+static void udp_frames(struct wcap_path* path, WcapDecap_t* dec, const uint64_t rxTstamp)
+{
+    WcapEncapFrame_t frame = { 0 };
+    struct wcap_path* owner = NULL;
+    uint64_t sent = 0;
 
-    gCtx.rawSockIdx = nfds++;
-    fds[gCtx.rawSockIdx].fd = gCtx.rawSock;
-    fds[gCtx.rawSockIdx].events = (POLLIN | POLLERR);
+    // Steering normally delivers a datagram to its own radio's datapath, but
+    // GRO may have merged it with datagrams for another
+    owner = &gCtx.paths[dec->tunnel * gOpts.fanout];
 
-    while (true)
+    while (WcapDecapNext(dec, &frame))
     {
-        if (poll(fds, nfds, 10000) < 0)
+        if ((frame.flags & (WCAP_ENCAP_F_NO_RADIOTAP | WCAP_ENCAP_F_META)) &&
+            !radiotap_restore(&frame))
         {
-            fprintf(stderr, "Polling error occurred\n");
-            status = false;
-            goto exit_del_addr;
+            WcapStatsAdd(path_stats(path), WCAP_STATS_UDP_RX_DROP_MALFORMED, 1);
+            continue;
+        }
+
+        // Keep beacons and probes the peer may later only repeat, and bring
+        // back the ones it did
+        if (frame.flags & WCAP_ENCAP_F_CACHE)
+        {
+            WcapRadiotapMeta_t meta = { 0 };
+            size_t rtlen = 0;
+            size_t fcs = (WcapRadiotapParse(frame.data, frame.len, &meta, &rtlen) &&
+                          (meta.flags & WCAP_RADIOTAP_F_FCS)) ? WCAP_RADIOTAP_FCS_LEN : 0;
+            WcapSuppressStore(&path->suppressRx, dec->tunnel, frame.data, frame.len, fcs);
+        }
+        else if ((frame.flags & WCAP_ENCAP_F_REPEAT) && !suppress_regenerate(path, dec, &frame))
+        {
+            WcapStatsAdd(path_stats(path), WCAP_STATS_UDP_RX_DROP_REBUILD, 1);
+            __atomic_store_n(&gCtx.suppressResend, true, __ATOMIC_RELAXED);
+            continue;
         }
-        for (int i = 0; i < nfds; i++)
+
+        // With the pipeline, injection happens on its own thread
+        if (gOpts.threads)
         {
-            if (fds[i].revents & POLLERR)
+            if (!WcapSpscPush(&gCtx.udpRing, frame.data, frame.len, rxTstamp))
             {
-                fprintf(stderr, "Socket [%d] encountered an error: [%d] %s\n", fds[i].fd, errno,
-                                strerror(errno));
-                status = false;
-                goto exit_del_addr;
+                WcapStatsAdd(path_stats(path), WCAP_STATS_UDP_RX_DROP_RING, 1);
             }
         }
-        if (fds[gCtx.udpSockIdx].revents & POLLIN)
+        else if (owner->tunnel != path->tunnel)
         {
-            char buf[8192] = { 0 };
-            int addrlen = sizeof(gCtx.dstAddr);
-            int cnt = recvfrom(fds[gCtx.udpSockIdx].fd, &buf, sizeof(buf), 0, (struct sockaddr*) &gCtx.dstAddr, &addrlen);
-            fprintf(stdout, "Received %d bytes on UDP socket: %d\n", cnt, fds[gCtx.udpSockIdx].fd);
-            cnt = sendto(gCtx.rawSock, buf, cnt, 0, NULL, 0);
-            fprintf(stdout, "Sent %d bytes on Raw socket: %d\n", cnt, fds[gCtx.rawSockIdx].fd);
+            // The owner's TX ring belongs to its thread, only the socket is
+            // safe to share
+            ssize_t cnt = sendto(owner->rawSock, frame.data, frame.len, 0, NULL, 0);
+
+            if (cnt == (ssize_t) frame.len)
+            {
+                WcapStatsAdd(path_stats(path), WCAP_STATS_UDP_RX_MISROUTED, 1);
+                inject_latency(path, rxTstamp);
+            }
+            else if ((cnt < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == ENOBUFS)))
+            {
+                WcapStatsAdd(path_stats(path), WCAP_STATS_RAW_TX_EAGAIN, 1);
+            }
+            else
+            {
+                WcapStatsAdd(path_stats(path), WCAP_STATS_RAW_TX_ERRORS, 1);
+            }
         }
-        if (fds[gCtx.rawSockIdx].revents & POLLIN)
+        else
         {
-            char buf[8192] = { 0 };
-            int cnt = recvfrom(fds[gCtx.rawSockIdx].fd, &buf, sizeof(buf), 0, NULL, NULL);
-            fprintf(stdout, "Received %d bytes on Raw socket: %d\n", cnt, fds[gCtx.rawSockIdx].fd);
-            cnt = sendto(gCtx.udpSock, buf, cnt, 0, (struct sockaddr*) &gCtx.dstAddr, sizeof(gCtx.dstAddr));
-            fprintf(stdout, "Sent %d bytes on UDP socket [%d] to %s:%d\n", cnt, fds[gCtx.udpSockIdx].fd, inet_ntoa(gCtx.dstAddr.sin_addr), ntohs(gCtx.dstAddr.sin_port));
+            udp_to_raw(path, frame.data, frame.len, rxTstamp);
+
+            // A rebuilt frame lives in the cache, which the next frame from
+            // its transmitter may reallocate before the burst is submitted
+            if ((frame.flags & WCAP_ENCAP_F_REPEAT) && path->uring.fd)
+            {
+                raw_flush(path);
+            }
         }
     }
 
-exit_del_addr:
-
-    if (!WcapIfaceInetAddrRemove(iface, addr, 16))
+    if (rxTstamp && WcapDecapSent(dec, &sent))
     {
-        fprintf(stdout, "Failed to remove link local address from interface: %s\n", iface);
+        WcapStatsRecord(path_stats(path), WCAP_STATS_LAT_TRANSIT, (int64_t) (rxTstamp - sent));
     }
+}
 
-exit_fail:
+static void reorder_arm(struct wcap_path* path)
+{
+    uint64_t deadline = WcapSeqReorderDeadline(&path->reorder);
 
-    if (gCtx.udpSock != 0)
+    if (deadline == path->reorderDeadline)
+    {
+        return;
+    }
+    if (deadline)
     {
-        close(gCtx.udpSock);
-        gCtx.udpSock = 0;
+        WcapEventTimerSetAt(path->reorderTimer, deadline);
     }
+    else
+    {
+        WcapEventTimerSet(path->reorderTimer, 0, 0);
+    }
+    path->reorderDeadline = deadline;
+}
+
+// Delivers the held datagrams that are now in order or waited long enough,
+// and with 'force' one more to make room
+static void reorder_drain(struct wcap_path* path, const uint64_t now, bool force)
+{
+    WcapSeqHeld_t* held = NULL;
+    WcapDecap_t dec = { 0 };
 
-    if (gCtx.rawSock != 0)
+    while ((held = WcapSeqReorderNext(&path->reorder, now, force)))
     {
-        close(gCtx.rawSock);
-        gCtx.rawSock = 0;
+        force = false;
+        if (WcapDecapInit(&dec, held->buf, held->len))
+        {
+            udp_frames(path, &dec, held->tstamp);
+        }
+
+        // io_uring sends from the copy, which the next held datagram reuses
+        if (path->uring.fd)
+        {
+            raw_flush(path);
+        }
+        WcapSeqReorderRelease(&path->reorder, held);
     }
+}
 
-    WcapNL80211Disconnect();
+static void udp_reorder(struct wcap_path* path, WcapSeqTrack_t* trk, WcapDecap_t* dec,
+                        const uint8_t* buf, const size_t len, const uint64_t rxTstamp)
+{
+    uint64_t now = now_ns(CLOCK_MONOTONIC);
 
-    return status;
+    // A full buffer gives up on its oldest gap to make room, which may also
+    // put this datagram in order
+    if (WcapSeqReorderFull(&path->reorder))
+    {
+        reorder_drain(path, now, true);
+    }
 
+    if (WcapSeqReorderAccept(&path->reorder, trk, dec->seq))
+    {
+        udp_frames(path, dec, rxTstamp);
+        reorder_drain(path, now, false);
+    }
+    else if (WcapSeqReorderHold(&path->reorder, trk, dec->seq, buf, len, rxTstamp, now))
+    {
+        WcapStatsAdd(path_stats(path), WCAP_STATS_UDP_RX_REORDER_HELD, 1);
+    }
+    else
+    {
+        udp_frames(path, dec, rxTstamp);
+    }
+
+    reorder_arm(path);
 }
 
-int main(int argc, char** argv)
+static void udp_datagram(struct wcap_path* path, const uint8_t* buf, const size_t len,
+                         const struct sockaddr_in* src, uint64_t rxTstamp)
 {
+    WcapDecap_t dec = { 0 };
+    WcapSession_t* session = NULL;
+    WcapSeqTrack_t* trk = NULL;
+    WcapSeqVerdict_t verdict = WCAP_SEQ_NEW;
+    WcapCompress_t was = path->decompress;
+    bool valid = false;
+    const uint8_t* data = NULL;
+    size_t dlen = 0;
+    uint64_t lost = 0;
 
-    char* progname = NULL;
-    char c;
-    bool sflag = false;
-    bool cflag = false;
-    char* addr = NULL;
-    char* wiface = NULL;
-    char* iface = NULL;
+    WCAP_TRACE("Received %zu bytes on UDP socket: %d", len, path->udpSock);
+    WcapStatsAdd(path_stats(path), WCAP_STATS_UDP_RX_DATAGRAMS, 1);
+    WcapStatsAdd(path_stats(path), WCAP_STATS_UDP_RX_BYTES, len);
 
-    // Set program name
-    progname = basename(argv[0]);
-    opterr = 0;
+    valid = WcapDecompressDatagram(&path->decompress, buf, len, &data, &dlen);
+    if (path->decompress.datagrams != was.datagrams)
+    {
+        compress_stats(path, WCAP_STATS_UDP_RX_LZ4, &was, &path->decompress);
+    }
+    if (!valid || !WcapDecapInit(&dec, data, dlen))
+    {
+        WCAP_LOG_LIMIT(WCAP_LOG_WARN, "Dropped malformed datagram from %s:%d",
+                                      inet_ntoa(src->sin_addr), ntohs(src->sin_port));
+        WcapStatsAdd(path_stats(path), WCAP_STATS_UDP_RX_DROP_MALFORMED, 1);
+        return;
+    }
 
-    // Validate number of arguments before attempting to parse command line
-    if (argc <= 1)
+    if (dec.tunnel >= gCtx.radioCount)
     {
-        usage(progname);
-        goto exit_success;
+        WCAP_LOG_LIMIT(WCAP_LOG_WARN, "Dropped datagram for unknown tunnel %u", dec.tunnel);
+        WcapStatsAdd(path_stats(path), WCAP_STATS_UDP_RX_DROP_TUNNEL, 1);
+        return;
     }
 
-    // Parse command line arguments
-    while ((c = getopt(argc, argv, "hsc:")) != -1)
+    session = WcapSessionTouch(&gCtx.sessions, src, now_ns(CLOCK_MONOTONIC));
+    if (!session)
     {
-        switch (c)
+        WCAP_LOG_LIMIT(WCAP_LOG_WARN, "Dropped datagram from %s:%d, session table full",
+                                      inet_ntoa(src->sin_addr), ntohs(src->sin_port));
+        WcapStatsAdd(path_stats(path), WCAP_STATS_UDP_RX_DROP_SESSION, 1);
+        return;
+    }
+
+    // A peer heard from for the first time, or asking for it, has none of
+    // the frames suppressed so far
+    if (!__atomic_fetch_add(&session->rxDatagrams, 1, __ATOMIC_RELAXED) ||
+        (dec.flags & WCAP_ENCAP_HDR_F_RESEND))
+    {
+        __atomic_fetch_add(&gCtx.suppressEpoch, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&session->rxBytes, len, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&session->rxFrames, dec.remain, __ATOMIC_RELAXED);
+    if (!(__atomic_load_n(&session->tunnels, __ATOMIC_RELAXED) & (1U << dec.tunnel)))
+    {
+        __atomic_fetch_or(&session->tunnels, (1U << dec.tunnel), __ATOMIC_RELAXED);
+    }
+    if (__atomic_load_n(&session->peerFlags, __ATOMIC_RELAXED) != dec.flags)
+    {
+        __atomic_store_n(&session->peerFlags, dec.flags, __ATOMIC_RELAXED);
+    }
+
+    // Each datapath of the peer numbers its datagrams, so what went missing
+    // or out of order on the way shows apart from what the radios lost
+    trk = &session->seq[dec.stream];
+    verdict = WcapSeqTrackCheck(trk, dec.seq, &lost);
+    switch (verdict)
+    {
+        case WCAP_SEQ_REORDERED:
         {
-            case 'h':
-            {
-                usage(progname);
-                goto exit_success;
-            }
-            case 's':
-            {
-                sflag = true;
-                break;
-            }
-            case 'c':
-            {
-                cflag = true;
-                addr = optarg;
-                break;
-            }
-            case 'a':
-            {
-                break;
-            }
-            case '?':
+            WcapStatsAdd(path_stats(path), WCAP_STATS_UDP_RX_SEQ_REORDERED, 1);
+            break;
+        }
+        case WCAP_SEQ_DUPLICATE:
+        {
+            // Its frames were injected already
+            WcapStatsAdd(path_stats(path), WCAP_STATS_UDP_RX_SEQ_DUPLICATE, 1);
+            return;
+        }
+        case WCAP_SEQ_LATE:
+        case WCAP_SEQ_STRAY:
+        {
+            WcapStatsAdd(path_stats(path), WCAP_STATS_UDP_RX_SEQ_LATE, 1);
+            break;
+        }
+        case WCAP_SEQ_RESYNC:
+        {
+            WCAP_LOG_LIMIT(WCAP_LOG_WARN, "Peer %s:%d restarted stream %u at datagram %u",
+                                          inet_ntoa(src->sin_addr), ntohs(src->sin_port),
+                                          dec.stream, dec.seq);
+            WcapStatsAdd(path_stats(path), WCAP_STATS_UDP_RX_SEQ_RESYNC, 1);
+            break;
+        }
+        default:
+        {
+            break;
+        }
+    }
+    if (lost)
+    {
+        WcapStatsAdd(path_stats(path), WCAP_STATS_UDP_RX_SEQ_LOST, lost);
+    }
+
+    // Where the kernel could not say, the datagram is taken as received now
+    if (gOpts.latency && !rxTstamp)
+    {
+        rxTstamp = now_ns(CLOCK_REALTIME);
+    }
+
+    // Only the tunnel's own datapath restores its order; one the tracker
+    // could not place has no order to restore and must not move it
+    if (path->reorder.size && (&gCtx.paths[dec.tunnel * gOpts.fanout] == path) &&
+        (verdict != WCAP_SEQ_LATE) && (verdict != WCAP_SEQ_STRAY))
+    {
+        udp_reorder(path, trk, &dec, data, dlen, rxTstamp);
+    }
+    else
+    {
+        udp_frames(path, &dec, rxTstamp);
+    }
+
+    // An expanded datagram is overwritten by the next one, so io_uring has to
+    // send its frames first
+    if ((data != buf) && path->uring.fd)
+    {
+        raw_flush(path);
+    }
+}
+
+static void recv_udp(struct wcap_path* path)
+{
+    int cnt = 0;
+
+    // Drain the socket a batch at a time; a short batch means it is empty
+    do
+    {
+        cnt = WcapUdpBatchRecv(&path->udpRx);
+        if (cnt > 0)
+        {
+            WcapStatsAdd(path_stats(path), WCAP_STATS_UDP_RX_BATCHES, 1);
+            WcapStatsBatch(path_stats(path), WCAP_STATS_UDP_RX_BATCH, cnt);
+        }
+        for (int i = 0; i < cnt; i++)
+        {
+            uint8_t* buf = NULL;
+            size_t len = 0;
+            size_t seg = 0;
+            uint64_t tstamp = 0;
+            struct sockaddr_in* src = NULL;
+            if (!WcapUdpBatchGet(&path->udpRx, i, &buf, &len, &src))
             {
-                if (optopt == 'c')
-                {
-                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
-                }
-                goto exit_fail;
+                continue;
             }
-            default:
+            // Split coalesced GRO buffers back into the datagrams they were
+            seg = WcapUdpBatchSegSize(&path->udpRx, i);
+            tstamp = WcapUdpBatchTstamp(&path->udpRx, i);
+            for (size_t off = 0; seg && (off < len); off += seg)
             {
-                goto exit_fail;
+                udp_datagram(path, buf + off, ((len - off) < seg) ? (len - off) : seg, src, tstamp);
             }
         }
+    } while (cnt == (int) path->udpRx.size);
+    WcapStatsSet(path_stats(path), WCAP_STATS_UDP_RX_TRUNC, path->udpRx.truncs);
+
+    if (gOpts.threads)
+    {
+        WcapSpscNotify(&gCtx.udpRing);
     }
+    else
+    {
+        raw_flush(path);
+    }
+}
 
-    // Validate command line arguments
-    if (!(cflag || sflag))
+static bool udp_setup(struct wcap_path* path, const WcapIfaceInfo_t* info)
+{
+    size_t aggsiz = agg_size(info);
+    size_t rxsiz = gOpts.udpGro ? WCAP_UDP_GSO_BUF_SIZE : WCAP_UDP_BUF_SIZE;
+    size_t txsiz = gOpts.udpGso ? WCAP_UDP_GSO_BUF_SIZE : WCAP_UDP_BUF_SIZE;
+
+    // Allocate batches for draining and emitting datagrams
+    if (!WcapUdpBatchCreate(&path->udpRx, path->udpSock, gOpts.batch, rxsiz) ||
+        !WcapUdpBatchCreate(&path->udpTx, path->udpSock, gOpts.batch, txsiz))
     {
-        fprintf(stderr, "Must specify mode\n");
-        goto exit_fail;
+        fprintf(stderr, "Failed to allocate UDP batches\n");
+        return false;
     }
-    else if (cflag && sflag)
+
+    // Aggregate captured frames into datagrams sized for the Ethernet link
+    if (!WcapEncapCreate(&path->encap, WCAP_UDP_BUF_SIZE, aggsiz))
     {
-        fprintf(stderr, "Must specify only one mode\n");
-        goto exit_fail;
+        fprintf(stderr, "Failed to set up frame aggregation\n");
+        return false;
+    }
+    path->encap.tunnel = path->tunnel;
+    path->encap.stream = path->id;
+
+    // Suppression state for each direction, each owned by its own thread
+    if (!WcapSuppressCreate(&path->suppressTx, gOpts.suppressEntries, gOpts.suppressRefresh) ||
+        !WcapSuppressCreate(&path->suppressRx, gOpts.suppressEntries, gOpts.suppressRefresh))
+    {
+        fprintf(stderr, "Failed to set up frame suppression\n");
+        return false;
     }
 
-    wiface = argv[optind++];
-    iface = argv[optind++];
+    // Compression works on whole aggregated datagrams, which is also what an
+    // expanded one may grow back to
+    if (!WcapCompressCreate(&path->compress, WCAP_UDP_BUF_SIZE, gOpts.compressMin) ||
+        !WcapCompressCreate(&path->decompress, WCAP_UDP_BUF_SIZE, 0))
+    {
+        fprintf(stderr, "Failed to set up compression\n");
+        return false;
+    }
 
-    if (sflag)
+    // Datagrams that overtook others wait for them in copies of their own
+    if (gOpts.reorder && !WcapSeqReorderCreate(&path->reorder, gOpts.reorder, WCAP_UDP_BUF_SIZE,
+                                               (gOpts.reorderDelay * 1000ULL)))
     {
-        return do_server(wiface, iface);
+        fprintf(stderr, "Failed to set up reordering\n");
+        return false;
     }
 
-    else if (cflag)
+    // Every GSO segment has to fit the link MTU without fragmentation
+    if (gOpts.udpGso)
+    {
+        if (info->mtu && ((aggsiz + 28) > info->mtu))
+        {
+            fprintf(stderr, "UDP GSO requires an aggregation size of at most %u\n", info->mtu - 28);
+            return false;
+        }
+        if (!WcapUdpBatchSetGso(&path->udpTx, aggsiz))
+        {
+            fprintf(stderr, "Failed to enable UDP GSO\n");
+            return false;
+        }
+    }
+
+    if (gOpts.udpGro && !WcapUdpBatchSetGro(&path->udpRx))
+    {
+        return false;
+    }
+
+    // Datagrams are stamped on the way in and out to time the network
+    if (gOpts.latency && !WcapUdpBatchSetTstamp(&path->udpRx))
     {
-        return do_client(wiface, iface, addr);
+        return false;
     }
+    path->encap.stamp = gOpts.latency;
+
+    return true;
+}
+
+static bool xdp_open(struct wcap_path* path, const WcapIfaceInfo_t* info)
+{
+    if (!WcapXdpProgAttach(&gCtx.xdp, info->ifindex, ntohs(gCtx.udpAddr.sin_port)))
+    {
+        fprintf(stderr, "Failed to attach XDP program to Ethernet interface: %s\n", info->ifname);
+        return false;
+    }
+
+    if (!WcapXskCreate(&path->xsk, info->ifname, gOpts.xdpQueue, gOpts.xdpFrames, gOpts.xdpCopy) ||
+        !WcapXdpProgSetSocket(&gCtx.xdp, gOpts.xdpQueue, path->xsk.fd))
+    {
+        fprintf(stderr, "Failed to open AF_XDP socket on Ethernet interface: %s\n", info->ifname);
+        return false;
+    }
+    WcapXskSetSource(&path->xsk, info->hwaddr, &gCtx.udpAddr);
+
+    // Frames leave whole, so each has to fit the link and a UMEM frame
+    if (info->mtu && ((path->encap.maxlen + 28) > info->mtu))
+    {
+        fprintf(stderr, "AF_XDP requires an aggregation size of at most %u\n", info->mtu - 28);
+        return false;
+    }
+    if (path->encap.maxlen > WCAP_XSK_PAYLOAD_MAX)
+    {
+        fprintf(stderr, "AF_XDP requires an aggregation size of at most %d\n", WCAP_XSK_PAYLOAD_MAX);
+        return false;
+    }
+
+    WCAP_INFO("AF_XDP socket on %s queue %u (%s, %s XDP)", info->ifname, gOpts.xdpQueue,
+              path->xsk.zerocopy ? "zero-copy" : "copy",
+              gCtx.xdp.generic ? "generic" : "native");
+
+    return true;
+}
+
+static bool udp_open(struct wcap_path* path, const WcapIfaceInfo_t* info)
+{
+    int one = 1;
+
+    // Open UDP socket for sending / receiving encapsulated 80211 frames
+    path->udpSock = socket(AF_INET, (SOCK_DGRAM | SOCK_NONBLOCK), 0);
+    if (path->udpSock < 0)
+    {
+        fprintf(stderr, "Failed to open UDP socket on Ethernet interface: %s\n", info->ifname);
+        path->udpSock = 0;
+        return false;
+    }
+
+    // Every worker sends from the same address and port
+    if ((gCtx.pathCount > 1) &&
+        (setsockopt(path->udpSock, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0))
+    {
+        fprintf(stderr, "Failed to share UDP port: [%d] %s\n", errno, strerror(errno));
+        return false;
+    }
+
+    // Bind UDP socket to link local address
+    if (bind(path->udpSock, (struct sockaddr*) &gCtx.udpAddr, sizeof(gCtx.udpAddr)) < 0)
+    {
+        fprintf(stderr, "Failed to bind socket to Ethernet interface: %s\n", info->ifname);
+        return false;
+    }
+
+    // Hand each datagram to the first datapath of the radio it is for, which
+    // is also where its order is restored; a single radio's workers are
+    // otherwise left whatever peers the kernel spreads over them
+    if ((gCtx.pathCount > 1) && ((gCtx.radioCount > 1) || gOpts.reorder) &&
+        !WcapUdpSteer(path->udpSock, offsetof(WcapEncapHdr_t, tunnel), gOpts.fanout))
+    {
+        return false;
+    }
+
+    // Set up batching, aggregation and offloads for the tunnel socket
+    if (!udp_setup(path, info))
+    {
+        return false;
+    }
+
+    // The UDP socket stays open for whatever the XDP program passes on, such
+    // as datagrams arriving on other queues
+    return (!gOpts.xdp || xdp_open(path, info));
+}
+
+static bool tx_ring_setup(struct wcap_path* path, const WcapWifaceInfo_t* info)
+{
+    int one = 1;
+
+    // Inject from a dedicated socket that never receives (protocol 0) so
+    // the TX ring can coexist with a TPACKET_V3 RX ring on the capture socket
+    path->txSock = socket(AF_PACKET, (SOCK_RAW | SOCK_NONBLOCK), 0);
+    if (path->txSock < 0)
+    {
+        fprintf(stderr, "Failed to open injection socket on monitor interface: %s\n", info->ifname);
+        path->txSock = 0;
+        return false;
+    }
+
+    if (bind(path->txSock, (struct sockaddr*) &path->rawAddr, sizeof(path->rawAddr)) < 0)
+    {
+        fprintf(stderr, "Failed to bind injection socket to monitor interface: %s\n", info->ifname);
+        return false;
+    }
+
+    if (!WcapTxRingCreate(&path->txRing, path->txSock, gOpts.txFrameSize, gOpts.txFrameCount,
+                          gOpts.txBypass))
+    {
+        return false;
+    }
+
+    // Frames injected by another socket would otherwise be captured on the way
+    // out and forwarded straight back over the tunnel
+    if (setsockopt(path->rawSock, SOL_PACKET, PACKET_IGNORE_OUTGOING, &one, sizeof(one)) < 0)
+    {
+        fprintf(stderr, "Failed to ignore outgoing frames on monitor interface: %s\n", info->ifname);
+        return false;
+    }
+
+    return true;
+}
+
+static void tx_ring_teardown(struct wcap_path* path)
+{
+    if (path->txSock != 0)
+    {
+        if (path->txRing.kicks)
+        {
+            WCAP_INFO("TX ring: %llu frames in %llu kicks (%.1f frames/kick), %llu dropped",
+                      (unsigned long long) path->txRing.frames,
+                      (unsigned long long) path->txRing.kicks,
+                      (double) path->txRing.frames / path->txRing.kicks,
+                      (unsigned long long) path->txRing.drops);
+        }
+        WcapTxRingDestroy(&path->txRing);
+        close(path->txSock);
+        path->txSock = 0;
+    }
+}
+
+static bool raw_open(struct wcap_path* path, const WcapWifaceInfo_t* info)
+{
+    // Open raw socket for sending / receiving on monitor interface
+    path->rawSock = socket(AF_PACKET, (SOCK_RAW | SOCK_NONBLOCK), htons(ETH_P_ALL));
+    if (path->rawSock < 0)
+    {
+        fprintf(stderr, "Failed to open raw socket on monitor interface: %s\n", info->ifname);
+        path->rawSock = 0;
+        return false;
+    }
+
+    // Filter before binding so no unfiltered frame is ever queued
+    if (gCtx.filter.code && !WcapFilterAttach(&gCtx.filter, path->rawSock))
+    {
+        fprintf(stderr, "Failed to filter capture on monitor interface: %s\n", info->ifname);
+        return false;
+    }
+
+    // Bind raw socket to monitor interface
+    if (bind(path->rawSock, (struct sockaddr*) &path->rawAddr, sizeof(path->rawAddr)) < 0)
+    {
+        fprintf(stderr, "Failed to bind socket to monitor interface: %s\n", info->ifname);
+        return false;
+    }
+
+    // Frames are stamped as the driver hands them over rather than when read
+    if (gOpts.latency && !WcapTstampEnable(path->rawSock))
+    {
+        return false;
+    }
+
+    // Optionally capture through a shared memory ring instead of recvfrom()
+    if (gOpts.rxRing && !WcapRxRingCreate(&path->rxRing, path->rawSock, gOpts.rxBlockSize,
+                                          gOpts.rxBlockCount, gOpts.rxRetireMs))
+    {
+        fprintf(stderr, "Failed to set up RX ring on monitor interface: %s\n", info->ifname);
+        return false;
+    }
+
+    // Spread capture over the radio's workers, one fanout group per radio
+    if ((gOpts.fanout > 1) && !WcapFanoutJoin(path->rawSock, ((getpid() + path->tunnel) & 0xffff),
+                                              gOpts.fanoutMode, gOpts.fanout))
+    {
+        fprintf(stderr, "Failed to set up capture fanout on monitor interface: %s\n", info->ifname);
+        return false;
+    }
+
+    // Optionally inject through a shared memory ring instead of sendto()
+    if (gOpts.txRing && !tx_ring_setup(path, info))
+    {
+        fprintf(stderr, "Failed to set up TX ring on monitor interface: %s\n", info->ifname);
+        return false;
+    }
+
+    return true;
+}
+
+static bool record_open(struct wcap_path* path, const WcapWifaceInfo_t* info)
+{
+    char name[PATH_MAX];
+
+    if (!gOpts.record)
+    {
+        return true;
+    }
+
+    // Every datapath records on its own, without sharing a lock
+    if (gCtx.pathCount > 1)
+    {
+        snprintf(name, sizeof(name), "%s-%u", gOpts.record, path->id);
+    }
+    else
+    {
+        snprintf(name, sizeof(name), "%s", gOpts.record);
+    }
+
+    if (!WcapPcapngCreate(&path->record, name, info->ifname, ((size_t) gOpts.recordBuffer << 20),
+                          ((uint64_t) gOpts.recordSize << 20), gOpts.recordTime,
+                          gOpts.recordDirect))
+    {
+        fprintf(stderr, "Failed to set up recording to %s\n", name);
+        return false;
+    }
+
+    WCAP_INFO("Recording wireless interface %s to %s", info->ifname, name);
+
+    return true;
+}
+
+static bool radio_open(const char* wiface, const unsigned int tunnel)
+{
+    WcapWifaceInfo_t wiface_info = { 0 };
+    struct sockaddr_ll raw_addr = { 0 };
+
+    if (!WcapNL80211WifaceGet(wiface, &wiface_info))
+    {
+        // A link that is no radio, such as the veth or TAP a test stands in
+        // for one with, carries the frames as they are
+        if (!WcapIfaceInfoGet(wiface, &wiface_info.iface))
+        {
+            fprintf(stderr, "Failed to find interface: %s\n", wiface);
+            return false;
+        }
+        wiface_info.ifindex = wiface_info.iface.ifindex;
+        snprintf(wiface_info.ifname, sizeof(wiface_info.ifname), "%s", wiface_info.iface.ifname);
+        WCAP_WARN("Interface %s is not a wireless interface, using it as a plain link", wiface);
+    }
+
+    WCAP_INFO("Found wireless interface: [%d] %s (%02x:%02x:%02x:%02x:%02x:%02x)",
+              wiface_info.ifindex, wiface_info.ifname,
+              wiface_info.iface.hwaddr[0], wiface_info.iface.hwaddr[1],
+              wiface_info.iface.hwaddr[2],
+              wiface_info.iface.hwaddr[3], wiface_info.iface.hwaddr[4],
+              wiface_info.iface.hwaddr[5]);
+
+    // Set the monitor interface's state to administratively up
+    wiface_info.iface.flags |= (IFF_UP | IFF_RUNNING);
+    if (!WcapIfaceInfoSet(wiface, &wiface_info.iface))
+    {
+        fprintf(stderr, "Failed to bring interface '%s' up\n", wiface);
+        return false;
+    }
+
+    // Construct raw socket address of monitor interface
+    raw_addr.sll_ifindex = wiface_info.ifindex;
+    raw_addr.sll_family = AF_PACKET;
+    raw_addr.sll_protocol = htons(ETH_P_ALL);
+    raw_addr.sll_pkttype = PACKET_HOST;
+
+    // Open a raw socket for each of the radio's datapaths
+    for (unsigned int i = 0; i < gOpts.fanout; i++)
+    {
+        struct wcap_path* path = &gCtx.paths[(tunnel * gOpts.fanout) + i];
+        path->rawAddr = raw_addr;
+        if (!raw_open(path, &wiface_info) || !record_open(path, &wiface_info))
+        {
+            return false;
+        }
+    }
+
+    WCAP_INFO("Listening on Wireless interface: [%d] %s (tunnel %u)", wiface_info.ifindex,
+              wiface_info.ifname, tunnel);
+
+    return true;
+}
+
+static void uring_teardown(struct wcap_path* path)
+{
+    if (path->uring.fd)
+    {
+        WCAP_INFO("io_uring [%d]: %llu completions, %llu requests in %llu enters, "
+                  "%llu send errors, %llu/%llu raw/UDP buffer exhaustions", path->uring.fd,
+                  (unsigned long long) path->uring.completed,
+                  (unsigned long long) path->uring.submitted,
+                  (unsigned long long) path->uring.enters,
+                  (unsigned long long) path->uringSendErrs,
+                  (unsigned long long) path->rawBufs.exhausted,
+                  (unsigned long long) path->udpBufs.exhausted);
+        WcapUringBufDestroy(&path->uring, &path->rawBufs);
+        WcapUringBufDestroy(&path->uring, &path->udpBufs);
+        WcapUringDestroy(&path->uring);
+    }
+}
+
+static bool paths_create(const unsigned int radios)
+{
+    char name[WCAP_STATS_NAME_LEN];
+
+    // Peers are shared by every datapath, read by the main thread and any
+    // worker
+    if (!WcapSessionTableCreate(&gCtx.sessions, gOpts.maxSessions,
+                                (gOpts.sessionIdle * 1000000000ULL),
+                                (1 + (((radios * gOpts.fanout) > THREAD_MAX) ?
+                                      (radios * gOpts.fanout) : THREAD_MAX))))
+    {
+        return false;
+    }
+
+    // Datapaths are grouped by radio, the workers of tunnel N start at N * fanout
+    gCtx.radioCount = radios;
+    gCtx.pathCount = radios * gOpts.fanout;
+    gCtx.paths = calloc(gCtx.pathCount, sizeof(*gCtx.paths));
+    if (!gCtx.paths)
+    {
+        fprintf(stderr, "Failed to allocate %u datapaths\n", gCtx.pathCount);
+        gCtx.pathCount = 0;
+        return false;
+    }
+
+    // Counters live in shared memory, where wcap-top can find them
+    if (!gOpts.statsShm)
+    {
+        snprintf(name, sizeof(name), "%s%d", WCAP_STATS_PREFIX, (int) getpid());
+    }
+    // A slot for each datapath, one for the main thread to poll its kernel
+    // counters into, and with the pipeline one for each thread after the first
+    if (!WcapStatsCreate(&gCtx.stats, (gOpts.statsShm ? gOpts.statsShm : name),
+                         ((gCtx.pathCount * 2) + (gOpts.threads ? (THREAD_MAX - 1) : 0))))
+    {
+        free(gCtx.paths);
+        gCtx.paths = NULL;
+        gCtx.pathCount = 0;
+        return false;
+    }
+    if (gCtx.stats.owner)
+    {
+        WCAP_INFO("Publishing statistics at /dev/shm%s", gCtx.stats.name);
+    }
+
+    // Captured frames are read straight into these, and handed between
+    // threads by reference; the pipeline needs enough to fill its ring
+    if (!gOpts.poolFrames)
+    {
+        gOpts.poolFrames = gOpts.threads ? (gOpts.ringSize + (2 * WCAP_POOL_CACHE_MAX)) :
+                                           (gCtx.pathCount * WCAP_POOL_CACHE_BATCH);
+    }
+    if (!WcapPoolCreate(&gCtx.pool, gOpts.poolFrames, WCAP_UDP_BUF_SIZE, gOpts.poolHuge))
+    {
+        WcapStatsDestroy(&gCtx.stats);
+        free(gCtx.paths);
+        gCtx.paths = NULL;
+        gCtx.pathCount = 0;
+        return false;
+    }
+
+    for (unsigned int i = 0; i < gCtx.pathCount; i++)
+    {
+        WcapPoolCacheInit(&gCtx.paths[i].rxCache, &gCtx.pool);
+        WcapPoolCacheInit(&gCtx.paths[i].txCache, &gCtx.pool);
+        gCtx.paths[i].id = i;
+        gCtx.paths[i].tunnel = i / gOpts.fanout;
+        gCtx.paths[i].stats = WcapStatsSlot(&gCtx.stats, i);
+        snprintf(gCtx.paths[i].stats->name, WCAP_STATS_NAME_LEN, "worker %u, tunnel %u", i,
+                 gCtx.paths[i].tunnel);
+        gCtx.paths[i].kstats = WcapStatsSlot(&gCtx.stats, (gCtx.pathCount + i));
+        gCtx.paths[i].kstats->datapath = i;
+        snprintf(gCtx.paths[i].kstats->name, WCAP_STATS_NAME_LEN, "worker %u, kernel", i);
+    }
+
+    return true;
+}
+
+static void paths_destroy(void)
+{
+    for (unsigned int i = 0; i < gCtx.pathCount; i++)
+    {
+        struct wcap_path* path = &gCtx.paths[i];
+
+        if (path->udpSock != 0)
+        {
+            WcapUdpBatchDestroy(&path->udpRx);
+            WcapUdpBatchDestroy(&path->udpTx);
+            WcapEncapDestroy(&path->encap);
+            if (path->suppressTx.frames || path->suppressRx.frames)
+            {
+                WCAP_INFO("Worker %u: %llu beacons/probes sent, %llu suppressed; "
+                          "%llu cached, %llu rebuilt, %llu not rebuilt (%llu out of date)",
+                          path->id, (unsigned long long) path->suppressTx.frames,
+                          (unsigned long long) path->suppressTx.repeats,
+                          (unsigned long long) path->suppressRx.frames,
+                          (unsigned long long) path->suppressRx.repeats,
+                          (unsigned long long) path->suppressRx.misses,
+                          (unsigned long long) path->suppressRx.stale);
+            }
+            WcapSuppressDestroy(&path->suppressTx);
+            WcapSuppressDestroy(&path->suppressRx);
+            if (path->compress.datagrams)
+            {
+                WCAP_INFO("Worker %u: LZ4 compressed %llu of %llu datagrams (%llu small, "
+                          "%llu incompressible), ratio %.2f, %.0f ns each", path->id,
+                          (unsigned long long) path->compress.packed,
+                          (unsigned long long) path->compress.datagrams,
+                          (unsigned long long) path->compress.small,
+                          (unsigned long long) path->compress.incompressible,
+                          path->compress.bytesOut ?
+                          ((double) path->compress.bytesIn / path->compress.bytesOut) : 0.0,
+                          (path->compress.packed + path->compress.incompressible) ?
+                          ((double) path->compress.ns /
+                           (path->compress.packed + path->compress.incompressible)) : 0.0);
+            }
+            if (path->decompress.datagrams)
+            {
+                WCAP_INFO("Worker %u: LZ4 expanded %llu datagrams (%llu malformed), "
+                          "%.0f ns each", path->id,
+                          (unsigned long long) path->decompress.packed,
+                          (unsigned long long) path->decompress.errors,
+                          (double) path->decompress.ns / path->decompress.datagrams);
+            }
+            WcapCompressDestroy(&path->compress);
+            WcapCompressDestroy(&path->decompress);
+            if (path->reorder.holds)
+            {
+                WCAP_INFO("Worker %u: held %llu datagrams to restore their order, gave up on "
+                          "%llu gaps (%llu to make room), %u left held", path->id,
+                          (unsigned long long) path->reorder.holds,
+                          (unsigned long long) path->reorder.skips,
+                          (unsigned long long) path->reorder.forced, path->reorder.count);
+            }
+            WcapSeqReorderDestroy(&path->reorder);
+            close(path->udpSock);
+            path->udpSock = 0;
+        }
+
+        if (gOpts.radiotap != RADIOTAP_KEEP)
+        {
+            WCAP_INFO("Worker %u: %lld tunnel bytes saved on radiotap headers", path->id,
+                      (long long) path->radiotapSaved);
+        }
+
+        tx_ring_teardown(path);
+        uring_teardown(path);
+
+        if (path->xsk.fd)
+        {
+            WCAP_INFO("AF_XDP [%d]: %llu datagrams in (%llu not ours), %llu out, "
+                      "%llu dropped, %llu awaiting ARP", path->xsk.fd,
+                      (unsigned long long) path->xsk.rxPackets,
+                      (unsigned long long) path->xsk.rxInvalid,
+                      (unsigned long long) path->xsk.txPackets,
+                      (unsigned long long) path->xsk.txDrops,
+                      (unsigned long long) path->xsk.unresolved);
+            WcapXskDestroy(&path->xsk);
+        }
+
+        if (path->record.started)
+        {
+            WcapPcapngDestroy(&path->record);
+            WCAP_INFO("Worker %u: recorded %llu frames to %u files, %llu dropped, "
+                      "%llu write errors", path->id,
+                      (unsigned long long) path->record.frames, path->record.files,
+                      (unsigned long long) path->record.drops,
+                      (unsigned long long) path->record.writeErrors);
+        }
+
+        if (path->rawSock != 0)
+        {
+            WcapRxRingDestroy(&path->rxRing);
+            close(path->rawSock);
+            path->rawSock = 0;
+        }
+    }
+
+    WcapXdpProgDetach(&gCtx.xdp);
+    WcapSessionTableDestroy(&gCtx.sessions);
+    WcapStatsDestroy(&gCtx.stats);
+
+    if (gCtx.pool.exhausted)
+    {
+        WCAP_INFO("Frame pool: %u buffers%s, ran out %llu times", gCtx.pool.count,
+                  gCtx.pool.huge ? " in huge pages" : "",
+                  (unsigned long long) gCtx.pool.exhausted);
+    }
+    WcapPoolDestroy(&gCtx.pool);
+
+    free(gCtx.paths);
+    gCtx.paths = NULL;
+    gCtx.pathCount = 0;
+    gCtx.radioCount = 0;
+}
+
+// Queues a captured frame for the encapsulation thread; one already in a pool
+// buffer goes by reference, anything else is copied into one
+static void raw_handoff(struct wcap_path* path, WcapPoolBuf_t* pbuf, const void* buf,
+                        const int len, const uint64_t tstamp)
+{
+    if (pbuf)
+    {
+        WcapPoolRef(pbuf);
+    }
+    else if ((size_t) len > gCtx.pool.bufsiz)
+    {
+        WcapStatsAdd(path_stats(path), WCAP_STATS_RAW_RX_TRUNC, 1);
+        return;
+    }
+    else if (!(pbuf = WcapPoolGet(&path->rxCache)))
+    {
+        WcapStatsAdd(path_stats(path), WCAP_STATS_RAW_RX_DROP_POOL, 1);
+        return;
+    }
+    else
+    {
+        memcpy(pbuf->data, buf, len);
+    }
+    pbuf->len = len;
+    pbuf->tstamp = tstamp;
+
+    if (!WcapSpscPush(&gCtx.rawRing, &pbuf, sizeof(pbuf), tstamp))
+    {
+        WcapStatsAdd(path_stats(path), WCAP_STATS_RAW_RX_DROP_RING, 1);
+        WcapPoolPut(&path->rxCache, pbuf);
+    }
+}
+
+static void raw_frame(struct wcap_path* path, WcapPoolBuf_t* pbuf, const void* buf,
+                      const int len, const uint64_t tstamp)
+{
+    WcapStatsAdd(path_stats(path), WCAP_STATS_RAW_RX_FRAMES, 1);
+    WcapStatsAdd(path_stats(path), WCAP_STATS_RAW_RX_BYTES, (len > 0) ? len : 0);
+
+    // Recording is a copy into the write-behind buffer, never a wait
+    if (path->record.started && (len > 0) &&
+        !WcapPcapngWrite(&path->record, buf, len, tstamp))
+    {
+        WcapStatsSet(path_stats(path), WCAP_STATS_RAW_RX_DROP_RECORD, path->record.drops);
+    }
+
+    // With the pipeline, encapsulation happens on its own thread
+    if (gOpts.threads)
+    {
+        if (len > 0)
+        {
+            raw_handoff(path, pbuf, buf, len, tstamp);
+        }
+    }
+    else
+    {
+        raw_to_udp(path, buf, len, tstamp);
+    }
+}
+
+static void recv_raw(struct wcap_path* path)
+{
+    WcapStatsAdd(path_stats(path), WCAP_STATS_RAW_RX_BURSTS, 1);
+
+    if (path->rxRing.map)
+    {
+        uint8_t* frame = NULL;
+        size_t len = 0;
+        uint64_t tstamp = 0;
+
+        // Walk every frame in the blocks the kernel has retired so far
+        while (WcapRxRingRecv(&path->rxRing, &frame, &len, &tstamp))
+        {
+            WCAP_TRACE("Received %zu bytes on Raw ring: %d", len, path->rawSock);
+            raw_frame(path, NULL, frame, len, tstamp);
+        }
+    }
+    else
+    {
+        uint8_t scrap[64];
+        uint8_t ctrl[WCAP_TSTAMP_CTRL_SIZE];
+        struct iovec iov = { 0 };
+        struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1 };
+        uint64_t tstamp = 0;
+        int cnt = 0;
+
+        for (;;)
+        {
+            // Frames are read straight into a pool buffer; while there are
+            // none they are still read, so the socket drains, but dropped
+            if (!path->rxBuf)
+            {
+                path->rxBuf = WcapPoolGet(&path->rxCache);
+            }
+            iov.iov_base = path->rxBuf ? path->rxBuf->data : scrap;
+            iov.iov_len = path->rxBuf ? gCtx.pool.bufsiz : sizeof(scrap);
+            msg.msg_control = ctrl;
+            msg.msg_controllen = sizeof(ctrl);
+
+            // MSG_TRUNC gives away frames longer than the buffer
+            cnt = recvmsg(path->rawSock, &msg, MSG_TRUNC);
+            if (cnt < 0)
+            {
+                break;
+            }
+            WCAP_TRACE("Received %d bytes on Raw socket: %d", cnt, path->rawSock);
+            if (!path->rxBuf)
+            {
+                WcapStatsAdd(path_stats(path), WCAP_STATS_RAW_RX_DROP_POOL, 1);
+                continue;
+            }
+            if (cnt > (int) iov.iov_len)
+            {
+                WcapStatsAdd(path_stats(path), WCAP_STATS_RAW_RX_TRUNC, 1);
+                cnt = iov.iov_len;
+            }
+            tstamp = WcapTstampGet(&msg);
+            raw_frame(path, path->rxBuf, path->rxBuf->data, cnt,
+                      tstamp ? tstamp : now_ns(CLOCK_REALTIME));
+
+            // Reuse the buffer unless it went on to another thread
+            if (__atomic_load_n(&path->rxBuf->refs, __ATOMIC_ACQUIRE) > 1)
+            {
+                WcapPoolPut(&path->rxCache, path->rxBuf);
+                path->rxBuf = NULL;
+            }
+        }
+    }
+
+    if (gOpts.threads)
+    {
+        WcapSpscNotify(&gCtx.rawRing);
+    }
+    else
+    {
+        udp_burst_end(path);
+    }
+}
+
+static void sock_error(const int fd)
+{
+    int err = 0;
+    socklen_t len = sizeof(err);
+
+    // Reading the pending error clears it; errors such as ICMP port unreachable
+    // from a peer that has gone away are reported but are not fatal; another
+    // reader may have cleared it first, leaving nothing to report
+    if ((getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == 0) && err)
+    {
+        WCAP_ERR("Socket [%d] encountered an error: [%d] %s", fd, err, strerror(err));
+    }
+}
+
+static void on_udp(WcapEventLoop_t* loop, const int fd, const uint32_t events, void* arg)
+{
+    (void) loop;
+    if (events & EPOLLERR)
+    {
+        sock_error(fd);
+    }
+    if (events & EPOLLIN)
+    {
+        struct wcap_path* path = arg;
+        session_enter();
+        recv_udp(path);
+        session_leave(path->reorder.count);
+    }
+}
+
+static void on_raw(WcapEventLoop_t* loop, const int fd, const uint32_t events, void* arg)
+{
+    (void) loop;
+    if (events & EPOLLERR)
+    {
+        sock_error(fd);
+    }
+    if (events & EPOLLIN)
+    {
+        session_enter();
+        recv_raw(arg);
+        session_leave(false);
+    }
+}
+
+static void on_xsk(WcapEventLoop_t* loop, const int fd, const uint32_t events, void* arg)
+{
+    struct wcap_path* path = arg;
+    const uint8_t* buf = NULL;
+    size_t len = 0;
+    struct sockaddr_in src = { 0 };
+    unsigned int cnt = 0;
+
+    (void) loop;
+    (void) fd;
+    (void) events;
+    session_enter();
+    while (WcapXskRecv(&path->xsk, &buf, &len, &src))
+    {
+        udp_datagram(path, buf, len, &src, 0);
+        cnt++;
+    }
+    if (cnt)
+    {
+        WcapStatsAdd(path_stats(path), WCAP_STATS_UDP_RX_BATCHES, 1);
+        WcapStatsBatch(path_stats(path), WCAP_STATS_UDP_RX_BATCH, cnt);
+    }
+
+    // Injection copies the frames, so the UMEM can have them back afterwards
+    raw_flush(path);
+    session_leave(path->reorder.count);
+    WcapXskRelease(&path->xsk);
+}
+
+static size_t uring_gro_size(const WcapUringMsg_t* msg)
+{
+    struct msghdr hdr = { .msg_control = msg->ctrl, .msg_controllen = msg->ctrllen };
+    struct cmsghdr* cmsg = NULL;
+    int segsiz = 0;
+
+    // A coalesced GRO buffer holds equally sized segments
+    for (cmsg = (msg->ctrl ? CMSG_FIRSTHDR(&hdr) : NULL); cmsg; cmsg = CMSG_NXTHDR(&hdr, cmsg))
+    {
+        if ((cmsg->cmsg_level == SOL_UDP) && (cmsg->cmsg_type == UDP_GRO))
+        {
+            memcpy(&segsiz, CMSG_DATA(cmsg), sizeof(segsiz));
+        }
+    }
+
+    return (segsiz > 0) ? (size_t) segsiz : msg->len;
+}
+
+static uint64_t uring_tstamp(const WcapUringMsg_t* msg)
+{
+    struct msghdr hdr = { .msg_control = msg->ctrl, .msg_controllen = msg->ctrllen };
+
+    return WcapTstampGet(&hdr);
+}
+
+static void uring_raw(struct wcap_path* path, const struct io_uring_cqe* cqe)
+{
+    uint8_t* buf = WcapUringBufGet(&path->rawBufs, cqe);
+
+    if (cqe->res == -ENOBUFS)
+    {
+        path->rawBufs.exhausted++;
+    }
+    if (buf && (cqe->res > 0))
+    {
+        WCAP_TRACE("Received %d bytes on Raw socket: %d", cqe->res, path->rawSock);
+        raw_frame(path, NULL, buf, cqe->res, now_ns(CLOCK_REALTIME));
+    }
+
+    WcapUringBufRecycle(&path->rawBufs, cqe);
+}
+
+static void uring_udp(struct wcap_path* path, const struct io_uring_cqe* cqe)
+{
+    uint8_t* buf = WcapUringBufGet(&path->udpBufs, cqe);
+    WcapUringMsg_t msg = { 0 };
+    size_t seg = 0;
+    uint64_t tstamp = 0;
+
+    if (cqe->res == -ENOBUFS)
+    {
+        path->udpBufs.exhausted++;
+    }
+    if (buf && WcapUringMsgParse(&path->udpMsg, buf, cqe->res, &msg))
+    {
+        if ((msg.flags & MSG_TRUNC) || (msg.namelen < sizeof(struct sockaddr_in)))
+        {
+            path->udpRx.truncs++;
+            WcapStatsSet(path_stats(path), WCAP_STATS_UDP_RX_TRUNC, path->udpRx.truncs);
+        }
+        else
+        {
+            // Split coalesced GRO buffers back into the datagrams they were
+            seg = uring_gro_size(&msg);
+            tstamp = uring_tstamp(&msg);
+            for (size_t off = 0; seg && (off < msg.len); off += seg)
+            {
+                udp_datagram(path, msg.data + off, ((msg.len - off) < seg) ? (msg.len - off) : seg,
+                             (struct sockaddr_in*) msg.name, tstamp);
+            }
+        }
+    }
+
+    WcapUringBufRecycle(&path->udpBufs, cqe);
+}
+
+static bool uring_arm(struct wcap_path* path, const bool raw, const bool udp)
+{
+    // Buffers go back to the kernel before receives that need them
+    WcapUringBufCommit(&path->rawBufs);
+    WcapUringBufCommit(&path->udpBufs);
+
+    if ((raw && !WcapUringRecvMultishot(&path->uring, path->rawSock, URING_RAW_RECV,
+                                        URING_RAW_RECV)) ||
+        (udp && !WcapUringRecvmsgMultishot(&path->uring, path->udpSock, &path->udpMsg,
+                                           URING_UDP_RECV, URING_UDP_RECV)))
+    {
+        return false;
+    }
+
+    return (WcapUringSubmit(&path->uring, 0) >= 0);
+}
+
+static void on_uring(WcapEventLoop_t* loop, const int fd, const uint32_t events, void* arg)
+{
+    struct wcap_path* path = arg;
+    struct io_uring_cqe* cqe = NULL;
+    bool raw = false;
+    bool udp = false;
+    unsigned int rawCnt = 0;
+    unsigned int udpCnt = 0;
+
+    (void) fd;
+    (void) events;
+    session_enter();
+    while ((cqe = WcapUringPeek(&path->uring)))
+    {
+        switch (cqe->user_data)
+        {
+            case URING_RAW_RECV:
+            {
+                uring_raw(path, cqe);
+                raw |= !(cqe->flags & IORING_CQE_F_MORE);
+                rawCnt++;
+                break;
+            }
+            case URING_UDP_RECV:
+            {
+                uring_udp(path, cqe);
+                udp |= !(cqe->flags & IORING_CQE_F_MORE);
+                udpCnt++;
+                break;
+            }
+            case URING_RAW_SEND:
+            {
+                // Successful sends post nothing where the kernel allows it
+                if (cqe->res < 0)
+                {
+                    path->uringSendErrs++;
+                    WcapStatsAdd(path_stats(path), (cqe->res == -EAGAIN) ? WCAP_STATS_RAW_TX_EAGAIN :
+                                                                      WCAP_STATS_RAW_TX_ERRORS, 1);
+                }
+                break;
+            }
+            default:
+            {
+                if (cqe->res < 0)
+                {
+                    path->uringSendErrs++;
+                    path->udpTx.drops++;
+                }
+                break;
+            }
+        }
+        WcapUringSeen(&path->uring);
+    }
+
+    if (rawCnt)
+    {
+        WcapStatsAdd(path_stats(path), WCAP_STATS_RAW_RX_BURSTS, 1);
+    }
+    if (udpCnt)
+    {
+        WcapStatsAdd(path_stats(path), WCAP_STATS_UDP_RX_BATCHES, 1);
+        WcapStatsBatch(path_stats(path), WCAP_STATS_UDP_RX_BATCH, udpCnt);
+    }
+
+    // Everything the burst produced leaves in one io_uring_enter()
+    udp_burst_end(path);
+    raw_flush(path);
+    session_leave(path->reorder.count);
+
+    // Only now may the kernel reuse the buffers injected frames were sent
+    // from; a receive stops when it runs out of buffers and is rearmed
+    if (!uring_arm(path, raw, udp))
+    {
+        WCAP_ERR("Failed to rearm io_uring receives");
+        WcapEventLoopStop(loop);
+    }
+}
+
+static bool uring_setup(WcapEventLoop_t* loop, struct wcap_path* path)
+{
+    size_t rxsiz = gOpts.udpGro ? WCAP_UDP_GSO_BUF_SIZE : WCAP_UDP_BUF_SIZE;
+
+    // Each UDP buffer holds the recvmsg() header, the source address and the
+    // GRO control message ahead of the payload
+    path->udpMsg.msg_namelen = sizeof(struct sockaddr_in);
+    path->udpMsg.msg_controllen = (gOpts.udpGro ? CMSG_SPACE(sizeof(int)) : 0) +
+                                  (gOpts.latency ? WCAP_TSTAMP_CTRL_SIZE : 0);
+    rxsiz += sizeof(struct io_uring_recvmsg_out) + path->udpMsg.msg_namelen +
+             path->udpMsg.msg_controllen;
+
+    if (!WcapUringCreate(&path->uring, WCAP_URING_ENTRIES_DEF) ||
+        !WcapUringBufCreate(&path->uring, &path->rawBufs, URING_RAW_RECV, gOpts.uringBufs, 8192) ||
+        !WcapUringBufCreate(&path->uring, &path->udpBufs, URING_UDP_RECV, gOpts.uringBufs, rxsiz) ||
+        !uring_arm(path, true, true))
+    {
+        fprintf(stderr, "Failed to set up io_uring datapath\n");
+        return false;
+    }
+
+    // The ring descriptor turns readable whenever completions are waiting
+    return WcapEventAdd(loop, path->uring.fd, EPOLLIN, on_uring, path);
+}
+
+static void on_agg_timer(WcapEventLoop_t* loop, const uint64_t expirations, void* arg)
+{
+    struct wcap_path* path = arg;
+
+    (void) loop;
+    (void) expirations;
+    path->aggArmed = false;
+    session_enter();
+    encap_close(path);
+    udp_flush(path);
+    session_leave(false);
+}
+
+static void on_reorder_timer(WcapEventLoop_t* loop, const uint64_t expirations, void* arg)
+{
+    struct wcap_path* path = arg;
+
+    (void) loop;
+    (void) expirations;
+    path->reorderDeadline = 0;
+    session_enter();
+    reorder_drain(path, now_ns(CLOCK_MONOTONIC), false);
+    session_leave(path->reorder.count);
+    reorder_arm(path);
+
+    if (gOpts.threads)
+    {
+        WcapSpscNotify(&gCtx.udpRing);
+    }
+    else
+    {
+        raw_flush(path);
+    }
+}
+
+static void on_replay_timer(WcapEventLoop_t* loop, const uint64_t expirations, void* arg)
+{
+    struct wcap_path* path = arg;
+    const uint8_t* frame = NULL;
+    size_t len = 0;
+    uint64_t due = 0;
+    uint64_t now = 0;
+
+    (void) expirations;
+
+    // Everything already due goes out in one burst, short enough that a
+    // signal is not kept waiting when replaying flat out
+    for (unsigned int burst = 0; ; burst++)
+    {
+        now = now_ns(CLOCK_MONOTONIC);
+        if (!WcapReplayPeek(&gCtx.replay, now, &frame, &len, &due))
+        {
+            raw_flush(path);
+            WcapEventLoopStop(loop);
+            return;
+        }
+        if ((due > now) || (burst == WCAP_REPLAY_BURST))
+        {
+            break;
+        }
+        udp_to_raw(path, frame, len, 0);
+        WcapReplaySent(&gCtx.replay, now);
+    }
+    raw_flush(path);
+
+    WcapEventTimerSetAt(gCtx.replayTimer, due);
+}
+
+static void on_signal(WcapEventLoop_t* loop, const int signo, void* arg)
+{
+    (void) arg;
+    WCAP_INFO("Caught signal %d, shutting down", signo);
+    WcapEventLoopStop(loop);
+}
+
+static void on_raw_ring(WcapEventLoop_t* loop, const int fd, const uint32_t events, void* arg)
+{
+    struct wcap_path* path = arg;
+    uint8_t* slot = NULL;
+    size_t len = 0;
+    WcapPoolBuf_t* pbuf = NULL;
+
+    (void) loop;
+    (void) fd;
+    (void) events;
+
+    // The ring carries references, the frames stay where they were captured
+    session_enter();
+    WcapSpscClear(&gCtx.rawRing);
+    while (WcapSpscPeek(&gCtx.rawRing, &slot, &len, NULL))
+    {
+        memcpy(&pbuf, slot, sizeof(pbuf));
+        WcapSpscPop(&gCtx.rawRing);
+        raw_to_udp(path, pbuf->data, pbuf->len, pbuf->tstamp);
+        WcapPoolPut(&path->txCache, pbuf);
+    }
+
+    udp_burst_end(path);
+    session_leave(false);
+}
+
+static void on_udp_ring(WcapEventLoop_t* loop, const int fd, const uint32_t events, void* arg)
+{
+    struct wcap_path* path = arg;
+    uint8_t* frame = NULL;
+    size_t len = 0;
+    uint64_t rxTstamp = 0;
+
+    (void) loop;
+    (void) fd;
+    (void) events;
+    WcapSpscClear(&gCtx.udpRing);
+    while (WcapSpscPeek(&gCtx.udpRing, &frame, &len, &rxTstamp))
+    {
+        udp_to_raw(path, frame, len, rxTstamp);
+        WcapSpscPop(&gCtx.udpRing);
+    }
+
+    raw_flush(path);
+}
+
+static void ring_stats(const char* name, WcapSpsc_t* ring)
+{
+    WCAP_INFO("%s ring: %u queued, %u peak, %llu frames, %llu dropped", name,
+              WcapSpscCount(ring), ring->peak, (unsigned long long) ring->pushed,
+              (unsigned long long) ring->drops);
+}
+
+static void sessions_print(void)
+{
+    WcapSession_t* session = NULL;
+    unsigned int iter = 0;
+
+    while ((session = WcapSessionNext(&gCtx.sessions, &iter)))
+    {
+        session_print(session, "");
+    }
+
+    if (gCtx.sessions.refused)
+    {
+        WCAP_INFO("Refused %llu sessions, table full",
+                  (unsigned long long) gCtx.sessions.refused);
+    }
+}
+
+static void on_session_timer(WcapEventLoop_t* loop, const uint64_t expirations, void* arg)
+{
+    (void) loop;
+    (void) expirations;
+    (void) arg;
+    WcapSessionExpire(&gCtx.sessions, now_ns(CLOCK_MONOTONIC), session_print, " expired");
+}
+
+static void on_stats_timer(WcapEventLoop_t* loop, const uint64_t expirations, void* arg)
+{
+    (void) loop;
+    (void) expirations;
+    (void) arg;
+    sessions_print();
+
+    if (gOpts.threads)
+    {
+        ring_stats("Wireless->UDP", &gCtx.rawRing);
+        ring_stats("UDP->Wireless", &gCtx.udpRing);
+    }
+
+    for (unsigned int i = 0; (gCtx.pathCount > 1) && (i < gCtx.pathCount); i++)
+    {
+        WcapStatsSlot_t* slot = gCtx.paths[i].stats;
+        WCAP_INFO("Worker %u (tunnel %u): %llu frames captured, %llu frames injected, "
+                  "%llu misrouted", i, gCtx.paths[i].tunnel,
+                  (unsigned long long) WcapStatsGet(slot, WCAP_STATS_RAW_RX_FRAMES),
+                  (unsigned long long) WcapStatsGet(slot, WCAP_STATS_RAW_TX_FRAMES),
+                  (unsigned long long) WcapStatsGet(slot, WCAP_STATS_UDP_RX_MISROUTED));
+    }
+}
+
+static void on_kernel_stats_timer(WcapEventLoop_t* loop, const uint64_t expirations, void* arg)
+{
+    (void) loop;
+    (void) expirations;
+    (void) arg;
+    for (unsigned int i = 0; i < gCtx.pathCount; i++)
+    {
+        struct wcap_path* path = &gCtx.paths[i];
+        struct tpacket_stats_v3 tp = { 0 };
+        uint32_t mem[SK_MEMINFO_VARS] = { 0 };
+        socklen_t len = sizeof(tp);
+
+        // PACKET_STATISTICS counts from the last time it was read
+        if (path->rawSock &&
+            (getsockopt(path->rawSock, SOL_PACKET, PACKET_STATISTICS, &tp, &len) == 0))
+        {
+            WcapStatsAdd(path->kstats, WCAP_STATS_RAW_RX_DROP_KERNEL, tp.tp_drops);
+        }
+
+        len = sizeof(mem);
+        if (path->udpSock && (getsockopt(path->udpSock, SOL_SOCKET, SO_MEMINFO, mem, &len) == 0))
+        {
+            WcapStatsSet(path->kstats, WCAP_STATS_UDP_RX_DROP_KERNEL, mem[SK_MEMINFO_DROPS]);
+        }
+    }
+}
+
+static void* thread_main(void* arg)
+{
+    struct wcap_thread* thread = arg;
+
+    tReader = 1 + (thread - gCtx.threads);
+    tStats = thread->stats;
+    thread->status = WcapEventLoopRun(&thread->loop);
+
+    // Send whatever was still waiting on its deadline
+    if (thread->flush)
+    {
+        session_enter();
+        encap_close(thread->path);
+        udp_flush(thread->path);
+    }
+    WcapSessionLeave(&gCtx.sessions, tReader);
+
+    // One thread failing brings the whole process down
+    if (!thread->status)
+    {
+        WCAP_ERR("Thread '%s' exited on error", thread->name);
+        WcapEventLoopStop(&gCtx.loop);
+    }
+
+    return NULL;
+}
+
+static bool thread_start(const unsigned int idx)
+{
+    struct wcap_thread* thread = &gCtx.threads[idx];
+    pthread_attr_t attr;
+    int cpu = (idx < gOpts.cpuCount) ? gOpts.cpus[idx] : -1;
+    int err = 0;
+
+    pthread_attr_init(&attr);
+
+    if (cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+    }
+
+    // Without CAP_SYS_NICE or an RLIMIT_RTPRIO this fails the thread's start
+    if (gOpts.schedFifo)
+    {
+        struct sched_param param = { .sched_priority = gOpts.schedFifo };
+        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+        pthread_attr_setschedparam(&attr, &param);
+    }
+
+    err = pthread_create(&thread->tid, &attr, thread_main, thread);
+    pthread_attr_destroy(&attr);
+    if (err)
+    {
+        fprintf(stderr, "Failed to start thread '%s': [%d] %s\n", thread->name, err, strerror(err));
+        return false;
+    }
+
+    thread->started = true;
+    WCAP_INFO("Started thread '%s' (cpu: %d)", thread->name, cpu);
+
+    return true;
+}
+
+static bool pipeline_setup(void)
+{
+    struct wcap_thread* threads = gCtx.threads;
+    struct wcap_path* path = &gCtx.paths[0];
+    static const char* names[THREAD_MAX] = { "wireless-rx", "udp-tx", "udp-rx", "wireless-tx" };
+
+    if (!WcapSpscCreate(&gCtx.rawRing, gOpts.ringSize, sizeof(WcapPoolBuf_t*)) ||
+        !WcapSpscCreate(&gCtx.udpRing, gOpts.ringSize, WCAP_UDP_BUF_SIZE))
+    {
+        return false;
+    }
+
+    // The first thread counts in the datapath's own slot, the rest in the
+    // slots that follow the kernel's
+    for (int i = 0; i < THREAD_MAX; i++)
+    {
+        snprintf(threads[i].name, sizeof(threads[i].name), "%s", names[i]);
+        threads[i].path = path;
+        threads[i].stats = path->stats;
+        if (i)
+        {
+            threads[i].stats = WcapStatsSlot(&gCtx.stats, ((gCtx.pathCount * 2) + i - 1));
+            threads[i].stats->datapath = path->id;
+            snprintf(threads[i].stats->name, WCAP_STATS_NAME_LEN, "worker %u, %s", path->id,
+                     names[i]);
+        }
+    }
+    threads[THREAD_UDP_TX].flush = true;
+
+    if (!WcapEventAdd(&threads[THREAD_RAW_RX].loop, path->rawSock, EPOLLIN, on_raw, path) ||
+        !WcapEventAdd(&threads[THREAD_UDP_TX].loop, gCtx.rawRing.efd, EPOLLIN, on_raw_ring, path) ||
+        !WcapEventAdd(&threads[THREAD_UDP_RX].loop, path->udpSock, EPOLLIN, on_udp, path) ||
+        !WcapEventAdd(&threads[THREAD_RAW_TX].loop, gCtx.udpRing.efd, EPOLLIN, on_udp_ring, path))
+    {
+        return false;
+    }
+
+    path->aggTimer = WcapEventTimerAdd(&threads[THREAD_UDP_TX].loop, on_agg_timer, path);
+    if (gOpts.reorder)
+    {
+        path->reorderTimer = WcapEventTimerAdd(&threads[THREAD_UDP_RX].loop, on_reorder_timer,
+                                               path);
+    }
+
+    return ((path->aggTimer >= 0) && (path->reorderTimer >= 0));
+}
+
+static bool path_attach(WcapEventLoop_t* loop, struct wcap_path* path)
+{
+    if (gOpts.io == IO_URING)
+    {
+        // The sockets are only ever read through the ring
+        if (!uring_setup(loop, path))
+        {
+            return false;
+        }
+    }
+    // Every source is edge-triggered, the socket handlers drain until EAGAIN
+    else if (!WcapEventAdd(loop, path->udpSock, EPOLLIN, on_udp, path) ||
+             !WcapEventAdd(loop, path->rawSock, EPOLLIN, on_raw, path))
+    {
+        return false;
+    }
+
+    if (path->xsk.fd && !WcapEventAdd(loop, path->xsk.fd, EPOLLIN, on_xsk, path))
+    {
+        return false;
+    }
+
+    // Partial datagrams are flushed from a timer rather than a poll timeout,
+    // and held ones let go of the same way
+    path->aggTimer = WcapEventTimerAdd(loop, on_agg_timer, path);
+    if (gOpts.reorder)
+    {
+        path->reorderTimer = WcapEventTimerAdd(loop, on_reorder_timer, path);
+    }
+
+    return ((path->aggTimer >= 0) && (path->reorderTimer >= 0));
+}
+
+// Datapath loops spin and busy poll as asked; a kernel without per epoll
+// busy polling still has the sockets' own and net.core.busy_poll
+static void loop_tune(WcapEventLoop_t* loop)
+{
+    WcapEventLoopSetSpin(loop, (gOpts.spinUs * 1000ULL));
+    if (gOpts.busyPoll &&
+        !WcapEventLoopSetBusyPoll(loop, gOpts.busyPoll, gOpts.busyPollBudget, gOpts.preferBusyPoll))
+    {
+        WCAP_WARN("epoll_wait() will not busy poll, see net.core.busy_poll");
+    }
+}
+
+static void loop_stats(const char* name, WcapEventLoop_t* loop)
+{
+    if (loop->spin)
+    {
+        WCAP_DEBUG("%s: %llu empty polls spun, %llu blocking waits", name,
+                   (unsigned long long) loop->spins, (unsigned long long) loop->sleeps);
+    }
+}
+
+static bool paths_busy_poll(void)
+{
+    for (unsigned int i = 0; i < gCtx.pathCount; i++)
+    {
+        struct wcap_path* path = &gCtx.paths[i];
+        int fds[] = { path->rawSock, path->txSock, path->udpSock, path->xsk.fd };
+
+        for (unsigned int f = 0; f < (sizeof(fds) / sizeof(fds[0])); f++)
+        {
+            if ((fds[f] > 0) &&
+                !WcapEventSockBusyPoll(fds[f], gOpts.busyPoll, gOpts.busyPollBudget,
+                                       gOpts.preferBusyPoll))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Without threads the main thread is the datapath, it takes the first CPU
+static bool main_tune(void)
+{
+    int err = 0;
+
+    if (gOpts.cpuCount && (gOpts.cpus[0] >= 0))
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(gOpts.cpus[0], &set);
+        err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err)
+        {
+            fprintf(stderr, "Failed to pin to CPU %d: [%d] %s\n", gOpts.cpus[0], err, strerror(err));
+            return false;
+        }
+    }
+
+    if (gOpts.schedFifo)
+    {
+        struct sched_param param = { .sched_priority = gOpts.schedFifo };
+        err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err)
+        {
+            fprintf(stderr, "Failed to set SCHED_FIFO priority %u: [%d] %s\n", gOpts.schedFifo,
+                    err, strerror(err));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool threads_start(void)
+{
+    gCtx.threadCount = gOpts.threads ? THREAD_MAX : gCtx.pathCount;
+    gCtx.threads = calloc(gCtx.threadCount, sizeof(*gCtx.threads));
+    if (!gCtx.threads)
+    {
+        gCtx.threadCount = 0;
+        return false;
+    }
+
+    for (unsigned int i = 0; i < gCtx.threadCount; i++)
+    {
+        if (!WcapEventLoopCreate(&gCtx.threads[i].loop))
+        {
+            return false;
+        }
+        loop_tune(&gCtx.threads[i].loop);
+    }
+
+    // Every source is wired up before any thread runs so nothing is missed
+    if (gOpts.threads)
+    {
+        if (!pipeline_setup())
+        {
+            return false;
+        }
+    }
+    else
+    {
+        // A worker owns a whole datapath
+        for (unsigned int i = 0; i < gCtx.threadCount; i++)
+        {
+            struct wcap_thread* thread = &gCtx.threads[i];
+            snprintf(thread->name, sizeof(thread->name), "worker-%u", i);
+            thread->path = &gCtx.paths[i];
+            thread->flush = true;
+            if (!path_attach(&thread->loop, thread->path))
+            {
+                return false;
+            }
+        }
+    }
+
+    for (unsigned int i = 0; i < gCtx.threadCount; i++)
+    {
+        if (!thread_start(i))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool threads_stop(void)
+{
+    bool status = true;
+
+    for (unsigned int i = 0; i < gCtx.threadCount; i++)
+    {
+        WcapEventLoopStop(&gCtx.threads[i].loop);
+    }
+
+    for (unsigned int i = 0; i < gCtx.threadCount; i++)
+    {
+        if (gCtx.threads[i].started)
+        {
+            pthread_join(gCtx.threads[i].tid, NULL);
+            status &= gCtx.threads[i].status;
+            loop_stats(gCtx.threads[i].name, &gCtx.threads[i].loop);
+        }
+        WcapEventLoopDestroy(&gCtx.threads[i].loop);
+    }
+
+    if (gCtx.threadCount)
+    {
+        on_stats_timer(NULL, 0, NULL);
+    }
+
+    WcapSpscDestroy(&gCtx.rawRing);
+    WcapSpscDestroy(&gCtx.udpRing);
+    free(gCtx.threads);
+    gCtx.threads = NULL;
+    gCtx.threadCount = 0;
+
+    return status;
+}
+
+static bool wcap_run(void)
+{
+    bool threaded = (gOpts.threads || (gCtx.pathCount > 1));
+    bool status = true;
+    int kernelTimer = 0;
+
+    // From here on nothing on the datapath waits for stdout
+    if (!WcapLogStart(gOpts.logRing))
+    {
+        return false;
+    }
+
+    if (!WcapEventLoopCreate(&gCtx.loop))
+    {
+        WcapLogStop();
+        return false;
+    }
+
+    if (gOpts.busyPoll && !paths_busy_poll())
+    {
+        status = false;
+        goto exit;
+    }
+
+    // Shut down cleanly so the link local address gets removed; signals are
+    // blocked before any thread is started so only this loop sees them
+    if ((WcapEventSignalAdd(&gCtx.loop, SIGINT, on_signal, NULL) < 0) ||
+        (WcapEventSignalAdd(&gCtx.loop, SIGTERM, on_signal, NULL) < 0))
+    {
+        status = false;
+        goto exit;
+    }
+
+    if (threaded)
+    {
+        // This thread is left with signals and statistics only
+        if (!threads_start())
+        {
+            status = false;
+            goto exit;
+        }
+
+        if (gOpts.statsInterval)
+        {
+            int fd = WcapEventTimerAdd(&gCtx.loop, on_stats_timer, NULL);
+            uint64_t interval = gOpts.statsInterval * 1000000000ULL;
+            if ((fd < 0) || !WcapEventTimerSet(fd, interval, interval))
+            {
+                status = false;
+                goto exit;
+            }
+        }
+    }
+    else if (!main_tune() || !path_attach(&gCtx.loop, &gCtx.paths[0]))
+    {
+        status = false;
+        goto exit;
+    }
+    else
+    {
+        loop_tune(&gCtx.loop);
+    }
+
+    // Drops inside the kernel are picked up once a second
+    kernelTimer = WcapEventTimerAdd(&gCtx.loop, on_kernel_stats_timer, NULL);
+    if ((kernelTimer < 0) || !WcapEventTimerSet(kernelTimer, 1000000000ULL, 1000000000ULL))
+    {
+        status = false;
+        goto exit;
+    }
+
+    // Idle sessions are swept once a second
+    if (gOpts.sessionIdle)
+    {
+        int fd = WcapEventTimerAdd(&gCtx.loop, on_session_timer, NULL);
+        if ((fd < 0) || !WcapEventTimerSet(fd, 1000000000ULL, 1000000000ULL))
+        {
+            status = false;
+            goto exit;
+        }
+    }
+
+    status = WcapEventLoopRun(&gCtx.loop);
+
+    // Send whatever was still waiting on its deadline
+    if (!threaded)
+    {
+        encap_close(&gCtx.paths[0]);
+        udp_flush(&gCtx.paths[0]);
+    }
+
+exit:
+
+    if (threaded && !threads_stop())
+    {
+        status = false;
+    }
+
+    sessions_print();
+
+    if (!threaded)
+    {
+        loop_stats("main", &gCtx.loop);
+    }
+    WcapEventLoopDestroy(&gCtx.loop);
+
+    WcapLogStop();
+
+    return status;
+}
+
+static bool do_server(const char** wifaces, const unsigned int count, const char* iface)
+{
+
+    bool status = true;
+    bool hwsim = true;
+    WcapIfaceInfo_t iface_info = { 0 };
+    char addr[16] = { 0 };
+
+    errno = 0;
+
+    // Validity check arguments
+    if ((iface == NULL) || !strlen(iface))
+    {
+        fprintf(stderr, "Invalid ethernet interface name");
+        return false;
+    }
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if ((wifaces[i] == NULL) || !strlen(wifaces[i]))
+        {
+            fprintf(stderr, "Invalid wireless interface name");
+            return false;
+        }
+    }
+
+    // Allocate the datapaths of every radio
+    if (!paths_create(count))
+    {
+        return false;
+    }
+
+    // Connect NL80211 netlink socket for managing wireless interfaces
+    if (!WcapGENLConnect())
+    {
+        fprintf(stderr, "Failed to connect General netlink socket\n");
+        status = false;
+        goto exit_fail;
+    }
+
+    // Connect Route netlink socket for managing ethernet interfaces
+    if (!WcapRTNLConnect())
+    {
+        fprintf(stderr, "Failed to connect Route netlink socket\n");
+        status = false;
+        goto exit_fail;
+    }
+
+    //-------------------------------------------------------------------------
+    // Retrieve information about Ethernet interface
+    //-------------------------------------------------------------------------
+
+    if (!WcapIfaceInfoGet(iface, &iface_info))
+    {
+        fprintf(stderr, "Failed to find interface: %s\n", iface);
+        status = false;
+        goto exit_fail;
+    }
+
+    WCAP_INFO("Found ethernet interface: [%d] %s (%02x:%02x:%02x:%02x:%02x:%02x)",
+              iface_info.ifindex, iface_info.ifname,
+              iface_info.hwaddr[0], iface_info.hwaddr[1], iface_info.hwaddr[2],
+              iface_info.hwaddr[3], iface_info.hwaddr[4], iface_info.hwaddr[5]);
+
+    // Construct link local address using the last two octets of the interface's MAC
+    snprintf(addr, 16, "169.254.%d.%d", iface_info.hwaddr[4], iface_info.hwaddr[5]);
+
+    // Add address to interface
+    if (!WcapIfaceInetAddrAdd(iface, addr, 16))
+    {
+        WCAP_WARN("Failed to add link local address to interface: %s", iface);
+    }
+
+    // Set the interface's state to administratively up
+    iface_info.flags |= (IFF_UP | IFF_RUNNING);
+    if (!WcapIfaceInfoSet(iface, &iface_info))
+    {
+        fprintf(stderr, "Failed to bring interface '%s' up\n", iface);
+        status = false;
+        goto exit_del_addr;
+    }
+
+    // Set up IP address for UDP socket
+    gCtx.udpAddr.sin_family = AF_INET;
+    gCtx.udpAddr.sin_addr.s_addr = inet_addr(addr);
+    gCtx.udpAddr.sin_port = htons(8888);
+
+    // Open a UDP socket per datapath for the encapsulated 80211 frames
+    for (unsigned int i = 0; i < gCtx.pathCount; i++)
+    {
+        if (!udp_open(&gCtx.paths[i], &iface_info))
+        {
+            status = false;
+            goto exit_del_addr;
+        }
+    }
+
+    WCAP_INFO("Listening on Ethernet interface: %s (%s)", iface, addr);
+
+    //-------------------------------------------------------------------------
+    // Retrieve information about each wireless interface
+    //-------------------------------------------------------------------------
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (!radio_open(wifaces[i], i))
+        {
+            status = false;
+            goto exit_del_addr;
+        }
+    }
+
+    //-------------------------------------------------------------------------
+    // Listen on both sockets until told to stop
+    //-------------------------------------------------------------------------
+
+    status = wcap_run();
+
+exit_del_addr:
+
+    if (!WcapIfaceInetAddrRemove(iface, addr, 16))
+    {
+        WCAP_WARN("Failed to remove link local address from interface: %s", iface);
+    }
+
+exit_fail:
+
+    paths_destroy();
+
+    WcapNL80211Disconnect();
+
+    return status;
+
+}
+
+bool do_client(const char** wifaces, const unsigned int count, const char* iface,
+               const char* dst)
+{
+
+    bool status = true;
+    WcapIfaceInfo_t iface_info = { 0 };
+    char addr[16] = { 0 };
+    struct sockaddr_in dst_addr = { 0 };
+    WcapSession_t* session = NULL;
+
+    errno = 0;
+
+    // Validity check arguments
+    if ((iface == NULL) || !strlen(iface))
+    {
+        fprintf(stderr, "Invalid ethernet interface name");
+        return false;
+    }
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if ((wifaces[i] == NULL) || !strlen(wifaces[i]))
+        {
+            fprintf(stderr, "Invalid wireless interface name");
+            return false;
+        }
+    }
+
+    // Allocate the datapaths of every radio
+    if (!paths_create(count))
+    {
+        return false;
+    }
+
+    // Connect NL80211 netlink socket for managing wireless interfaces
+    if (!WcapGENLConnect())
+    {
+        fprintf(stderr, "Failed to connect General netlink socket\n");
+        status = false;
+        goto exit_fail;
+    }
+
+    // Connect Route netlink socket for managing ethernet interfaces
+    if (!WcapRTNLConnect())
+    {
+        fprintf(stderr, "Failed to connect Route netlink socket\n");
+        status = false;
+        goto exit_fail;
+    }
+
+    //-------------------------------------------------------------------------
+    // Retrieve information about Ethernet interface
+    //-------------------------------------------------------------------------
+
+    if (!WcapIfaceInfoGet(iface, &iface_info))
+    {
+        fprintf(stderr, "Failed to find interface: %s\n", iface);
+        status = false;
+        goto exit_fail;
+    }
+
+    WCAP_INFO("Found ethernet interface: [%d] %s (%02x:%02x:%02x:%02x:%02x:%02x)",
+              iface_info.ifindex, iface_info.ifname,
+              iface_info.hwaddr[0], iface_info.hwaddr[1], iface_info.hwaddr[2],
+              iface_info.hwaddr[3], iface_info.hwaddr[4], iface_info.hwaddr[5]);
+    WCAP_DEBUG("Flags: 0x%08x", iface_info.flags);
+
+    // Construct link local address using the last two octets of the interface's MAC
+    snprintf(addr, 16, "169.254.%d.%d", iface_info.hwaddr[4], iface_info.hwaddr[5]);
+
+    // Add address to interface
+    if (!WcapIfaceInetAddrAdd(iface, addr, 16))
+    {
+        WCAP_WARN("Failed to add link local address to interface: %s", iface);
+    }
+
+    // Set the interface's state to administratively up
+    iface_info.flags |= (IFF_UP | IFF_RUNNING);
+    if (!WcapIfaceInfoSet(iface, &iface_info))
+    {
+        fprintf(stderr, "Failed to bring interface '%s' up\n", iface);
+        status = false;
+        goto exit_del_addr;
+    }
+
+    // Set up IP address for UDP socket
+    gCtx.udpAddr.sin_family = AF_INET;
+    gCtx.udpAddr.sin_addr.s_addr = inet_addr(addr);
+    gCtx.udpAddr.sin_port = htons(8888);
+
+    // Set up IP address of server
+    dst_addr.sin_family = AF_INET;
+    dst_addr.sin_addr.s_addr = inet_addr(dst);
+    dst_addr.sin_port = htons(8888);
+
+    // The server is always a destination, whether or not it has spoken
+    session = WcapSessionTouch(&gCtx.sessions, &dst_addr, now_ns(CLOCK_MONOTONIC));
+    if (!session)
+    {
+        status = false;
+        goto exit_del_addr;
+    }
+    session->fixed = true;
+    session->tunnels = UINT32_MAX;
+
+    // Open a UDP socket per datapath for the encapsulated 80211 frames
+    for (unsigned int i = 0; i < gCtx.pathCount; i++)
+    {
+        if (!udp_open(&gCtx.paths[i], &iface_info))
+        {
+            status = false;
+            goto exit_del_addr;
+        }
+    }
+
+    WCAP_INFO("Listening on Ethernet interface: %s (%s)", iface, addr);
+
+    //-------------------------------------------------------------------------
+    // Retrieve information about each wireless interface
+    //-------------------------------------------------------------------------
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (!radio_open(wifaces[i], i))
+        {
+            status = false;
+            goto exit_del_addr;
+        }
+    }
+
+    //-------------------------------------------------------------------------
+    // Listen on both sockets until told to stop
+    //-------------------------------------------------------------------------
+
+    status = wcap_run();
+
+exit_del_addr:
+
+    if (!WcapIfaceInetAddrRemove(iface, addr, 16))
+    {
+        WCAP_WARN("Failed to remove link local address from interface: %s", iface);
+    }
+
+exit_fail:
+
+    paths_destroy();
+
+    WcapNL80211Disconnect();
+
+    return status;
+
+}
+
+static bool do_replay(const char* wiface, const char* file)
+{
+
+    bool status = true;
+    struct wcap_path* path = NULL;
+    struct sock_filter drop = BPF_STMT(BPF_RET | BPF_K, 0);
+    struct sock_fprog prog = { .len = 1, .filter = &drop };
+
+    // Validity check arguments
+    if ((wiface == NULL) || !strlen(wiface))
+    {
+        fprintf(stderr, "Invalid wireless interface name");
+        return false;
+    }
+
+    if (!WcapReplayCreate(&gCtx.replay, file, gOpts.replayTimed, gOpts.replayLoops))
+    {
+        fprintf(stderr, "Failed to open capture file: %s\n", file);
+        return false;
+    }
+
+    if (!paths_create(1))
+    {
+        WcapReplayDestroy(&gCtx.replay);
+        return false;
+    }
+    path = &gCtx.paths[0];
+
+    if (!WcapGENLConnect())
+    {
+        fprintf(stderr, "Failed to connect General netlink socket\n");
+        status = false;
+        goto exit_fail;
+    }
+
+    if (!WcapRTNLConnect())
+    {
+        fprintf(stderr, "Failed to connect Route netlink socket\n");
+        status = false;
+        goto exit_fail;
+    }
+
+    if (!radio_open(wiface, 0))
+    {
+        status = false;
+        goto exit_fail;
+    }
+
+    // Nothing is read back while replaying, so nothing should be queued
+    if (setsockopt(path->rawSock, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0)
+    {
+        fprintf(stderr, "Failed to stop capture on monitor interface: %s\n", wiface);
+    }
+
+    // Wake up as close to each frame's time as the timer allows
+    if (gOpts.replayTimed)
+    {
+        prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+    }
+
+    if (!WcapEventLoopCreate(&gCtx.loop))
+    {
+        status = false;
+        goto exit_fail;
+    }
+
+    gCtx.replayTimer = WcapEventTimerAdd(&gCtx.loop, on_replay_timer, path);
+    if ((WcapEventSignalAdd(&gCtx.loop, SIGINT, on_signal, NULL) < 0) ||
+        (WcapEventSignalAdd(&gCtx.loop, SIGTERM, on_signal, NULL) < 0) ||
+        (gCtx.replayTimer < 0) ||
+        !WcapEventTimerSetAt(gCtx.replayTimer, now_ns(CLOCK_MONOTONIC)))
+    {
+        status = false;
+    }
+    else if (!WcapLogStart(gOpts.logRing))
+    {
+        status = false;
+    }
+    else
+    {
+        status = WcapEventLoopRun(&gCtx.loop);
+        WcapLogStop();
+    }
+
+    WcapEventLoopDestroy(&gCtx.loop);
+
+    WcapReplayPrint(&gCtx.replay, stdout);
+    WCAP_INFO("Injected %llu frames, %llu failed",
+              (unsigned long long) WcapStatsGet(path->stats, WCAP_STATS_RAW_TX_FRAMES),
+              (unsigned long long) (WcapStatsGet(path->stats, WCAP_STATS_RAW_TX_EAGAIN) +
+                                    WcapStatsGet(path->stats, WCAP_STATS_RAW_TX_ERRORS)));
+
+exit_fail:
+
+    paths_destroy();
+
+    WcapNL80211Disconnect();
+
+    WcapReplayDestroy(&gCtx.replay);
+
+    return status;
+
+}
+
+int main(int argc, char** argv)
+{
+
+    char* progname = NULL;
+    int c;
+    bool sflag = false;
+    bool cflag = false;
+    bool dflag = false;
+    bool rflag = false;
+    bool status = false;
+    char* addr = NULL;
+    char* filter = NULL;
+    char* replay = NULL;
+    const char** wifaces = NULL;
+    unsigned int count = 0;
+    char* iface = NULL;
+
+    // Set program name
+    progname = basename(argv[0]);
+    opterr = 0;
+
+    // Validate number of arguments before attempting to parse command line
+    if (argc <= 1)
+    {
+        usage(progname);
+        goto exit_success;
+    }
+
+    // Parse command line arguments
+    while ((c = getopt_long(argc, argv, "hsc:f:r:", gLongOpts, NULL)) != -1)
+    {
+        switch (c)
+        {
+            case 'h':
+            {
+                usage(progname);
+                goto exit_success;
+            }
+            case 's':
+            {
+                sflag = true;
+                break;
+            }
+            case 'c':
+            {
+                cflag = true;
+                addr = optarg;
+                break;
+            }
+            case 'a':
+            {
+                break;
+            }
+            case 'f':
+            {
+                filter = optarg;
+                break;
+            }
+            case 'r':
+            {
+                rflag = true;
+                replay = optarg;
+                break;
+            }
+            case OPT_FILTER_DUMP:
+            {
+                dflag = true;
+                break;
+            }
+            case OPT_RX_RING:
+            {
+                gOpts.rxRing = true;
+                break;
+            }
+            case OPT_RX_BLOCK_SIZE:
+            {
+                if (!parse_uint(optarg, &gOpts.rxBlockSize))
+                {
+                    fprintf(stderr, "Invalid RX ring block size: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_RX_BLOCK_COUNT:
+            {
+                if (!parse_uint(optarg, &gOpts.rxBlockCount) || !gOpts.rxBlockCount)
+                {
+                    fprintf(stderr, "Invalid RX ring block count: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_RX_RETIRE_MS:
+            {
+                if (!parse_uint(optarg, &gOpts.rxRetireMs))
+                {
+                    fprintf(stderr, "Invalid RX ring retire timeout: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_TX_RING:
+            {
+                gOpts.txRing = true;
+                break;
+            }
+            case OPT_TX_FRAME_SIZE:
+            {
+                if (!parse_uint(optarg, &gOpts.txFrameSize))
+                {
+                    fprintf(stderr, "Invalid TX ring frame size: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_TX_FRAME_COUNT:
+            {
+                if (!parse_uint(optarg, &gOpts.txFrameCount) || !gOpts.txFrameCount)
+                {
+                    fprintf(stderr, "Invalid TX ring frame count: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_TX_BATCH:
+            {
+                if (!parse_uint(optarg, &gOpts.txBatch) || !gOpts.txBatch)
+                {
+                    fprintf(stderr, "Invalid TX ring batch size: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_TX_QDISC_BYPASS:
+            {
+                gOpts.txBypass = true;
+                break;
+            }
+            case OPT_AGG_SIZE:
+            {
+                if (!parse_uint(optarg, &gOpts.aggSize) ||
+                    (gOpts.aggSize <= WCAP_ENCAP_OVERHEAD(1)))
+                {
+                    fprintf(stderr, "Invalid aggregation size: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_AGG_DELAY:
+            {
+                if (!parse_uint(optarg, &gOpts.aggDelay))
+                {
+                    fprintf(stderr, "Invalid aggregation delay: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_UDP_GSO:
+            {
+                gOpts.udpGso = true;
+                break;
+            }
+            case OPT_UDP_GRO:
+            {
+                gOpts.udpGro = true;
+                break;
+            }
+            case OPT_THREADS:
+            {
+                gOpts.threads = true;
+                break;
+            }
+            case OPT_CPU_LIST:
+            {
+                if (!parse_cpu_list(optarg, gOpts.cpus, &gOpts.cpuCount, WCAP_FANOUT_MAX))
+                {
+                    fprintf(stderr, "Invalid CPU list: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_RING_SIZE:
+            {
+                if (!parse_uint(optarg, &gOpts.ringSize) || !gOpts.ringSize ||
+                    (gOpts.ringSize > WCAP_SPSC_COUNT_MAX))
+                {
+                    fprintf(stderr, "Invalid ring size: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_STATS_INTERVAL:
+            {
+                if (!parse_uint(optarg, &gOpts.statsInterval))
+                {
+                    fprintf(stderr, "Invalid statistics interval: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_STATS_SHM:
+            {
+                gOpts.statsShm = optarg;
+                break;
+            }
+            case OPT_LATENCY:
+            {
+                gOpts.latency = true;
+                break;
+            }
+            case OPT_LOG_LEVEL:
+            {
+                if (!WcapLogLevelParse(optarg, &gWcapLogLevel))
+                {
+                    fprintf(stderr, "Invalid log level: %s\n", optarg);
+                    goto exit_fail;
+                }
+                if (gWcapLogLevel > WCAP_LOG_LEVEL_MAX)
+                {
+                    fprintf(stderr, "Log level %s is not built in, see --with-log-level\n", optarg);
+                }
+                break;
+            }
+            case OPT_POOL_FRAMES:
+            {
+                if (!parse_uint(optarg, &gOpts.poolFrames) || !gOpts.poolFrames ||
+                    (gOpts.poolFrames > WCAP_POOL_COUNT_MAX))
+                {
+                    fprintf(stderr, "Invalid frame pool size: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_POOL_HUGE:
+            {
+                gOpts.poolHuge = true;
+                break;
+            }
+            case OPT_LOW_LATENCY:
+            {
+                gOpts.lowLatency = true;
+                break;
+            }
+            case OPT_BUSY_POLL:
+            {
+                if (!parse_uint(optarg, &gOpts.busyPoll) || (gOpts.busyPoll > INT32_MAX))
+                {
+                    fprintf(stderr, "Invalid busy poll time: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_BUSY_POLL_BUDGET:
+            {
+                if (!parse_uint(optarg, &gOpts.busyPollBudget) || (gOpts.busyPollBudget > 0xffff))
+                {
+                    fprintf(stderr, "Invalid busy poll budget: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_PREFER_BUSY_POLL:
+            {
+                gOpts.preferBusyPoll = true;
+                break;
+            }
+            case OPT_SPIN_US:
+            {
+                if (!parse_uint(optarg, &gOpts.spinUs))
+                {
+                    fprintf(stderr, "Invalid spin time: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_SCHED_FIFO:
+            {
+                if (!parse_uint(optarg, &gOpts.schedFifo) ||
+                    (gOpts.schedFifo < (unsigned int) sched_get_priority_min(SCHED_FIFO)) ||
+                    (gOpts.schedFifo > (unsigned int) sched_get_priority_max(SCHED_FIFO)))
+                {
+                    fprintf(stderr, "Invalid SCHED_FIFO priority: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_LOG_RING:
+            {
+                if (!parse_uint(optarg, &gOpts.logRing) || !gOpts.logRing ||
+                    (gOpts.logRing > WCAP_LOG_COUNT_MAX))
+                {
+                    fprintf(stderr, "Invalid log ring size: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_FANOUT:
+            {
+                if (!parse_uint(optarg, &gOpts.fanout) || !gOpts.fanout ||
+                    (gOpts.fanout > WCAP_FANOUT_MAX))
+                {
+                    fprintf(stderr, "Invalid fanout worker count: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_FANOUT_MODE:
+            {
+                if (!parse_fanout_mode(optarg, &gOpts.fanoutMode))
+                {
+                    fprintf(stderr, "Invalid fanout mode: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_MAX_SESSIONS:
+            {
+                if (!parse_uint(optarg, &gOpts.maxSessions) || !gOpts.maxSessions ||
+                    (gOpts.maxSessions > WCAP_SESSION_MAX))
+                {
+                    fprintf(stderr, "Invalid session count: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_SESSION_IDLE:
+            {
+                if (!parse_uint(optarg, &gOpts.sessionIdle))
+                {
+                    fprintf(stderr, "Invalid session idle timeout: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_SESSION_SEND:
+            {
+                if (!strcmp(optarg, "all"))
+                {
+                    gOpts.sessionSend = SESSION_SEND_ALL;
+                }
+                else if (!strcmp(optarg, "tunnel"))
+                {
+                    gOpts.sessionSend = SESSION_SEND_TUNNEL;
+                }
+                else
+                {
+                    fprintf(stderr, "Invalid session send set: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_RADIOTAP:
+            {
+                if (!strcmp(optarg, "keep"))
+                {
+                    gOpts.radiotap = RADIOTAP_KEEP;
+                }
+                else if (!strcmp(optarg, "strip"))
+                {
+                    gOpts.radiotap = RADIOTAP_STRIP;
+                }
+                else if (!strcmp(optarg, "compact"))
+                {
+                    gOpts.radiotap = RADIOTAP_COMPACT;
+                }
+                else
+                {
+                    fprintf(stderr, "Invalid radiotap mode: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_SUPPRESS:
+            {
+                if (!strcmp(optarg, "off"))
+                {
+                    gOpts.suppress = SUPPRESS_OFF;
+                }
+                else if (!strcmp(optarg, "repeat"))
+                {
+                    gOpts.suppress = SUPPRESS_REPEAT;
+                }
+                else if (!strcmp(optarg, "drop"))
+                {
+                    gOpts.suppress = SUPPRESS_DROP;
+                }
+                else
+                {
+                    fprintf(stderr, "Invalid suppression policy: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_SUPPRESS_ENTRIES:
+            {
+                if (!parse_uint(optarg, &gOpts.suppressEntries) || !gOpts.suppressEntries ||
+                    (gOpts.suppressEntries > WCAP_SUPPRESS_ENTRIES_MAX))
+                {
+                    fprintf(stderr, "Invalid suppression table size: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_SUPPRESS_REFRESH:
+            {
+                if (!parse_uint(optarg, &gOpts.suppressRefresh))
+                {
+                    fprintf(stderr, "Invalid suppression refresh: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_COMPRESS:
+            {
+                if (!strcmp(optarg, "none"))
+                {
+                    gOpts.compress = false;
+                }
+                else if (!strcmp(optarg, "lz4"))
+                {
+                    gOpts.compress = true;
+                }
+                else
+                {
+                    fprintf(stderr, "Invalid compression codec: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_COMPRESS_MIN:
+            {
+                if (!parse_uint(optarg, &gOpts.compressMin))
+                {
+                    fprintf(stderr, "Invalid compression threshold: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_REORDER:
+            {
+                if (!parse_uint(optarg, &gOpts.reorder) || (gOpts.reorder > WCAP_SEQ_REORDER_MAX))
+                {
+                    fprintf(stderr, "Invalid reorder buffer size: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_REORDER_DELAY:
+            {
+                if (!parse_uint(optarg, &gOpts.reorderDelay) || !gOpts.reorderDelay)
+                {
+                    fprintf(stderr, "Invalid reorder delay: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_RECORD:
+            {
+                gOpts.record = optarg;
+                break;
+            }
+            case OPT_RECORD_SIZE:
+            {
+                if (!parse_uint(optarg, &gOpts.recordSize))
+                {
+                    fprintf(stderr, "Invalid capture file size: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_RECORD_TIME:
+            {
+                if (!parse_uint(optarg, &gOpts.recordTime))
+                {
+                    fprintf(stderr, "Invalid capture file duration: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_RECORD_BUFFER:
+            {
+                if (!parse_uint(optarg, &gOpts.recordBuffer) || !gOpts.recordBuffer ||
+                    (gOpts.recordBuffer > 4096))
+                {
+                    fprintf(stderr, "Invalid capture file buffer size: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_RECORD_DIRECT:
+            {
+                gOpts.recordDirect = true;
+                break;
+            }
+            case OPT_REPLAY_SPEED:
+            {
+                if (!strcmp(optarg, "orig"))
+                {
+                    gOpts.replayTimed = true;
+                }
+                else if (!strcmp(optarg, "max"))
+                {
+                    gOpts.replayTimed = false;
+                }
+                else
+                {
+                    fprintf(stderr, "Invalid replay speed: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_REPLAY_LOOP:
+            {
+                if (!parse_uint(optarg, &gOpts.replayLoops))
+                {
+                    fprintf(stderr, "Invalid replay loop count: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_IO:
+            {
+                if (!strcmp(optarg, "epoll"))
+                {
+                    gOpts.io = IO_EPOLL;
+                }
+                else if (!strcmp(optarg, "uring"))
+                {
+                    gOpts.io = IO_URING;
+                }
+                else
+                {
+                    fprintf(stderr, "Invalid I/O mode: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_URING_BUFS:
+            {
+                if (!parse_uint(optarg, &gOpts.uringBufs) || !gOpts.uringBufs ||
+                    (gOpts.uringBufs > WCAP_URING_BUFS_MAX) ||
+                    (gOpts.uringBufs & (gOpts.uringBufs - 1)))
+                {
+                    fprintf(stderr, "Invalid io_uring buffer count: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_XDP:
+            {
+                gOpts.xdp = true;
+                break;
+            }
+            case OPT_XDP_QUEUE:
+            {
+                if (!parse_uint(optarg, &gOpts.xdpQueue) || (gOpts.xdpQueue >= WCAP_XDP_QUEUE_MAX))
+                {
+                    fprintf(stderr, "Invalid XDP queue: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_XDP_FRAMES:
+            {
+                if (!parse_uint(optarg, &gOpts.xdpFrames) || (gOpts.xdpFrames < 2) ||
+                    (gOpts.xdpFrames > WCAP_XSK_FRAME_COUNT_MAX) ||
+                    (gOpts.xdpFrames & (gOpts.xdpFrames - 1)))
+                {
+                    fprintf(stderr, "Invalid UMEM frame count: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case OPT_XDP_COPY:
+            {
+                gOpts.xdpCopy = true;
+                break;
+            }
+            case OPT_BATCH:
+            {
+                if (!parse_uint(optarg, &gOpts.batch) || !gOpts.batch ||
+                    (gOpts.batch > WCAP_UDP_BATCH_MAX))
+                {
+                    fprintf(stderr, "Invalid batch size: %s\n", optarg);
+                    goto exit_fail;
+                }
+                break;
+            }
+            case '?':
+            {
+                if ((optopt == 'c') || (optopt == 'f') || (optopt == 'r'))
+                {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                }
+                else if (optopt >= OPT_RX_RING)
+                {
+                    fprintf (stderr, "Option %s requires an argument.\n", argv[optind - 1]);
+                }
+                goto exit_fail;
+            }
+            default:
+            {
+                goto exit_fail;
+            }
+        }
+    }
+
+    // Compile the capture filter up front, a typo should not cost a setup
+    if (filter && !WcapFilterCreate(&gCtx.filter, filter))
+    {
+        fprintf(stderr, "Invalid capture filter: %s\n", filter);
+        goto exit_fail;
+    }
+    if (dflag)
+    {
+        WcapFilterDump(&gCtx.filter, stdout);
+        WcapFilterDestroy(&gCtx.filter);
+        goto exit_success;
+    }
+
+    // Settings given on their own win over what --low-latency implies
+    if (gOpts.lowLatency)
+    {
+        gOpts.busyPoll = gOpts.busyPoll ? gOpts.busyPoll : WCAP_EVENT_BUSY_POLL_DEF;
+        gOpts.spinUs = gOpts.spinUs ? gOpts.spinUs : WCAP_EVENT_SPIN_DEF;
+    }
+
+    // Validate command line arguments
+    if (!(cflag || sflag || rflag))
+    {
+        fprintf(stderr, "Must specify mode\n");
+        goto exit_fail;
+    }
+    else if ((cflag + sflag + rflag) > 1)
+    {
+        fprintf(stderr, "Must specify only one mode\n");
+        goto exit_fail;
+    }
+
+    // Replay injects into a single wireless interface, nothing is tunneled
+    if (rflag)
+    {
+        if ((argc - optind) != 1)
+        {
+            fprintf(stderr, "Must specify the wireless interface to replay into\n");
+            goto exit_fail;
+        }
+        if ((gOpts.fanout > 1) || gOpts.threads || (gOpts.io != IO_EPOLL) || gOpts.xdp ||
+            gOpts.record)
+        {
+            fprintf(stderr, "-r cannot be combined with --fanout, --threads, --io=uring, --xdp\n"
+                            "  or --record\n");
+            goto exit_fail;
+        }
+        status = do_replay(argv[optind], replay);
+        WcapFilterDestroy(&gCtx.filter);
+        return status ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // One or more wireless interfaces followed by the Ethernet interface
+    if ((argc - optind) < 2)
+    {
+        fprintf(stderr, "Must specify wireless and Ethernet interfaces\n");
+        goto exit_fail;
+    }
+
+    // Each wireless interface is carried in the tunnel numbered after its
+    // position, both ends must list them in the same order
+    wifaces = (const char**) &argv[optind];
+    count = argc - optind - 1;
+    iface = argv[argc - 1];
+
+    if (count > WCAP_ENCAP_TUNNEL_MAX)
+    {
+        fprintf(stderr, "Too many wireless interfaces (max: %d)\n", WCAP_ENCAP_TUNNEL_MAX);
+        goto exit_fail;
+    }
+    if ((count * gOpts.fanout) > WCAP_FANOUT_MAX)
+    {
+        fprintf(stderr, "Too many datapaths: %u radios with %u workers each (max: %d)\n", count,
+                        gOpts.fanout, WCAP_FANOUT_MAX);
+        goto exit_fail;
+    }
+
+    // The pipeline splits a single datapath, workers each own a whole one
+    if (gOpts.threads && ((gOpts.fanout > 1) || (count > 1)))
+    {
+        fprintf(stderr, "--threads requires a single wireless interface without --fanout\n");
+        goto exit_fail;
+    }
+
+    // io_uring receives into its own buffers and drives whole datapaths
+    if ((gOpts.io == IO_URING) && (gOpts.threads || gOpts.rxRing))
+    {
+        fprintf(stderr, "--io=uring cannot be combined with --threads or --rx-ring\n");
+        goto exit_fail;
+    }
+
+    // One AF_XDP socket serves one datapath and sends plain datagrams
+    if (gOpts.xdp && ((count > 1) || (gOpts.fanout > 1) || gOpts.threads ||
+                      (gOpts.io != IO_EPOLL) || gOpts.udpGso || gOpts.udpGro))
+    {
+        fprintf(stderr, "--xdp requires a single wireless interface without --fanout, --threads,\n"
+                        "  --io=uring or UDP offloads\n");
+        goto exit_fail;
+    }
+
+    if (sflag)
+    {
+        status = do_server(wifaces, count, iface);
+    }
+
+    else if (cflag)
+    {
+        status = do_client(wifaces, count, iface, addr);
+    }
+
+    WcapFilterDestroy(&gCtx.filter);
+    return status ? EXIT_SUCCESS : EXIT_FAILURE;
 
 exit_fail:
+    WcapFilterDestroy(&gCtx.filter);
     usage(progname);
     return EXIT_FAILURE;
 